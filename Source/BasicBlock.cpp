@@ -3,14 +3,16 @@
 #include "offsetof_def.h"
 #include "MipsJitter.h"
 #include "Jitter_CodeGenFactory.h"
+#include "JitBlockCache.h"
 
 #if defined(AOT_BUILD_CACHE) || defined(AOT_USE_CACHE)
 #define AOT_ENABLED
 #endif
 
+#include <zlib.h>
+
 #ifdef AOT_ENABLED
 
-#include <zlib.h>
 #include "StdStream.h"
 #include "StdStreamUtils.h"
 
@@ -38,6 +40,30 @@ extern "C" {
 
 #endif
 
+#ifndef AOT_USE_CACHE
+
+static CMipsJitter* GetJitter()
+{
+	//Blocks can be compiled from more than one thread (ie.: threaded VU1)
+	static thread_local CMipsJitter* jitter = nullptr;
+	if(jitter == nullptr)
+	{
+		Jitter::CCodeGen* codeGen = Jitter::CreateCodeGen();
+		jitter = new CMipsJitter(codeGen);
+
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			jitter->SetVariableAsConstant(
+				offsetof(CMIPS, m_State.nGPR[CMIPS::R0].nV[i]),
+				0
+				);
+		}
+	}
+	return jitter;
+}
+
+#endif
+
 CBasicBlock::CBasicBlock(CMIPS& context, uint32 begin, uint32 end)
 : m_begin(begin)
 , m_end(end)
@@ -48,11 +74,16 @@ CBasicBlock::CBasicBlock(CMIPS& context, uint32 begin, uint32 end)
 #endif
 {
 	assert(m_end >= m_begin);
+	for(unsigned int i = 0; i < LINK_SLOT_MAX; i++)
+	{
+		m_linkAddress[i] = MIPS_INVALID_PC;
+		m_linkBlock[i] = nullptr;
+	}
 }
 
 CBasicBlock::~CBasicBlock()
 {
-
+	UnlinkAllBlocks();
 }
 
 #ifdef AOT_BUILD_CACHE
@@ -68,40 +99,51 @@ void CBasicBlock::SetAotBlockOutputStream(Framework::CStdStream* outputStream)
 
 #endif
 
-void CBasicBlock::Compile()
+void CBasicBlock::Compile(CJitBlockCache* blockCache)
 {
+	{
+		uint32 blockSize = ((m_end - m_begin) / 4) + 1;
+		m_codeSnapshot.resize(blockSize);
+		for(uint32 i = 0; i < blockSize; i++)
+		{
+			m_codeSnapshot[i] = m_context.m_pMemoryMap->GetInstruction(m_begin + (i * 4));
+		}
+	}
+
 #ifndef AOT_USE_CACHE
 
-	Framework::CMemStream stream;
+	AOT_BLOCK_KEY blockKey = {};
+	const CJitBlockCache::CodeBuffer* cachedCode = nullptr;
+	if(blockCache)
 	{
-		static
-#ifdef AOT_BUILD_CACHE
-		__declspec(thread)
-#endif
-		CMipsJitter* jitter = nullptr;
-		if(jitter == nullptr)
-		{
-			Jitter::CCodeGen* codeGen = Jitter::CreateCodeGen();
-			jitter = new CMipsJitter(codeGen);
+		blockKey = ComputeBlockKey();
+		cachedCode = blockCache->FindBlock(blockKey);
+	}
 
-			for(unsigned int i = 0; i < 4; i++)
-			{
-				jitter->SetVariableAsConstant(
-					offsetof(CMIPS, m_State.nGPR[CMIPS::R0].nV[i]),
-					0
-					);
-			}
+	if(cachedCode)
+	{
+		m_function = CMemoryFunction(cachedCode->data(), cachedCode->size());
+	}
+	else
+	{
+		Framework::CMemStream stream;
+		{
+			auto jitter = GetJitter();
+			jitter->SetStream(&stream);
+			jitter->Begin();
+			CompileRange(jitter);
+//			codeGen.DumpVariables(0);
+//			codeGen.EndQuota();
+			jitter->End();
 		}
 
-		jitter->SetStream(&stream);
-		jitter->Begin();
-		CompileRange(jitter);
-//		codeGen.DumpVariables(0);
-//		codeGen.EndQuota();
-		jitter->End();
-	}
+		m_function = CMemoryFunction(stream.GetBuffer(), stream.GetSize());
 
-	m_function = CMemoryFunction(stream.GetBuffer(), stream.GetSize());
+		if(blockCache)
+		{
+			blockCache->InsertBlock(blockKey, stream.GetBuffer(), stream.GetSize());
+		}
+	}
 	
 #ifdef VTUNE_ENABLED
 	if(iJIT_IsProfilingActive() == iJIT_SAMPLING_ON)
@@ -178,6 +220,123 @@ void CBasicBlock::Compile()
 #endif
 }
 
+void CBasicBlock::CompileTrace(const BlockArray& blocks)
+{
+#ifndef AOT_USE_CACHE
+	assert(!blocks.empty() && (blocks[0] == this));
+
+	DiscardTrace();
+	m_traceExits.clear();
+
+	Framework::CMemStream stream;
+	{
+		auto jitter = GetJitter();
+		jitter->SetStream(&stream);
+		jitter->Begin();
+
+		//Every exit leaves the PC after the last block that was run, this tells ExecuteTrace
+		//how much was executed. Pending jumps are taken care of by Execute. The PC must not be
+		//touched otherwise, access fault handlers rely on it to know which block is running.
+		auto emitExit =
+			[jitter] (uint32 exitAddress)
+			{
+				jitter->PushCst(exitAddress);
+				jitter->PullRel(offsetof(CMIPS, m_State.nPC));
+				jitter->Goto(jitter->GetFinalBlockLabel());
+			};
+
+		unsigned int instructionCount = 0;
+		for(unsigned int i = 0; i < blocks.size(); i++)
+		{
+			auto block = blocks[i];
+			block->CompileRange(jitter);
+			instructionCount += ((block->m_end - block->m_begin) / 4) + 1;
+
+			uint32 fallthroughAddress = block->m_end + 4;
+			TRACE_EXIT traceExit;
+			traceExit.address = fallthroughAddress;
+			traceExit.instructionCount = instructionCount;
+			m_traceExits.push_back(traceExit);
+
+			if((i + 1) == blocks.size())
+			{
+				emitExit(fallthroughAddress);
+				break;
+			}
+
+			//Leave if an exception was raised or if a block of the trace might have changed.
+			//Both are checked at once to keep the jitter blocks between trace members long.
+			static_assert(MIPS_EXCEPTION_NONE == 0, "MIPS_EXCEPTION_NONE must be 0.");
+			static_assert(sizeof(m_context.m_codeWritten) == sizeof(uint32), "m_codeWritten must be readable as a plain uint32.");
+			jitter->PushRel(offsetof(CMIPS, m_State.nHasException));
+			jitter->PushRel(offsetof(CMIPS, m_codeWritten));
+			jitter->Or();
+			jitter->PushCst(0);
+			jitter->BeginIf(Jitter::CONDITION_NE);
+			{
+				emitExit(fallthroughAddress);
+			}
+			jitter->EndIf();
+
+			uint32 branchTarget = block->GetStaticBranchTarget();
+			if(branchTarget == MIPS_INVALID_PC) continue;
+
+			//Leave if the branch didn't go where the next block of the trace is
+			uint32 nextAddress = blocks[i + 1]->m_begin;
+			branchTarget = m_context.m_pAddrTranslator(&m_context, branchTarget);
+			if(branchTarget != nextAddress)
+			{
+				assert(nextAddress == fallthroughAddress);
+				jitter->PushRel(offsetof(CMIPS, m_State.nDelayedJumpAddr));
+				jitter->PushCst(MIPS_INVALID_PC);
+				jitter->BeginIf(Jitter::CONDITION_NE);
+				{
+					emitExit(fallthroughAddress);
+				}
+				jitter->EndIf();
+				continue;
+			}
+			if(nextAddress != fallthroughAddress)
+			{
+				jitter->PushRel(offsetof(CMIPS, m_State.nDelayedJumpAddr));
+				jitter->PushCst(MIPS_INVALID_PC);
+				jitter->BeginIf(Jitter::CONDITION_EQ);
+				{
+					emitExit(fallthroughAddress);
+				}
+				jitter->EndIf();
+			}
+
+			//We're following the jump, make sure it's not taken again when leaving
+			jitter->PushCst(MIPS_INVALID_PC);
+			jitter->PullRel(offsetof(CMIPS, m_State.nDelayedJumpAddr));
+		}
+
+		jitter->End();
+	}
+
+	m_traceFunction = CMemoryFunction(stream.GetBuffer(), stream.GetSize());
+	m_traceValid = true;
+	m_traceBlocks = blocks;
+	for(unsigned int i = 1; i < blocks.size(); i++)
+	{
+		blocks[i]->m_tracedBy.push_back(this);
+	}
+#endif
+}
+
+AOT_BLOCK_KEY CBasicBlock::ComputeBlockKey() const
+{
+	uint32 blockSize = ((m_end - m_begin) / 4) + 1;
+	assert(m_codeSnapshot.size() == blockSize);
+
+	AOT_BLOCK_KEY result = {};
+	result.crc = crc32(0, reinterpret_cast<const Bytef*>(m_codeSnapshot.data()), blockSize * 4);
+	result.begin = m_begin;
+	result.end = m_end;
+	return result;
+}
+
 void CBasicBlock::CompileRange(CMipsJitter* jitter)
 {
 	for(uint32 address = m_begin; address <= m_end; address += 4)
@@ -193,16 +352,38 @@ void CBasicBlock::CompileRange(CMipsJitter* jitter)
 
 unsigned int CBasicBlock::Execute()
 {
-	m_function(&m_context);
+	unsigned int instructionCount = 0;
 
-	if(m_context.m_State.nDelayedJumpAddr != MIPS_INVALID_PC)
+#ifndef AOT_USE_CACHE
+	if(m_traceValid)
 	{
-		m_context.m_State.nPC = m_context.m_State.nDelayedJumpAddr;
-		m_context.m_State.nDelayedJumpAddr = MIPS_INVALID_PC;
+		instructionCount = ExecuteTrace();
 	}
 	else
+#endif
 	{
-		m_context.m_State.nPC = m_end + 4;
+#ifndef AOT_USE_CACHE
+		if(!m_traceFunction.IsEmpty())
+		{
+			//Trace was invalidated, its code can't be running anymore at this point
+			m_traceFunction = CMemoryFunction();
+			m_traceExits.clear();
+		}
+#endif
+
+		m_function(&m_context);
+
+		if(m_context.m_State.nDelayedJumpAddr != MIPS_INVALID_PC)
+		{
+			m_context.m_State.nPC = m_context.m_State.nDelayedJumpAddr;
+			m_context.m_State.nDelayedJumpAddr = MIPS_INVALID_PC;
+		}
+		else
+		{
+			m_context.m_State.nPC = m_end + 4;
+		}
+
+		instructionCount = ((m_end - m_begin) / 4) + 1;
 	}
 
 	assert(m_context.m_State.nGPR[0].nV0 == 0);
@@ -217,7 +398,34 @@ unsigned int CBasicBlock::Execute()
 	assert(m_context.m_State.nCOP2[0].nV3 == 0x3F800000);
 	assert(m_context.m_State.nCOP2VI[0] == 0);
 
-	return ((m_end - m_begin) / 4) + 1;
+	return instructionCount;
+}
+
+unsigned int CBasicBlock::ExecuteTrace()
+{
+#ifndef AOT_USE_CACHE
+	//m_codeWritten is cleared by the executor once it has taken care of the writes
+	m_traceFunction(&m_context);
+
+	uint32 exitAddress = m_context.m_State.nPC;
+	if(m_context.m_State.nDelayedJumpAddr != MIPS_INVALID_PC)
+	{
+		m_context.m_State.nPC = m_context.m_State.nDelayedJumpAddr;
+		m_context.m_State.nDelayedJumpAddr = MIPS_INVALID_PC;
+	}
+
+	for(const auto& traceExit : m_traceExits)
+	{
+		if(traceExit.address == exitAddress)
+		{
+			return traceExit.instructionCount;
+		}
+	}
+	assert(false);
+	return m_traceExits.back().instructionCount;
+#else
+	return 0;
+#endif
 }
 
 uint32 CBasicBlock::GetBeginAddress() const
@@ -248,3 +456,207 @@ void CBasicBlock::SetSelfLoopCount(unsigned int selfLoopCount)
 {
 	m_selfLoopCount = selfLoopCount;
 }
+
+uint32 CBasicBlock::GetExecutionCount() const
+{
+	return m_executionCount;
+}
+
+uint32 CBasicBlock::IncrementExecutionCount()
+{
+	return ++m_executionCount;
+}
+
+uint32 CBasicBlock::GetBranchTakenCount() const
+{
+	return m_branchTakenCount;
+}
+
+void CBasicBlock::RecordSuccessor(uint32 physicalAddress)
+{
+	if(physicalAddress != (m_end + 4))
+	{
+		m_branchTakenCount++;
+	}
+}
+
+bool CBasicBlock::HasTrace() const
+{
+	return m_traceValid;
+}
+
+bool CBasicBlock::IsValidationPending() const
+{
+	return m_validationPending;
+}
+
+void CBasicBlock::SetValidationPending(bool validationPending)
+{
+	m_validationPending = validationPending;
+}
+
+bool CBasicBlock::HasCodeChanged() const
+{
+	assert(IsCompiled());
+	for(uint32 i = 0; i < m_codeSnapshot.size(); i++)
+	{
+		if(m_context.m_pMemoryMap->GetInstruction(m_begin + (i * 4)) != m_codeSnapshot[i])
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+CBasicBlock* CBasicBlock::GetLinkedBlock(uint32 address) const
+{
+	for(unsigned int i = 0; i < LINK_SLOT_MAX; i++)
+	{
+		if(m_linkAddress[i] == address)
+		{
+			return m_linkBlock[i];
+		}
+	}
+	return nullptr;
+}
+
+void CBasicBlock::TryLinkBlock(uint32 address, uint32 physicalAddress, CBasicBlock* block)
+{
+	//Only link to successors that can be known by looking at the code. Blocks ending with
+	//a jump to a register would keep replacing their links otherwise.
+	LINK_SLOT slot = LINK_SLOT_MAX;
+	if(physicalAddress == (m_end + 4))
+	{
+		slot = LINK_SLOT_NEXT;
+	}
+	else if(physicalAddress == GetStaticBranchTarget())
+	{
+		slot = LINK_SLOT_BRANCH;
+	}
+	else
+	{
+		return;
+	}
+
+	if(m_linkBlock[slot] == block) return;
+
+	UnlinkBlock(slot);
+	m_linkAddress[slot] = address;
+	m_linkBlock[slot] = block;
+	block->m_linkedFrom.push_back(this);
+}
+
+void CBasicBlock::UnlinkAllBlocks()
+{
+	//Traces are links too, ours and the ones we're part of
+	DiscardTrace();
+	auto tracedBy = m_tracedBy;
+	for(const auto& headBlock : tracedBy)
+	{
+		headBlock->InvalidateTrace();
+	}
+	assert(m_tracedBy.empty());
+
+	for(unsigned int i = 0; i < LINK_SLOT_MAX; i++)
+	{
+		UnlinkBlock(static_cast<LINK_SLOT>(i));
+	}
+	//Copy the list since unlinking will modify it
+	auto linkedFrom = m_linkedFrom;
+	for(const auto& sourceBlock : linkedFrom)
+	{
+		for(unsigned int i = 0; i < LINK_SLOT_MAX; i++)
+		{
+			if(sourceBlock->m_linkBlock[i] == this)
+			{
+				sourceBlock->UnlinkBlock(static_cast<LINK_SLOT>(i));
+			}
+		}
+	}
+	assert(m_linkedFrom.empty());
+}
+
+void CBasicBlock::UnlinkBlock(LINK_SLOT slot)
+{
+	auto block = m_linkBlock[slot];
+	if(block == nullptr) return;
+	auto linkedFromIterator = std::find(std::begin(block->m_linkedFrom), std::end(block->m_linkedFrom), this);
+	assert(linkedFromIterator != std::end(block->m_linkedFrom));
+	block->m_linkedFrom.erase(linkedFromIterator);
+	m_linkAddress[slot] = MIPS_INVALID_PC;
+	m_linkBlock[slot] = nullptr;
+}
+
+void CBasicBlock::DiscardTrace()
+{
+	//Code isn't released here since we might be running it (ie.: invalidated by a write
+	//to a block of the trace), Execute will take care of it
+	for(unsigned int i = 1; i < m_traceBlocks.size(); i++)
+	{
+		auto& tracedBy = m_traceBlocks[i]->m_tracedBy;
+		auto tracedByIterator = std::find(std::begin(tracedBy), std::end(tracedBy), this);
+		assert(tracedByIterator != std::end(tracedBy));
+		tracedBy.erase(tracedByIterator);
+	}
+	m_traceBlocks.clear();
+	if(m_traceValid)
+	{
+		//We might be running, make sure we don't go into the blocks that come after the current one
+		m_context.m_codeWritten = 1;
+	}
+	m_traceValid = false;
+}
+
+void CBasicBlock::InvalidateTrace()
+{
+	DiscardTrace();
+	//Give it a chance to become hot again with the new code
+	m_executionCount = 0;
+	m_branchTakenCount = 0;
+}
+
+uint32 CBasicBlock::GetStaticBranchTarget()
+{
+	AnalyseBranch();
+	return m_branchTarget;
+}
+
+bool CBasicBlock::HasStaticSuccessors()
+{
+	AnalyseBranch();
+	return !m_hasDynamicExit;
+}
+
+void CBasicBlock::AnalyseBranch()
+{
+	if(m_branchAnalysed) return;
+	m_branchAnalysed = true;
+
+	auto arch = m_context.m_pArch;
+	uint32 lastOpcode = m_context.m_pMemoryMap->GetInstruction(m_end);
+	if(arch->IsInstructionBranch(&m_context, m_end, lastOpcode) != MIPS_BRANCH_NONE)
+	{
+		//Either something like SYSCALL or ERET, or a branch that got its delay slot split away
+		m_hasDynamicExit = true;
+	}
+
+	if(m_end != m_begin)
+	{
+		//Branch instruction sits before the delay slot that ends the block
+		uint32 branchAddress = m_end - 4;
+		uint32 opcode = m_context.m_pMemoryMap->GetInstruction(branchAddress);
+		if(arch->IsInstructionBranch(&m_context, branchAddress, opcode) == MIPS_BRANCH_NORMAL)
+		{
+			//Jumps to registers don't have an effective address
+			uint32 branchTarget = arch->GetInstructionEffectiveAddress(&m_context, branchAddress, opcode);
+			if(branchTarget == 0)
+			{
+				m_hasDynamicExit = true;
+			}
+			else
+			{
+				m_branchTarget = branchTarget;
+			}
+		}
+	}
+}
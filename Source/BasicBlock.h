@@ -1,5 +1,6 @@
 #pragma once
 
+#include <vector>
 #include "MIPS.h"
 #include "MemoryFunction.h"
 #ifdef AOT_BUILD_CACHE
@@ -40,13 +41,25 @@ namespace Jitter
 	class CJitter;
 };
 
+class CJitBlockCache;
+
 class CBasicBlock
 {
 public:
+	enum LINK_SLOT
+	{
+		LINK_SLOT_NEXT,
+		LINK_SLOT_BRANCH,
+		LINK_SLOT_MAX,
+	};
+
+	typedef std::vector<CBasicBlock*> BlockArray;
+
 									CBasicBlock(CMIPS&, uint32, uint32);
 	virtual							~CBasicBlock();
 	unsigned int					Execute();
-	void							Compile();
+	void							Compile(CJitBlockCache*);
+	void							CompileTrace(const BlockArray&);
 
 	uint32							GetBeginAddress() const;
 	uint32							GetEndAddress() const;
@@ -54,6 +67,22 @@ public:
 	unsigned int					GetSelfLoopCount() const;
 	void							SetSelfLoopCount(unsigned int);
 
+	uint32							GetExecutionCount() const;
+	uint32							IncrementExecutionCount();
+	uint32							GetBranchTakenCount() const;
+	void							RecordSuccessor(uint32);
+	bool							HasTrace() const;
+	bool							HasStaticSuccessors();
+
+	bool							IsValidationPending() const;
+	void							SetValidationPending(bool);
+	bool							HasCodeChanged() const;
+	uint32							GetStaticBranchTarget();
+
+	CBasicBlock*					GetLinkedBlock(uint32) const;
+	void							TryLinkBlock(uint32, uint32, CBasicBlock*);
+	void							UnlinkAllBlocks();
+
 #ifdef AOT_BUILD_CACHE
 	static void						SetAotBlockOutputStream(Framework::CStdStream*);
 #endif
@@ -66,6 +95,19 @@ protected:
 	virtual void					CompileRange(CMipsJitter*);
 
 private:
+	struct TRACE_EXIT
+	{
+		uint32						address;
+		unsigned int				instructionCount;
+	};
+	typedef std::vector<TRACE_EXIT> TraceExitArray;
+
+	AOT_BLOCK_KEY					ComputeBlockKey() const;
+	void							AnalyseBranch();
+	void							UnlinkBlock(LINK_SLOT);
+	unsigned int					ExecuteTrace();
+	void							DiscardTrace();
+	void							InvalidateTrace();
 
 #ifdef AOT_BUILD_CACHE
 	static Framework::CStdStream*	m_aotBlockOutputStream;
@@ -79,4 +121,33 @@ private:
 #endif
 
 	unsigned int					m_selfLoopCount;
+	uint32							m_executionCount = 0;
+	uint32							m_branchTakenCount = 0;
+
+	//Code the block was compiled from, used to check if the block is still valid after
+	//something was written near it
+	std::vector<uint32>				m_codeSnapshot;
+	bool							m_validationPending = false;
+
+	//Successor blocks that we know about. Link addresses are the (virtual) PC values
+	//that were used when the link was established. Links are a cache for the dispatcher
+	//in CMipsExecutor::Execute, they save it the address translation and block table
+	//lookup. Generated code isn't patched and still returns to the dispatcher after
+	//every block, the jitter doesn't emit jumps that could be patched later on.
+	uint32							m_linkAddress[LINK_SLOT_MAX];
+	CBasicBlock*					m_linkBlock[LINK_SLOT_MAX];
+	std::vector<CBasicBlock*>		m_linkedFrom;
+	bool							m_branchAnalysed = false;
+	bool							m_hasDynamicExit = false;
+	uint32							m_branchTarget = MIPS_INVALID_PC;
+
+	//Second tier: code for a chain of hot blocks starting with this one. Blocks that are
+	//part of it know about us through m_tracedBy and will invalidate it if they go away.
+#ifndef AOT_USE_CACHE
+	CMemoryFunction					m_traceFunction;
+#endif
+	bool							m_traceValid = false;
+	BlockArray						m_traceBlocks;
+	TraceExitArray					m_traceExits;
+	std::vector<CBasicBlock*>		m_tracedBy;
 };
@@ -472,6 +472,18 @@ void CCOP_FPU::CVT_S_W()
 //31
 void CCOP_FPU::LWC1()
 {
+	bool fastMemory = IsFastMemoryEnabled();
+	if(fastMemory)
+	{
+		BeginFastMemoryAccess();
+		{
+			PushFastMemoryRef();
+			m_codeGen->LoadFromRef();
+			m_codeGen->PullRel(offsetof(CMIPS, m_State.nCOP1[m_ft]));
+		}
+		m_codeGen->Else();
+	}
+
 	ComputeMemAccessAddr();
 
 	m_codeGen->PushCtx();
@@ -481,11 +493,28 @@ void CCOP_FPU::LWC1()
 	m_codeGen->PullRel(offsetof(CMIPS, m_State.nCOP1[m_ft]));
 
 	m_codeGen->PullTop();
+
+	if(fastMemory)
+	{
+		m_codeGen->EndIf();
+	}
 }
 
 //39
 void CCOP_FPU::SWC1()
 {
+	bool fastMemory = IsFastMemoryEnabled();
+	if(fastMemory)
+	{
+		BeginFastMemoryAccess();
+		{
+			PushFastMemoryRef();
+			m_codeGen->PushRel(offsetof(CMIPS, m_State.nCOP1[m_ft]));
+			m_codeGen->StoreAtRef();
+		}
+		m_codeGen->Else();
+	}
+
 	ComputeMemAccessAddr();
 
 	m_codeGen->PushCtx();
@@ -494,6 +523,11 @@ void CCOP_FPU::SWC1()
 	m_codeGen->Call(reinterpret_cast<void*>(&MemoryUtils_SetWordProxy), 3, false);
 
 	m_codeGen->PullTop();
+
+	if(fastMemory)
+	{
+		m_codeGen->EndIf();
+	}
 }
 
 //////////////////////////////////////////////////
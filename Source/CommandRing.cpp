@@ -0,0 +1,175 @@
+#include <cassert>
+#include <thread>
+#include "CommandRing.h"
+#include "AlignedAlloc.h"
+
+#define PACKET_TYPE_PADDING		(~0U)
+#define PACKET_ALIGNMENT		(0x10)
+
+//Some consumers read a few bytes past the end of packets (ie.: 24-bits pixel transfers)
+#define BUFFER_SLACK_SIZE		(0x10)
+
+CCommandRing::CCommandRing(uint32 capacity)
+: m_capacity(capacity)
+, m_writePosition(0)
+, m_readPosition(0)
+, m_consumerWaiting(false)
+{
+	assert((capacity & (capacity - 1)) == 0);
+	m_buffer = reinterpret_cast<uint8*>(framework_aligned_alloc(m_capacity + BUFFER_SLACK_SIZE, PACKET_ALIGNMENT));
+}
+
+CCommandRing::~CCommandRing()
+{
+	framework_aligned_free(m_buffer);
+}
+
+uint32 CCommandRing::GetMaxPacketSize() const
+{
+	//Keep packets small enough so that the producer never has to wait for the whole ring to drain
+	return (m_capacity / 4) - sizeof(PACKET);
+}
+
+uint32 CCommandRing::GetPacketSize(uint32 dataSize)
+{
+	return (sizeof(PACKET) + dataSize + PACKET_ALIGNMENT - 1) & ~(PACKET_ALIGNMENT - 1);
+}
+
+//Tells if a packet can be started right away, without having to wait for the consumer
+bool CCommandRing::CanBeginPacket(uint32 size) const
+{
+	uint32 packetSize = GetPacketSize(size);
+	uint64 writePosition = m_writePosition.load(std::memory_order_relaxed);
+	uint32 offset = static_cast<uint32>(writePosition & (m_capacity - 1));
+	if((offset + packetSize) > m_capacity)
+	{
+		packetSize += m_capacity - offset;
+	}
+	return (writePosition + packetSize - m_readPosition.load(std::memory_order_acquire)) <= m_capacity;
+}
+
+void* CCommandRing::BeginPacket(uint32 type, uint32 size)
+{
+	assert(type != PACKET_TYPE_PADDING);
+	assert(size <= GetMaxPacketSize());
+
+	uint32 packetSize = GetPacketSize(size);
+	uint64 writePosition = m_writePosition.load(std::memory_order_relaxed);
+	uint32 offset = static_cast<uint32>(writePosition & (m_capacity - 1));
+	if((offset + packetSize) > m_capacity)
+	{
+		//Packet doesn't fit before the end of the buffer, skip what's left and start over from the beginning
+		uint32 paddingSize = m_capacity - offset;
+		WaitForSpace(writePosition, paddingSize);
+		auto padding = reinterpret_cast<PACKET*>(m_buffer + offset);
+		padding->type = PACKET_TYPE_PADDING;
+		padding->size = paddingSize - sizeof(PACKET);
+		writePosition += paddingSize;
+		PublishWritePosition(writePosition);
+		offset = 0;
+	}
+
+	WaitForSpace(writePosition, packetSize);
+	auto packet = reinterpret_cast<PACKET*>(m_buffer + offset);
+	packet->type = type;
+	packet->size = size;
+	m_pendingPacket = packet;
+	m_pendingWritePosition = writePosition + packetSize;
+	return packet->GetData();
+}
+
+void CCommandRing::EndPacket()
+{
+	assert(m_pendingWritePosition != 0);
+	PublishWritePosition(m_pendingWritePosition);
+	m_pendingPacket = nullptr;
+	m_pendingWritePosition = 0;
+}
+
+//Used when the final size of a packet isn't known when it's started, the space
+//reserved past the given size is given back to the ring
+void CCommandRing::EndPacket(uint32 size)
+{
+	assert(m_pendingPacket != nullptr);
+	assert(size <= m_pendingPacket->size);
+	uint64 packetPosition = m_pendingWritePosition - GetPacketSize(m_pendingPacket->size);
+	m_pendingPacket->size = size;
+	m_pendingWritePosition = packetPosition + GetPacketSize(size);
+	EndPacket();
+}
+
+uint64 CCommandRing::GetWritePosition() const
+{
+	return m_writePosition.load(std::memory_order_acquire);
+}
+
+CCommandRing::PACKET* CCommandRing::ReadPacket()
+{
+	while(1)
+	{
+		uint64 readPosition = m_readPosition.load(std::memory_order_relaxed);
+		if(readPosition == m_writePosition.load(std::memory_order_acquire))
+		{
+			return nullptr;
+		}
+		auto packet = reinterpret_cast<PACKET*>(m_buffer + (readPosition & (m_capacity - 1)));
+		if(packet->type != PACKET_TYPE_PADDING)
+		{
+			return packet;
+		}
+		m_readPosition.store(readPosition + sizeof(PACKET) + packet->size, std::memory_order_release);
+	}
+}
+
+void CCommandRing::ReleasePacket()
+{
+	uint64 readPosition = m_readPosition.load(std::memory_order_relaxed);
+	assert(readPosition != m_writePosition.load(std::memory_order_acquire));
+	auto packet = reinterpret_cast<PACKET*>(m_buffer + (readPosition & (m_capacity - 1)));
+	m_readPosition.store(readPosition + GetPacketSize(packet->size), std::memory_order_release);
+}
+
+uint64 CCommandRing::GetReadPosition() const
+{
+	return m_readPosition.load(std::memory_order_relaxed);
+}
+
+void CCommandRing::WaitForPacket(unsigned int timeOut)
+{
+	std::unique_lock<std::mutex> waitLock(m_waitMutex);
+	m_consumerWaiting = true;
+	m_waitCondition.wait_for(waitLock, std::chrono::milliseconds(timeOut),
+		[this] ()
+		{
+			return m_notified || (m_readPosition.load(std::memory_order_relaxed) != m_writePosition.load());
+		}
+	);
+	m_consumerWaiting = false;
+	m_notified = false;
+}
+
+void CCommandRing::Notify()
+{
+	std::lock_guard<std::mutex> waitLock(m_waitMutex);
+	m_notified = true;
+	m_waitCondition.notify_one();
+}
+
+void CCommandRing::WaitForSpace(uint64 writePosition, uint32 size)
+{
+	while((writePosition + size - m_readPosition.load(std::memory_order_acquire)) > m_capacity)
+	{
+		std::this_thread::yield();
+	}
+}
+
+void CCommandRing::PublishWritePosition(uint64 writePosition)
+{
+	//Sequentially consistent store/load pair makes sure we can't miss a consumer going to sleep
+	m_writePosition.store(writePosition);
+	if(m_consumerWaiting.load())
+	{
+		std::lock_guard<std::mutex> waitLock(m_waitMutex);
+		m_waitCondition.notify_one();
+	}
+}
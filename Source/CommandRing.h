@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include "Types.h"
+
+//Single producer/single consumer queue of variable sized packets. Packets are
+//written in place in a preallocated buffer, so queuing a packet never allocates
+//and never takes a lock. Only one thread may read from the ring. Writers on
+//different threads must be serialized by the caller, a packet being written
+//from BeginPacket to EndPacket. CGIF's path mutex does this for the GS handler's
+//ring, paths 1 and 2 being processed on the VU1 thread and path 3 on the EE thread.
+class CCommandRing
+{
+public:
+	struct PACKET
+	{
+		uint32			type;
+		uint32			size;
+		uint32			reserved[2];
+
+		void*			GetData()
+		{
+			return this + 1;
+		}
+	};
+	static_assert(sizeof(PACKET) == 0x10, "Size of PACKET struct must be 16 bytes.");
+
+						CCommandRing(uint32);
+	virtual				~CCommandRing();
+
+	uint32				GetMaxPacketSize() const;
+
+	//Producer side
+	bool				CanBeginPacket(uint32) const;
+	void*				BeginPacket(uint32, uint32);
+	void				EndPacket();
+	void				EndPacket(uint32);
+	uint64				GetWritePosition() const;
+
+	//Consumer side
+	PACKET*				ReadPacket();
+	void				ReleasePacket();
+	uint64				GetReadPosition() const;
+	void				WaitForPacket(unsigned int);
+
+	void				Notify();
+
+private:
+	static uint32		GetPacketSize(uint32);
+	void				WaitForSpace(uint64, uint32);
+	void				PublishWritePosition(uint64);
+
+	uint8*				m_buffer = nullptr;
+	uint32				m_capacity = 0;
+	PACKET*				m_pendingPacket = nullptr;
+	uint64				m_pendingWritePosition = 0;
+
+	std::atomic<uint64>	m_writePosition;
+	std::atomic<uint64>	m_readPosition;
+
+	std::atomic<bool>		m_consumerWaiting;
+	bool					m_notified = false;
+	std::mutex				m_waitMutex;
+	std::condition_variable	m_waitCondition;
+};
@@ -1,12 +1,15 @@
 #pragma once
 
+#include <memory>
+#include <mutex>
 #include "Types.h"
 #include "Stream.h"
+#include "ImageFrameCache.h"
 
 class CCsoImageStream : public Framework::CStream
 {
 public:
-						CCsoImageStream(Framework::CStream* baseStream);
+						CCsoImageStream(Framework::CStream* baseStream, uint32 cacheSize = CImageFrameCache::DEFAULT_CACHE_SIZE, bool prefetchEnabled = true);
 	virtual				~CCsoImageStream();
 
 	virtual void		Seek(int64 pos, Framework::STREAM_SEEK_DIRECTION whence) override;
@@ -21,16 +24,19 @@ private:
 	uint64				GetTotalSize() const;
 	uint32				ReadFromNextFrame(uint8* dest, uint64 maxBytes);
 	uint64				ReadBaseAt(uint64 pos, uint8* dest, uint64 bytes);
-	void				DecompressFrame(uint32 frame, uint64 readBufferSize);
+	void				LoadFrame(uint32 frame, uint8* dest);
+	void				DecompressFrame(const uint8* src, uint64 srcSize, uint8* dest);
+
+	typedef std::unique_ptr<CImageFrameCache> FrameCachePtr;
 
 	Framework::CStream*	m_baseStream;
+	std::mutex			m_baseStreamMutex;
 	uint32				m_frameSize;
+	uint32				m_frameCount;
 	uint8				m_frameShift;
 	uint8				m_indexShift;
-	uint8*				m_readBuffer;
-	uint8*				m_zlibBuffer;
-	uint32				m_zlibBufferFrame;
 	uint32*				m_index;
 	uint64				m_totalSize;
 	uint64				m_position;
+	FrameCachePtr		m_frameCache;
 };
@@ -1,10 +1,12 @@
 #include <boost/algorithm/string.hpp>
 #include "make_unique.h"
+#include "AppConfig.h"
 #include "Utils.h"
 #include "stricmp.h"
 #include "DiskUtils.h"
 #include "IszImageStream.h"
 #include "CsoImageStream.h"
+#include "ISO9660/BlockProviderMapped.h"
 #include "StdStream.h"
 #ifdef WIN32
 #include "VolumeStream.h"
@@ -30,15 +32,17 @@ DiskUtils::Iso9660Ptr DiskUtils::CreateDiskImageFromPath(const boost::filesystem
 
 	std::shared_ptr<Framework::CStream> stream;
 	auto extension = imagePath.extension().string();
+	uint32 cacheSize = CAppConfig::GetInstance().GetPreferenceInteger(PREF_DISKIMAGE_CACHESIZE);
+	bool prefetchEnabled = CAppConfig::GetInstance().GetPreferenceBoolean(PREF_DISKIMAGE_PREFETCH_ENABLED);
 
 	//Gotta think of something better than that...
 	if(!stricmp(extension.c_str(), ".isz"))
 	{
-		stream = std::make_shared<CIszImageStream>(CreateImageStream(imagePath));
+		stream = std::make_shared<CIszImageStream>(CreateImageStream(imagePath), cacheSize, prefetchEnabled);
 	}
 	else if(!stricmp(extension.c_str(), ".cso"))
 	{
-		stream = std::make_shared<CCsoImageStream>(CreateImageStream(imagePath));
+		stream = std::make_shared<CCsoImageStream>(CreateImageStream(imagePath), cacheSize, prefetchEnabled);
 	}
 #ifdef WIN32
 	else if(imagePath.string()[0] == '\\')
@@ -60,13 +64,25 @@ DiskUtils::Iso9660Ptr DiskUtils::CreateDiskImageFromPath(const boost::filesystem
 	}
 #endif
 
-	//If it's null after all that, just feed it to a StdStream
+	Iso9660Ptr result;
+
+	//If it's null after all that, it's a plain image file. Try mapping it in memory first
+	//and fall back to a StdStream if that doesn't work (ie.: not enough address space)
 	if(!stream)
 	{
+		try
+		{
+			auto blockProvider = std::make_shared<ISO9660::CBlockProviderMapped>(imagePath);
+			result = std::make_unique<CISO9660>(blockProvider);
+			return result;
+		}
+		catch(...)
+		{
+			//Not mappable or not a 2048 bytes per sector image
+		}
 		stream = std::shared_ptr<Framework::CStream>(CreateImageStream(imagePath));
 	}
 
-	Iso9660Ptr result;
 	try
 	{
 		auto blockProvider = std::make_shared<ISO9660::CBlockProvider2048>(stream);
@@ -5,6 +5,9 @@
 #include <boost/filesystem.hpp>
 #include "ISO9660/ISO9660.h"
 
+#define PREF_DISKIMAGE_CACHESIZE			("diskimage.cachesize")
+#define PREF_DISKIMAGE_PREFETCH_ENABLED		("diskimage.prefetch.enabled")
+
 namespace DiskUtils
 {
 	typedef std::unique_ptr<CISO9660> Iso9660Ptr;
@@ -0,0 +1,139 @@
+#include <cassert>
+#include <algorithm>
+#include "EventScheduler.h"
+
+//Past this many entries per event, stale entries are removed all at once
+#define MAX_ENTRIES_PER_EVENT	(4)
+
+CEventScheduler::CEventScheduler(unsigned int eventCount)
+: m_generations(eventCount, 0)
+, m_deadlines(eventCount, 0)
+, m_scheduled(eventCount, false)
+{
+
+}
+
+void CEventScheduler::Reset()
+{
+	m_heap.clear();
+	std::fill(std::begin(m_scheduled), std::end(m_scheduled), false);
+	m_time = 0;
+	ResetStats();
+}
+
+void CEventScheduler::SetSliceLimits(int minSliceTicks, int maxSliceTicks)
+{
+	m_minSliceTicks = std::max(minSliceTicks, 1);
+	m_maxSliceTicks = std::max(maxSliceTicks, m_minSliceTicks);
+}
+
+int CEventScheduler::GetMinSliceTicks() const
+{
+	return m_minSliceTicks;
+}
+
+int CEventScheduler::GetMaxSliceTicks() const
+{
+	return m_maxSliceTicks;
+}
+
+int64 CEventScheduler::GetTime() const
+{
+	return m_time;
+}
+
+void CEventScheduler::Schedule(unsigned int eventId, int64 deadline)
+{
+	assert(eventId < m_generations.size());
+	if(m_scheduled[eventId] && (m_deadlines[eventId] == deadline)) return;
+	//Older entries of the same event are left in the heap and skipped when they reach the top
+	uint32 generation = ++m_generations[eventId];
+	m_deadlines[eventId] = deadline;
+	m_scheduled[eventId] = true;
+	if(m_heap.size() >= (m_generations.size() * MAX_ENTRIES_PER_EVENT))
+	{
+		m_heap.erase(
+			std::remove_if(std::begin(m_heap), std::end(m_heap),
+				[this] (const ENTRY& entry) { return entry.generation != m_generations[entry.eventId]; }),
+			std::end(m_heap));
+		std::make_heap(std::begin(m_heap), std::end(m_heap));
+	}
+	ENTRY entry;
+	entry.deadline = deadline;
+	entry.eventId = eventId;
+	entry.generation = generation;
+	m_heap.push_back(entry);
+	std::push_heap(std::begin(m_heap), std::end(m_heap));
+}
+
+void CEventScheduler::Cancel(unsigned int eventId)
+{
+	assert(eventId < m_generations.size());
+	m_generations[eventId]++;
+	m_scheduled[eventId] = false;
+}
+
+bool CEventScheduler::IsScheduled(unsigned int eventId) const
+{
+	assert(eventId < m_scheduled.size());
+	return m_scheduled[eventId];
+}
+
+int64 CEventScheduler::GetDeadline(unsigned int eventId) const
+{
+	assert(eventId < m_deadlines.size());
+	return m_deadlines[eventId];
+}
+
+bool CEventScheduler::PopDueEvent(unsigned int& eventId)
+{
+	DiscardStaleEntries();
+	if(m_heap.empty()) return false;
+	const auto& entry = m_heap.front();
+	if(entry.deadline > m_time) return false;
+	eventId = entry.eventId;
+	m_scheduled[eventId] = false;
+	std::pop_heap(std::begin(m_heap), std::end(m_heap));
+	m_heap.pop_back();
+	return true;
+}
+
+int CEventScheduler::GetSliceTicks()
+{
+	DiscardStaleEntries();
+	int64 sliceTicks = m_maxSliceTicks;
+	if(!m_heap.empty())
+	{
+		sliceTicks = std::min<int64>(sliceTicks, m_heap.front().deadline - m_time);
+	}
+	return static_cast<int>(std::max<int64>(sliceTicks, m_minSliceTicks));
+}
+
+void CEventScheduler::Advance(int ticks)
+{
+	assert(ticks >= 0);
+	m_time += ticks;
+	m_stats.sliceCount++;
+	m_stats.sliceTicks += ticks;
+}
+
+const CEventScheduler::STATS& CEventScheduler::GetStats() const
+{
+	return m_stats;
+}
+
+void CEventScheduler::ResetStats()
+{
+	m_stats = STATS();
+}
+
+void CEventScheduler::DiscardStaleEntries()
+{
+	while(!m_heap.empty())
+	{
+		const auto& entry = m_heap.front();
+		if(entry.generation == m_generations[entry.eventId]) break;
+		std::pop_heap(std::begin(m_heap), std::end(m_heap));
+		m_heap.pop_back();
+	}
+}
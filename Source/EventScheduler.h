@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include "Types.h"
+
+//Keeps the deadlines of upcoming events in a min-heap so that the emulation loop can
+//let the processors run until the next event that could affect them. Time is counted
+//in ticks of the master clock and event identifiers are small integers chosen by the user.
+class CEventScheduler
+{
+public:
+	struct STATS
+	{
+		uint64		sliceCount = 0;
+		uint64		sliceTicks = 0;
+
+		double GetAverageSliceTicks() const
+		{
+			return (sliceCount == 0) ? 0 : static_cast<double>(sliceTicks) / static_cast<double>(sliceCount);
+		}
+	};
+
+					CEventScheduler(unsigned int);
+	virtual			~CEventScheduler() = default;
+
+	void			Reset();
+
+	void			SetSliceLimits(int, int);
+	int				GetMinSliceTicks() const;
+	int				GetMaxSliceTicks() const;
+
+	int64			GetTime() const;
+
+	//Replaces the previous deadline of the event, if any
+	void			Schedule(unsigned int, int64);
+	void			Cancel(unsigned int);
+	bool			IsScheduled(unsigned int) const;
+	//Last deadline given to the event, still valid once the event was popped
+	int64			GetDeadline(unsigned int) const;
+	bool			PopDueEvent(unsigned int&);
+
+	//Ticks until the next deadline, within slice limits
+	int				GetSliceTicks();
+	void			Advance(int);
+
+	const STATS&	GetStats() const;
+	void			ResetStats();
+
+private:
+	struct ENTRY
+	{
+		int64		deadline;
+		uint32		eventId;
+		uint32		generation;
+
+		bool operator <(const ENTRY& rhs) const
+		{
+			//Reversed to get a min-heap out of the std heap functions
+			return deadline > rhs.deadline;
+		}
+	};
+
+	void			DiscardStaleEntries();
+
+	std::vector<ENTRY>		m_heap;
+	std::vector<uint32>		m_generations;
+	std::vector<int64>		m_deadlines;
+	std::vector<bool>		m_scheduled;
+	int64					m_time = 0;
+	int						m_minSliceTicks = 1;
+	int						m_maxSliceTicks = 1;
+	STATS					m_stats;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include "Types.h"
 #include "Stream.h"
 
@@ -16,6 +17,22 @@ namespace ISO9660
 
 		virtual				~CBlockProvider() {};
 		virtual void		ReadBlock(uint32, void*) = 0;
+
+		virtual void ReadBlocks(uint32 address, uint32 count, void* blocks)
+		{
+			auto output = reinterpret_cast<uint8*>(blocks);
+			for(unsigned int i = 0; i < count; i++)
+			{
+				ReadBlock(address + i, output + (i * BLOCKSIZE));
+			}
+		}
+
+		//Returns a pointer to the data of a range of blocks if the provider
+		//has direct access to it, nullptr otherwise.
+		virtual const uint8* GetBlocks(uint32, uint32)
+		{
+			return nullptr;
+		}
 	};
 
 	class CBlockProvider2048 : public CBlockProvider
@@ -75,4 +92,44 @@ namespace ISO9660
 
 		StreamPtr m_stream;
 	};
+
+	//Serializes reads made to another provider, allowing blocks to be read from several threads.
+	//Blocks accessed directly through GetBlocks are read-only and don't need to be serialized.
+	class CBlockProviderSynchronized : public CBlockProvider
+	{
+	public:
+		typedef std::shared_ptr<CBlockProvider> BlockProviderPtr;
+
+		CBlockProviderSynchronized(const BlockProviderPtr& blockProvider)
+			: m_blockProvider(blockProvider)
+		{
+
+		}
+
+		virtual ~CBlockProviderSynchronized()
+		{
+
+		}
+
+		void ReadBlock(uint32 address, void* block) override
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_blockProvider->ReadBlock(address, block);
+		}
+
+		void ReadBlocks(uint32 address, uint32 count, void* blocks) override
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_blockProvider->ReadBlocks(address, count, blocks);
+		}
+
+		const uint8* GetBlocks(uint32 address, uint32 count) override
+		{
+			return m_blockProvider->GetBlocks(address, count);
+		}
+
+	private:
+		BlockProviderPtr	m_blockProvider;
+		std::mutex			m_mutex;
+	};
 }
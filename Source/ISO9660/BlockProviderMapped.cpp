@@ -0,0 +1,134 @@
+#include <string.h>
+#include <stdint.h>
+#include <stdexcept>
+#include <algorithm>
+#include "BlockProviderMapped.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace ISO9660;
+
+CBlockProviderMapped::CBlockProviderMapped(const boost::filesystem::path& path)
+{
+#ifdef _WIN32
+	m_file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if(m_file == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("Failed to open image file.");
+	}
+	LARGE_INTEGER fileSize = {};
+	GetFileSizeEx(m_file, &fileSize);
+	m_size = fileSize.QuadPart;
+	if((m_size == 0) || (m_size > SIZE_MAX))
+	{
+		Unmap();
+		throw std::runtime_error("Image file can't be mapped.");
+	}
+	m_mapping = CreateFileMapping(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(m_mapping != NULL)
+	{
+		m_data = reinterpret_cast<uint8*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	}
+	if(m_data == nullptr)
+	{
+		Unmap();
+		throw std::runtime_error("Failed to map image file.");
+	}
+#else
+	m_fd = open(path.string().c_str(), O_RDONLY);
+	if(m_fd == -1)
+	{
+		throw std::runtime_error("Failed to open image file.");
+	}
+	struct stat fileStat = {};
+	fstat(m_fd, &fileStat);
+	m_size = fileStat.st_size;
+	if(!S_ISREG(fileStat.st_mode) || (m_size == 0) || (m_size > SIZE_MAX))
+	{
+		Unmap();
+		throw std::runtime_error("Image file can't be mapped.");
+	}
+	void* data = mmap(nullptr, static_cast<size_t>(m_size), PROT_READ, MAP_SHARED, m_fd, 0);
+	if(data == MAP_FAILED)
+	{
+		Unmap();
+		throw std::runtime_error("Failed to map image file.");
+	}
+	m_data = reinterpret_cast<uint8*>(data);
+#endif
+}
+
+CBlockProviderMapped::~CBlockProviderMapped()
+{
+	Unmap();
+}
+
+void CBlockProviderMapped::Unmap()
+{
+#ifdef _WIN32
+	if(m_data != nullptr)
+	{
+		UnmapViewOfFile(m_data);
+	}
+	if(m_mapping != NULL)
+	{
+		CloseHandle(m_mapping);
+		m_mapping = NULL;
+	}
+	if(m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+#else
+	if(m_data != nullptr)
+	{
+		munmap(m_data, static_cast<size_t>(m_size));
+	}
+	if(m_fd != -1)
+	{
+		close(m_fd);
+		m_fd = -1;
+	}
+#endif
+	m_data = nullptr;
+}
+
+uint64 CBlockProviderMapped::GetSize() const
+{
+	return m_size;
+}
+
+void CBlockProviderMapped::ReadBlock(uint32 address, void* block)
+{
+	ReadBlocks(address, 1, block);
+}
+
+void CBlockProviderMapped::ReadBlocks(uint32 address, uint32 count, void* blocks)
+{
+	//Anything past the end of the image reads as zeroes
+	uint64 start = static_cast<uint64>(address) * BLOCKSIZE;
+	uint64 size = static_cast<uint64>(count) * BLOCKSIZE;
+	uint64 available = (start < m_size) ? std::min<uint64>(size, m_size - start) : 0;
+	if(available != 0)
+	{
+		memcpy(blocks, m_data + start, static_cast<size_t>(available));
+	}
+	if(available != size)
+	{
+		memset(reinterpret_cast<uint8*>(blocks) + available, 0, static_cast<size_t>(size - available));
+	}
+}
+
+const uint8* CBlockProviderMapped::GetBlocks(uint32 address, uint32 count)
+{
+	uint64 start = static_cast<uint64>(address) * BLOCKSIZE;
+	uint64 size = static_cast<uint64>(count) * BLOCKSIZE;
+	if((start + size) > m_size) return nullptr;
+	return m_data + start;
+}
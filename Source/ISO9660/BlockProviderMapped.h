@@ -0,0 +1,39 @@
+#pragma once
+
+#include <boost/filesystem.hpp>
+#include "BlockProvider.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace ISO9660
+{
+	//Provides blocks from a plain 2048 bytes per sector image by mapping the whole
+	//file in the address space. Reading a block doesn't involve any system call
+	//and ranges of blocks can be accessed directly through GetBlocks.
+	class CBlockProviderMapped : public CBlockProvider
+	{
+	public:
+							CBlockProviderMapped(const boost::filesystem::path&);
+		virtual				~CBlockProviderMapped();
+
+		void				ReadBlock(uint32, void*) override;
+		void				ReadBlocks(uint32, uint32, void*) override;
+		const uint8*		GetBlocks(uint32, uint32) override;
+
+		uint64				GetSize() const;
+
+	private:
+		void				Unmap();
+
+#ifdef _WIN32
+		HANDLE				m_file = INVALID_HANDLE_VALUE;
+		HANDLE				m_mapping = NULL;
+#else
+		int					m_fd = -1;
+#endif
+		uint8*				m_data = nullptr;
+		uint64				m_size = 0;
+	};
+}
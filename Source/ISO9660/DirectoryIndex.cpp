@@ -0,0 +1,162 @@
+#include <cassert>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <unordered_set>
+#include "DirectoryIndex.h"
+#include "PtrStream.h"
+#include "../Log.h"
+
+using namespace ISO9660;
+
+#define LOG_NAME			("iso9660")
+
+//Size of the fixed part of a directory record, without the name
+#define RECORD_HEADER_SIZE	(0x21)
+
+void CDirectoryIndex::Build(CBlockProvider* blockProvider, uint32 rootAddress)
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	m_records.clear();
+	m_stats = STATS();
+	m_isBuilt = false;
+
+	//The size of the root directory is given by its '.' entry
+	uint32 rootSize = 0;
+	{
+		uint8 block[CBlockProvider::BLOCKSIZE];
+		blockProvider->ReadBlock(rootAddress, block);
+		Framework::CPtrStream stream(block, CBlockProvider::BLOCKSIZE);
+		CDirectoryRecord record(&stream);
+		rootSize = record.GetDataLength();
+	}
+
+	//Some images have directories pointing at the same extent, only visit them once
+	std::unordered_set<uint32> visitedAddresses;
+	std::vector<DIRECTORY> pendingDirectories;
+	pendingDirectories.push_back({rootAddress, rootSize, std::string()});
+	while(!pendingDirectories.empty())
+	{
+		auto directory = std::move(pendingDirectories.back());
+		pendingDirectories.pop_back();
+		if(!visitedAddresses.insert(directory.address).second) continue;
+		ReadDirectory(blockProvider, directory, pendingDirectories);
+	}
+
+	m_isBuilt = true;
+	m_stats.memorySize = ComputeMemorySize();
+	m_stats.buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+	CLog::GetInstance().Print(LOG_NAME, "Indexed %u files and %u directories in %0.2fms (%llu bytes).\r\n",
+		m_stats.fileCount, m_stats.directoryCount, m_stats.buildTime, static_cast<unsigned long long>(m_stats.memorySize));
+}
+
+bool CDirectoryIndex::IsBuilt() const
+{
+	return m_isBuilt;
+}
+
+const CDirectoryRecord* CDirectoryIndex::Find(const char* path) const
+{
+	auto recordIterator = m_records.find(NormalizePath(path));
+	if(recordIterator == std::end(m_records)) return nullptr;
+	return &recordIterator->second;
+}
+
+const CDirectoryIndex::STATS& CDirectoryIndex::GetStats() const
+{
+	return m_stats;
+}
+
+std::string CDirectoryIndex::NormalizePath(const char* path)
+{
+	std::string result;
+	std::string component;
+	for(const char* character = path; ; character++)
+	{
+		if((*character == '/') || (*character == '\\') || (*character == 0))
+		{
+			if(!component.empty())
+			{
+				if(!result.empty()) result += '/';
+				result += NormalizeName(component.c_str());
+				component.clear();
+			}
+			if(*character == 0) break;
+		}
+		else
+		{
+			component += *character;
+		}
+	}
+	return result;
+}
+
+std::string CDirectoryIndex::NormalizeName(const char* name)
+{
+	std::string result;
+	for(const char* character = name; (*character != 0) && (*character != ';'); character++)
+	{
+		result += static_cast<char>(toupper(static_cast<unsigned char>(*character)));
+	}
+	//Files without an extension are recorded with a trailing '.'
+	if((result.size() > 1) && (result.back() == '.'))
+	{
+		result.pop_back();
+	}
+	return result;
+}
+
+void CDirectoryIndex::ReadDirectory(CBlockProvider* blockProvider, const DIRECTORY& directory, std::vector<DIRECTORY>& pendingDirectories)
+{
+	uint32 blockCount = (directory.size + CBlockProvider::BLOCKSIZE - 1) / CBlockProvider::BLOCKSIZE;
+	uint8 block[CBlockProvider::BLOCKSIZE];
+	for(uint32 blockIndex = 0; blockIndex < blockCount; blockIndex++)
+	{
+		blockProvider->ReadBlock(directory.address + blockIndex, block);
+
+		//Records never cross block boundaries, the remaining space of a block is zero filled
+		uint32 offset = 0;
+		while(offset < CBlockProvider::BLOCKSIZE)
+		{
+			uint8 recordLength = block[offset];
+			if(recordLength < RECORD_HEADER_SIZE) break;
+			if((offset + recordLength) > CBlockProvider::BLOCKSIZE) break;
+
+			Framework::CPtrStream stream(block + offset, recordLength);
+			CDirectoryRecord record(&stream);
+			offset += recordLength;
+
+			//Skip '.' and '..' entries
+			const char* name = record.GetName();
+			if((name[0] == 0x00) || ((name[0] == 0x01) && (name[1] == 0x00))) continue;
+
+			std::string path = directory.path.empty() ? NormalizeName(name) : (directory.path + '/' + NormalizeName(name));
+			if(record.IsDirectory())
+			{
+				m_stats.directoryCount++;
+				pendingDirectories.push_back({record.GetPosition(), record.GetDataLength(), path});
+			}
+			else
+			{
+				m_stats.fileCount++;
+			}
+			//Keep the first record if a name appears more than once (ie.: different versions)
+			m_records.insert(std::make_pair(std::move(path), std::move(record)));
+		}
+	}
+}
+
+uint64 CDirectoryIndex::ComputeMemorySize() const
+{
+	//Estimate, doesn't account for allocator overhead
+	uint64 result = m_records.bucket_count() * sizeof(void*);
+	for(const auto& recordPair : m_records)
+	{
+		result += sizeof(RecordMapType::value_type) + sizeof(void*);
+		result += recordPair.first.capacity() + 1;
+		result += strlen(recordPair.second.GetName()) + 1;
+	}
+	return result;
+}
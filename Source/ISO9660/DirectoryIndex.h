@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "BlockProvider.h"
+#include "DirectoryRecord.h"
+
+namespace ISO9660
+{
+	//Records of every file and directory of the image, indexed by their full path.
+	//Paths are matched without regard to case, version suffixes (ie.: ;1) or slash style.
+	class CDirectoryIndex
+	{
+	public:
+		struct STATS
+		{
+			uint32			fileCount = 0;
+			uint32			directoryCount = 0;
+			uint64			memorySize = 0;
+			double			buildTime = 0;
+		};
+
+		//Walks the directory tree starting from the root directory's extent
+		void						Build(CBlockProvider*, uint32);
+		bool						IsBuilt() const;
+
+		const CDirectoryRecord*		Find(const char*) const;
+		const STATS&				GetStats() const;
+
+		static std::string			NormalizePath(const char*);
+
+	private:
+		typedef std::unordered_map<std::string, CDirectoryRecord> RecordMapType;
+
+		struct DIRECTORY
+		{
+			uint32			address;
+			uint32			size;
+			std::string		path;
+		};
+
+		static std::string			NormalizeName(const char*);
+		void						ReadDirectory(CBlockProvider*, const DIRECTORY&, std::vector<DIRECTORY>&);
+		uint64						ComputeMemorySize() const;
+
+		RecordMapType				m_records;
+		STATS						m_stats;
+		bool						m_isBuilt = false;
+	};
+}
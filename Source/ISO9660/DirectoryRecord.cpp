@@ -5,7 +5,7 @@ using namespace ISO9660;
 
 CDirectoryRecord::CDirectoryRecord()
 {
-	memset(&m_name, 0, sizeof(m_name));
+
 }
 
 CDirectoryRecord::CDirectoryRecord(Framework::CStream* stream)
@@ -20,8 +20,9 @@ CDirectoryRecord::CDirectoryRecord(Framework::CStream* stream)
 	m_flags = stream->Read8();
 	stream->Seek(6, Framework::STREAM_SEEK_CUR);
 	uint8 nameSize = stream->Read8();
-	stream->Read(m_name, nameSize);
-	m_name[nameSize] = 0x00;
+	char name[256];
+	stream->Read(name, nameSize);
+	m_name.assign(name, nameSize);
 
 	int skipAmount = m_length - (0x21 + nameSize);
 	if(skipAmount > 0)
@@ -47,7 +48,7 @@ bool CDirectoryRecord::IsDirectory() const
 
 const char* CDirectoryRecord::GetName() const
 {
-	return m_name;
+	return m_name.c_str();
 }
 
 uint32 CDirectoryRecord::GetPosition() const
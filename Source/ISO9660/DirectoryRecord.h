@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include "Types.h"
 #include "Stream.h"
 
@@ -24,6 +25,6 @@ namespace ISO9660
 		uint32			m_position = 0;
 		uint32			m_dataLength = 0;
 		uint8			m_flags = 0;
-		char			m_name[256];
+		std::string		m_name;
 	};
 }
@@ -5,15 +5,26 @@
 #include "File.h"
 #include "DirectoryRecord.h"
 #include "stricmp.h"
+#include "../Log.h"
+
+#define LOG_NAME			("iso9660")
 
 using namespace ISO9660;
 
 CISO9660::CISO9660(const BlockProviderPtr& blockProvider)
-: m_blockProvider(blockProvider)
-, m_volumeDescriptor(blockProvider.get())
-, m_pathTable(blockProvider.get(), m_volumeDescriptor.GetLPathTableAddress())
+: m_blockProvider(std::make_shared<CBlockProviderSynchronized>(blockProvider))
+, m_volumeDescriptor(m_blockProvider.get())
+, m_pathTable(m_blockProvider.get(), m_volumeDescriptor.GetLPathTableAddress())
 {
-
+	//Lookups fall back to reading directories from the image if the tree can't be indexed
+	try
+	{
+		m_directoryIndex.Build(m_blockProvider.get(), m_pathTable.GetDirectoryAddress(m_pathTable.FindRoot()));
+	}
+	catch(const std::exception& exception)
+	{
+		CLog::GetInstance().Print(LOG_NAME, "Failed to index directory tree: %s\r\n", exception.what());
+	}
 }
 
 CISO9660::~CISO9660()
@@ -27,12 +38,37 @@ void CISO9660::ReadBlock(uint32 address, void* data)
 	//are properly called as some system calls (ie.: ReadFile)
 	//won't generate an exception when trying to write to
 	//a write protected area
+	std::lock_guard<std::mutex> blockBufferLock(m_blockBufferMutex);
 	m_blockProvider->ReadBlock(address, m_blockBuffer);
 	memcpy(data, m_blockBuffer, CBlockProvider::BLOCKSIZE);
 }
 
+void CISO9660::ReadBlocks(uint32 address, uint32 count, void* data)
+{
+	//Copy straight from the provider if it has direct access to the blocks,
+	//a fault while writing to data will be raised like any other access
+	if(auto blocks = m_blockProvider->GetBlocks(address, count))
+	{
+		memcpy(data, blocks, static_cast<size_t>(count) * CBlockProvider::BLOCKSIZE);
+		return;
+	}
+	auto output = reinterpret_cast<uint8*>(data);
+	for(unsigned int i = 0; i < count; i++)
+	{
+		ReadBlock(address + i, output + (i * CBlockProvider::BLOCKSIZE));
+	}
+}
+
 bool CISO9660::GetFileRecord(CDirectoryRecord* record, const char* filename)
 {
+	if(m_directoryIndex.IsBuilt())
+	{
+		auto indexRecord = m_directoryIndex.Find(filename);
+		if(indexRecord == nullptr) return false;
+		(*record) = (*indexRecord);
+		return true;
+	}
+
 	//Remove the first '/'
 	if(filename[0] == '/' || filename[0] == '\\') filename++;
 
@@ -77,6 +113,11 @@ bool CISO9660::GetFileRecordFromDirectory(CDirectoryRecord* record, uint32 addre
 	return false;
 }
 
+const CDirectoryIndex::STATS& CISO9660::GetDirectoryIndexStats() const
+{
+	return m_directoryIndex.GetStats();
+}
+
 Framework::CStream* CISO9660::Open(const char* filename)
 {
 	CDirectoryRecord record;
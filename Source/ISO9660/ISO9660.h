@@ -1,10 +1,12 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include "BlockProvider.h"
 #include "VolumeDescriptor.h"
 #include "PathTable.h"
 #include "DirectoryRecord.h"
+#include "DirectoryIndex.h"
 
 class CISO9660
 {
@@ -14,17 +16,23 @@ public:
 								CISO9660(const BlockProviderPtr&);
 								~CISO9660();
 
+	//Blocks can be read from any thread
 	void						ReadBlock(uint32, void*);
+	void						ReadBlocks(uint32, uint32, void*);
 
 	Framework::CStream*			Open(const char*);
 	bool						GetFileRecord(ISO9660::CDirectoryRecord*, const char*);
 
+	const ISO9660::CDirectoryIndex::STATS&	GetDirectoryIndexStats() const;
+
 private:
 	bool						GetFileRecordFromDirectory(ISO9660::CDirectoryRecord*, uint32, const char*);
 
 	BlockProviderPtr			m_blockProvider;
 	ISO9660::CVolumeDescriptor	m_volumeDescriptor;
 	ISO9660::CPathTable			m_pathTable;
+	ISO9660::CDirectoryIndex	m_directoryIndex;
 
+	std::mutex					m_blockBufferMutex;
 	uint8						m_blockBuffer[ISO9660::CBlockProvider::BLOCKSIZE];
 };
@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+#include "ImageFrameCache.h"
+#include "Log.h"
+
+#define LOG_NAME				("imageframecache")
+
+//Minimum amount of frames kept in the cache
+#define MIN_CACHED_FRAMES		(8)
+
+//Amount of data decompressed ahead of the current read position
+#define PREFETCH_SIZE			(512 * 1024)
+
+//Number of consecutive frames to read before we start prefetching
+#define SEQUENTIAL_THRESHOLD	(2)
+
+CImageFrameCache::CImageFrameCache(uint32 frameSize, uint32 frameCount, const FrameLoader& loader, uint32 cacheSize, bool prefetchEnabled)
+: m_frameSize(frameSize)
+, m_frameCount(frameCount)
+, m_loader(loader)
+{
+	assert(m_frameSize != 0);
+
+	unsigned int cachedFrameCount = std::max<unsigned int>(cacheSize / m_frameSize, MIN_CACHED_FRAMES);
+	cachedFrameCount = std::max<unsigned int>(std::min<unsigned int>(cachedFrameCount, m_frameCount), 1);
+
+	m_buffer.resize(static_cast<size_t>(cachedFrameCount) * m_frameSize);
+	m_entries.resize(cachedFrameCount);
+	for(unsigned int i = 0; i < cachedFrameCount; i++)
+	{
+		auto& entry = m_entries[i];
+		entry.data = m_buffer.data() + (static_cast<size_t>(i) * m_frameSize);
+		entry.lruIterator = m_lru.insert(m_lru.end(), i);
+	}
+
+	//Keep at least half of the cache for frames that were already read, prefetching
+	//shouldn't be able to evict everything
+	m_prefetchDepth = std::max<unsigned int>(PREFETCH_SIZE / m_frameSize, 1);
+	m_prefetchDepth = std::min<unsigned int>(m_prefetchDepth, cachedFrameCount / 2);
+	if(prefetchEnabled && (m_prefetchDepth != 0))
+	{
+		m_prefetchThread = std::thread([this] () { PrefetchThreadProc(); });
+	}
+}
+
+CImageFrameCache::~CImageFrameCache()
+{
+	if(m_prefetchThread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_prefetchTerminate = true;
+		}
+		m_prefetchCondition.notify_all();
+		m_prefetchThread.join();
+	}
+
+	uint64 accessCount = m_hitCount + m_missCount;
+	if(accessCount != 0)
+	{
+		CLog::GetInstance().Print(LOG_NAME, "Frame cache stats: %d hits, %d misses (%d%% hit rate), %d prefetched frames used.\r\n",
+			static_cast<int>(m_hitCount), static_cast<int>(m_missCount), static_cast<int>((m_hitCount * 100) / accessCount),
+			static_cast<int>(m_prefetchHitCount));
+	}
+}
+
+void CImageFrameCache::Read(uint32 frame, uint32 offset, void* dest, uint32 size)
+{
+	assert(frame < m_frameCount);
+	assert((offset + size) <= m_frameSize);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	UpdateAccessPattern(frame);
+
+	while(1)
+	{
+		auto entryIterator = m_frameEntries.find(frame);
+		if(entryIterator == std::end(m_frameEntries)) break;
+
+		unsigned int entryIndex = entryIterator->second;
+		auto& entry = m_entries[entryIndex];
+		if(entry.state == ENTRY_STATE_LOADING)
+		{
+			//Being prefetched, wait for it and check again (loading might have failed)
+			m_loadCondition.wait(lock);
+			continue;
+		}
+
+		assert(entry.state == ENTRY_STATE_READY);
+		m_hitCount++;
+		if(entry.prefetched)
+		{
+			m_prefetchHitCount++;
+			entry.prefetched = false;
+		}
+		TouchEntry(entryIndex);
+		memcpy(dest, entry.data + offset, size);
+		return;
+	}
+
+	m_missCount++;
+
+	unsigned int entryIndex = AcquireEntry(frame);
+	if(entryIndex == INVALID_ENTRY)
+	{
+		//Everything is being prefetched, don't bother caching this one
+		lock.unlock();
+		std::vector<uint8> frameData(m_frameSize);
+		m_loader(frame, frameData.data());
+		memcpy(dest, frameData.data() + offset, size);
+		return;
+	}
+
+	auto& entry = m_entries[entryIndex];
+	lock.unlock();
+	try
+	{
+		m_loader(frame, entry.data);
+	}
+	catch(...)
+	{
+		lock.lock();
+		ReleaseEntry(entryIndex);
+		m_loadCondition.notify_all();
+		throw;
+	}
+	lock.lock();
+	entry.state = ENTRY_STATE_READY;
+	m_loadCondition.notify_all();
+	memcpy(dest, entry.data + offset, size);
+}
+
+uint32 CImageFrameCache::GetFrameSize() const
+{
+	return m_frameSize;
+}
+
+unsigned int CImageFrameCache::GetCachedFrameCount() const
+{
+	return static_cast<unsigned int>(m_entries.size());
+}
+
+uint64 CImageFrameCache::GetHitCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_hitCount;
+}
+
+uint64 CImageFrameCache::GetMissCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_missCount;
+}
+
+uint64 CImageFrameCache::GetPrefetchHitCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_prefetchHitCount;
+}
+
+unsigned int CImageFrameCache::AcquireEntry(uint32 frame)
+{
+	//Must be called with the lock held. Reuses the least recently used entry that isn't being loaded.
+	for(auto lruIterator = m_lru.rbegin(); lruIterator != m_lru.rend(); lruIterator++)
+	{
+		unsigned int entryIndex = *lruIterator;
+		auto& entry = m_entries[entryIndex];
+		if(entry.state == ENTRY_STATE_LOADING) continue;
+		if(entry.state == ENTRY_STATE_READY)
+		{
+			m_frameEntries.erase(entry.frame);
+		}
+		entry.frame = frame;
+		entry.state = ENTRY_STATE_LOADING;
+		entry.prefetched = false;
+		m_frameEntries[frame] = entryIndex;
+		TouchEntry(entryIndex);
+		return entryIndex;
+	}
+	return INVALID_ENTRY;
+}
+
+void CImageFrameCache::ReleaseEntry(unsigned int entryIndex)
+{
+	auto& entry = m_entries[entryIndex];
+	m_frameEntries.erase(entry.frame);
+	entry.state = ENTRY_STATE_EMPTY;
+	entry.prefetched = false;
+	m_lru.splice(m_lru.end(), m_lru, entry.lruIterator);
+}
+
+void CImageFrameCache::TouchEntry(unsigned int entryIndex)
+{
+	auto& entry = m_entries[entryIndex];
+	m_lru.splice(m_lru.begin(), m_lru, entry.lruIterator);
+}
+
+void CImageFrameCache::UpdateAccessPattern(uint32 frame)
+{
+	//Must be called with the lock held
+	if(frame == m_lastFrame) return;
+
+	if(frame == (m_lastFrame + 1))
+	{
+		m_sequentialCount++;
+	}
+	else
+	{
+		m_sequentialCount = 0;
+		m_prefetchQueue.clear();
+	}
+	m_lastFrame = frame;
+
+	if(!m_prefetchThread.joinable()) return;
+	if(m_sequentialCount < SEQUENTIAL_THRESHOLD) return;
+
+	bool queued = false;
+	for(unsigned int i = 1; i <= m_prefetchDepth; i++)
+	{
+		uint32 prefetchFrame = frame + i;
+		if(prefetchFrame >= m_frameCount) break;
+		if(m_frameEntries.find(prefetchFrame) != std::end(m_frameEntries)) continue;
+		if(std::find(std::begin(m_prefetchQueue), std::end(m_prefetchQueue), prefetchFrame) != std::end(m_prefetchQueue)) continue;
+		m_prefetchQueue.push_back(prefetchFrame);
+		queued = true;
+	}
+	if(queued)
+	{
+		m_prefetchCondition.notify_one();
+	}
+}
+
+void CImageFrameCache::PrefetchThreadProc()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while(1)
+	{
+		m_prefetchCondition.wait(lock, [this] () { return m_prefetchTerminate || !m_prefetchQueue.empty(); });
+		if(m_prefetchTerminate) break;
+
+		uint32 frame = m_prefetchQueue.front();
+		m_prefetchQueue.pop_front();
+		if(m_frameEntries.find(frame) != std::end(m_frameEntries)) continue;
+
+		unsigned int entryIndex = AcquireEntry(frame);
+		if(entryIndex == INVALID_ENTRY) continue;
+
+		auto& entry = m_entries[entryIndex];
+		entry.prefetched = true;
+
+		lock.unlock();
+		bool succeeded = true;
+		try
+		{
+			m_loader(frame, entry.data);
+		}
+		catch(const std::exception& exception)
+		{
+			CLog::GetInstance().Print(LOG_NAME, "Failed to prefetch frame %d: %s\r\n", frame, exception.what());
+			succeeded = false;
+		}
+		lock.lock();
+
+		if(succeeded)
+		{
+			entry.state = ENTRY_STATE_READY;
+		}
+		else
+		{
+			ReleaseEntry(entryIndex);
+		}
+		m_loadCondition.notify_all();
+	}
+}
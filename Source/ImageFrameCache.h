@@ -0,0 +1,92 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <list>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Types.h"
+
+//Keeps the most recently used frames (or blocks) of a compressed disk image in
+//their decompressed form. When sequential access is detected, the frames following
+//the one being read are decompressed ahead of time on a background thread.
+class CImageFrameCache
+{
+public:
+	typedef std::function<void (uint32, uint8*)> FrameLoader;
+
+	enum
+	{
+		DEFAULT_CACHE_SIZE = 8 * 1024 * 1024,
+	};
+
+							CImageFrameCache(uint32, uint32, const FrameLoader&, uint32 = DEFAULT_CACHE_SIZE, bool = true);
+	virtual					~CImageFrameCache();
+
+	void					Read(uint32, uint32, void*, uint32);
+
+	uint32					GetFrameSize() const;
+	unsigned int			GetCachedFrameCount() const;
+
+	uint64					GetHitCount() const;
+	uint64					GetMissCount() const;
+	uint64					GetPrefetchHitCount() const;
+
+private:
+	enum ENTRY_STATE
+	{
+		ENTRY_STATE_EMPTY,
+		ENTRY_STATE_LOADING,
+		ENTRY_STATE_READY,
+	};
+
+	typedef std::list<unsigned int> LruList;
+
+	struct ENTRY
+	{
+		uint32				frame = 0;
+		ENTRY_STATE			state = ENTRY_STATE_EMPTY;
+		bool				prefetched = false;
+		uint8*				data = nullptr;
+		LruList::iterator	lruIterator;
+	};
+
+	enum
+	{
+		INVALID_ENTRY = ~0U,
+	};
+
+	unsigned int			AcquireEntry(uint32);
+	void					ReleaseEntry(unsigned int);
+	void					TouchEntry(unsigned int);
+	void					UpdateAccessPattern(uint32);
+
+	void					PrefetchThreadProc();
+
+	uint32					m_frameSize = 0;
+	uint32					m_frameCount = 0;
+	FrameLoader				m_loader;
+
+	std::vector<uint8>		m_buffer;
+	std::vector<ENTRY>		m_entries;
+	LruList					m_lru;
+	std::unordered_map<uint32, unsigned int>	m_frameEntries;
+	mutable std::mutex		m_mutex;
+	std::condition_variable	m_loadCondition;
+
+	uint32					m_lastFrame = ~0U;
+	unsigned int			m_sequentialCount = 0;
+	unsigned int			m_prefetchDepth = 0;
+
+	std::thread				m_prefetchThread;
+	std::deque<uint32>		m_prefetchQueue;
+	std::condition_variable	m_prefetchCondition;
+	bool					m_prefetchTerminate = false;
+
+	uint64					m_hitCount = 0;
+	uint64					m_missCount = 0;
+	uint64					m_prefetchHitCount = 0;
+};
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include "IoPortMap.h"
+#include "Log.h"
+
+CIoPortMap::CIoPortMap(uint32 start, uint32 end)
+: m_start(start & ~((1 << PAGE_BITS) - 1))
+, m_end(end)
+{
+	assert(start <= end);
+	m_pages.resize(((end - m_start) >> PAGE_BITS) + 1);
+}
+
+void CIoPortMap::InsertReadHandler(uint32 start, uint32 end, const ReadHandler& handler)
+{
+	assert(m_readHandlers.size() < MAX_HANDLERS);
+	m_readHandlers.push_back(handler);
+	InsertHandler(start, end, static_cast<uint8>(m_readHandlers.size()), false);
+}
+
+void CIoPortMap::InsertWriteHandler(uint32 start, uint32 end, const WriteHandler& handler)
+{
+	assert(m_writeHandlers.size() < MAX_HANDLERS);
+	m_writeHandlers.push_back(handler);
+	InsertHandler(start, end, static_cast<uint8>(m_writeHandlers.size()), true);
+}
+
+void CIoPortMap::InsertHandler(uint32 start, uint32 end, uint8 handlerId, bool write)
+{
+	assert(start <= end);
+	assert((start >= m_start) && (end <= m_end));
+	for(uint32 address = (start & ~((1 << REGISTER_BITS) - 1)); address <= end; address += (1 << REGISTER_BITS))
+	{
+		auto& page = GetOrCreatePage(address);
+		auto& handlers = write ? page.writeHandlers : page.readHandlers;
+		auto& registerHandler = handlers[(address >> REGISTER_BITS) & (REGISTERS_PER_PAGE - 1)];
+		if(registerHandler == 0)
+		{
+			registerHandler = handlerId;
+		}
+		//Don't wrap around if the range ends at the top of the address space
+		if(address > (end - (1 << REGISTER_BITS))) break;
+	}
+}
+
+CIoPortMap::PAGE* CIoPortMap::GetPage(uint32 address) const
+{
+	if((address < m_start) || (address > m_end)) return nullptr;
+	return m_pages[(address - m_start) >> PAGE_BITS].get();
+}
+
+CIoPortMap::PAGE& CIoPortMap::GetOrCreatePage(uint32 address)
+{
+	auto& page = m_pages[(address - m_start) >> PAGE_BITS];
+	if(!page)
+	{
+		page = std::make_unique<PAGE>();
+		memset(page.get(), 0, sizeof(PAGE));
+	}
+	return *page;
+}
+
+bool CIoPortMap::Read(uint32 address, uint32& value)
+{
+	auto page = GetPage(address);
+	if(page == nullptr) return false;
+	uint32 registerIndex = (address >> REGISTER_BITS) & (REGISTERS_PER_PAGE - 1);
+	uint8 handlerId = page->readHandlers[registerIndex];
+	if(handlerId == 0) return false;
+	page->readCounts[registerIndex]++;
+	value = m_readHandlers[handlerId - 1](address);
+	return true;
+}
+
+bool CIoPortMap::Write(uint32 address, uint32 value)
+{
+	auto page = GetPage(address);
+	if(page == nullptr) return false;
+	uint32 registerIndex = (address >> REGISTER_BITS) & (REGISTERS_PER_PAGE - 1);
+	uint8 handlerId = page->writeHandlers[registerIndex];
+	if(handlerId == 0) return false;
+	page->writeCounts[registerIndex]++;
+	m_writeHandlers[handlerId - 1](address, value);
+	return true;
+}
+
+CIoPortMap::RegisterStatsArray CIoPortMap::GetStats() const
+{
+	RegisterStatsArray stats;
+	for(uint32 pageIndex = 0; pageIndex < m_pages.size(); pageIndex++)
+	{
+		const auto& page = m_pages[pageIndex];
+		if(!page) continue;
+		for(uint32 registerIndex = 0; registerIndex < REGISTERS_PER_PAGE; registerIndex++)
+		{
+			if((page->readCounts[registerIndex] == 0) && (page->writeCounts[registerIndex] == 0)) continue;
+			REGISTER_STATS registerStats;
+			registerStats.address = m_start + (pageIndex << PAGE_BITS) + (registerIndex << REGISTER_BITS);
+			registerStats.readCount = page->readCounts[registerIndex];
+			registerStats.writeCount = page->writeCounts[registerIndex];
+			stats.push_back(registerStats);
+		}
+	}
+	std::sort(stats.begin(), stats.end(),
+		[] (const REGISTER_STATS& lhs, const REGISTER_STATS& rhs)
+		{
+			return (static_cast<uint64>(lhs.readCount) + lhs.writeCount) > (static_cast<uint64>(rhs.readCount) + rhs.writeCount);
+		}
+	);
+	return stats;
+}
+
+void CIoPortMap::ResetStats()
+{
+	for(auto& page : m_pages)
+	{
+		if(!page) continue;
+		memset(page->readCounts, 0, sizeof(page->readCounts));
+		memset(page->writeCounts, 0, sizeof(page->writeCounts));
+	}
+}
+
+void CIoPortMap::LogStats(const char* logName, unsigned int maxRegisterCount) const
+{
+	auto stats = GetStats();
+	if(stats.empty()) return;
+	CLog::GetInstance().Print(logName, "Most accessed I/O registers:\r\n");
+	for(unsigned int i = 0; i < std::min<size_t>(stats.size(), maxRegisterCount); i++)
+	{
+		const auto& registerStats = stats[i];
+		CLog::GetInstance().Print(logName, "  0x%0.8X: %u reads, %u writes.\r\n",
+			registerStats.address, registerStats.readCount, registerStats.writeCount);
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include "Types.h"
+
+//Dispatches hardware register accesses to the devices that registered their address range.
+//Handlers are found through a table holding an entry for every register, which is only allocated
+//for pages that have registers in them. Accesses made to every register are counted to help
+//finding the registers that get polled the most.
+class CIoPortMap
+{
+public:
+	typedef std::function<uint32 (uint32)> ReadHandler;
+	typedef std::function<void (uint32, uint32)> WriteHandler;
+
+	struct REGISTER_STATS
+	{
+		uint32		address = 0;
+		uint32		readCount = 0;
+		uint32		writeCount = 0;
+	};
+	typedef std::vector<REGISTER_STATS> RegisterStatsArray;
+
+						CIoPortMap(uint32, uint32);
+	virtual				~CIoPortMap() = default;
+
+	//Ranges are inclusive, registers that already have a handler keep it
+	void				InsertReadHandler(uint32, uint32, const ReadHandler&);
+	void				InsertWriteHandler(uint32, uint32, const WriteHandler&);
+
+	//Return false if no device handles the register
+	bool				Read(uint32, uint32&);
+	bool				Write(uint32, uint32);
+
+	//Registers that were accessed, most accessed first
+	RegisterStatsArray	GetStats() const;
+	void				ResetStats();
+	void				LogStats(const char*, unsigned int) const;
+
+private:
+	enum
+	{
+		PAGE_BITS = 12,
+		REGISTER_BITS = 2,
+		REGISTERS_PER_PAGE = (1 << (PAGE_BITS - REGISTER_BITS)),
+		MAX_HANDLERS = 0xFF,
+	};
+
+	//Handler indices are stored plus one, zero means unhandled
+	struct PAGE
+	{
+		uint8		readHandlers[REGISTERS_PER_PAGE];
+		uint8		writeHandlers[REGISTERS_PER_PAGE];
+		uint32		readCounts[REGISTERS_PER_PAGE];
+		uint32		writeCounts[REGISTERS_PER_PAGE];
+	};
+	typedef std::unique_ptr<PAGE> PagePtr;
+
+	PAGE*				GetPage(uint32) const;
+	PAGE&				GetOrCreatePage(uint32);
+	void				InsertHandler(uint32, uint32, uint8, bool);
+
+	uint32						m_start = 0;
+	uint32						m_end = 0;
+	std::vector<PagePtr>		m_pages;
+	std::vector<ReadHandler>	m_readHandlers;
+	std::vector<WriteHandler>	m_writeHandlers;
+};
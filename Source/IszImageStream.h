@@ -1,12 +1,15 @@
 #pragma once
 
+#include <memory>
+#include <mutex>
 #include "Types.h"
 #include "Stream.h"
+#include "ImageFrameCache.h"
 
 class CIszImageStream : public Framework::CStream
 {
 public:
-						CIszImageStream(Framework::CStream*);
+						CIszImageStream(Framework::CStream*, uint32 = CImageFrameCache::DEFAULT_CACHE_SIZE, bool = true);
 	virtual				~CIszImageStream();
 
 	virtual void		Seek(int64, Framework::STREAM_SEEK_DIRECTION) override;
@@ -68,21 +71,22 @@ private:
 		ADI_BZ2 = 3
 	};
 
+	typedef std::unique_ptr<CImageFrameCache> BlockCachePtr;
+
 	void					ReadBlockDescriptorTable();
 	uint64					GetTotalSize() const;
-	const BLOCKDESCRIPTOR&	SeekToBlock(uint64);
-	void					SyncCache();
+	void					LoadBlock(uint32, uint8*);
 
 	void					ReadZeroBlock(uint32);
-	void					ReadDataBlock(uint32);
-	void					ReadGzipBlock(uint32);
-	void					ReadBz2Block(uint32);
+	void					ReadDataBlock(uint32, const uint8*, uint8*);
+	void					ReadGzipBlock(uint32, const uint8*, uint8*);
+	void					ReadBz2Block(uint32, uint8*, uint8*);
 
 	Framework::CStream*		m_baseStream = nullptr;
+	std::mutex				m_baseStreamMutex;
 	HEADER					m_header;
 	BLOCKDESCRIPTOR*		m_blockDescriptorTable = nullptr;
-	int64					m_cachedBlockNumber = -1;
-	uint8*					m_cachedBlock = nullptr;
-	uint8*					m_readBuffer = nullptr;
+	uint64*					m_blockOffsetTable = nullptr;
+	BlockCachePtr			m_blockCache;
 	uint64					m_position = 0;
 };
@@ -0,0 +1,210 @@
+#include <zlib.h>
+#include "JitBlockCache.h"
+#include "MemoryUtils.h"
+#include "StdStreamUtils.h"
+#include "Log.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#define LOG_NAME			("jitblockcache")
+
+#define CACHE_FILE_MAGIC	(0x4354494A)	//'JITC'
+#define CACHE_FILE_VERSION	(3)
+
+CJitBlockCache::CJitBlockCache()
+: m_imageSignature(GetImageSignature())
+{
+
+}
+
+CJitBlockCache::~CJitBlockCache()
+{
+
+}
+
+void CJitBlockCache::Load(const boost::filesystem::path& path)
+{
+	Clear();
+
+	//We can't tell if cached code would be valid if we don't know what we're running
+	if(m_imageSignature == 0) return;
+	if(!boost::filesystem::exists(path)) return;
+
+	try
+	{
+		auto stream = Framework::CreateInputStdStream(path.native());
+
+		uint32 magic = stream.Read32();
+		uint32 version = stream.Read32();
+		if((magic != CACHE_FILE_MAGIC) || (version != CACHE_FILE_VERSION))
+		{
+			return;
+		}
+
+		//Discard everything if we're not running the same image at the same place
+		uint64 signature = stream.Read32();
+		signature |= static_cast<uint64>(stream.Read32()) << 32;
+		if(signature != m_imageSignature)
+		{
+			CLog::GetInstance().Print(LOG_NAME, "Discarding cache '%s', image signature mismatch.\r\n", path.string().c_str());
+			m_dirty = true;
+			return;
+		}
+
+		uint32 blockCount = stream.Read32();
+		for(uint32 i = 0; i < blockCount; i++)
+		{
+			AOT_BLOCK_KEY key = {};
+			key.crc = stream.Read32();
+			key.begin = stream.Read32();
+			key.end = stream.Read32();
+			uint32 codeSize = stream.Read32();
+			CodeBuffer code(codeSize);
+			if(stream.Read(code.data(), codeSize) != codeSize)
+			{
+				throw std::runtime_error("Truncated block cache file.");
+			}
+			m_blocks.insert(std::make_pair(key, std::move(code)));
+		}
+	}
+	catch(const std::exception& exception)
+	{
+		CLog::GetInstance().Print(LOG_NAME, "Failed to load cache '%s': %s\r\n", path.string().c_str(), exception.what());
+		m_blocks.clear();
+		m_dirty = true;
+		return;
+	}
+
+	CLog::GetInstance().Print(LOG_NAME, "Loaded %d blocks from '%s'.\r\n", static_cast<int>(m_blocks.size()), path.string().c_str());
+}
+
+void CJitBlockCache::Save(const boost::filesystem::path& path)
+{
+	if(!m_dirty) return;
+
+	try
+	{
+		auto stream = Framework::CreateOutputStdStream(path.native());
+
+		stream.Write32(CACHE_FILE_MAGIC);
+		stream.Write32(CACHE_FILE_VERSION);
+		stream.Write32(static_cast<uint32>(m_imageSignature));
+		stream.Write32(static_cast<uint32>(m_imageSignature >> 32));
+		stream.Write32(static_cast<uint32>(m_blocks.size()));
+		for(const auto& blockPair : m_blocks)
+		{
+			const auto& key = blockPair.first;
+			const auto& code = blockPair.second;
+			stream.Write32(key.crc);
+			stream.Write32(key.begin);
+			stream.Write32(key.end);
+			stream.Write32(static_cast<uint32>(code.size()));
+			stream.Write(code.data(), code.size());
+		}
+	}
+	catch(const std::exception& exception)
+	{
+		CLog::GetInstance().Print(LOG_NAME, "Failed to save cache '%s': %s\r\n", path.string().c_str(), exception.what());
+		return;
+	}
+
+	m_dirty = false;
+}
+
+void CJitBlockCache::Clear()
+{
+	m_blocks.clear();
+	m_dirty = false;
+	ResetStats();
+}
+
+const CJitBlockCache::CodeBuffer* CJitBlockCache::FindBlock(const AOT_BLOCK_KEY& key)
+{
+	auto blockIterator = m_blocks.find(key);
+	if(blockIterator == std::end(m_blocks))
+	{
+		m_missCount++;
+		return nullptr;
+	}
+	m_hitCount++;
+	return &blockIterator->second;
+}
+
+void CJitBlockCache::InsertBlock(const AOT_BLOCK_KEY& key, const void* code, size_t codeSize)
+{
+	if(m_imageSignature == 0) return;
+
+	auto codeBytes = reinterpret_cast<const uint8*>(code);
+	m_blocks[key] = CodeBuffer(codeBytes, codeBytes + codeSize);
+	m_dirty = true;
+}
+
+size_t CJitBlockCache::GetBlockCount() const
+{
+	return m_blocks.size();
+}
+
+uint32 CJitBlockCache::GetHitCount() const
+{
+	return m_hitCount;
+}
+
+uint32 CJitBlockCache::GetMissCount() const
+{
+	return m_missCount;
+}
+
+void CJitBlockCache::ResetStats()
+{
+	m_hitCount = 0;
+	m_missCount = 0;
+}
+
+uint64 CJitBlockCache::GetImageSignature()
+{
+	//Identifies the image we're running from and where it was loaded, 0 if we can't tell.
+	//The build stamp only changes when this file is built again, the image file's size
+	//and modification time catch the other cases.
+	static const uint64 signature =
+		[] () -> uint64
+		{
+			auto functionAddress = reinterpret_cast<void*>(&MemoryUtils_GetWordProxy);
+			uintptr_t imageBase = 0;
+			boost::filesystem::path imagePath;
+#ifdef _WIN32
+			HMODULE module = NULL;
+			BOOL result = GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+				reinterpret_cast<LPCWSTR>(functionAddress), &module);
+			if(result == FALSE) return 0;
+			wchar_t modulePath[MAX_PATH] = {};
+			DWORD modulePathLength = GetModuleFileNameW(module, modulePath, MAX_PATH);
+			if((modulePathLength == 0) || (modulePathLength == MAX_PATH)) return 0;
+			imageBase = reinterpret_cast<uintptr_t>(module);
+			imagePath = modulePath;
+#else
+			Dl_info info = {};
+			if((dladdr(functionAddress, &info) == 0) || (info.dli_fname == nullptr)) return 0;
+			imageBase = reinterpret_cast<uintptr_t>(info.dli_fbase);
+			imagePath = info.dli_fname;
+#endif
+			boost::system::error_code errorCode;
+			uint64 imageSize = boost::filesystem::file_size(imagePath, errorCode);
+			if(errorCode) return 0;
+			uint64 imageTime = static_cast<uint64>(boost::filesystem::last_write_time(imagePath, errorCode));
+			if(errorCode) return 0;
+
+			static const char buildStamp[] = __DATE__ " " __TIME__;
+			uint64 imageBase64 = imageBase;
+			uint32 buildCrc = crc32(0, reinterpret_cast<const Bytef*>(buildStamp), sizeof(buildStamp));
+			uint32 imageCrc = crc32(0, reinterpret_cast<const Bytef*>(&imageBase64), sizeof(imageBase64));
+			imageCrc = crc32(imageCrc, reinterpret_cast<const Bytef*>(&imageSize), sizeof(imageSize));
+			imageCrc = crc32(imageCrc, reinterpret_cast<const Bytef*>(&imageTime), sizeof(imageTime));
+			uint64 imageSignature = static_cast<uint64>(buildCrc) | (static_cast<uint64>(imageCrc) << 32);
+			return (imageSignature != 0) ? imageSignature : 1;
+		}();
+	return signature;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "Types.h"
+#include "BasicBlock.h"
+
+//Keeps the machine code generated for basic blocks so that it can be reused
+//across sessions. Blocks are identified by the CRC of their opcodes and their
+//address range, which means that a cached block is only reused if the code
+//it was generated from is exactly the same.
+//Generated code refers to host functions by their absolute address. The code generator
+//doesn't tell us where these are, so the cache is tied to the exact image that generated
+//it and to the address it was loaded at. A cache saved by another build or by a run where
+//the image was loaded somewhere else is discarded.
+class CJitBlockCache
+{
+public:
+	typedef std::vector<uint8> CodeBuffer;
+
+								CJitBlockCache();
+	virtual						~CJitBlockCache();
+
+	void						Load(const boost::filesystem::path&);
+	void						Save(const boost::filesystem::path&);
+	void						Clear();
+
+	const CodeBuffer*			FindBlock(const AOT_BLOCK_KEY&);
+	void						InsertBlock(const AOT_BLOCK_KEY&, const void*, size_t);
+
+	size_t						GetBlockCount() const;
+	uint32						GetHitCount() const;
+	uint32						GetMissCount() const;
+	void						ResetStats();
+
+private:
+	typedef std::map<AOT_BLOCK_KEY, CodeBuffer> BlockMap;
+
+	static uint64				GetImageSignature();
+
+	BlockMap					m_blocks;
+	uint64						m_imageSignature = 0;
+	bool						m_dirty = false;
+	uint32						m_hitCount = 0;
+	uint32						m_missCount = 0;
+};
@@ -564,7 +564,33 @@ void CMA_MIPSIV::LWL()
 //23
 void CMA_MIPSIV::LW()
 {
+	if(m_nRT == 0) return;
+
+	bool fastMemory = IsFastMemoryEnabled();
+	if(fastMemory)
+	{
+		BeginFastMemoryAccess();
+		{
+			PushFastMemoryRef();
+			m_codeGen->LoadFromRef();
+
+			if(m_regSize == MIPS_REGSIZE_64)
+			{
+				m_codeGen->PushTop();
+				m_codeGen->SignExt();
+				m_codeGen->PullRel(offsetof(CMIPS, m_State.nGPR[m_nRT].nV[1]));
+			}
+			m_codeGen->PullRel(offsetof(CMIPS, m_State.nGPR[m_nRT].nV[0]));
+		}
+		m_codeGen->Else();
+	}
+
 	Template_LoadUnsigned32(reinterpret_cast<void*>(&MemoryUtils_GetWordProxy));
+
+	if(fastMemory)
+	{
+		m_codeGen->EndIf();
+	}
 }
 
 //24
@@ -603,6 +629,21 @@ void CMA_MIPSIV::LWU()
 {
 	if(m_nRT == 0) return;
 
+	bool fastMemory = IsFastMemoryEnabled();
+	if(fastMemory)
+	{
+		BeginFastMemoryAccess();
+		{
+			PushFastMemoryRef();
+			m_codeGen->LoadFromRef();
+			m_codeGen->PullRel(offsetof(CMIPS, m_State.nGPR[m_nRT].nV[0]));
+
+			m_codeGen->PushCst(0);
+			m_codeGen->PullRel(offsetof(CMIPS, m_State.nGPR[m_nRT].nV[1]));
+		}
+		m_codeGen->Else();
+	}
+
 	ComputeMemAccessAddr();
 
 	m_codeGen->PushCtx();
@@ -614,6 +655,11 @@ void CMA_MIPSIV::LWU()
 	m_codeGen->PullRel(offsetof(CMIPS, m_State.nGPR[m_nRT].nV[1]));
 
 	m_codeGen->PullTop();
+
+	if(fastMemory)
+	{
+		m_codeGen->EndIf();
+	}
 }
 
 //28
@@ -654,6 +700,18 @@ void CMA_MIPSIV::SWL()
 //2B
 void CMA_MIPSIV::SW()
 {
+	bool fastMemory = IsFastMemoryEnabled();
+	if(fastMemory)
+	{
+		BeginFastMemoryAccess();
+		{
+			PushFastMemoryRef();
+			m_codeGen->PushRel(offsetof(CMIPS, m_State.nGPR[m_nRT].nV[0]));
+			m_codeGen->StoreAtRef();
+		}
+		m_codeGen->Else();
+	}
+
 	ComputeMemAccessAddr();
 
 	m_codeGen->PushCtx();
@@ -662,6 +720,11 @@ void CMA_MIPSIV::SW()
 	m_codeGen->Call(reinterpret_cast<void*>(&MemoryUtils_SetWordProxy), 3, false);
 
 	m_codeGen->PullTop();
+
+	if(fastMemory)
+	{
+		m_codeGen->EndIf();
+	}
 }
 
 //2C
@@ -740,6 +803,29 @@ void CMA_MIPSIV::LD()
 
 	assert(m_regSize == MIPS_REGSIZE_64);
 
+	bool fastMemory = IsFastMemoryEnabled();
+	if(fastMemory)
+	{
+		BeginFastMemoryAccess();
+		{
+			PushFastMemoryRef();
+			for(unsigned int i = 0; i < 2; i++)
+			{
+				m_codeGen->PushTop();
+				m_codeGen->LoadFromRef();
+				m_codeGen->PullRel(offsetof(CMIPS, m_State.nGPR[m_nRT].nV[i]));
+
+				if(i != 1)
+				{
+					m_codeGen->PushCst(4);
+					m_codeGen->AddRef();
+				}
+			}
+			m_codeGen->PullTop();
+		}
+		m_codeGen->Else();
+	}
+
 	ComputeMemAccessAddr();
 
 	m_codeGen->PushCtx();
@@ -748,6 +834,11 @@ void CMA_MIPSIV::LD()
 	m_codeGen->PullRel64(offsetof(CMIPS, m_State.nGPR[m_nRT]));
 
 	m_codeGen->PullTop();
+
+	if(fastMemory)
+	{
+		m_codeGen->EndIf();
+	}
 }
 
 //39
@@ -781,6 +872,29 @@ void CMA_MIPSIV::SD()
 {
 	assert(m_regSize == MIPS_REGSIZE_64);
 
+	bool fastMemory = IsFastMemoryEnabled();
+	if(fastMemory)
+	{
+		BeginFastMemoryAccess();
+		{
+			PushFastMemoryRef();
+			for(unsigned int i = 0; i < 2; i++)
+			{
+				m_codeGen->PushTop();
+				m_codeGen->PushRel(offsetof(CMIPS, m_State.nGPR[m_nRT].nV[i]));
+				m_codeGen->StoreAtRef();
+
+				if(i != 1)
+				{
+					m_codeGen->PushCst(4);
+					m_codeGen->AddRef();
+				}
+			}
+			m_codeGen->PullTop();
+		}
+		m_codeGen->Else();
+	}
+
 	ComputeMemAccessAddr();
 
 	m_codeGen->PushCtx();
@@ -789,6 +903,11 @@ void CMA_MIPSIV::SD()
 	m_codeGen->Call(reinterpret_cast<void*>(&MemoryUtils_SetDoubleProxy), 3, Jitter::CJitter::RETURN_VALUE_NONE);
 
 	m_codeGen->PullTop();
+
+	if(fastMemory)
+	{
+		m_codeGen->EndIf();
+	}
 }
 
 //////////////////////////////////////////////////
@@ -9,6 +9,7 @@
 #include "MIPSTags.h"
 #include "uint128.h"
 #include <set>
+#include <atomic>
 
 struct REGISTER_PIPELINE
 {
@@ -125,6 +126,16 @@ public:
 
 	void*						m_vuMem = nullptr;
 
+	//RAM that generated code can access directly, mirrored at the start of every 512MB segment.
+	//Loads and stores go through the memory map if this is null.
+	void*						m_fastMemory = nullptr;
+	uint32						m_fastMemorySize = 0;
+
+	//Set when compiled code might have been changed or thrown away. Traces check it
+	//between their blocks and leave as soon as it is set, the executor then takes care
+	//of the changes before following any link. Can be set by an access fault handler.
+	std::atomic<uint32>			m_codeWritten = {0};
+
 	CMIPSArchitecture*			m_pArch;
 	CMIPSCoprocessor*			m_pCOP[4];
 	CMemoryMap*					m_pMemoryMap;
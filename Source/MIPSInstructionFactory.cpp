@@ -67,6 +67,49 @@ void CMIPSInstructionFactory::ComputeMemAccessAddr()
 	}
 }
 
+bool CMIPSInstructionFactory::IsFastMemoryEnabled() const
+{
+	return (m_pCtx->m_fastMemory != nullptr);
+}
+
+void CMIPSInstructionFactory::BeginFastMemoryAccess()
+{
+	assert(IsFastMemoryEnabled());
+	assert((m_pCtx->m_fastMemorySize & (m_pCtx->m_fastMemorySize - 1)) == 0);
+
+	uint8 nRS			= (uint8) ((m_nOpcode >> 21) & 0x001F);
+	uint16 nImmediate	= (uint16)((m_nOpcode >>  0) & 0xFFFF);
+
+	//Address is in RAM if it falls in the mirror found at the start of its segment
+	m_codeGen->PushRel(offsetof(CMIPS, m_State.nGPR[nRS].nV[0]));
+	if(nImmediate != 0)
+	{
+		m_codeGen->PushCst((int16)nImmediate);
+		m_codeGen->Add();
+	}
+	m_codeGen->PushCst(0x1FFFFFFF & ~(m_pCtx->m_fastMemorySize - 1));
+	m_codeGen->And();
+	m_codeGen->PushCst(0);
+	m_codeGen->BeginIf(Jitter::CONDITION_EQ);
+}
+
+void CMIPSInstructionFactory::PushFastMemoryRef(uint32 addressMask)
+{
+	uint8 nRS			= (uint8) ((m_nOpcode >> 21) & 0x001F);
+	uint16 nImmediate	= (uint16)((m_nOpcode >>  0) & 0xFFFF);
+
+	m_codeGen->PushRelRef(offsetof(CMIPS, m_fastMemory));
+	m_codeGen->PushRel(offsetof(CMIPS, m_State.nGPR[nRS].nV[0]));
+	if(nImmediate != 0)
+	{
+		m_codeGen->PushCst((int16)nImmediate);
+		m_codeGen->Add();
+	}
+	m_codeGen->PushCst((m_pCtx->m_fastMemorySize - 1) & addressMask);
+	m_codeGen->And();
+	m_codeGen->AddRef();
+}
+
 void CMIPSInstructionFactory::Branch(Jitter::CONDITION condition)
 {
 	uint16 nImmediate = (uint16)(m_nOpcode & 0xFFFF);
@@ -28,6 +28,9 @@ public:
 
 protected:
 	void					ComputeMemAccessAddr();
+	bool					IsFastMemoryEnabled() const;
+	void					BeginFastMemoryAccess();
+	void					PushFastMemoryRef(uint32 = ~0U);
 	void					Branch(Jitter::CONDITION);
 	void					BranchLikely(Jitter::CONDITION);
 
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <stdio.h>
+#include <algorithm>
 #include "MemoryMap.h"
 
 CMemoryMap::~CMemoryMap()
@@ -47,17 +48,17 @@ const CMemoryMap::MEMORYMAPELEMENT* CMemoryMap::GetWriteMap(uint32 address) cons
 	return GetMap(m_writeMap, address);
 }
 
-void CMemoryMap::InsertMap(MemoryMapListType& memoryMap, uint32 start, uint32 end, void* pointer, unsigned char key)
+void CMemoryMap::InsertMap(MEMORYMAP& memoryMap, uint32 start, uint32 end, void* pointer, unsigned char key)
 {
 	MEMORYMAPELEMENT element;
 	element.nStart		= start;
 	element.nEnd		= end;
 	element.pPointer	= pointer;
 	element.nType		= MEMORYMAP_TYPE_MEMORY;
-	memoryMap.push_back(element);
+	InsertElement(memoryMap, element);
 }
 
-void CMemoryMap::InsertMap(MemoryMapListType& memoryMap, uint32 start, uint32 end, const MemoryMapHandlerType& handler, unsigned char key)
+void CMemoryMap::InsertMap(MEMORYMAP& memoryMap, uint32 start, uint32 end, const MemoryMapHandlerType& handler, unsigned char key)
 {
 	MEMORYMAPELEMENT element;
 	element.nStart		= start;
@@ -65,10 +66,53 @@ void CMemoryMap::InsertMap(MemoryMapListType& memoryMap, uint32 start, uint32 en
 	element.handler		= handler;
 	element.pPointer	= NULL;
 	element.nType		= MEMORYMAP_TYPE_FUNCTION;
-	memoryMap.push_back(element);
+	InsertElement(memoryMap, element);
 }
 
-const CMemoryMap::MEMORYMAPELEMENT* CMemoryMap::GetMap(const MemoryMapListType& memoryMap, uint32 nAddress)
+void CMemoryMap::InsertElement(MEMORYMAP& memoryMap, const MEMORYMAPELEMENT& element)
+{
+	assert(element.nStart <= element.nEnd);
+	auto elementIterator = std::upper_bound(memoryMap.elements.begin(), memoryMap.elements.end(), element,
+		[] (const MEMORYMAPELEMENT& lhs, const MEMORYMAPELEMENT& rhs) { return lhs.nStart < rhs.nStart; });
+	memoryMap.elements.insert(elementIterator, element);
+	UpdatePages(memoryMap);
+}
+
+void CMemoryMap::UpdatePages(MEMORYMAP& memoryMap)
+{
+	auto& pages = memoryMap.pages;
+	pages.clear();
+	if(memoryMap.elements.empty()) return;
+
+	uint32 lastPage = memoryMap.elements.back().nEnd >> MAP_PAGE_BITS;
+	pages.resize(lastPage + 1, NULL);
+
+	for(const auto& element : memoryMap.elements)
+	{
+		for(uint32 page = (element.nStart >> MAP_PAGE_BITS); page <= (element.nEnd >> MAP_PAGE_BITS); page++)
+		{
+			if(pages[page] == NULL)
+			{
+				pages[page] = &element;
+			}
+		}
+	}
+}
+
+const CMemoryMap::MEMORYMAPELEMENT* CMemoryMap::GetMap(const MEMORYMAP& memoryMap, uint32 nAddress)
+{
+	uint32 page = nAddress >> MAP_PAGE_BITS;
+	if(page >= memoryMap.pages.size()) return NULL;
+	const MEMORYMAPELEMENT* element = memoryMap.pages[page];
+	if((element != NULL) && (nAddress >= element->nStart) && (nAddress <= element->nEnd))
+	{
+		return element;
+	}
+	//Page is shared by more elements or isn't completely mapped
+	return FindMap(memoryMap.elements, nAddress);
+}
+
+const CMemoryMap::MEMORYMAPELEMENT* CMemoryMap::FindMap(const MemoryMapListType& memoryMap, uint32 nAddress)
 {
 	for(MemoryMapListType::const_iterator element(memoryMap.begin());
 		memoryMap.end() != element; element++)
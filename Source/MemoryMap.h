@@ -49,16 +49,33 @@ public:
 
 protected:
 	typedef std::vector<MEMORYMAPELEMENT> MemoryMapListType;
+	typedef std::vector<const MEMORYMAPELEMENT*> PageTableType;
 
-	static const MEMORYMAPELEMENT*			GetMap(const MemoryMapListType&, uint32);
+	enum
+	{
+		MAP_PAGE_BITS = 12,
+	};
+
+	//Elements are sorted by address. Every page up to the end of the last element points
+	//to the first element found in it, elements are only searched if that one doesn't match.
+	struct MEMORYMAP
+	{
+		MemoryMapListType					elements;
+		PageTableType						pages;
+	};
+
+	static const MEMORYMAPELEMENT*			GetMap(const MEMORYMAP&, uint32);
+	static const MEMORYMAPELEMENT*			FindMap(const MemoryMapListType&, uint32);
 
-	MemoryMapListType						m_instructionMap;
-	MemoryMapListType						m_readMap;
-	MemoryMapListType						m_writeMap;
+	MEMORYMAP								m_instructionMap;
+	MEMORYMAP								m_readMap;
+	MEMORYMAP								m_writeMap;
 
 private:
-	static void								InsertMap(MemoryMapListType&, uint32, uint32, void*, unsigned char);
-	static void								InsertMap(MemoryMapListType&, uint32, uint32, const MemoryMapHandlerType&, unsigned char);
+	static void								InsertMap(MEMORYMAP&, uint32, uint32, void*, unsigned char);
+	static void								InsertMap(MEMORYMAP&, uint32, uint32, const MemoryMapHandlerType&, unsigned char);
+	static void								InsertElement(MEMORYMAP&, const MEMORYMAPELEMENT&);
+	static void								UpdatePages(MEMORYMAP&);
 };
 
 class CMemoryMap_LSBF : public CMemoryMap
@@ -17,3 +17,19 @@ void CMemoryStateFile::Write(Framework::CStream& stream)
 {
 	stream.Write(m_memory, m_size);
 }
+
+void CMemoryStateFile::InsertMemoryAreas(Framework::CZipArchiveWriter& archive, const MemoryAreaList& memoryAreas)
+{
+	for(const auto& memoryArea : memoryAreas)
+	{
+		archive.InsertFile(new CMemoryStateFile(memoryArea.name, memoryArea.memory, memoryArea.size));
+	}
+}
+
+void CMemoryStateFile::ReadMemoryAreas(Framework::CZipArchiveReader& archive, const MemoryAreaList& memoryAreas)
+{
+	for(const auto& memoryArea : memoryAreas)
+	{
+		archive.BeginReadFile(memoryArea.name)->Read(memoryArea.memory, memoryArea.size);
+	}
+}
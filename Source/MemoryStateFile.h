@@ -1,15 +1,30 @@
 #pragma once
 
+#include <vector>
 #include "zip/ZipFile.h"
+#include "zip/ZipArchiveWriter.h"
+#include "zip/ZipArchiveReader.h"
 
 class CMemoryStateFile : public Framework::CZipFile
 {
 public:
+	//Large memory areas that can also be saved outside of an archive (ie.: by state snapshots)
+	struct MEMORYAREA
+	{
+		const char*		name;
+		void*			memory;
+		size_t			size;
+	};
+	typedef std::vector<MEMORYAREA> MemoryAreaList;
+
 					CMemoryStateFile(const char*, const void*, size_t);
 	virtual			~CMemoryStateFile();
 
 	virtual void	Write(Framework::CStream&);
 
+	static void		InsertMemoryAreas(Framework::CZipArchiveWriter&, const MemoryAreaList&);
+	static void		ReadMemoryAreas(Framework::CZipArchiveReader&, const MemoryAreaList&);
+
 private:
 	const void*		m_memory;
 	size_t			m_size;
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "MipsExecutor.h"
 
 static bool IsInsideRange(uint32 address, uint32 start, uint32 end)
@@ -49,6 +50,12 @@ void CMipsExecutor::Reset()
 
 void CMipsExecutor::ClearActiveBlocks()
 {
+	//Blocks might outlive this (ie.: VU block cache), make sure they don't keep links to each other
+	for(const auto& block : m_blocks)
+	{
+		block->UnlinkAllBlocks();
+	}
+
 	for(unsigned int i = 0; i < m_subTableCount; i++)
 	{
 		CBasicBlock** subTable = m_blockTable[i];
@@ -99,38 +106,159 @@ void CMipsExecutor::ClearActiveBlocksInRangeInternal(uint32 start, uint32 end, C
 
 	if(!blocksToDelete.empty())
 	{
+		for(const auto& block : blocksToDelete)
+		{
+			block->UnlinkAllBlocks();
+		}
 		m_blocks.remove_if([&] (const BasicBlockPtr& block) { return blocksToDelete.find(block.get()) != std::end(blocksToDelete); });
 	}
 }
 
+CJitBlockCache* CMipsExecutor::GetBlockCache() const
+{
+	return m_blockCache;
+}
+
+void CMipsExecutor::SetBlockCache(CJitBlockCache* blockCache)
+{
+	m_blockCache = blockCache;
+}
+
+bool CMipsExecutor::GetBlockLinkingEnabled() const
+{
+	return m_blockLinkingEnabled;
+}
+
+void CMipsExecutor::SetBlockLinkingEnabled(bool blockLinkingEnabled)
+{
+	m_blockLinkingEnabled = blockLinkingEnabled;
+}
+
+bool CMipsExecutor::GetTraceCompilationEnabled() const
+{
+	return m_traceCompilationEnabled;
+}
+
+void CMipsExecutor::SetTraceCompilationEnabled(bool traceCompilationEnabled)
+{
+	m_traceCompilationEnabled = traceCompilationEnabled;
+}
+
+uint64 CMipsExecutor::GetLinkHitCount() const
+{
+	return m_linkHitCount;
+}
+
+uint64 CMipsExecutor::GetDispatchCount() const
+{
+	return m_dispatchCount;
+}
+
+uint32 CMipsExecutor::GetTraceCount() const
+{
+	return m_traceCount;
+}
+
+uint32 CMipsExecutor::GetCompileCount() const
+{
+	return m_compileCount;
+}
+
+void CMipsExecutor::ResetStats()
+{
+	m_linkHitCount = 0;
+	m_dispatchCount = 0;
+	m_traceCount = 0;
+	m_compileCount = 0;
+}
+
 int CMipsExecutor::Execute(int cycles)
 {
 	CBasicBlock* block(nullptr);
 	while(cycles > 0)
 	{
-		uint32 address = m_context.m_pAddrTranslator(&m_context, m_context.m_State.nPC);
-		if(!block || address != block->GetBeginAddress())
+		if(m_context.m_codeWritten.exchange(0))
+		{
+			//Blocks might need to be unlinked before we can follow links again
+			ProcessCodeWrites();
+		}
+		//Follow links established by previous executions of this block if possible, this saves us
+		//from translating the address and looking it up in the block table. We still come back
+		//here after every block, only traces keep running generated code across blocks.
+		CBasicBlock* nextBlock = (block && m_blockLinkingEnabled) ? block->GetLinkedBlock(m_context.m_State.nPC) : nullptr;
+		if(nextBlock)
+		{
+			m_linkHitCount++;
+		}
+		else
 		{
-			block = FindBlockStartingAt(address);
-			if(block == NULL)
+			m_dispatchCount++;
+			bool canLink = (block != nullptr) && m_blockLinkingEnabled;
+			uint32 address = m_context.m_pAddrTranslator(&m_context, m_context.m_State.nPC);
+			if(!block || address != block->GetBeginAddress())
 			{
-				//We need to partition the space and compile the blocks
+				nextBlock = FindBlockStartingAt(address);
+				if(nextBlock == NULL)
+				{
+					//We need to partition the space and compile the blocks
+					//This might delete the previous block, so don't try to link with it
+					PartitionFunction(address);
+					canLink = false;
+					block = nullptr;
+					nextBlock = FindBlockStartingAt(address);
+					if(nextBlock == NULL)
+					{
+						throw std::runtime_error("Couldn't create block starting at address.");
+					}
+				}
+				if(!nextBlock->IsCompiled())
+				{
+					nextBlock->Compile(m_blockCache);
+					m_compileCount++;
+				}
+			}
+			else
+			{
+				nextBlock = block;
+			}
+			if(nextBlock->IsValidationPending() && !RevalidateBlock(nextBlock))
+			{
+				//Code changed since the block was compiled, start over with fresh blocks
+				//The previous block might be the one going away, don't try to link with it
+				canLink = false;
+				block = nullptr;
+				DeleteBlock(nextBlock);
 				PartitionFunction(address);
-				block = FindBlockStartingAt(address);
-				if(block == NULL)
+				nextBlock = FindBlockStartingAt(address);
+				if(nextBlock == NULL)
 				{
 					throw std::runtime_error("Couldn't create block starting at address.");
 				}
+				nextBlock->Compile(m_blockCache);
+				m_compileCount++;
 			}
-			if(!block->IsCompiled())
+			//Blocks waiting for validation must always be entered through here
+			if(canLink && !nextBlock->IsValidationPending())
 			{
-				block->Compile();
+				block->TryLinkBlock(m_context.m_State.nPC, address, nextBlock);
 			}
 		}
-		else if(block != NULL)
+		if(nextBlock == block)
 		{
 			block->SetSelfLoopCount(block->GetSelfLoopCount() + 1);
 		}
+		if(m_traceCompilationEnabled)
+		{
+			if(block)
+			{
+				block->RecordSuccessor(nextBlock->GetBeginAddress());
+			}
+			if((nextBlock->IncrementExecutionCount() == TRACE_THRESHOLD) && !nextBlock->HasTrace())
+			{
+				CompileTrace(nextBlock);
+			}
+		}
+		block = nextBlock;
 
 #ifdef DEBUGGER_INCLUDED
 		if(!m_breakpointsDisabledOnce && MustBreak()) break;
@@ -168,6 +296,60 @@ void CMipsExecutor::DisableBreakpointsOnce()
 
 #endif
 
+void CMipsExecutor::CompileTrace(CBasicBlock* headBlock)
+{
+#ifdef DEBUGGER_INCLUDED
+	//Breakpoints are checked at block boundaries, traces would skip them
+	if(!m_context.m_breakpoints.empty()) return;
+#endif
+
+	if(headBlock->IsValidationPending()) return;
+
+	CBasicBlock::BlockArray traceBlocks;
+	traceBlocks.push_back(headBlock);
+	uint32 instructionCount = ((headBlock->GetEndAddress() - headBlock->GetBeginAddress()) / 4) + 1;
+
+	auto block = headBlock;
+	while(traceBlocks.size() < MAX_TRACE_BLOCKS)
+	{
+		auto nextBlock = FindHotSuccessor(block);
+		if(nextBlock == nullptr) break;
+		//Stop at loops, the head block will get dispatched again
+		if(std::find(std::begin(traceBlocks), std::end(traceBlocks), nextBlock) != std::end(traceBlocks)) break;
+		instructionCount += ((nextBlock->GetEndAddress() - nextBlock->GetBeginAddress()) / 4) + 1;
+		if(instructionCount > MAX_TRACE_INSTRUCTIONS) break;
+		traceBlocks.push_back(nextBlock);
+		block = nextBlock;
+	}
+
+	//Nothing to gain if we couldn't chain anything with the block
+	if(traceBlocks.size() < 2) return;
+
+	headBlock->CompileTrace(traceBlocks);
+	m_traceCount++;
+}
+
+CBasicBlock* CMipsExecutor::FindHotSuccessor(CBasicBlock* block)
+{
+	if(!block->HasStaticSuccessors()) return nullptr;
+
+	//Follow the branch if it was taken most of the time
+	uint32 nextAddress = block->GetEndAddress() + 4;
+	uint32 branchTarget = block->GetStaticBranchTarget();
+	if((branchTarget != MIPS_INVALID_PC) && ((block->GetBranchTakenCount() * 2) >= block->GetExecutionCount()))
+	{
+		nextAddress = m_context.m_pAddrTranslator(&m_context, branchTarget);
+	}
+
+	if((nextAddress >> 16) >= m_subTableCount) return nullptr;
+	auto nextBlock = FindBlockStartingAt(nextAddress);
+	if(nextBlock == nullptr) return nullptr;
+	if(!nextBlock->IsCompiled()) return nullptr;
+	if(nextBlock->IsValidationPending()) return nullptr;
+	if(nextBlock->GetExecutionCount() < (TRACE_THRESHOLD / 2)) return nullptr;
+	return nextBlock;
+}
+
 CBasicBlock* CMipsExecutor::FindBlockAt(uint32 address) const
 {
 	uint32 hiAddress = address >> 16;
@@ -253,6 +435,8 @@ void CMipsExecutor::CreateBlock(uint32 start, uint32 end)
 
 void CMipsExecutor::DeleteBlock(CBasicBlock* block)
 {
+	block->UnlinkAllBlocks();
+
 	for(uint32 address = block->GetBeginAddress(); address <= block->GetEndAddress(); address += 4)
 	{
 		uint32 hiAddress = address >> 16;
@@ -270,6 +454,18 @@ void CMipsExecutor::DeleteBlock(CBasicBlock* block)
 	m_blocks.erase(blockIterator);
 }
 
+bool CMipsExecutor::RevalidateBlock(CBasicBlock* block)
+{
+	if(block->HasCodeChanged()) return false;
+	block->SetValidationPending(false);
+	return true;
+}
+
+void CMipsExecutor::ProcessCodeWrites()
+{
+
+}
+
 CMipsExecutor::BasicBlockPtr CMipsExecutor::BlockFactory(CMIPS& context, uint32 start, uint32 end)
 {
 	return std::make_shared<CBasicBlock>(context, start, end);
@@ -4,6 +4,7 @@
 #include <list>
 #include "MIPS.h"
 #include "BasicBlock.h"
+#include "JitBlockCache.h"
 
 class CMipsExecutor
 {
@@ -18,6 +19,19 @@ public:
 	void						ClearActiveBlocks();
 	virtual void				ClearActiveBlocksInRange(uint32, uint32);
 
+	CJitBlockCache*				GetBlockCache() const;
+	void						SetBlockCache(CJitBlockCache*);
+
+	bool						GetBlockLinkingEnabled() const;
+	void						SetBlockLinkingEnabled(bool);
+	bool						GetTraceCompilationEnabled() const;
+	void						SetTraceCompilationEnabled(bool);
+	uint64						GetLinkHitCount() const;
+	uint64						GetDispatchCount() const;
+	uint32						GetTraceCount() const;
+	uint32						GetCompileCount() const;
+	virtual void				ResetStats();
+
 #ifdef DEBUGGER_INCLUDED
 	bool						MustBreak() const;
 	void						DisableBreakpointsOnce();
@@ -27,18 +41,40 @@ protected:
 	typedef std::shared_ptr<CBasicBlock> BasicBlockPtr;
 	typedef std::list<BasicBlockPtr> BlockList;
 
+	enum
+	{
+		//Amount of times a block needs to run before we try compiling a trace from it
+		TRACE_THRESHOLD = 0x400,
+		MAX_TRACE_BLOCKS = 8,
+		MAX_TRACE_INSTRUCTIONS = 0x400,
+	};
+
 	void						CreateBlock(uint32, uint32);
 	virtual BasicBlockPtr		BlockFactory(CMIPS&, uint32, uint32);
 	virtual void				PartitionFunction(uint32);
+	virtual bool				RevalidateBlock(CBasicBlock*);
+	virtual void				ProcessCodeWrites();
 	
 	void						ClearActiveBlocksInRangeInternal(uint32, uint32, CBasicBlock*);
 
+	void						CompileTrace(CBasicBlock*);
+	CBasicBlock*				FindHotSuccessor(CBasicBlock*);
+
 	BlockList					m_blocks;
 	CMIPS&						m_context;
 
 	CBasicBlock***				m_blockTable;
 	uint32						m_subTableCount;
 
+	CJitBlockCache*				m_blockCache = nullptr;
+
+	bool						m_blockLinkingEnabled = true;
+	bool						m_traceCompilationEnabled = false;
+	uint64						m_linkHitCount = 0;
+	uint64						m_dispatchCount = 0;
+	uint32						m_traceCount = 0;
+	uint32						m_compileCount = 0;
+
 #ifdef DEBUGGER_INCLUDED
 	bool						m_breakpointsDisabledOnce;
 #endif
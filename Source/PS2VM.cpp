@@ -25,6 +25,9 @@
 #include "Log.h"
 #include "ISO9660/BlockProvider.h"
 #include "DiskUtils.h"
+#include "ImageFrameCache.h"
+#include "MemStream.h"
+#include "PtrStream.h"
 
 #define LOG_NAME		("ps2vm")
 
@@ -38,8 +41,31 @@
 
 #define SPU_UPDATE_TICKS	(PS2::IOP_CLOCK_OVER_FREQ / 1000)
 
+//EE CPU is 8 times faster than the IOP CPU, slices are kept multiples of this ratio
+#define IOP_CLOCK_RATIO			(8)
+#define MIN_SLICE_TICKS			(64)
+#define DEFAULT_MAX_SLICE_TICKS	(1920)
+//Devices are updated when a processor's execution returns, this keeps them updated as often
+//as they were before slices got longer than this
+#define MAX_EXECUTE_TICKS		(480)
+
+//Fastest deflate level, states are compressed as fast as possible
+#define DEFAULT_SAVESTATE_COMPRESSION_LEVEL	(1)
+
+//Rewind interval is in frames, length in seconds and memory in MiB
+#define DEFAULT_REWIND_INTERVAL		(30)
+#define DEFAULT_REWIND_LENGTH		(60)
+#define DEFAULT_REWIND_MAXMEMORY	(512)
+
 #define VPU_LOG_BASE		"./vpu_logs/"
 
+#define JITBLOCKCACHE_PATH	("jitcache")
+
+//Code generated with fast memory access enabled can't be used without it
+#define EE_JITBLOCKCACHE_NAME			("ee.jitcache")
+#define EE_FASTMEM_JITBLOCKCACHE_NAME	("ee_fastmem.jitcache")
+#define IOP_JITBLOCKCACHE_NAME			("iop.jitcache")
+
 namespace filesystem = boost::filesystem;
 
 CPS2VM::CPS2VM()
@@ -50,16 +76,16 @@ CPS2VM::CPS2VM()
 , m_singleStepIop(false)
 , m_singleStepVu0(false)
 , m_singleStepVu1(false)
-, m_vblankTicks(0)
+, m_scheduler(SCHEDULER_EVENT_COUNT)
 , m_inVblank(false)
 , m_eeExecutionTicks(0)
 , m_iopExecutionTicks(0)
-, m_spuUpdateTicks(SPU_UPDATE_TICKS)
 , m_eeProfilerZone(CProfiler::GetInstance().RegisterZone("EE"))
 , m_iopProfilerZone(CProfiler::GetInstance().RegisterZone("IOP"))
 , m_spuProfilerZone(CProfiler::GetInstance().RegisterZone("SPU"))
 , m_gsSyncProfilerZone(CProfiler::GetInstance().RegisterZone("GSSYNC"))
 , m_otherProfilerZone(CProfiler::GetInstance().RegisterZone("OTHER"))
+, m_rewindProfilerZone(CProfiler::GetInstance().RegisterZone("REWIND"))
 {
 	const char* basicDirectorySettings[] =
 	{
@@ -85,6 +111,27 @@ CPS2VM::CPS2VM()
 
 	m_ee = std::make_unique<Ee::CSubSystem>(m_iop->m_ram, *m_iopOs);
 	m_ee->m_os->OnRequestLoadExecutable.connect(boost::bind(&CPS2VM::ReloadExecutable, this, _1, _2));
+	m_ee->m_os->OnExecutableChange.connect(boost::bind(&CPS2VM::OnEeExecutableChange, this));
+	m_ee->m_os->OnExecutableUnloading.connect(boost::bind(&CPS2VM::OnEeExecutableUnloading, this));
+	m_iopOs->OnModuleReset.connect(boost::bind(&CPS2VM::OnIopModuleReset, this, _1));
+	m_ee->m_sif.SetTransferHandler([this] () { m_scheduler.Schedule(SCHEDULER_EVENT_SIF_TRANSFER, m_scheduler.GetTime()); });
+
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_JITBLOCKCACHE_ENABLED, true);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_BLOCKLINKING_ENABLED, true);
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_PS2_IPU_DECODERMODE, CIPU::DECODER_MODE_FAST);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_SPUTHREAD_ENABLED, true);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_VU1THREAD_ENABLED, false);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_TRACECOMPILATION_ENABLED, false);
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_PS2_SCHEDULER_MAXSLICETICKS, DEFAULT_MAX_SLICE_TICKS);
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_PS2_SAVESTATE_COMPRESSIONLEVEL, DEFAULT_SAVESTATE_COMPRESSION_LEVEL);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_REWIND_ENABLED, false);
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_PS2_REWIND_INTERVAL, DEFAULT_REWIND_INTERVAL);
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_PS2_REWIND_LENGTH, DEFAULT_REWIND_LENGTH);
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_PS2_REWIND_MAXMEMORY, DEFAULT_REWIND_MAXMEMORY);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_FASTMEM_ENABLED, true);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_CDVD_READTIMING_ENABLED, true);
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_DISKIMAGE_CACHESIZE, CImageFrameCache::DEFAULT_CACHE_SIZE);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_DISKIMAGE_PREFETCH_ENABLED, true);
 }
 
 CPS2VM::~CPS2VM()
@@ -218,6 +265,8 @@ void CPS2VM::Initialize()
 {
 	CreateVM();
 	m_nEnd = false;
+	m_spuThreadEnd = false;
+	m_spuThread = std::thread([&] () { SpuThread(); });
 	m_thread = std::thread([&] () { EmuThread(); });
 }
 
@@ -225,16 +274,37 @@ void CPS2VM::Destroy()
 {
 	m_mailBox.SendCall(std::bind(&CPS2VM::DestroyImpl, this));
 	m_thread.join();
+	m_spuMailBox.SendCall([this] () { m_spuThreadEnd = true; });
+	m_spuThread.join();
 	DestroyVM();
 }
 
 unsigned int CPS2VM::SaveState(const char* sPath)
 {
-	unsigned int result = 0;
-	m_mailBox.SendCall(std::bind(&CPS2VM::SaveVMState, this, sPath, std::ref(result)), true);
+	return SaveStateAsync(sPath).get();
+}
+
+std::future<unsigned int> CPS2VM::SaveStateAsync(const char* sPath)
+{
+	std::future<unsigned int> result;
+	m_mailBox.SendCall([&] () { result = SaveVMState(sPath); }, true);
+	return result;
+}
+
+bool CPS2VM::Rewind()
+{
+	bool result = false;
+	m_mailBox.SendCall([&] () { result = RewindImpl(); }, true);
 	return result;
 }
 
+CRewindBuffer::STATS CPS2VM::GetRewindStats()
+{
+	CRewindBuffer::STATS stats;
+	m_mailBox.SendCall([&] () { stats = m_rewindBuffer.GetStats(); }, true);
+	return stats;
+}
+
 unsigned int CPS2VM::LoadState(const char* sPath)
 {
 	unsigned int result = 0;
@@ -255,6 +325,13 @@ void CPS2VM::TriggerFrameDump(const FrameDumpCallback& frameDumpCallback)
 	);
 }
 
+CEventScheduler::STATS CPS2VM::GetSchedulerStats()
+{
+	CEventScheduler::STATS stats;
+	m_mailBox.SendCall([&] () { stats = m_scheduler.GetStats(); }, true);
+	return stats;
+}
+
 #ifdef DEBUGGER_INCLUDED
 
 #define TAGS_SECTION_TAGS			("tags")
@@ -345,11 +422,19 @@ void CPS2VM::CreateVM()
 
 void CPS2VM::ResetVM()
 {
+	LogSchedulerStats();
+
 	m_ee->Reset();
+	m_ee->SetFastMemoryEnabled(CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_FASTMEM_ENABLED));
 
 	m_iop->Reset();
 	m_iop->SetBios(m_iopOs);
 
+	//IOP cache was saved when the EE's executable was unloaded
+	m_iop->m_executor.SetBlockCache(nullptr);
+	m_iopBlockCacheBasePath.clear();
+	m_iopImageName.clear();
+
 	//LoadBIOS();
 
 	if(m_ee->m_gs != NULL)
@@ -360,6 +445,7 @@ void CPS2VM::ResetVM()
 	m_iopOs->Reset(std::make_shared<Iop::CSifManPs2>(m_ee->m_sif, m_ee->m_ram, m_iop->m_ram));
 
 	CDROM0_Reset();
+	m_iopOs->GetCdvdman()->SetReadTimingEnabled(CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_CDVD_READTIMING_ENABLED));
 
 	m_iopOs->GetIoman()->RegisterDevice("host", Iop::CIoman::DevicePtr(new Iop::Ioman::CDirectoryDevice(PREF_PS2_HOST_DIRECTORY)));
 	m_iopOs->GetIoman()->RegisterDevice("mc0", Iop::CIoman::DevicePtr(new Iop::Ioman::CDirectoryDevice(PREF_PS2_MC0_DIRECTORY)));
@@ -368,14 +454,44 @@ void CPS2VM::ResetVM()
 
 	m_iopOs->GetLoadcore()->SetLoadExecutableHandler(std::bind(&CPS2OS::LoadExecutable, m_ee->m_os, std::placeholders::_1, std::placeholders::_2));
 
-	m_vblankTicks = ONSCREEN_TICKS;
 	m_inVblank = false;
+	m_scheduler.Reset();
+	m_scheduler.SetSliceLimits(MIN_SLICE_TICKS, CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_SCHEDULER_MAXSLICETICKS));
+	m_scheduler.Schedule(SCHEDULER_EVENT_VBLANK, ONSCREEN_TICKS);
+	m_scheduler.Schedule(SCHEDULER_EVENT_SPU_UPDATE, SPU_UPDATE_TICKS * IOP_CLOCK_RATIO);
 
 	m_eeExecutionTicks = 0;
 	m_iopExecutionTicks = 0;
+	m_iopPendingEeTicks = 0;
+
+	{
+		bool blockLinkingEnabled = CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_BLOCKLINKING_ENABLED);
+		m_ee->m_executor.SetBlockLinkingEnabled(blockLinkingEnabled);
+		m_ee->m_executor.ResetStats();
+		m_iop->m_executor.SetBlockLinkingEnabled(blockLinkingEnabled);
+		m_iop->m_executor.ResetStats();
+		//Only the EE runs enough code to make the second tier worth it
+		m_ee->m_executor.SetTraceCompilationEnabled(CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_TRACECOMPILATION_ENABLED));
+	}
+
+	m_ee->m_ipu.SetDecoderMode(static_cast<CIPU::DECODER_MODE>(CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_IPU_DECODERMODE)));
+
+	m_stateSnapshotBuilder.Reset();
+	m_stateSnapshotBuilder.SetCompressionLevel(CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_SAVESTATE_COMPRESSIONLEVEL));
+
+	{
+		m_rewindEnabled = CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_REWIND_ENABLED);
+		m_rewindInterval = std::max(CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_REWIND_INTERVAL), 1);
+		m_rewindFrameCount = 0;
+		unsigned int rewindLength = std::max(CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_REWIND_LENGTH), 1);
+		uint64 rewindMaxMemory = static_cast<uint64>(std::max(CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_REWIND_MAXMEMORY), 1)) * 0x100000;
+		m_rewindBuffer.Reset();
+		m_rewindBuffer.SetLimits((rewindLength * 60) / m_rewindInterval, rewindMaxMemory);
+	}
 
-	m_spuUpdateTicks = SPU_UPDATE_TICKS;
 	m_currentSpuBlock = 0;
+	m_spuThreadEnabled = CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_SPUTHREAD_ENABLED);
+	m_ee->m_vpu1->SetThreaded(CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_VU1THREAD_ENABLED));
 
 	RegisterModulesInPadHandler();
 
@@ -395,40 +511,162 @@ void CPS2VM::ResetVM()
 
 void CPS2VM::DestroyVM()
 {
+	LogSchedulerStats();
+	OnEeExecutableUnloading();
 	CDROM0_Destroy();
 }
 
-void CPS2VM::SaveVMState(const char* sPath, unsigned int& result)
+std::future<unsigned int> CPS2VM::SaveVMState(const char* sPath)
 {
+	std::promise<unsigned int> failedResult;
+	failedResult.set_value(1);
+
 	if(m_ee->m_gs == NULL)
 	{
 		printf("PS2VM: GS Handler was not instancied. Cannot save state.\r\n");
-		result = 1;
-		return;
+		return failedResult.get_future();
 	}
 
+	WaitForSpu();
+	//Disk reads in flight aren't part of the state
+	m_iopOs->GetCdvdman()->FlushReads();
+
+	CStateSnapshotBuilder::SnapshotPtr snapshot;
 	try
 	{
-		Framework::CStdStream stateStream(sPath, "wb");
+		snapshot = CaptureState();
+	}
+	catch(...)
+	{
+		return failedResult.get_future();
+	}
+
+	std::string path(sPath);
+	return std::async(std::launch::async,
+		[snapshot, path] () -> unsigned int
+		{
+			try
+			{
+				Framework::CStdStream stateStream(path.c_str(), "wb");
+				snapshot->Write(stateStream);
+			}
+			catch(...)
+			{
+				return 1;
+			}
+
+			const auto& stats = snapshot->GetStats();
+			printf("PS2VM: Saved state to file '%s' (%d of %d chunks compressed).\r\n", path.c_str(),
+				stats.compressedChunkCount, stats.chunkCount);
+			return 0;
+		}
+	);
+}
+
+//Memory areas are copied and left for the snapshot to compress, the rest goes through the regular archive
+CStateSnapshotBuilder::SnapshotPtr CPS2VM::CaptureState()
+{
+	CMemoryStateFile::MemoryAreaList memoryAreas;
+	GetMemoryAreas(memoryAreas);
+
+	CVpu::CThreadSync vpu1Sync(*m_ee->m_vpu1);
+
+	Framework::CMemStream archiveStream;
+	{
 		Framework::CZipArchiveWriter archive;
 
-		m_ee->SaveState(archive);
-		m_iop->SaveState(archive);
-		m_ee->m_gs->SaveState(archive);
+		m_ee->SaveState(archive, false);
+		m_iop->SaveState(archive, false);
+		m_ee->m_gs->SaveState(archive, false);
 		m_iopOs->GetPadman()->SaveState(archive);
 		//TODO: Save CDVDFSV state
 
-		archive.Write(stateStream);
+		archive.Write(archiveStream);
+	}
+
+	std::vector<uint8> archiveData(archiveStream.GetBuffer(), archiveStream.GetBuffer() + archiveStream.GetSize());
+	return m_stateSnapshotBuilder.Capture(std::move(archiveData), memoryAreas);
+}
+
+void CPS2VM::GetMemoryAreas(CMemoryStateFile::MemoryAreaList& memoryAreas)
+{
+	m_ee->GetMemoryAreas(memoryAreas);
+	m_iop->GetMemoryAreas(memoryAreas);
+	m_ee->m_gs->GetMemoryAreas(memoryAreas);
+}
+
+void CPS2VM::RestoreState(CStateSnapshot& snapshot)
+{
+	CMemoryStateFile::MemoryAreaList memoryAreas;
+	GetMemoryAreas(memoryAreas);
+
+	CVpu::CThreadSync vpu1Sync(*m_ee->m_vpu1);
+
+	//Memory areas are written by worker threads, code pages can't be protected at that point
+	//since the access fault handler would run on those threads (or not at all, on macOS).
+	//Blocks are discarded when the EE's state is loaded anyway.
+	m_ee->m_executor.Reset();
+	snapshot.RestoreMemoryAreas(memoryAreas);
+
+	const auto& archiveData = snapshot.GetArchiveData();
+	Framework::CPtrStream archiveStream(archiveData.data(), archiveData.size());
+	Framework::CZipArchiveReader archive(archiveStream);
+
+	m_ee->LoadState(archive, false);
+	m_iop->LoadState(archive, false);
+	m_ee->m_gs->LoadState(archive, false);
+	m_iopOs->GetPadman()->LoadState(archive);
+}
+
+void CPS2VM::UpdateRewind()
+{
+	if(!m_rewindEnabled || (m_ee->m_gs == NULL)) return;
+	if(++m_rewindFrameCount < m_rewindInterval) return;
+	//Flushing disk reads would change the game's timing, try again on the next frame instead
+	if(m_iopOs->GetCdvdman()->IsReading()) return;
+	m_rewindFrameCount = 0;
+
+#ifdef PROFILE
+	CProfilerZone profilerZone(m_rewindProfilerZone);
+#endif
+
+	WaitForSpu();
+
+	try
+	{
+		m_rewindBuffer.Push(CaptureState());
+	}
+	catch(const std::exception& exception)
+	{
+		CLog::GetInstance().Print(LOG_NAME, "Failed to capture rewind state: %s\r\n", exception.what());
+	}
+}
+
+bool CPS2VM::RewindImpl()
+{
+	if(m_ee->m_gs == NULL) return false;
+
+	auto snapshot = m_rewindBuffer.Pop();
+	if(!snapshot) return false;
+
+	WaitForSpu();
+
+	try
+	{
+		RestoreState(*snapshot);
 	}
 	catch(...)
 	{
-		result = 1;
-		return;
+		//State is only partially restored at this point
+		PauseImpl();
+		m_rewindBuffer.Reset();
+		return false;
 	}
 
-	printf("PS2VM: Saved state to file '%s'.\r\n", sPath);
+	m_rewindFrameCount = 0;
+	OnMachineStateChange();
 
-	result = 0;
+	return true;
 }
 
 void CPS2VM::LoadVMState(const char* sPath, unsigned int& result)
@@ -445,6 +683,8 @@ void CPS2VM::LoadVMState(const char* sPath, unsigned int& result)
 		Framework::CStdStream stateStream(sPath, "rb");
 		Framework::CZipArchiveReader archive(stateStream);
 		
+		WaitForSpu();
+
 		try
 		{
 			m_ee->LoadState(archive);
@@ -558,32 +798,133 @@ void CPS2VM::OnGsNewFrame()
 #endif
 }
 
-void CPS2VM::UpdateEe()
+void CPS2VM::OnEeExecutableChange()
+{
+	//Pages that were hot for the previous executable might not be for this one
+	m_ee->m_executor.ResetPageFaultCounts();
+
+	if(!CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_JITBLOCKCACHE_ENABLED))
+	{
+		m_ee->m_executor.SetBlockCache(nullptr);
+		m_iop->m_executor.SetBlockCache(nullptr);
+		return;
+	}
+
+	const char* executableName = m_ee->m_os->GetExecutableName();
+	m_eeBlockCache.Load(GetJitBlockCachePath(executableName) / GetEeJitBlockCacheName());
+	m_ee->m_executor.SetBlockCache(&m_eeBlockCache);
+
+	//The IOP keeps running the same image when the EE's executable changes. Its caches
+	//are kept with the first executable started after a reset and are keyed by image.
+	if(m_iopBlockCacheBasePath.empty())
+	{
+		m_iopBlockCacheBasePath = GetJitBlockCachePath(executableName);
+		LoadIopBlockCache();
+	}
+}
+
+void CPS2VM::OnEeExecutableUnloading()
+{
+	if(m_ee->m_executor.GetBlockCache() == nullptr) return;
+
+	const char* executableName = m_ee->m_os->GetExecutableName();
+	auto cachePath = GetJitBlockCachePath(executableName);
+	Framework::PathUtils::EnsurePathExists(cachePath);
+	m_eeBlockCache.Save(cachePath / GetEeJitBlockCacheName());
+	SaveIopBlockCache();
+
+	CLog::GetInstance().Print(LOG_NAME, "JIT block cache stats for '%s': EE %d hits, %d misses; IOP %d hits, %d misses.\r\n",
+		executableName,
+		m_eeBlockCache.GetHitCount(), m_eeBlockCache.GetMissCount(),
+		m_iopBlockCache.GetHitCount(), m_iopBlockCache.GetMissCount());
+
+	m_ee->m_executor.SetBlockCache(nullptr);
+}
+
+void CPS2VM::OnIopModuleReset(const std::string& imagePath)
+{
+	//Code running on the IOP depends on the image it was reset with
+	SaveIopBlockCache();
+	m_iopImageName = imagePath;
+	LoadIopBlockCache();
+}
+
+void CPS2VM::LoadIopBlockCache()
+{
+	if(m_iopBlockCacheBasePath.empty()) return;
+	m_iopBlockCache.Load(GetIopJitBlockCachePath());
+	m_iop->m_executor.SetBlockCache(&m_iopBlockCache);
+}
+
+void CPS2VM::SaveIopBlockCache()
+{
+	if(m_iop->m_executor.GetBlockCache() == nullptr) return;
+	Framework::PathUtils::EnsurePathExists(m_iopBlockCacheBasePath);
+	m_iopBlockCache.Save(GetIopJitBlockCachePath());
+}
+
+boost::filesystem::path CPS2VM::GetIopJitBlockCachePath() const
+{
+	if(m_iopImageName.empty())
+	{
+		return m_iopBlockCacheBasePath / IOP_JITBLOCKCACHE_NAME;
+	}
+	return m_iopBlockCacheBasePath / ("iop_" + SanitizeJitBlockCacheName(m_iopImageName) + ".jitcache");
+}
+
+const char* CPS2VM::GetEeJitBlockCacheName() const
+{
+	return m_ee->IsFastMemoryEnabled() ? EE_FASTMEM_JITBLOCKCACHE_NAME : EE_JITBLOCKCACHE_NAME;
+}
+
+std::string CPS2VM::SanitizeJitBlockCacheName(std::string cacheName)
+{
+	for(auto& nameChar : cacheName)
+	{
+		if(!isalnum(static_cast<unsigned char>(nameChar)) && (nameChar != '.') && (nameChar != '_'))
+		{
+			nameChar = '_';
+		}
+	}
+	return cacheName;
+}
+
+boost::filesystem::path CPS2VM::GetJitBlockCachePath(const char* executableName) const
+{
+	return CAppConfig::GetBasePath() / JITBLOCKCACHE_PATH / SanitizeJitBlockCacheName(executableName);
+}
+
+int CPS2VM::UpdateEe()
 {
 #ifdef PROFILE
 	CProfilerZone profilerZone(m_eeProfilerZone);
 #endif
 
+	int totalExecuted = 0;
 	while(m_eeExecutionTicks > 0)
 	{
-		int executed = m_ee->ExecuteCpu(m_singleStepEe ? 1 : m_eeExecutionTicks);
+		int executed = m_ee->ExecuteCpu(m_singleStepEe ? 1 : std::min(m_eeExecutionTicks, MAX_EXECUTE_TICKS));
 		if(m_ee->IsCpuIdle())
 		{
 			executed = m_eeExecutionTicks;
 		}
 
 		m_eeExecutionTicks -= executed;
+		totalExecuted += executed;
 		m_ee->CountTicks(executed);
-		m_vblankTicks -= executed;
 
 		//Stop executing if executing VU subroutine
 		if(m_ee->m_EE.m_State.callMsEnabled) break;
 
+		//Let the IOP deal with what we sent it
+		if(m_scheduler.IsScheduled(SCHEDULER_EVENT_SIF_TRANSFER)) break;
+
 #ifdef DEBUGGER_INCLUDED
 		if(m_singleStepEe) break;
 		if(m_ee->m_executor.MustBreak()) break;
 #endif
 	}
+	return totalExecuted;
 }
 
 void CPS2VM::UpdateIop()
@@ -594,14 +935,13 @@ void CPS2VM::UpdateIop()
 
 	while(m_iopExecutionTicks > 0)
 	{
-		int executed = m_iop->ExecuteCpu(m_singleStepIop ? 1 : m_iopExecutionTicks);
+		int executed = m_iop->ExecuteCpu(m_singleStepIop ? 1 : std::min(m_iopExecutionTicks, MAX_EXECUTE_TICKS / IOP_CLOCK_RATIO));
 		if(m_iop->IsCpuIdle())
 		{
 			executed = m_iopExecutionTicks;
 		}
 
 		m_iopExecutionTicks -= executed;
-		m_spuUpdateTicks -= executed;
 		m_iop->CountTicks(executed);
 
 #ifdef DEBUGGER_INCLUDED
@@ -617,6 +957,33 @@ void CPS2VM::UpdateSpu()
 	CProfilerZone profilerZone(m_spuProfilerZone);
 #endif
 
+	assert(!m_spuRenderPending);
+	if(m_spuThreadEnabled)
+	{
+		m_spuRenderPending = true;
+		m_spuMailBox.SendCall([this] () { RenderSpu(); });
+	}
+	else
+	{
+		RenderSpu();
+	}
+}
+
+void CPS2VM::WaitForSpu()
+{
+	if(!m_spuRenderPending) return;
+
+	//Only the time the emulation thread spends waiting is accounted for here
+#ifdef PROFILE
+	CProfilerZone profilerZone(m_spuProfilerZone);
+#endif
+
+	m_spuMailBox.FlushCalls();
+	m_spuRenderPending = false;
+}
+
+void CPS2VM::RenderSpu()
+{
 	unsigned int blockOffset = (BLOCK_SIZE * m_currentSpuBlock);
 	int16* samplesSpu0 = m_samples + blockOffset;
 
@@ -626,14 +993,7 @@ void CPS2VM::UpdateSpu()
 	{
 		int16 samplesSpu1[BLOCK_SIZE];
 		m_iop->m_spuCore1.Render(samplesSpu1, BLOCK_SIZE, 44100);
-
-		for(unsigned int i = 0; i < BLOCK_SIZE; i++)
-		{
-			int32 resultSample = static_cast<int32>(samplesSpu0[i]) + static_cast<int32>(samplesSpu1[i]);
-			resultSample = std::max<int32>(resultSample, SHRT_MIN);
-			resultSample = std::min<int32>(resultSample, SHRT_MAX);
-			samplesSpu0[i] = static_cast<int16>(resultSample);
-		}
+		Iop::CSpuBase::AccumulateSamples(samplesSpu0, samplesSpu1, BLOCK_SIZE);
 	}
 
 	m_currentSpuBlock++;
@@ -659,6 +1019,7 @@ void CPS2VM::CDROM0_Initialize()
 
 void CPS2VM::CDROM0_Reset()
 {
+	SetIopCdImage(nullptr);
 	m_cdrom0.reset();
 	CDROM0_Mount(CAppConfig::GetInstance().GetPreferenceString(PS2VM_CDROM0PATH));
 }
@@ -673,7 +1034,9 @@ void CPS2VM::CDROM0_Mount(const char* path)
 	{
 		try
 		{
-			m_cdrom0 = DiskUtils::CreateDiskImageFromPath(path);
+			auto cdrom0 = DiskUtils::CreateDiskImageFromPath(path);
+			SetIopCdImage(nullptr);
+			m_cdrom0 = std::move(cdrom0);
 			SetIopCdImage(m_cdrom0.get());
 		}
 		catch(const std::exception& Exception)
@@ -712,6 +1075,88 @@ void CPS2VM::ReloadExecutable(const char* executablePath, const CPS2OS::Argument
 	m_ee->m_os->BootFromVirtualPath(executablePath, arguments);
 }
 
+void CPS2VM::ScheduleTimerEvents()
+{
+	int64 time = m_scheduler.GetTime();
+	m_scheduler.Schedule(SCHEDULER_EVENT_EE_TIMER, time + m_ee->GetTicksUntilNextEvent());
+	m_scheduler.Schedule(SCHEDULER_EVENT_IOP_TIMER, time + static_cast<int64>(m_iop->GetTicksUntilNextEvent()) * IOP_CLOCK_RATIO);
+}
+
+void CPS2VM::ProcessSchedulerEvents()
+{
+	unsigned int eventId = 0;
+	while(m_scheduler.PopDueEvent(eventId))
+	{
+		int64 deadline = m_scheduler.GetDeadline(eventId);
+		switch(eventId)
+		{
+		case SCHEDULER_EVENT_VBLANK:
+			ToggleVBlank();
+			if(m_inVblank)
+			{
+				UpdateRewind();
+			}
+			m_scheduler.Schedule(SCHEDULER_EVENT_VBLANK, deadline + (m_inVblank ? VBLANK_TICKS : ONSCREEN_TICKS));
+			break;
+		case SCHEDULER_EVENT_SPU_UPDATE:
+			WaitForSpu();
+			UpdateSpu();
+			m_scheduler.Schedule(SCHEDULER_EVENT_SPU_UPDATE, deadline + (SPU_UPDATE_TICKS * IOP_CLOCK_RATIO));
+			break;
+		default:
+			//Timers are rescheduled before every slice, SIF transfers only end the EE's slice
+			break;
+		}
+	}
+}
+
+void CPS2VM::ToggleVBlank()
+{
+	m_inVblank = !m_inVblank;
+	if(m_inVblank)
+	{
+		m_ee->NotifyVBlankStart();
+		m_iop->NotifyVBlankStart();
+
+		if(m_ee->m_gs != NULL)
+		{
+#ifdef PROFILE
+			CProfilerZone profilerZone(m_gsSyncProfilerZone);
+#endif
+			m_ee->m_gs->SetVBlank();
+		}
+
+		if(m_pad != NULL)
+		{
+			m_pad->Update(m_ee->m_ram);
+		}
+#ifdef PROFILE
+		{
+			auto stats = CProfiler::GetInstance().GetStats();
+			ProfileFrameDone(stats);
+			CProfiler::GetInstance().Reset();
+		}
+#endif
+	}
+	else
+	{
+		m_ee->NotifyVBlankEnd();
+		m_iop->NotifyVBlankEnd();
+		if(m_ee->m_gs != NULL)
+		{
+			m_ee->m_gs->ResetVBlank();
+		}
+	}
+}
+
+void CPS2VM::LogSchedulerStats()
+{
+	const auto& stats = m_scheduler.GetStats();
+	if(stats.sliceCount == 0) return;
+	CLog::GetInstance().Print(LOG_NAME, "Scheduler stats: %llu slices, %f ticks per slice on average.\r\n",
+		static_cast<unsigned long long>(stats.sliceCount), stats.GetAverageSliceTicks());
+}
+
 void CPS2VM::EmuThread()
 {
 	fesetround(FE_TOWARDZERO);
@@ -734,64 +1179,28 @@ void CPS2VM::EmuThread()
 			CProfilerZone profilerZone(m_otherProfilerZone);
 #endif
 
-			if(m_spuUpdateTicks <= 0)
-			{
-				UpdateSpu();
-				m_spuUpdateTicks += SPU_UPDATE_TICKS;
-			}
+			ProcessSchedulerEvents();
+			ScheduleTimerEvents();
 
 			//EE execution
 			{
-				//Check vblank stuff
-				if(m_vblankTicks <= 0)
-				{
-					m_inVblank = !m_inVblank;
-					if(m_inVblank)
-					{
-						m_vblankTicks += VBLANK_TICKS;
-						m_ee->NotifyVBlankStart();
-						m_iop->NotifyVBlankStart();
-
-						if(m_ee->m_gs != NULL)
-						{
-#ifdef PROFILE
-							CProfilerZone profilerZone(m_gsSyncProfilerZone);
-#endif
-							m_ee->m_gs->SetVBlank();
-						}
+				int sliceTicks = m_scheduler.GetSliceTicks();
+				sliceTicks = (sliceTicks + IOP_CLOCK_RATIO - 1) & ~(IOP_CLOCK_RATIO - 1);
+				//Time only moves by what was executed, nothing is carried over to the next slice
+				m_eeExecutionTicks = sliceTicks;
 
-						if(m_pad != NULL)
-						{
-							m_pad->Update(m_ee->m_ram);
-						}
-#ifdef PROFILE
-						{
-							auto stats = CProfiler::GetInstance().GetStats();
-							ProfileFrameDone(stats);
-							CProfiler::GetInstance().Reset();
-						}
-#endif
-					}
-					else
-					{
-						m_vblankTicks += ONSCREEN_TICKS;
-						m_ee->NotifyVBlankEnd();
-						m_iop->NotifyVBlankEnd();
-						if(m_ee->m_gs != NULL)
-						{
-							m_ee->m_gs->ResetVBlank();
-						}
-					}
-				}
-
-				//EE CPU is 8 times faster than the IOP CPU
-				static const int tickStep = 480;
-				m_eeExecutionTicks += tickStep;
-				m_iopExecutionTicks += tickStep / 8;
-
-				UpdateEe();
+				int eeExecuted = UpdateEe();
+
+				//IOP runs for as long as the EE did
+				m_iopPendingEeTicks += eeExecuted;
+				m_iopExecutionTicks += m_iopPendingEeTicks / IOP_CLOCK_RATIO;
+				m_iopPendingEeTicks %= IOP_CLOCK_RATIO;
+
+				WaitForSpu();
 				UpdateIop();
 
+				m_scheduler.Advance(eeExecuted);
+
 				m_ee->m_vpu0->Execute(m_singleStepVu0);
 				m_ee->m_vpu1->Execute(m_singleStepVu1);
 			}
@@ -815,3 +1224,17 @@ void CPS2VM::EmuThread()
 	}
 	m_ee->m_executor.RemoveExceptionHandler();
 }
+
+void CPS2VM::SpuThread()
+{
+	//Reverb is computed with floats, use the same rounding mode as the emulation thread
+	fesetround(FE_TOWARDZERO);
+	while(!m_spuThreadEnd)
+	{
+		m_spuMailBox.WaitForCall();
+		while(m_spuMailBox.IsPending())
+		{
+			m_spuMailBox.ReceiveCall();
+		}
+	}
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <thread>
+#include <future>
 #include "AppDef.h"
 #include "Types.h"
 #include "MIPS.h"
@@ -14,10 +15,28 @@
 #include "../tools/PsfPlayer/Source/SoundHandler.h"
 #include "FrameDump.h"
 #include "Profiler.h"
+#include "JitBlockCache.h"
+#include "EventScheduler.h"
+#include "StateSnapshot.h"
+#include "RewindBuffer.h"
 
 #define PREF_PS2_HOST_DIRECTORY				("ps2.host.directory")
 #define PREF_PS2_MC0_DIRECTORY				("ps2.mc0.directory")
 #define PREF_PS2_MC1_DIRECTORY				("ps2.mc1.directory")
+#define PREF_PS2_JITBLOCKCACHE_ENABLED		("ps2.jitblockcache.enabled")
+#define PREF_PS2_BLOCKLINKING_ENABLED		("ps2.blocklinking.enabled")
+#define PREF_PS2_IPU_DECODERMODE			("ps2.ipu.decodermode")
+#define PREF_PS2_SPUTHREAD_ENABLED			("ps2.sputhread.enabled")
+#define PREF_PS2_VU1THREAD_ENABLED			("ps2.vu1thread.enabled")
+#define PREF_PS2_TRACECOMPILATION_ENABLED	("ps2.tracecompilation.enabled")
+#define PREF_PS2_SCHEDULER_MAXSLICETICKS	("ps2.scheduler.maxsliceticks")
+#define PREF_PS2_SAVESTATE_COMPRESSIONLEVEL	("ps2.savestate.compressionlevel")
+#define PREF_PS2_REWIND_ENABLED				("ps2.rewind.enabled")
+#define PREF_PS2_REWIND_INTERVAL			("ps2.rewind.interval")
+#define PREF_PS2_REWIND_LENGTH				("ps2.rewind.length")
+#define PREF_PS2_REWIND_MAXMEMORY			("ps2.rewind.maxmemory")
+#define PREF_PS2_FASTMEM_ENABLED			("ps2.fastmem.enabled")
+#define PREF_PS2_CDVD_READTIMING_ENABLED	("ps2.cdvd.readtiming.enabled")
 
 class CPS2VM : public CVirtualMachine
 {
@@ -59,10 +78,18 @@ public:
 	void						DestroySoundHandler();
 
 	unsigned int				SaveState(const char*);
+	//Emulation goes on as soon as the state is captured, result is available once the file is written
+	std::future<unsigned int>	SaveStateAsync(const char*);
+
+	//Goes back to the most recent state kept by the rewind buffer, returns false if there's none left
+	bool						Rewind();
+	CRewindBuffer::STATS		GetRewindStats();
 	unsigned int				LoadState(const char*);
 
 	void						TriggerFrameDump(const FrameDumpCallback&);
 
+	CEventScheduler::STATS		GetSchedulerStats();
+
 #ifdef DEBUGGER_INCLUDED
 	std::string					MakeDebugTagsPackagePath(const char*);
 	void						LoadDebugTags(const char*);
@@ -81,10 +108,30 @@ public:
 private:
 	typedef std::unique_ptr<CISO9660> Iso9660Ptr;
 
+	//Timers only need to be scheduled to bound time slices, they raise their
+	//interrupts by themselves when ticks are counted.
+	//EE DMAC, IPU and GS transfers are resumed every time the EE's execution returns
+	//(see MAX_EXECUTE_TICKS). SIF transfers need the IOP to run, the EE's slice is
+	//ended as soon as it sends something to the IOP.
+	enum SCHEDULER_EVENT
+	{
+		SCHEDULER_EVENT_VBLANK,
+		SCHEDULER_EVENT_SPU_UPDATE,
+		SCHEDULER_EVENT_EE_TIMER,
+		SCHEDULER_EVENT_IOP_TIMER,
+		SCHEDULER_EVENT_SIF_TRANSFER,
+		SCHEDULER_EVENT_COUNT,
+	};
+
 	void						CreateVM();
 	void						ResetVM();
 	void						DestroyVM();
-	void						SaveVMState(const char*, unsigned int&);
+	std::future<unsigned int>	SaveVMState(const char*);
+	CStateSnapshotBuilder::SnapshotPtr	CaptureState();
+	void						GetMemoryAreas(CMemoryStateFile::MemoryAreaList&);
+	void						RestoreState(CStateSnapshot&);
+	void						UpdateRewind();
+	bool						RewindImpl();
 	void						LoadVMState(const char*, unsigned int&);
 
 	void						ReloadExecutable(const char*, const CPS2OS::ArgumentList&);
@@ -102,12 +149,24 @@ private:
 	void						CreateSoundHandlerImpl(const CSoundHandler::FactoryFunction&);
 	void						DestroySoundHandlerImpl();
 
-	void						UpdateEe();
+	int							UpdateEe();
 	void						UpdateIop();
 	void						UpdateSpu();
+	void						RenderSpu();
+	void						WaitForSpu();
 
 	void						OnGsNewFrame();
 
+	void						OnEeExecutableChange();
+	void						OnEeExecutableUnloading();
+	void						OnIopModuleReset(const std::string&);
+	void						LoadIopBlockCache();
+	void						SaveIopBlockCache();
+	static std::string			SanitizeJitBlockCacheName(std::string);
+	boost::filesystem::path		GetJitBlockCachePath(const char*) const;
+	boost::filesystem::path		GetIopJitBlockCachePath() const;
+	const char*					GetEeJitBlockCacheName() const;
+
 	void						CDROM0_Initialize();
 	void						CDROM0_Mount(const char*);
 	void						CDROM0_Reset();
@@ -116,18 +175,34 @@ private:
 
 	void						RegisterModulesInPadHandler();
 
+	void						ScheduleTimerEvents();
+	void						ProcessSchedulerEvents();
+	void						ToggleVBlank();
+	void						LogSchedulerStats();
+
 	void						EmuThread();
+	void						SpuThread();
 
 	std::thread					m_thread;
 	CMailBox					m_mailBox;
 	STATUS						m_nStatus;
 	bool						m_nEnd;
 
-	int							m_vblankTicks = 0;
+	//SPU blocks are rendered on this thread while the EE runs and are
+	//waited for before the IOP gets to run again
+	std::thread					m_spuThread;
+	CMailBox					m_spuMailBox;
+	bool						m_spuThreadEnd = false;
+	bool						m_spuThreadEnabled = true;
+	bool						m_spuRenderPending = false;
+
+	//Time is counted in EE ticks
+	CEventScheduler				m_scheduler;
 	bool						m_inVblank = 0;
-	int							m_spuUpdateTicks = 0;
 	int							m_eeExecutionTicks = 0;
 	int							m_iopExecutionTicks = 0;
+	//EE ticks that weren't given to the IOP yet, less than IOP_CLOCK_RATIO
+	int							m_iopPendingEeTicks = 0;
 
 	bool						m_singleStepEe;
 	bool						m_singleStepIop;
@@ -141,6 +216,18 @@ private:
 
 	Iso9660Ptr					m_cdrom0;
 
+	CJitBlockCache				m_eeBlockCache;
+	CJitBlockCache				m_iopBlockCache;
+	boost::filesystem::path		m_iopBlockCacheBasePath;
+	std::string					m_iopImageName;
+
+	CStateSnapshotBuilder		m_stateSnapshotBuilder;
+
+	CRewindBuffer				m_rewindBuffer;
+	bool						m_rewindEnabled = false;
+	unsigned int				m_rewindInterval = 1;
+	unsigned int				m_rewindFrameCount = 0;
+
 	enum
 	{
 		SAMPLE_COUNT = 44,
@@ -157,4 +244,5 @@ private:
 	CProfiler::ZoneHandle		m_spuProfilerZone = 0;
 	CProfiler::ZoneHandle		m_gsSyncProfilerZone = 0;
 	CProfiler::ZoneHandle		m_otherProfilerZone = 0;
+	CProfiler::ZoneHandle		m_rewindProfilerZone = 0;
 };
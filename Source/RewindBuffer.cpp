@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <cassert>
+#include "RewindBuffer.h"
+
+void CRewindBuffer::Reset()
+{
+	m_entries.clear();
+	m_chunkRefCounts.clear();
+	m_memorySize = 0;
+}
+
+void CRewindBuffer::SetLimits(unsigned int maxSnapshotCount, uint64 maxMemorySize)
+{
+	m_maxSnapshotCount = std::max<unsigned int>(maxSnapshotCount, 1);
+	m_maxMemorySize = maxMemorySize;
+	Trim();
+}
+
+void CRewindBuffer::Push(const SnapshotPtr& snapshot)
+{
+	assert(snapshot);
+	//Chunk sizes are only known once compressed, which is done by the time the next snapshot is captured
+	if(!m_entries.empty() && !m_entries.back().accounted)
+	{
+		Account(m_entries.back());
+	}
+	ENTRY entry;
+	entry.snapshot = snapshot;
+	m_entries.push_back(std::move(entry));
+	Trim();
+}
+
+CRewindBuffer::SnapshotPtr CRewindBuffer::Pop()
+{
+	if(m_entries.empty()) return SnapshotPtr();
+	auto& entry = m_entries.back();
+	if(entry.accounted)
+	{
+		Unaccount(entry);
+	}
+	auto snapshot = std::move(entry.snapshot);
+	m_entries.pop_back();
+	return snapshot;
+}
+
+CRewindBuffer::STATS CRewindBuffer::GetStats() const
+{
+	STATS stats;
+	stats.snapshotCount = static_cast<uint32>(m_entries.size());
+	stats.memorySize = m_memorySize;
+	return stats;
+}
+
+void CRewindBuffer::Account(ENTRY& entry)
+{
+	assert(!entry.accounted);
+	entry.snapshot->WaitForCompression();
+	m_memorySize += entry.snapshot->GetArchiveData().size();
+	for(const auto& area : entry.snapshot->GetAreas())
+	{
+		for(const auto& chunk : area.chunks)
+		{
+			if(m_chunkRefCounts[chunk.get()]++ == 0)
+			{
+				m_memorySize += chunk->data.size();
+			}
+		}
+	}
+	entry.accounted = true;
+}
+
+void CRewindBuffer::Unaccount(ENTRY& entry)
+{
+	assert(entry.accounted);
+	m_memorySize -= entry.snapshot->GetArchiveData().size();
+	for(const auto& area : entry.snapshot->GetAreas())
+	{
+		for(const auto& chunk : area.chunks)
+		{
+			auto refCountIterator = m_chunkRefCounts.find(chunk.get());
+			assert(refCountIterator != std::end(m_chunkRefCounts));
+			if(--refCountIterator->second == 0)
+			{
+				m_memorySize -= chunk->data.size();
+				m_chunkRefCounts.erase(refCountIterator);
+			}
+		}
+	}
+	entry.accounted = false;
+}
+
+void CRewindBuffer::Trim()
+{
+	//Always keep the most recent snapshot
+	while(m_entries.size() > 1)
+	{
+		bool overCount = m_entries.size() > m_maxSnapshotCount;
+		bool overMemory = (m_maxMemorySize != 0) && (m_memorySize > m_maxMemorySize);
+		if(!overCount && !overMemory) break;
+		auto& entry = m_entries.front();
+		if(entry.accounted)
+		{
+			Unaccount(entry);
+		}
+		m_entries.pop_front();
+	}
+}
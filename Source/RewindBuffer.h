@@ -0,0 +1,46 @@
+#pragma once
+
+#include <deque>
+#include <unordered_map>
+#include "StateSnapshot.h"
+
+//Keeps the most recent state snapshots within a count and memory limit. Snapshots share the
+//chunks that didn't change between captures, memory usage counts every chunk only once.
+class CRewindBuffer
+{
+public:
+	typedef CStateSnapshotBuilder::SnapshotPtr SnapshotPtr;
+
+	struct STATS
+	{
+		uint32		snapshotCount = 0;
+		uint64		memorySize = 0;
+	};
+
+	void				Reset();
+	void				SetLimits(unsigned int, uint64);
+
+	//Oldest snapshots are dropped when limits are exceeded
+	void				Push(const SnapshotPtr&);
+	//Returns the most recent snapshot and removes it from the buffer, null if empty
+	SnapshotPtr			Pop();
+
+	STATS				GetStats() const;
+
+private:
+	struct ENTRY
+	{
+		SnapshotPtr		snapshot;
+		bool			accounted = false;
+	};
+
+	void				Account(ENTRY&);
+	void				Unaccount(ENTRY&);
+	void				Trim();
+
+	std::deque<ENTRY>								m_entries;
+	std::unordered_map<const CStateSnapshot::CHUNK*, uint32>	m_chunkRefCounts;
+	uint64											m_memorySize = 0;
+	unsigned int									m_maxSnapshotCount = 1;
+	uint64											m_maxMemorySize = 0;
+};
@@ -0,0 +1,396 @@
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <zlib.h>
+#include "StateSnapshot.h"
+#include "PtrStream.h"
+#include "zip/ZipArchiveReader.h"
+
+//Empty block with the final bit set, terminates a sequence of chunks
+static const uint8 g_finalBlock[] = { 0x03, 0x00 };
+
+#define ZIP_LOCALFILEHEADER_SIG		(0x04034B50)
+#define ZIP_DIRFILEHEADER_SIG		(0x02014B50)
+#define ZIP_DIRENDHEADER_SIG		(0x06054B50)
+#define ZIP_VERSION					(20)
+#define ZIP_METHOD_DEFLATE			(8)
+
+static unsigned int GetJobCount(size_t itemCount)
+{
+	unsigned int threadCount = std::max<unsigned int>(std::thread::hardware_concurrency(), 1);
+	return static_cast<unsigned int>(std::min<size_t>(threadCount, itemCount));
+}
+
+CStateSnapshot::CStateSnapshot(std::vector<uint8> archiveData, AreaList areas, std::vector<std::future<uint64>> compressionJobs, const STATS& stats)
+: m_archiveData(std::move(archiveData))
+, m_areas(std::move(areas))
+, m_compressionJobs(std::move(compressionJobs))
+, m_stats(stats)
+{
+
+}
+
+CStateSnapshot::~CStateSnapshot()
+{
+	//Jobs write to chunks owned by this snapshot
+	std::lock_guard<std::mutex> compressionLock(m_compressionMutex);
+	for(auto& compressionJob : m_compressionJobs)
+	{
+		if(compressionJob.valid()) compressionJob.wait();
+	}
+}
+
+void CStateSnapshot::WaitForCompression()
+{
+	//Other callers wait here until the jobs are done and their results are accounted for
+	std::lock_guard<std::mutex> compressionLock(m_compressionMutex);
+	for(auto& compressionJob : m_compressionJobs)
+	{
+		m_stats.compressedChunkSize += compressionJob.get();
+	}
+	m_compressionJobs.clear();
+}
+
+const std::vector<uint8>& CStateSnapshot::GetArchiveData() const
+{
+	return m_archiveData;
+}
+
+const CStateSnapshot::AreaList& CStateSnapshot::GetAreas() const
+{
+	return m_areas;
+}
+
+const CStateSnapshot::STATS& CStateSnapshot::GetStats()
+{
+	WaitForCompression();
+	return m_stats;
+}
+
+void CStateSnapshot::RestoreMemoryAreas(const CMemoryStateFile::MemoryAreaList& memoryAreas)
+{
+	WaitForCompression();
+
+	struct PENDINGCHUNK
+	{
+		const CHUNK*	chunk;
+		uint8*			dst;
+		uint32			size;
+	};
+
+	std::vector<PENDINGCHUNK> pendingChunks;
+	for(const auto& memoryArea : memoryAreas)
+	{
+		auto areaIterator = std::find_if(std::begin(m_areas), std::end(m_areas),
+			[&] (const AREA& area) { return area.name == memoryArea.name; });
+		if((areaIterator == std::end(m_areas)) || (areaIterator->size != memoryArea.size))
+		{
+			throw std::runtime_error("Memory area doesn't match the one found in snapshot.");
+		}
+		const auto& area = *areaIterator;
+		auto memory = reinterpret_cast<uint8*>(memoryArea.memory);
+		for(uint32 chunkIndex = 0; chunkIndex < area.chunks.size(); chunkIndex++)
+		{
+			uint32 offset = chunkIndex * CHUNK_SIZE;
+			uint32 chunkSize = std::min<uint32>(area.size - offset, CHUNK_SIZE);
+			pendingChunks.push_back({ area.chunks[chunkIndex].get(), memory + offset, chunkSize });
+		}
+	}
+
+	std::vector<std::future<void>> jobs;
+	unsigned int jobCount = GetJobCount(pendingChunks.size());
+	for(unsigned int jobIndex = 0; jobIndex < jobCount; jobIndex++)
+	{
+		jobs.push_back(std::async(std::launch::async,
+			[&pendingChunks, jobIndex, jobCount] ()
+			{
+				for(size_t i = jobIndex; i < pendingChunks.size(); i += jobCount)
+				{
+					const auto& pendingChunk = pendingChunks[i];
+					DecompressChunk(*pendingChunk.chunk, pendingChunk.dst, pendingChunk.size);
+				}
+			}
+		));
+	}
+	for(auto& job : jobs)
+	{
+		job.get();
+	}
+}
+
+void CStateSnapshot::Write(Framework::CStream& stream)
+{
+	WaitForCompression();
+
+	struct ENTRY
+	{
+		std::string		name;
+		uint32			crc;
+		uint32			compressedSize;
+		uint32			uncompressedSize;
+		uint32			offset;
+	};
+
+	std::vector<ENTRY> entries;
+
+	auto writeEntry =
+		[&] (const std::string& name, const std::vector<const CHUNK*>& chunks, uint32 size)
+		{
+			ENTRY entry;
+			entry.name = name;
+			entry.crc = 0;
+			entry.compressedSize = sizeof(g_finalBlock);
+			entry.uncompressedSize = size;
+			entry.offset = static_cast<uint32>(stream.Tell());
+			for(uint32 chunkIndex = 0; chunkIndex < chunks.size(); chunkIndex++)
+			{
+				uint32 chunkSize = std::min<uint32>(size - (chunkIndex * CHUNK_SIZE), CHUNK_SIZE);
+				entry.crc = crc32_combine(entry.crc, chunks[chunkIndex]->crc, chunkSize);
+				entry.compressedSize += static_cast<uint32>(chunks[chunkIndex]->data.size());
+			}
+
+			stream.Write32(ZIP_LOCALFILEHEADER_SIG);
+			stream.Write16(ZIP_VERSION);
+			stream.Write16(0);
+			stream.Write16(ZIP_METHOD_DEFLATE);
+			stream.Write16(0);
+			stream.Write16(0);
+			stream.Write32(entry.crc);
+			stream.Write32(entry.compressedSize);
+			stream.Write32(entry.uncompressedSize);
+			stream.Write16(static_cast<uint16>(entry.name.size()));
+			stream.Write16(0);
+			stream.Write(entry.name.c_str(), entry.name.size());
+			for(const auto& chunk : chunks)
+			{
+				stream.Write(chunk->data.data(), chunk->data.size());
+			}
+			stream.Write(g_finalBlock, sizeof(g_finalBlock));
+
+			entries.push_back(std::move(entry));
+		};
+
+	//Files of the archive are small, compress them again as single chunks
+	{
+		Framework::CPtrStream archiveStream(m_archiveData.data(), m_archiveData.size());
+		Framework::CZipArchiveReader archive(archiveStream);
+		for(const auto& fileHeaderPair : archive.GetFileHeaders())
+		{
+			const auto& fileName = fileHeaderPair.first;
+			uint32 fileSize = fileHeaderPair.second.uncompressedSize;
+			std::vector<uint8> contents(fileSize);
+			archive.BeginReadFile(fileName.c_str())->Read(contents.data(), fileSize);
+
+			CHUNK chunk;
+			CompressChunk(chunk, contents.data(), fileSize, Z_DEFAULT_COMPRESSION);
+			writeEntry(fileName, { &chunk }, fileSize);
+		}
+	}
+
+	for(const auto& area : m_areas)
+	{
+		std::vector<const CHUNK*> chunks;
+		for(const auto& chunk : area.chunks)
+		{
+			chunks.push_back(chunk.get());
+		}
+		writeEntry(area.name, chunks, area.size);
+	}
+
+	uint32 dirOffset = static_cast<uint32>(stream.Tell());
+	for(const auto& entry : entries)
+	{
+		stream.Write32(ZIP_DIRFILEHEADER_SIG);
+		stream.Write16(ZIP_VERSION);
+		stream.Write16(ZIP_VERSION);
+		stream.Write16(0);
+		stream.Write16(ZIP_METHOD_DEFLATE);
+		stream.Write16(0);
+		stream.Write16(0);
+		stream.Write32(entry.crc);
+		stream.Write32(entry.compressedSize);
+		stream.Write32(entry.uncompressedSize);
+		stream.Write16(static_cast<uint16>(entry.name.size()));
+		stream.Write16(0);
+		stream.Write16(0);
+		stream.Write16(0);
+		stream.Write16(0);
+		stream.Write32(0);
+		stream.Write32(entry.offset);
+		stream.Write(entry.name.c_str(), entry.name.size());
+	}
+	uint32 dirSize = static_cast<uint32>(stream.Tell()) - dirOffset;
+
+	stream.Write32(ZIP_DIRENDHEADER_SIG);
+	stream.Write16(0);
+	stream.Write16(0);
+	stream.Write16(static_cast<uint16>(entries.size()));
+	stream.Write16(static_cast<uint16>(entries.size()));
+	stream.Write32(dirSize);
+	stream.Write32(dirOffset);
+	stream.Write16(0);
+}
+
+//Chunks end on a byte boundary without a final block so that they can be appended to each other
+void CStateSnapshot::CompressChunk(CHUNK& chunk, const uint8* src, uint32 size, int level)
+{
+	z_stream z = {};
+	if(deflateInit2(&z, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		throw std::runtime_error("Unable to initialize zlib for snapshot compression.");
+	}
+
+	//Bound doesn't account for the empty block emitted by the flush
+	chunk.data.resize(deflateBound(&z, size) + 0x10);
+
+	z.next_in = const_cast<Bytef*>(src);
+	z.avail_in = size;
+	z.next_out = chunk.data.data();
+	z.avail_out = static_cast<uInt>(chunk.data.size());
+
+	int status = deflate(&z, Z_SYNC_FLUSH);
+	if((status != Z_OK) || (z.avail_in != 0) || (z.avail_out == 0))
+	{
+		deflateEnd(&z);
+		throw std::runtime_error("Unable to compress snapshot chunk.");
+	}
+
+	chunk.data.resize(z.total_out);
+	chunk.crc = crc32(0, src, size);
+	deflateEnd(&z);
+}
+
+void CStateSnapshot::DecompressChunk(const CHUNK& chunk, uint8* dst, uint32 size)
+{
+	z_stream z = {};
+	if(inflateInit2(&z, -15) != Z_OK)
+	{
+		throw std::runtime_error("Unable to initialize zlib for snapshot decompression.");
+	}
+
+	z.next_in = const_cast<Bytef*>(chunk.data.data());
+	z.avail_in = static_cast<uInt>(chunk.data.size());
+	z.next_out = dst;
+	z.avail_out = size;
+
+	int status = inflate(&z, Z_SYNC_FLUSH);
+	if(((status != Z_OK) && (status != Z_BUF_ERROR)) || (z.total_out != size))
+	{
+		inflateEnd(&z);
+		throw std::runtime_error("Unable to decompress snapshot chunk.");
+	}
+	inflateEnd(&z);
+}
+
+CStateSnapshotBuilder::~CStateSnapshotBuilder()
+{
+	Reset();
+}
+
+void CStateSnapshotBuilder::Reset()
+{
+	//Compression jobs of the last snapshot read from our copies
+	if(m_lastSnapshot)
+	{
+		m_lastSnapshot->WaitForCompression();
+	}
+	m_lastSnapshot.reset();
+	m_areaCopies.clear();
+}
+
+void CStateSnapshotBuilder::SetCompressionLevel(int compressionLevel)
+{
+	m_compressionLevel = std::max(std::min(compressionLevel, Z_BEST_COMPRESSION), Z_BEST_SPEED);
+}
+
+CStateSnapshotBuilder::SnapshotPtr CStateSnapshotBuilder::Capture(std::vector<uint8> archiveData, const CMemoryStateFile::MemoryAreaList& memoryAreas)
+{
+	if(m_lastSnapshot)
+	{
+		m_lastSnapshot->WaitForCompression();
+	}
+
+	bool canShareChunks = m_lastSnapshot && IsCompatible(memoryAreas);
+	if(!canShareChunks)
+	{
+		m_areaCopies.clear();
+		for(const auto& memoryArea : memoryAreas)
+		{
+			m_areaCopies.emplace_back(memoryArea.size);
+		}
+	}
+
+	struct PENDINGCHUNK
+	{
+		CStateSnapshot::CHUNK*	chunk;
+		const uint8*			src;
+		uint32					size;
+	};
+
+	auto pendingChunks = std::make_shared<std::vector<PENDINGCHUNK>>();
+	CStateSnapshot::AreaList areas(memoryAreas.size());
+	CStateSnapshot::STATS stats;
+	for(unsigned int areaIndex = 0; areaIndex < memoryAreas.size(); areaIndex++)
+	{
+		const auto& memoryArea = memoryAreas[areaIndex];
+		auto& area = areas[areaIndex];
+		auto& areaCopy = m_areaCopies[areaIndex];
+		auto memory = reinterpret_cast<const uint8*>(memoryArea.memory);
+		area.name = memoryArea.name;
+		area.size = static_cast<uint32>(memoryArea.size);
+		for(uint32 offset = 0; offset < area.size; offset += CStateSnapshot::CHUNK_SIZE)
+		{
+			uint32 chunkSize = std::min<uint32>(area.size - offset, CStateSnapshot::CHUNK_SIZE);
+			if(canShareChunks && !memcmp(memory + offset, areaCopy.data() + offset, chunkSize))
+			{
+				const auto& lastArea = m_lastSnapshot->GetAreas()[areaIndex];
+				area.chunks.push_back(lastArea.chunks[offset / CStateSnapshot::CHUNK_SIZE]);
+				continue;
+			}
+			memcpy(areaCopy.data() + offset, memory + offset, chunkSize);
+			auto chunk = std::make_shared<CStateSnapshot::CHUNK>();
+			pendingChunks->push_back({ chunk.get(), areaCopy.data() + offset, chunkSize });
+			area.chunks.push_back(chunk);
+		}
+		stats.chunkCount += static_cast<uint32>(area.chunks.size());
+		stats.totalSize += area.size;
+	}
+	stats.compressedChunkCount = static_cast<uint32>(pendingChunks->size());
+
+	std::vector<std::future<uint64>> compressionJobs;
+	unsigned int jobCount = GetJobCount(pendingChunks->size());
+	int compressionLevel = m_compressionLevel;
+	for(unsigned int jobIndex = 0; jobIndex < jobCount; jobIndex++)
+	{
+		compressionJobs.push_back(std::async(std::launch::async,
+			[pendingChunks, jobIndex, jobCount, compressionLevel] ()
+			{
+				uint64 compressedSize = 0;
+				for(size_t i = jobIndex; i < pendingChunks->size(); i += jobCount)
+				{
+					const auto& pendingChunk = (*pendingChunks)[i];
+					CStateSnapshot::CompressChunk(*pendingChunk.chunk, pendingChunk.src, pendingChunk.size, compressionLevel);
+					compressedSize += pendingChunk.chunk->data.size();
+				}
+				return compressedSize;
+			}
+		));
+	}
+
+	m_lastSnapshot = std::make_shared<CStateSnapshot>(std::move(archiveData), std::move(areas), std::move(compressionJobs), stats);
+	return m_lastSnapshot;
+}
+
+bool CStateSnapshotBuilder::IsCompatible(const CMemoryStateFile::MemoryAreaList& memoryAreas) const
+{
+	const auto& lastAreas = m_lastSnapshot->GetAreas();
+	if(lastAreas.size() != memoryAreas.size()) return false;
+	for(unsigned int areaIndex = 0; areaIndex < memoryAreas.size(); areaIndex++)
+	{
+		if(lastAreas[areaIndex].name != memoryAreas[areaIndex].name) return false;
+		if(lastAreas[areaIndex].size != memoryAreas[areaIndex].size) return false;
+	}
+	return true;
+}
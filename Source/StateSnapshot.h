@@ -0,0 +1,96 @@
+#pragma once
+
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Types.h"
+#include "Stream.h"
+#include "MemoryStateFile.h"
+
+//Copy of the machine state kept in memory. Registers and small structures are kept in a regular
+//state archive while large memory areas are split in chunks that get compressed on worker threads.
+//Chunks are raw deflate streams that can be appended to each other, which lets the snapshot be
+//written as a state archive that can be loaded like any other.
+class CStateSnapshot
+{
+public:
+	enum
+	{
+		CHUNK_SIZE = 0x10000,
+	};
+
+	struct CHUNK
+	{
+		std::vector<uint8>	data;
+		uint32				crc = 0;
+	};
+	typedef std::shared_ptr<CHUNK> ChunkPtr;
+
+	struct AREA
+	{
+		std::string				name;
+		uint32					size = 0;
+		std::vector<ChunkPtr>	chunks;
+	};
+	typedef std::vector<AREA> AreaList;
+
+	struct STATS
+	{
+		uint32		chunkCount = 0;
+		uint32		compressedChunkCount = 0;
+		uint64		compressedChunkSize = 0;
+		uint64		totalSize = 0;
+	};
+
+						CStateSnapshot(std::vector<uint8>, AreaList, std::vector<std::future<uint64>>, const STATS&);
+	virtual				~CStateSnapshot();
+
+	//Can be called from several threads, returns once every chunk is compressed
+	void				WaitForCompression();
+
+	//Archive with everything but the memory areas
+	const std::vector<uint8>&	GetArchiveData() const;
+	const AreaList&				GetAreas() const;
+
+	//Only chunks compressed for this snapshot are counted, others are shared with older snapshots
+	const STATS&		GetStats();
+
+	//Memory areas are written by worker threads, writing to them must not fault
+	void				RestoreMemoryAreas(const CMemoryStateFile::MemoryAreaList&);
+	void				Write(Framework::CStream&);
+
+	static void			CompressChunk(CHUNK&, const uint8*, uint32, int);
+	static void			DecompressChunk(const CHUNK&, uint8*, uint32);
+
+private:
+	std::vector<uint8>					m_archiveData;
+	AreaList							m_areas;
+	std::mutex							m_compressionMutex;
+	std::vector<std::future<uint64>>	m_compressionJobs;
+	STATS								m_stats;
+};
+
+//Captures snapshots, keeping a copy of the memory areas it saw last time. Chunks that didn't
+//change since the previous capture are shared with the previous snapshot and are not compressed again.
+class CStateSnapshotBuilder
+{
+public:
+	typedef std::shared_ptr<CStateSnapshot> SnapshotPtr;
+
+	virtual				~CStateSnapshotBuilder();
+
+	void				Reset();
+	void				SetCompressionLevel(int);
+
+	//Memory areas are copied before returning, compression goes on in the background
+	SnapshotPtr			Capture(std::vector<uint8>, const CMemoryStateFile::MemoryAreaList&);
+
+private:
+	bool				IsCompatible(const CMemoryStateFile::MemoryAreaList&) const;
+
+	std::vector<std::vector<uint8>>		m_areaCopies;
+	SnapshotPtr							m_lastSnapshot;
+	int									m_compressionLevel = 1;
+};
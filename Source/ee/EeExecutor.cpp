@@ -1,5 +1,7 @@
+#include <algorithm>
 #include "EeExecutor.h"
 #include "../Ps2Const.h"
+#include "../Log.h"
 #include "AlignedAlloc.h"
 
 #if defined(__ANDROID__) || defined(__APPLE__)
@@ -30,6 +32,13 @@
 
 #endif
 
+#define LOG_NAME				("ee_executor")
+
+//Kernel area is below this and isn't protected. Some games will write code in there
+//but it is safe to assume that it won't change (code writes some data just besides itself
+//so it keeps generating exceptions, making the game slower)
+#define PROTECTED_AREA_START	(0x100000)
+
 static CEeExecutor* g_eeExecutor = nullptr;
 
 CEeExecutor::CEeExecutor(CMIPS& context, uint8* ram)
@@ -37,6 +46,15 @@ CEeExecutor::CEeExecutor(CMIPS& context, uint8* ram)
 , m_ram(ram)
 {
 	m_pageSize = framework_getpagesize();
+	uint32 pageCount = PS2::EE_RAM_SIZE / m_pageSize;
+	m_pageFaultCounts.resize(pageCount);
+	//Allocated here since the fault handler can't allocate
+	m_writtenPageWordCount = (pageCount + 31) / 32;
+	m_writtenPages.reset(new std::atomic<uint32>[m_writtenPageWordCount]);
+	for(uint32 i = 0; i < m_writtenPageWordCount; i++)
+	{
+		m_writtenPages[i] = 0;
+	}
 }
 
 CEeExecutor::~CEeExecutor()
@@ -91,10 +109,50 @@ void CEeExecutor::RemoveExceptionHandler()
 
 void CEeExecutor::Reset()
 {
+	if(m_faultCount != 0)
+	{
+		CLog::GetInstance().Print(LOG_NAME, "Code write stats: %d faults, %d blocks invalidated, %d blocks revalidated, %d blocks compiled.\r\n",
+			m_faultCount, m_invalidatedBlockCount, m_revalidatedBlockCount, GetCompileCount());
+	}
 	SetMemoryProtected(m_ram, PS2::EE_RAM_SIZE, false);
+	ResetPageFaultCounts();
+	for(uint32 i = 0; i < m_writtenPageWordCount; i++)
+	{
+		m_writtenPages[i] = 0;
+	}
+	m_context.m_codeWritten = 0;
 	CMipsExecutor::Reset();
 }
 
+void CEeExecutor::ResetPageFaultCounts()
+{
+	std::fill(std::begin(m_pageFaultCounts), std::end(m_pageFaultCounts), 0);
+	m_hotRevalidationCount = 0;
+}
+
+uint32 CEeExecutor::GetFaultCount() const
+{
+	return m_faultCount;
+}
+
+uint32 CEeExecutor::GetInvalidatedBlockCount() const
+{
+	return m_invalidatedBlockCount;
+}
+
+uint32 CEeExecutor::GetRevalidatedBlockCount() const
+{
+	return m_revalidatedBlockCount;
+}
+
+void CEeExecutor::ResetStats()
+{
+	CMipsExecutor::ResetStats();
+	m_faultCount = 0;
+	m_invalidatedBlockCount = 0;
+	m_revalidatedBlockCount = 0;
+}
+
 void CEeExecutor::ClearActiveBlocksInRange(uint32 start, uint32 end)
 {
 	uint32 rangeSize = end - start;
@@ -112,14 +170,109 @@ void CEeExecutor::ClearActiveBlocksInRange(uint32 start, uint32 end)
 
 CMipsExecutor::BasicBlockPtr CEeExecutor::BlockFactory(CMIPS& context, uint32 start, uint32 end)
 {
-	//Kernel area is below 0x100000 and isn't protected. Some games will write code in there
-	//but it is safe to assume that it won't change (code writes some data just besides itself
-	//so it keeps generating exceptions, making the game slower)
-	if(start >= 0x100000 && start < PS2::EE_RAM_SIZE)
+	auto block = CMipsExecutor::BlockFactory(context, start, end);
+	if(start >= PROTECTED_AREA_START && start < PS2::EE_RAM_SIZE)
+	{
+		if(IsRangeHot(start, end))
+		{
+			block->SetValidationPending(true);
+		}
+		else
+		{
+			SetMemoryProtected(m_ram + start, end - start + 4, true);
+		}
+	}
+	return block;
+}
+
+bool CEeExecutor::RevalidateBlock(CBasicBlock* block)
+{
+	if(block->HasCodeChanged())
+	{
+		m_invalidatedBlockCount++;
+		return false;
+	}
+
+	m_revalidatedBlockCount++;
+
+	uint32 start = block->GetBeginAddress();
+	uint32 end = block->GetEndAddress();
+	if((start < PROTECTED_AREA_START) || (start >= PS2::EE_RAM_SIZE))
+	{
+		block->SetValidationPending(false);
+		return true;
+	}
+	if(IsRangeHot(start, end))
+	{
+		//Keep checking this one every time, it would fault again anyway
+		m_hotRevalidationCount++;
+		if(m_hotRevalidationCount == PAGE_FAULT_DECAY_INTERVAL)
+		{
+			m_hotRevalidationCount = 0;
+			DecayPageFaultCounts();
+		}
+		return true;
+	}
+	block->SetValidationPending(false);
+	SetMemoryProtected(m_ram + start, end - start + 4, true);
+	return true;
+}
+
+bool CEeExecutor::IsRangeHot(uint32 start, uint32 end) const
+{
+	end = std::min<uint32>(end, PS2::EE_RAM_SIZE - 1);
+	for(uint32 page = start / m_pageSize; page <= (end / m_pageSize); page++)
+	{
+		if(m_pageFaultCounts[page] >= HOT_PAGE_FAULT_COUNT) return true;
+	}
+	return false;
+}
+
+void CEeExecutor::DecayPageFaultCounts()
+{
+	for(auto& pageFaultCount : m_pageFaultCounts)
+	{
+		pageFaultCount /= 2;
+	}
+}
+
+void CEeExecutor::ProcessCodeWrites()
+{
+	for(uint32 wordIndex = 0; wordIndex < m_writtenPageWordCount; wordIndex++)
+	{
+		if(m_writtenPages[wordIndex].load(std::memory_order_relaxed) == 0) continue;
+		uint32 pageBits = m_writtenPages[wordIndex].exchange(0, std::memory_order_acquire);
+		while(pageBits != 0)
+		{
+			uint32 bitIndex = 0;
+			while((pageBits & (1U << bitIndex)) == 0) bitIndex++;
+			pageBits &= ~(1U << bitIndex);
+
+			//A page only faults once until blocks in it protect it again
+			uint32 page = (wordIndex * 32) + bitIndex;
+			m_faultCount++;
+			auto& pageFaultCount = m_pageFaultCounts[page];
+			pageFaultCount = std::min<uint8>(pageFaultCount + 1, HOT_PAGE_FAULT_COUNT);
+
+			uint32 address = page * m_pageSize;
+			MarkBlocksForValidation(address, address + m_pageSize);
+		}
+	}
+}
+
+void CEeExecutor::MarkBlocksForValidation(uint32 start, uint32 end)
+{
+	//Blocks can't be entered through links while they're waiting for validation
+	CBasicBlock* prevBlock = nullptr;
+	for(uint32 address = start; address < end; address += 4)
 	{
-		SetMemoryProtected(m_ram + start, end - start + 4, true);
+		auto block = FindBlockAt(address);
+		if((block == nullptr) || (block == prevBlock)) continue;
+		prevBlock = block;
+		if(block->IsValidationPending()) continue;
+		block->UnlinkAllBlocks();
+		block->SetValidationPending(true);
 	}
-	return CMipsExecutor::BlockFactory(context, start, end);
 }
 
 bool CEeExecutor::HandleAccessFault(intptr_t ptr)
@@ -128,7 +281,14 @@ bool CEeExecutor::HandleAccessFault(intptr_t ptr)
 	if(addr >= 0 && addr < PS2::EE_RAM_SIZE)
 	{
 		addr &= ~(m_pageSize - 1);
-		ClearActiveBlocksInRange(addr, addr + m_pageSize);
+		uint32 page = static_cast<uint32>(addr / m_pageSize);
+		//Let the write go through. Instead of throwing everything away, blocks in the page
+		//will check if their code really changed before running again. We might be in a signal
+		//handler or on another thread here, only record the page and let the executor do the
+		//rest once it gets back control (see ProcessCodeWrites).
+		SetMemoryProtected(m_ram + addr, m_pageSize, false);
+		m_writtenPages[page / 32].fetch_or(1U << (page % 32), std::memory_order_release);
+		m_context.m_codeWritten.store(1, std::memory_order_release);
 		return true;
 	}
 	return false;
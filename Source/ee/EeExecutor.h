@@ -7,6 +7,8 @@
 #include <thread>
 #endif
 
+#include <atomic>
+#include <memory>
 #include "../MipsExecutor.h"
 
 class CEeExecutor : public CMipsExecutor
@@ -23,12 +25,51 @@ public:
 
 	BasicBlockPtr			BlockFactory(CMIPS&, uint32, uint32) override;
 
+	uint32					GetFaultCount() const;
+	uint32					GetInvalidatedBlockCount() const;
+	uint32					GetRevalidatedBlockCount() const;
+	void					ResetStats() override;
+	void					ResetPageFaultCounts();
+
+protected:
+	bool					RevalidateBlock(CBasicBlock*) override;
+	void					ProcessCodeWrites() override;
+
 private:
+	enum
+	{
+		//Pages faulting more than this won't be protected anymore, blocks in them
+		//will check their code every time they're entered instead
+		HOT_PAGE_FAULT_COUNT = 16,
+		//Fault counts are halved after blocks in hot pages were checked this many times,
+		//pages that aren't written to anymore will end up being protected again
+		PAGE_FAULT_DECAY_INTERVAL = 0x10000,
+	};
+
+	typedef std::vector<uint8> PageFaultCountArray;
+	typedef std::unique_ptr<std::atomic<uint32>[]> PageBitArray;
+
 	uint8*					m_ram = nullptr;
 	size_t					m_pageSize = 0;
 
+	PageFaultCountArray		m_pageFaultCounts;
+	uint32					m_hotRevalidationCount = 0;
+
+	//Pages written to since the last time the executor looked at them, one bit per page.
+	//Set by the access fault handler, which might be running in a signal handler or on another
+	//thread. Blocks in these pages are marked for validation on the executor's thread.
+	PageBitArray			m_writtenPages;
+	uint32					m_writtenPageWordCount = 0;
+
+	uint32					m_faultCount = 0;
+	uint32					m_invalidatedBlockCount = 0;
+	uint32					m_revalidatedBlockCount = 0;
+
 	bool					HandleAccessFault(intptr_t);
 	void					SetMemoryProtected(void*, size_t, bool);
+	bool					IsRangeHot(uint32, uint32) const;
+	void					DecayPageFaultCounts();
+	void					MarkBlocksForValidation(uint32, uint32);
 	
 #if defined(_WIN32)
 	static LONG CALLBACK	HandleException(_EXCEPTION_POINTERS*);
@@ -22,6 +22,8 @@ using namespace Ee;
 
 #define FAKE_IOP_RAM_SIZE	(0x1000)
 
+#define IOPORT_STATS_LOG_COUNT	(16)
+
 CSubSystem::CSubSystem(uint8* iopRam, CIopBios& iopBios)
 : m_ram(reinterpret_cast<uint8*>(framework_aligned_alloc(PS2::EE_RAM_SIZE, framework_getpagesize())))
 , m_bios(new uint8[PS2::EE_BIOS_SIZE])
@@ -44,6 +46,7 @@ CSubSystem::CSubSystem(uint8* iopRam, CIopBios& iopBios)
 , m_COP_FPU(MIPS_REGSIZE_64)
 , m_COP_VU(MIPS_REGSIZE_64)
 , m_iopBios(iopBios)
+, m_ioPorts(0x10000000, 0x12FFFFFF)
 {
 	//Some alignment checks, this is needed because of SIMD instructions used in generated code
 	assert((reinterpret_cast<size_t>(&m_EE.m_State) & 0x0F) == 0);
@@ -63,8 +66,8 @@ CSubSystem::CSubSystem(uint8* iopRam, CIopBios& iopBios)
 		m_EE.m_pMemoryMap->InsertReadMap(0x10000000,            0x10FFFFFF,                                     bind(&CSubSystem::IOPortReadHandler, this, PLACEHOLDER_1),    0x02);
 		m_EE.m_pMemoryMap->InsertReadMap(PS2::MICROMEM0ADDR,    PS2::MICROMEM0ADDR + PS2::MICROMEM0SIZE - 1,    m_microMem0,                                                  0x03);
 		m_EE.m_pMemoryMap->InsertReadMap(PS2::VUMEM0ADDR,       PS2::VUMEM0ADDR + PS2::VUMEM0SIZE - 1,          m_vuMem0,                                                     0x04);
-		m_EE.m_pMemoryMap->InsertReadMap(PS2::MICROMEM1ADDR,    PS2::MICROMEM1ADDR + PS2::MICROMEM1SIZE - 1,    m_microMem1,                                                  0x05);
-		m_EE.m_pMemoryMap->InsertReadMap(PS2::VUMEM1ADDR,       PS2::VUMEM1ADDR + PS2::VUMEM1SIZE - 1,          m_vuMem1,                                                     0x06);
+		m_EE.m_pMemoryMap->InsertReadMap(PS2::MICROMEM1ADDR,    PS2::MICROMEM1ADDR + PS2::MICROMEM1SIZE - 1,    bind(&CSubSystem::Vu1MemReadHandler, this, PLACEHOLDER_1),    0x05);
+		m_EE.m_pMemoryMap->InsertReadMap(PS2::VUMEM1ADDR,       PS2::VUMEM1ADDR + PS2::VUMEM1SIZE - 1,          bind(&CSubSystem::Vu1MemReadHandler, this, PLACEHOLDER_1),    0x06);
 		m_EE.m_pMemoryMap->InsertReadMap(0x12000000,            0x12FFFFFF,                                     bind(&CSubSystem::IOPortReadHandler, this, PLACEHOLDER_1),    0x07);
 		m_EE.m_pMemoryMap->InsertReadMap(0x1C000000,            0x1C001000,                                     m_fakeIopRam,                                                 0x08);
 		m_EE.m_pMemoryMap->InsertReadMap(0x1FC00000,            0x1FFFFFFF,                                     m_bios,                                                       0x09);
@@ -130,7 +133,7 @@ CSubSystem::CSubSystem(uint8* iopRam, CIopBios& iopBios)
 	m_VU1.m_vuMem = m_vuMem1;
 
 	m_dmac.SetChannelTransferFunction(CDMAC::CHANNEL_ID_VIF0,   bind(&CVif::ReceiveDMA, &m_vpu0->GetVif(), PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3, PLACEHOLDER_4));
-	m_dmac.SetChannelTransferFunction(CDMAC::CHANNEL_ID_VIF1,   bind(&CVif::ReceiveDMA, &m_vpu1->GetVif(), PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3, PLACEHOLDER_4));
+	m_dmac.SetChannelTransferFunction(CDMAC::CHANNEL_ID_VIF1,   bind(&CVpu::ReceiveDMA, m_vpu1.get(), PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3, PLACEHOLDER_4));
 	m_dmac.SetChannelTransferFunction(CDMAC::CHANNEL_ID_GIF,    bind(&CGIF::ReceiveDMA, &m_gif, PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3, PLACEHOLDER_4));
 	m_dmac.SetChannelTransferFunction(CDMAC::CHANNEL_ID_TO_IPU, bind(&CIPU::ReceiveDMA4, &m_ipu, PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_4, m_ram));
 	m_dmac.SetChannelTransferFunction(CDMAC::CHANNEL_ID_SIF0,   bind(&CSIF::ReceiveDMA5, &m_sif, PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3, PLACEHOLDER_4));
@@ -138,6 +141,8 @@ CSubSystem::CSubSystem(uint8* iopRam, CIopBios& iopBios)
 
 	m_ipu.SetDMA3ReceiveHandler(bind(&CDMAC::ResumeDMA3, &m_dmac, PLACEHOLDER_1, PLACEHOLDER_2));
 
+	InsertIOPortHandlers();
+
 	m_os = new CPS2OS(m_EE, m_ram, m_bios, m_spr, m_gs, m_sif, iopBios);
 	m_os->OnRequestInstructionCacheFlush.connect(boost::bind(&CSubSystem::FlushInstructionCache, this));
 }
@@ -156,6 +161,18 @@ CSubSystem::~CSubSystem()
 	delete [] m_microMem1;
 }
 
+void CSubSystem::SetFastMemoryEnabled(bool enabled)
+{
+	//Generated code will access RAM directly, other areas still go through the memory map
+	m_EE.m_fastMemory = enabled ? m_ram : nullptr;
+	m_EE.m_fastMemorySize = PS2::EE_RAM_SIZE;
+}
+
+bool CSubSystem::IsFastMemoryEnabled() const
+{
+	return (m_EE.m_fastMemory != nullptr);
+}
+
 void CSubSystem::SetVpu0(std::shared_ptr<CVpu> newVpu0)
 {
 	m_vpu0 = newVpu0;
@@ -205,6 +222,8 @@ void CSubSystem::Reset()
 	m_os->Initialize();
 	FillFakeIopRam();
 
+	m_ioPorts.LogStats(LOG_NAME, IOPORT_STATS_LOG_COUNT);
+	m_ioPorts.ResetStats();
 	m_statusRegisterCheckers.clear();
 	m_isIdle = false;
 }
@@ -297,7 +316,16 @@ void CSubSystem::CountTicks(int ticks)
 	{
 		m_dmac.ResumeDMA0();
 	}
-	if(!m_vpu1->IsVuRunning() || (m_vpu1->IsVuRunning() && !m_vpu1->GetVif().IsWaitingForProgramEnd()))
+	if(m_vpu1->IsThreaded())
+	{
+		//VIF1 queues whatever it gets, VPU thread deals with waiting for micro programs
+		m_dmac.ResumeDMA1();
+		if(m_vpu1->IsVifStalled())
+		{
+			m_intc.AssertLine(CINTC::INTC_LINE_VIF1);
+		}
+	}
+	else if(!m_vpu1->IsVuRunning() || (m_vpu1->IsVuRunning() && !m_vpu1->GetVif().IsWaitingForProgramEnd()))
 	{
 		m_dmac.ResumeDMA1();
 		if(m_vpu1->GetVif().IsStalledByInterrupt())
@@ -320,6 +348,11 @@ void CSubSystem::CountTicks(int ticks)
 	m_timer.Count(ticks);
 }
 
+uint32 CSubSystem::GetTicksUntilNextEvent() const
+{
+	return m_timer.GetTicksUntilNextInterrupt();
+}
+
 void CSubSystem::NotifyVBlankStart()
 {
 	m_intc.AssertLine(CINTC::INTC_LINE_VBLANK_START);
@@ -336,17 +369,19 @@ void CSubSystem::NotifyVBlankEnd()
 	m_intc.AssertLine(CINTC::INTC_LINE_VBLANK_END);
 }
 
-void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive)
+void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive, bool saveMemoryAreas)
 {
+	CVpu::CThreadSync vpu1Sync(*m_vpu1);
+
 	archive.InsertFile(new CMemoryStateFile(STATE_EE,			&m_EE.m_State,	sizeof(MIPSSTATE)));
 	archive.InsertFile(new CMemoryStateFile(STATE_VU0,			&m_VU0.m_State,	sizeof(MIPSSTATE)));
 	archive.InsertFile(new CMemoryStateFile(STATE_VU1,			&m_VU1.m_State,	sizeof(MIPSSTATE)));
-	archive.InsertFile(new CMemoryStateFile(STATE_RAM,			m_ram,			PS2::EE_RAM_SIZE));
-	archive.InsertFile(new CMemoryStateFile(STATE_SPR,			m_spr,			PS2::EE_SPR_SIZE));
-	archive.InsertFile(new CMemoryStateFile(STATE_VUMEM0,		m_vuMem0,		PS2::VUMEM0SIZE));
-	archive.InsertFile(new CMemoryStateFile(STATE_MICROMEM0,	m_microMem0,	PS2::MICROMEM0SIZE));
-	archive.InsertFile(new CMemoryStateFile(STATE_VUMEM1,		m_vuMem1,		PS2::VUMEM1SIZE));
-	archive.InsertFile(new CMemoryStateFile(STATE_MICROMEM1,	m_microMem1,	PS2::MICROMEM1SIZE));
+	if(saveMemoryAreas)
+	{
+		CMemoryStateFile::MemoryAreaList memoryAreas;
+		GetMemoryAreas(memoryAreas);
+		CMemoryStateFile::InsertMemoryAreas(archive, memoryAreas);
+	}
 
 	m_dmac.SaveState(archive);
 	m_intc.SaveState(archive);
@@ -357,17 +392,19 @@ void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive)
 	m_gif.SaveState(archive);
 }
 
-void CSubSystem::LoadState(Framework::CZipArchiveReader& archive)
+void CSubSystem::LoadState(Framework::CZipArchiveReader& archive, bool loadMemoryAreas)
 {
+	CVpu::CThreadSync vpu1Sync(*m_vpu1);
+
 	archive.BeginReadFile(STATE_EE			)->Read(&m_EE.m_State,	sizeof(MIPSSTATE));
 	archive.BeginReadFile(STATE_VU0			)->Read(&m_VU0.m_State,	sizeof(MIPSSTATE));
 	archive.BeginReadFile(STATE_VU1			)->Read(&m_VU1.m_State,	sizeof(MIPSSTATE));
-	archive.BeginReadFile(STATE_RAM			)->Read(m_ram,			PS2::EE_RAM_SIZE);
-	archive.BeginReadFile(STATE_SPR			)->Read(m_spr,			PS2::EE_SPR_SIZE);
-	archive.BeginReadFile(STATE_VUMEM0		)->Read(m_vuMem0,		PS2::VUMEM0SIZE);
-	archive.BeginReadFile(STATE_MICROMEM0	)->Read(m_microMem0,	PS2::MICROMEM0SIZE);
-	archive.BeginReadFile(STATE_VUMEM1		)->Read(m_vuMem1,		PS2::VUMEM1SIZE);
-	archive.BeginReadFile(STATE_MICROMEM1	)->Read(m_microMem1,	PS2::MICROMEM1SIZE);
+	if(loadMemoryAreas)
+	{
+		CMemoryStateFile::MemoryAreaList memoryAreas;
+		GetMemoryAreas(memoryAreas);
+		CMemoryStateFile::ReadMemoryAreas(archive, memoryAreas);
+	}
 
 	m_dmac.LoadState(archive);
 	m_intc.LoadState(archive);
@@ -380,49 +417,104 @@ void CSubSystem::LoadState(Framework::CZipArchiveReader& archive)
 	m_executor.Reset();
 }
 
-uint32 CSubSystem::IOPortReadHandler(uint32 nAddress)
+void CSubSystem::GetMemoryAreas(CMemoryStateFile::MemoryAreaList& memoryAreas)
 {
-	uint32 nReturn = 0;
-	if(nAddress >= 0x10000000 && nAddress <= 0x1000183F)
-	{
-		nReturn = m_timer.GetRegister(nAddress);
-	}
-	else if(nAddress >= 0x10002000 && nAddress <= 0x1000203F)
-	{
-		nReturn = m_ipu.GetRegister(nAddress);
-	}
-	else if(nAddress >= CGIF::REGS_START && nAddress < CGIF::REGS_END)
-	{
-		nReturn = m_gif.GetRegister(nAddress);
-	}
-	else if(nAddress >= CVif::REGS0_START && nAddress < CVif::REGS0_END)
-	{
-		nReturn = m_vpu0->GetVif().GetRegister(nAddress);
-	}
-	else if(nAddress >= CVif::REGS1_START && nAddress < CVif::REGS1_END)
-	{
-		nReturn = m_vpu1->GetVif().GetRegister(nAddress);
-	}
-	else if(nAddress >= 0x10008000 && nAddress <= 0x1000EFFC)
-	{
-		nReturn = m_dmac.GetRegister(nAddress);
-	}
-	else if(nAddress >= 0x1000F000 && nAddress <= 0x1000F01C)
-	{
-		nReturn = m_intc.GetRegister(nAddress);
-	}
-	else if(nAddress >= 0x1000F520 && nAddress <= 0x1000F59C)
-	{
-		nReturn = m_dmac.GetRegister(nAddress);
-	}
-	else if(nAddress >= 0x12000000 && nAddress <= 0x1200108C)
-	{
-		if(m_gs != NULL)
+	memoryAreas.push_back({ STATE_RAM,			m_ram,			PS2::EE_RAM_SIZE });
+	memoryAreas.push_back({ STATE_SPR,			m_spr,			PS2::EE_SPR_SIZE });
+	memoryAreas.push_back({ STATE_VUMEM0,		m_vuMem0,		PS2::VUMEM0SIZE });
+	memoryAreas.push_back({ STATE_MICROMEM0,	m_microMem0,	PS2::MICROMEM0SIZE });
+	memoryAreas.push_back({ STATE_VUMEM1,		m_vuMem1,		PS2::VUMEM1SIZE });
+	memoryAreas.push_back({ STATE_MICROMEM1,	m_microMem1,	PS2::MICROMEM1SIZE });
+}
+
+void CSubSystem::InsertIOPortHandlers()
+{
+	//Read handlers
+	m_ioPorts.InsertReadHandler(0x10000000, 0x1000183F, [this] (uint32 address) { return m_timer.GetRegister(address); });
+	m_ioPorts.InsertReadHandler(0x10002000, 0x1000203F, [this] (uint32 address) { return m_ipu.GetRegister(address); });
+	m_ioPorts.InsertReadHandler(CGIF::REGS_START, CGIF::REGS_END - 1, [this] (uint32 address) { return m_gif.GetRegister(address); });
+	m_ioPorts.InsertReadHandler(CVif::REGS0_START, CVif::REGS0_END - 1, [this] (uint32 address) { return m_vpu0->GetVif().GetRegister(address); });
+	m_ioPorts.InsertReadHandler(CVif::REGS1_START, CVif::REGS1_END - 1,
+		[this] (uint32 address)
 		{
-			nReturn = m_gs->ReadPrivRegister(nAddress);
+			CVpu::CThreadSync vpu1Sync(*m_vpu1);
+			return m_vpu1->GetVif().GetRegister(address);
 		}
-	}
-	else
+	);
+	m_ioPorts.InsertReadHandler(0x10008000, 0x1000EFFC, [this] (uint32 address) { return m_dmac.GetRegister(address); });
+	m_ioPorts.InsertReadHandler(0x1000F000, 0x1000F01C, [this] (uint32 address) { return m_intc.GetRegister(address); });
+	m_ioPorts.InsertReadHandler(0x1000F520, 0x1000F59C, [this] (uint32 address) { return m_dmac.GetRegister(address); });
+	m_ioPorts.InsertReadHandler(0x12000000, 0x1200108C,
+		[this] (uint32 address)
+		{
+			return (m_gs != NULL) ? m_gs->ReadPrivRegister(address) : 0;
+		}
+	);
+
+	//Write handlers
+	m_ioPorts.InsertWriteHandler(0x10000000, 0x1000183F, [this] (uint32 address, uint32 value) { m_timer.SetRegister(address, value); });
+	m_ioPorts.InsertWriteHandler(0x10002000, 0x1000203F,
+		[this] (uint32 address, uint32 value)
+		{
+			m_ipu.SetRegister(address, value);
+			ExecuteIpu();
+		}
+	);
+	m_ioPorts.InsertWriteHandler(CGIF::REGS_START, CGIF::REGS_END - 1, [this] (uint32 address, uint32 value) { m_gif.SetRegister(address, value); });
+	m_ioPorts.InsertWriteHandler(CVif::REGS0_START, CVif::REGS0_END - 1, [this] (uint32 address, uint32 value) { m_vpu0->GetVif().SetRegister(address, value); });
+	m_ioPorts.InsertWriteHandler(CVif::REGS1_START, CVif::REGS1_END - 1,
+		[this] (uint32 address, uint32 value)
+		{
+			CVpu::CThreadSync vpu1Sync(*m_vpu1);
+			m_vpu1->GetVif().SetRegister(address, value);
+		}
+	);
+	m_ioPorts.InsertWriteHandler(CVif::VIF0_FIFO_START, CVif::VIF0_FIFO_END - 1, [this] (uint32 address, uint32 value) { m_vpu0->GetVif().SetRegister(address, value); });
+	m_ioPorts.InsertWriteHandler(CVif::VIF1_FIFO_START, CVif::VIF1_FIFO_END - 1,
+		[this] (uint32 address, uint32 value)
+		{
+			CVpu::CThreadSync vpu1Sync(*m_vpu1);
+			m_vpu1->GetVif().SetRegister(address, value);
+		}
+	);
+	m_ioPorts.InsertWriteHandler(0x10007000, 0x1000702F,
+		[this] (uint32 address, uint32 value)
+		{
+			m_ipu.SetRegister(address, value);
+			ExecuteIpu();
+		}
+	);
+	m_ioPorts.InsertWriteHandler(0x10008000, 0x1000EFFC,
+		[this] (uint32 address, uint32 value)
+		{
+			m_dmac.SetRegister(address, value);
+			ExecuteIpu();
+		}
+	);
+	m_ioPorts.InsertWriteHandler(0x1000F000, 0x1000F01C, [this] (uint32 address, uint32 value) { m_intc.SetRegister(address, value); });
+	m_ioPorts.InsertWriteHandler(0x1000F180, 0x1000F180,
+		[this] (uint32 address, uint32 value)
+		{
+			//stdout data
+			m_iopBios.GetIoman()->Write(Iop::CIoman::FID_STDOUT, 1, &value);
+		}
+	);
+	m_ioPorts.InsertWriteHandler(0x1000F520, 0x1000F59C, [this] (uint32 address, uint32 value) { m_dmac.SetRegister(address, value); });
+	m_ioPorts.InsertWriteHandler(0x12000000, 0x1200108C,
+		[this] (uint32 address, uint32 value)
+		{
+			if(m_gs != NULL)
+			{
+				m_gs->WritePrivRegister(address, value);
+			}
+		}
+	);
+}
+
+uint32 CSubSystem::IOPortReadHandler(uint32 nAddress)
+{
+	uint32 nReturn = 0;
+	if(!m_ioPorts.Read(nAddress, nReturn))
 	{
 		printf("PS2VM: Read an unhandled IO port (0x%0.8X).\r\n", nAddress);
 	}
@@ -443,71 +535,31 @@ uint32 CSubSystem::IOPortReadHandler(uint32 nAddress)
 
 uint32 CSubSystem::IOPortWriteHandler(uint32 nAddress, uint32 nData)
 {
-	if(nAddress >= 0x10000000 && nAddress <= 0x1000183F)
-	{
-		m_timer.SetRegister(nAddress, nData);
-	}
-	else if(nAddress >= 0x10002000 && nAddress <= 0x1000203F)
-	{
-		m_ipu.SetRegister(nAddress, nData);
-		ExecuteIpu();
-	}
-	else if(nAddress >= CGIF::REGS_START && nAddress < CGIF::REGS_END)
-	{
-		m_gif.SetRegister(nAddress, nData);
-	}
-	else if(nAddress >= CVif::REGS0_START && nAddress < CVif::REGS0_END)
-	{
-		m_vpu0->GetVif().SetRegister(nAddress, nData);
-	}
-	else if(nAddress >= CVif::REGS1_START && nAddress < CVif::REGS1_END)
-	{
-		m_vpu1->GetVif().SetRegister(nAddress, nData);
-	}
-	else if(nAddress >= CVif::VIF0_FIFO_START && nAddress < CVif::VIF0_FIFO_END)
-	{
-		m_vpu0->GetVif().SetRegister(nAddress, nData);
-	}
-	else if(nAddress >= CVif::VIF1_FIFO_START && nAddress < CVif::VIF1_FIFO_END)
-	{
-		m_vpu1->GetVif().SetRegister(nAddress, nData);
-	}
-	else if(nAddress >= 0x10007000 && nAddress <= 0x1000702F)
-	{
-		m_ipu.SetRegister(nAddress, nData);
-		ExecuteIpu();
-	}
-	else if(nAddress >= 0x10008000 && nAddress <= 0x1000EFFC)
-	{
-		m_dmac.SetRegister(nAddress, nData);
-		ExecuteIpu();
-	}
-	else if(nAddress >= 0x1000F000 && nAddress <= 0x1000F01C)
-	{
-		m_intc.SetRegister(nAddress, nData);
-	}
-	else if(nAddress == 0x1000F180)
+	if(!m_ioPorts.Write(nAddress, nData))
 	{
-		//stdout data
-		m_iopBios.GetIoman()->Write(Iop::CIoman::FID_STDOUT, 1, &nData);
-	}
-	else if(nAddress >= 0x1000F520 && nAddress <= 0x1000F59C)
-	{
-		m_dmac.SetRegister(nAddress, nData);
+		printf("PS2VM: Wrote to an unhandled IO port (0x%0.8X, 0x%0.8X, PC: 0x%0.8X).\r\n", nAddress, nData, m_EE.m_State.nPC);
 	}
-	else if(nAddress >= 0x12000000 && nAddress <= 0x1200108C)
+
+	return 0;
+}
+
+//Only used for reads, VU1 memory is written to directly. Byte and halfword reads get the low bits.
+uint32 CSubSystem::Vu1MemReadHandler(uint32 address)
+{
+	CVpu::CThreadSync vpu1Sync(*m_vpu1);
+	uint8* memory = nullptr;
+	if(address >= PS2::VUMEM1ADDR)
 	{
-		if(m_gs != NULL)
-		{
-			m_gs->WritePrivRegister(nAddress, nData);
-		}
+		memory = m_vuMem1;
+		address -= PS2::VUMEM1ADDR;
 	}
 	else
 	{
-		printf("PS2VM: Wrote to an unhandled IO port (0x%0.8X, 0x%0.8X, PC: 0x%0.8X).\r\n", nAddress, nData, m_EE.m_State.nPC);
+		memory = m_microMem1;
+		address -= PS2::MICROMEM1ADDR;
 	}
-
-	return 0;
+	uint32 value = *reinterpret_cast<uint32*>(memory + (address & ~0x03));
+	return value >> ((address & 0x03) * 8);
 }
 
 uint32 CSubSystem::Vu0MicroMemWriteHandler(uint32 address, uint32 value)
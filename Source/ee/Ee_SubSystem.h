@@ -1,5 +1,6 @@
 #pragma once
 
+#include <unordered_map>
 #include "AlignedAlloc.h"
 #include "../COP_SCU.h"
 #include "../COP_FPU.h"
@@ -17,6 +18,8 @@
 #include "COP_VU.h"
 #include "PS2OS.h"
 #include "../gs/GSHandler.h"
+#include "../MemoryStateFile.h"
+#include "../IoPortMap.h"
 
 namespace Ee
 {
@@ -30,12 +33,19 @@ namespace Ee
 		int							ExecuteCpu(int);
 		bool						IsCpuIdle() const;
 		void						CountTicks(int);
+		uint32						GetTicksUntilNextEvent() const;
 
 		void						NotifyVBlankStart();
 		void						NotifyVBlankEnd();
 
-		void						SaveState(Framework::CZipArchiveWriter&);
-		void						LoadState(Framework::CZipArchiveReader&);
+		//Memory areas are left out of the archive if the caller saves them by itself
+		void						SaveState(Framework::CZipArchiveWriter&, bool = true);
+		void						LoadState(Framework::CZipArchiveReader&, bool = true);
+		void						GetMemoryAreas(CMemoryStateFile::MemoryAreaList&);
+
+		//Only affects code compiled afterwards
+		void						SetFastMemoryEnabled(bool);
+		bool						IsFastMemoryEnabled() const;
 
 		void						SetVpu0(std::shared_ptr<CVpu>);
 		void						SetVpu1(std::shared_ptr<CVpu>);
@@ -79,12 +89,14 @@ namespace Ee
 		}
 
 	private:
-		typedef std::map<uint32, uint32> StatusRegisterCheckerMap;
+		typedef std::unordered_map<uint32, uint32> StatusRegisterCheckerMap;
 
+		void						InsertIOPortHandlers();
 		uint32						IOPortReadHandler(uint32);
 		uint32						IOPortWriteHandler(uint32, uint32);
 
 		uint32						Vu0MicroMemWriteHandler(uint32, uint32);
+		uint32						Vu1MemReadHandler(uint32);
 
 		uint32						Vu0IoPortReadHandler(uint32);
 		uint32						Vu0IoPortWriteHandler(uint32, uint32);
@@ -104,6 +116,7 @@ namespace Ee
 		void						LoadBIOS();
 		void						FillFakeIopRam();
 
+		CIoPortMap					m_ioPorts;
 		StatusRegisterCheckerMap	m_statusRegisterCheckers;
 		bool						m_isIdle = false;
 
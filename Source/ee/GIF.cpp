@@ -23,6 +23,7 @@ CGIF::CGIF(CGSHandler*& gs, uint8* ram, uint8* spr)
 , m_regList(0)
 , m_eop(false)
 , m_qtemp(0)
+, m_discardedWrites(DISCARDED_WRITE_BUFFER_SIZE)
 , m_gifProfilerZone(CProfiler::GetInstance().RegisterZone("GIF"))
 {
 
@@ -48,7 +49,7 @@ void CGIF::Reset()
 void CGIF::LoadState(Framework::CZipArchiveReader& archive)
 {
 	CRegisterStateFile registerFile(*archive.BeginReadFile(STATE_REGS_XML));
-	m_path3Masked = registerFile.GetRegister32(STATE_REGS_M3P) != 0;
+	m_path3Masked = (registerFile.GetRegister32(STATE_REGS_M3P) != 0);
 }
 
 void CGIF::SaveState(Framework::CZipArchiveWriter& archive)
@@ -58,122 +59,160 @@ void CGIF::SaveState(Framework::CZipArchiveWriter& archive)
 	archive.InsertFile(registerFile);
 }
 
-uint32 CGIF::ProcessPacked(CGSHandler::RegisterWriteList& writeList, uint8* memory, uint32 address, uint32 end)
+static uint64 DecodePackedRgbaq(const uint128& packet, uint32 q)
+{
+	uint64 result = 0;
+	result  = (packet.nV[0] & 0xFF);
+	result |= (packet.nV[1] & 0xFF) << 8;
+	result |= (packet.nV[2] & 0xFF) << 16;
+	result |= (packet.nV[3] & 0xFF) << 24;
+	result |= (static_cast<uint64>(q) << 32);
+	return result;
+}
+
+static CGSHandler::RegisterWrite DecodePackedXyzf2(const uint128& packet)
+{
+	uint64 result = 0;
+	result  = (packet.nV[0] & 0xFFFF);
+	result |= (packet.nV[1] & 0xFFFF) << 16;
+	result |= static_cast<uint64>(packet.nV[2] & 0x0FFFFFF0) << 28;
+	result |= static_cast<uint64>(packet.nV[3] & 0x00000FF0) << 52;
+	uint8 registerId = (packet.nV[3] & 0x8000) ? GS_REG_XYZF3 : GS_REG_XYZF2;
+	return CGSHandler::RegisterWrite(registerId, result);
+}
+
+uint32 CGIF::ProcessPacked(uint8* memory, uint32 address, uint32 end)
 {
 	uint32 start = address;
 
 	while((m_loops != 0) && (address < end))
 	{
-		while((m_regsTemp != 0) && (address < end))
-		{
-			uint64 temp = 0;
-			uint32 regDesc = (uint32)((m_regList >> ((m_regs - m_regsTemp) * 4)) & 0x0F);
+		//Every qword produces one register write at most
+		uint32 qwordCount = (end - address + 0x0F) / 0x10;
+		qwordCount = std::min<uint32>(qwordCount, ReserveWrites(1, end - address));
 
-			uint128 packet = *(uint128*)&memory[address];
-			address += 0x10;
+		auto packetIterator = reinterpret_cast<const uint128*>(memory + address);
+		auto writeIterator = m_writes + m_writeCount;
 
-			m_regsTemp--;
+		//Fast path for whole loops of ST, RGBAQ and XYZF2 registers
+		if((m_regsTemp == m_regs) && (m_regs == 3) && ((m_regList & 0xFFF) == 0x412))
+		{
+			uint32 loopCount = std::min<uint32>(m_loops, qwordCount / 3);
+			uint32 qtemp = m_qtemp;
+			for(uint32 i = 0; i < loopCount; i++)
+			{
+				qtemp = packetIterator[0].nV2;
+				writeIterator[0] = CGSHandler::RegisterWrite(GS_REG_ST, packetIterator[0].nD0);
+				writeIterator[1] = CGSHandler::RegisterWrite(GS_REG_RGBAQ, DecodePackedRgbaq(packetIterator[1], qtemp));
+				writeIterator[2] = DecodePackedXyzf2(packetIterator[2]);
+				packetIterator += 3;
+				writeIterator += 3;
+			}
+			m_qtemp = qtemp;
+			m_loops -= loopCount;
+			qwordCount -= loopCount * 3;
+		}
 
-			switch(regDesc)
+		while((m_loops != 0) && (qwordCount != 0))
+		{
+			while((m_regsTemp != 0) && (qwordCount != 0))
 			{
-			case 0x00:
-				//PRIM
-				writeList.push_back(CGSHandler::RegisterWrite(GS_REG_PRIM, packet.nV0));
-				break;
-			case 0x01:
-				//RGBA
-				temp  = (packet.nV[0] & 0xFF);
-				temp |= (packet.nV[1] & 0xFF) << 8;
-				temp |= (packet.nV[2] & 0xFF) << 16;
-				temp |= (packet.nV[3] & 0xFF) << 24;
-				temp |= ((uint64)m_qtemp << 32);
-				writeList.push_back(CGSHandler::RegisterWrite(GS_REG_RGBAQ, temp));
-				break;
-			case 0x02:
-				//ST
-				m_qtemp = packet.nV2;
-				writeList.push_back(CGSHandler::RegisterWrite(GS_REG_ST, packet.nD0));
-				break;
-			case 0x03:
-				//UV
-				temp  = (packet.nV[0] & 0x7FFF);
-				temp |= (packet.nV[1] & 0x7FFF) << 16;
-				writeList.push_back(CGSHandler::RegisterWrite(GS_REG_UV, temp));
-				break;
-			case 0x04:
-				//XYZF2
-				temp  = (packet.nV[0] & 0xFFFF);
-				temp |= (packet.nV[1] & 0xFFFF) << 16;
-				temp |= (uint64)(packet.nV[2] & 0x0FFFFFF0) << 28;
-				temp |= (uint64)(packet.nV[3] & 0x00000FF0) << 52;
-				if(packet.nV[3] & 0x8000)
-				{
-					writeList.push_back(CGSHandler::RegisterWrite(GS_REG_XYZF3, temp));
-				}
-				else
-				{
-					writeList.push_back(CGSHandler::RegisterWrite(GS_REG_XYZF2, temp));
-				}
-				break;
-			case 0x05:
-				//XYZ2
-				temp  = (packet.nV[0] & 0xFFFF);
-				temp |= (packet.nV[1] & 0xFFFF) << 16;
-				temp |= (uint64)(packet.nV[2] & 0xFFFFFFFF) << 32;
-				if(packet.nV[3] & 0x8000)
-				{
-					writeList.push_back(CGSHandler::RegisterWrite(GS_REG_XYZ3, temp));
-				}
-				else
+				uint64 temp = 0;
+				uint32 regDesc = (uint32)((m_regList >> ((m_regs - m_regsTemp) * 4)) & 0x0F);
+
+				const auto& packet = *packetIterator;
+				packetIterator++;
+				qwordCount--;
+
+				m_regsTemp--;
+
+				switch(regDesc)
 				{
-					writeList.push_back(CGSHandler::RegisterWrite(GS_REG_XYZ2, temp));
+				case 0x00:
+					//PRIM
+					*writeIterator++ = CGSHandler::RegisterWrite(GS_REG_PRIM, packet.nV0);
+					break;
+				case 0x01:
+					//RGBA
+					*writeIterator++ = CGSHandler::RegisterWrite(GS_REG_RGBAQ, DecodePackedRgbaq(packet, m_qtemp));
+					break;
+				case 0x02:
+					//ST
+					m_qtemp = packet.nV2;
+					*writeIterator++ = CGSHandler::RegisterWrite(GS_REG_ST, packet.nD0);
+					break;
+				case 0x03:
+					//UV
+					temp  = (packet.nV[0] & 0x7FFF);
+					temp |= (packet.nV[1] & 0x7FFF) << 16;
+					*writeIterator++ = CGSHandler::RegisterWrite(GS_REG_UV, temp);
+					break;
+				case 0x04:
+					//XYZF2
+					*writeIterator++ = DecodePackedXyzf2(packet);
+					break;
+				case 0x05:
+					//XYZ2
+					temp  = (packet.nV[0] & 0xFFFF);
+					temp |= (packet.nV[1] & 0xFFFF) << 16;
+					temp |= (uint64)(packet.nV[2] & 0xFFFFFFFF) << 32;
+					if(packet.nV[3] & 0x8000)
+					{
+						*writeIterator++ = CGSHandler::RegisterWrite(GS_REG_XYZ3, temp);
+					}
+					else
+					{
+						*writeIterator++ = CGSHandler::RegisterWrite(GS_REG_XYZ2, temp);
+					}
+					break;
+				case 0x06:
+					//TEX0_1
+					*writeIterator++ = CGSHandler::RegisterWrite(GS_REG_TEX0_1, packet.nD0);
+					break;
+				case 0x07:
+					//TEX0_2
+					*writeIterator++ = CGSHandler::RegisterWrite(GS_REG_TEX0_2, packet.nD0);
+					break;
+				case 0x08:
+					//CLAMP_1
+					*writeIterator++ = CGSHandler::RegisterWrite(GS_REG_CLAMP_1, packet.nD0);
+					break;
+				case 0x0A:
+					//FOG
+					*writeIterator++ = CGSHandler::RegisterWrite(GS_REG_FOG, (packet.nD1 >> 36) << 56);
+					break;
+				case 0x0D:
+					//XYZ3
+					*writeIterator++ = CGSHandler::RegisterWrite(GS_REG_XYZ3, packet.nD0);
+					break;
+				case 0x0E:
+					//A + D
+					*writeIterator++ = CGSHandler::RegisterWrite(static_cast<uint8>(packet.nD1), packet.nD0);
+					break;
+				case 0x0F:
+					//NOP
+					break;
+				default:
+					assert(0);
+					break;
 				}
-				break;
-			case 0x06:
-				//TEX0_1
-				writeList.push_back(CGSHandler::RegisterWrite(GS_REG_TEX0_1, packet.nD0));
-				break;
-			case 0x07:
-				//TEX0_2
-				writeList.push_back(CGSHandler::RegisterWrite(GS_REG_TEX0_2, packet.nD0));
-				break;
-			case 0x08:
-				//CLAMP_1
-				writeList.push_back(CGSHandler::RegisterWrite(GS_REG_CLAMP_1, packet.nD0));
-				break;
-			case 0x0A:
-				//FOG
-				writeList.push_back(CGSHandler::RegisterWrite(GS_REG_FOG, (packet.nD1 >> 36) << 56));
-				break;
-			case 0x0D:
-				//XYZ3
-				writeList.push_back(CGSHandler::RegisterWrite(GS_REG_XYZ3, packet.nD0));
-				break;
-			case 0x0E:
-				//A + D
-				writeList.push_back(CGSHandler::RegisterWrite(static_cast<uint8>(packet.nD1), packet.nD0));
-				break;
-			case 0x0F:
-				//NOP
-				break;
-			default:
-				assert(0);
-				break;
 			}
-		}
 
-		if(m_regsTemp == 0)
-		{
-			m_loops--;
-			m_regsTemp = m_regs;
+			if(m_regsTemp == 0)
+			{
+				m_loops--;
+				m_regsTemp = m_regs;
+			}
 		}
 
+		m_writeCount = static_cast<unsigned int>(writeIterator - m_writes);
+		address = static_cast<uint32>(reinterpret_cast<const uint8*>(packetIterator) - memory);
 	}
 
 	return address - start;
 }
 
-uint32 CGIF::ProcessRegList(CGSHandler::RegisterWriteList& writeList, uint8* memory, uint32 address, uint32 end)
+uint32 CGIF::ProcessRegList(uint8* memory, uint32 address, uint32 end)
 {
 	uint32 start = address;
 
@@ -184,6 +223,10 @@ uint32 CGIF::ProcessRegList(CGSHandler::RegisterWriteList& writeList, uint8* mem
 			break;
 		}
 
+		//Make room for a whole loop
+		ReserveWrites(m_regs, end - address);
+		auto writeIterator = m_writes + m_writeCount;
+
 		for(uint32 j = 0; j < m_regs; j++)
 		{
 			assert(address < end);
@@ -197,9 +240,10 @@ uint32 CGIF::ProcessRegList(CGSHandler::RegisterWriteList& writeList, uint8* mem
 
 			if(nRegDesc == 0x0F) continue;
 
-			writeList.push_back(CGSHandler::RegisterWrite(static_cast<uint8>(nRegDesc), packet.nD0));
+			*writeIterator++ = CGSHandler::RegisterWrite(static_cast<uint8>(nRegDesc), packet.nD0);
 		}
 
+		m_writeCount = static_cast<unsigned int>(writeIterator - m_writes);
 		m_loops--;
 	}
 
@@ -227,19 +271,54 @@ uint32 CGIF::ProcessImage(uint8* memory, uint32 address, uint32 end)
 	return (totalLoops * 0x10);
 }
 
+//Makes sure there's room for at least 'count' register writes, sending the writes decoded so far if
+//needed. 'size' is the amount of data left in the packet, used to avoid reserving more than needed.
+//Returns the amount of writes that can be added.
+unsigned int CGIF::ReserveWrites(unsigned int count, uint32 size)
+{
+	if((m_writes != nullptr) && ((m_writeCapacity - m_writeCount) >= count))
+	{
+		return m_writeCapacity - m_writeCount;
+	}
+
+	FlushWrites();
+
+	//Every register write takes at least 8 bytes of data (REGLIST mode)
+	unsigned int capacity = std::max<unsigned int>(count, (size / 8) + 1);
+	if(m_gs != nullptr)
+	{
+		m_writeTarget = m_gs;
+		m_writeCapacity = std::min<unsigned int>(capacity, m_gs->GetMaxRegisterWriteCount());
+		m_writes = m_gs->BeginRegisterWrites(m_writeCapacity);
+	}
+	else
+	{
+		//No GS to send writes to, decode them in a buffer that is thrown away
+		m_writeTarget = nullptr;
+		m_writeCapacity = std::min<unsigned int>(capacity, DISCARDED_WRITE_BUFFER_SIZE);
+		m_writes = m_discardedWrites.data();
+	}
+	assert(m_writeCapacity >= count);
+	m_writeCount = 0;
+	return m_writeCapacity;
+}
+
+void CGIF::FlushWrites()
+{
+	if(m_writes == nullptr) return;
+	if(m_writeTarget != nullptr)
+	{
+		m_writeTarget->EndRegisterWrites(m_writeCount, m_packetMetadata);
+	}
+	m_writes = nullptr;
+	m_writeTarget = nullptr;
+	m_writeCount = 0;
+	m_writeCapacity = 0;
+}
+
 uint32 CGIF::ProcessPacket(uint8* memory, uint32 address, uint32 end, const CGsPacketMetadata& packetMetadata)
 {
 	std::unique_lock<std::mutex> pathLock(m_pathMutex);
-	static CGSHandler::RegisterWriteList writeList;
-	static const auto flushWriteList =
-		[] (CGSHandler* gs, const CGsPacketMetadata& packetMetadata)
-		{
-			if((gs != nullptr) && !writeList.empty())
-			{
-				gs->WriteRegisterMassively(writeList.data(), static_cast<unsigned int>(writeList.size()), &packetMetadata);
-			}
-			writeList.clear();
-		};
 
 #ifdef PROFILE
 	CProfilerZone profilerZone(m_gifProfilerZone);
@@ -250,7 +329,7 @@ uint32 CGIF::ProcessPacket(uint8* memory, uint32 address, uint32 end, const CGsP
 		packetMetadata.pathIndex, address, end - address);
 #endif
 
-	writeList.clear();
+	m_packetMetadata = &packetMetadata;
 
 	uint32 start = address;
 	while(address < end)
@@ -281,7 +360,8 @@ uint32 CGIF::ProcessPacket(uint8* memory, uint32 address, uint32 end, const CGsP
 			{
 				if(tag.pre != 0)
 				{
-					writeList.push_back(CGSHandler::RegisterWrite(GS_REG_PRIM, static_cast<uint64>(tag.prim)));
+					ReserveWrites(1, end - address);
+					m_writes[m_writeCount++] = CGSHandler::RegisterWrite(GS_REG_PRIM, static_cast<uint64>(tag.prim));
 				}
 			}
 
@@ -292,17 +372,17 @@ uint32 CGIF::ProcessPacket(uint8* memory, uint32 address, uint32 end, const CGsP
 		switch(m_cmd)
 		{
 		case 0x00:
-			address += ProcessPacked(writeList, memory, address, end);
+			address += ProcessPacked(memory, address, end);
 			break;
 		case 0x01:
-			address += ProcessRegList(writeList, memory, address, end);
+			address += ProcessRegList(memory, address, end);
 			break;
 		case 0x02:
 		case 0x03:
 			//We need to flush our list here because image data can be embedded in a GIF packet
 			//that specifies pixel transfer information in GS registers (and that has to be send first)
 			//This is done by FFX
-			flushWriteList(m_gs, packetMetadata);
+			FlushWrites();
 			address += ProcessImage(memory, address, end);
 			break;
 		}
@@ -316,7 +396,8 @@ uint32 CGIF::ProcessPacket(uint8* memory, uint32 address, uint32 end, const CGsP
 		}
 	}
 
-	flushWriteList(m_gs, packetMetadata);
+	FlushWrites();
+	m_packetMetadata = nullptr;
 
 #ifdef _DEBUG
 	CLog::GetInstance().Print(LOG_NAME, "Processed 0x%0.8X bytes.\r\n", address - start);
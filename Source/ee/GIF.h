@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include "Types.h"
 #include "zip/ZipArchiveWriter.h"
 #include "zip/ZipArchiveReader.h"
@@ -58,14 +59,23 @@ public:
 	void			SaveState(Framework::CZipArchiveWriter&);
 
 private:
-	uint32			ProcessPacked(CGSHandler::RegisterWriteList&, uint8*, uint32, uint32);
-	uint32			ProcessRegList(CGSHandler::RegisterWriteList&, uint8*, uint32, uint32);
+	enum
+	{
+		DISCARDED_WRITE_BUFFER_SIZE = 0x1000,
+	};
+
+	uint32			ProcessPacked(uint8*, uint32, uint32);
+	uint32			ProcessRegList(uint8*, uint32, uint32);
 	uint32			ProcessImage(uint8*, uint32, uint32);
 
+	unsigned int	ReserveWrites(unsigned int, uint32);
+	void			FlushWrites();
+
 	void			DisassembleGet(uint32);
 	void			DisassembleSet(uint32, uint32);
 
-	bool			m_path3Masked = false;
+	//Set by VIF1's MSKPATH3 (VU1 thread when threaded), read by the EE
+	std::atomic<bool>	m_path3Masked = {false};
 
 	uint16			m_loops;
 	uint8			m_cmd;
@@ -79,5 +89,13 @@ private:
 	CGSHandler*&	m_gs;
 	std::mutex		m_pathMutex;
 
+	//Register writes are decoded in place, in the GS handler's command ring
+	CGSHandler::RegisterWrite*			m_writes = nullptr;
+	unsigned int						m_writeCount = 0;
+	unsigned int						m_writeCapacity = 0;
+	CGSHandler*							m_writeTarget = nullptr;
+	const CGsPacketMetadata*			m_packetMetadata = nullptr;
+	CGSHandler::RegisterWriteList		m_discardedWrites;
+
 	CProfiler::ZoneHandle m_gifProfilerZone = 0;
 };
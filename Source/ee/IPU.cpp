@@ -8,6 +8,7 @@
 #include "IPU_MacroblockTypeBTable.h"
 #include "IPU_MotionCodeTable.h"
 #include "IPU_DmVectorTable.h"
+#include "IPU_FastKernels.h"
 #include "mpeg2/DcSizeLuminanceTable.h"
 #include "mpeg2/DcSizeChrominanceTable.h"
 #include "mpeg2/DctCoefficientTable0.h"
@@ -337,6 +338,12 @@ void CIPU::SetDMA3ReceiveHandler(const Dma3ReceiveHandler& receiveHandler)
 	m_OUT_FIFO.SetReceiveHandler(receiveHandler);
 }
 
+void CIPU::SetDecoderMode(DECODER_MODE decoderMode)
+{
+	m_BDECCommand.SetDecoderMode(decoderMode);
+	m_CSCCommand.SetDecoderMode(decoderMode);
+}
+
 uint32 CIPU::ReceiveDMA4(uint32 nAddress, uint32 nQWC, bool nTagIncluded, uint8* ram)
 {
 	assert(nTagIncluded == false);
@@ -715,9 +722,14 @@ void CIPU::COUTFIFO::RequestGrow(unsigned int size)
 /////////////////////////////////////////////
 
 CIPU::CINFIFO::CINFIFO()
-: m_size(0)
+: m_lookupBits(0)
+, m_lookupPosition(0)
+, m_lookupBitsDirty(true)
+, m_readPosition(0)
+, m_size(0)
 , m_bitPosition(0)
 {
+	memset(m_buffer, 0, sizeof(m_buffer));
 
 }
 
@@ -734,9 +746,17 @@ void CIPU::CINFIFO::Write(void* data, unsigned int size)
 		return;
 	}
 
-	memcpy(m_buffer + m_size, data, size);
+	if((m_readPosition + m_size + size) > BUFFERSIZE * 2)
+	{
+		memmove(m_buffer, m_buffer + m_readPosition, m_size);
+		m_readPosition = 0;
+		m_lookupBitsDirty = true;
+	}
+
+	unsigned int writePosition = m_readPosition + m_size;
+	memcpy(m_buffer + writePosition, data, size);
 	m_size += size;
-	m_lookupBitsDirty = true;
+	m_lookupBitsDirty |= ((m_lookupPosition + 8) > writePosition);
 }
 
 bool CIPU::CINFIFO::TryPeekBits_LSBF(uint8 nBits, uint32& result)
@@ -758,19 +778,41 @@ bool CIPU::CINFIFO::TryPeekBits_MSBF(uint8 size, uint32& result)
 		return false;
 	}
 
-	if(m_lookupBitsDirty)
+	//Lookup bits hold the 64 bits following m_lookupPosition, refill them if the
+	//requested bits are not completely inside that window
+	unsigned int bitPosition = (m_readPosition * 8) + m_bitPosition;
+	unsigned int lookupBitPosition = m_lookupPosition * 8;
+	if(
+		m_lookupBitsDirty || 
+		(bitPosition < lookupBitPosition) ||
+		((bitPosition - lookupBitPosition + size) > 64)
+		)
 	{
-		SyncLookupBits();
-		m_lookupBitsDirty = false;
+		SyncLookupBits(bitPosition / 8);
+		lookupBitPosition = m_lookupPosition * 8;
 	}
 
-	uint8 shift = 64 - (m_bitPosition % 32) - size;
-	uint64 mask = ~0ULL >> (64 - size);
-	result = static_cast<uint32>((m_lookupBits >> shift) & mask);
+	result = static_cast<uint32>((m_lookupBits << (bitPosition - lookupBitPosition)) >> (64 - size));
 
 	return true;
 }
 
+unsigned int CIPU::CINFIFO::TryReadBytes(void* data, unsigned int size)
+{
+	//Bulk reads are only possible when we're on a byte boundary
+	if((m_bitPosition & 7) != 0)
+	{
+		return 0;
+	}
+
+	unsigned int byteIndex = m_bitPosition / 8;
+	unsigned int readSize = std::min<unsigned int>(size, m_size - byteIndex);
+	memcpy(data, m_buffer + m_readPosition + byteIndex, readSize);
+	m_bitPosition += readSize * 8;
+	DiscardReadBlocks();
+	return readSize;
+}
+
 void CIPU::CINFIFO::Advance(uint8 bits)
 {
 	if(bits == 0) return;
@@ -780,32 +822,8 @@ void CIPU::CINFIFO::Advance(uint8 bits)
 		throw CBitStreamException();
 	}
 
-	uint32 wordsBefore = m_bitPosition / 32;
-	uint32 wordsAfter = (m_bitPosition + bits) / 32;
-	m_lookupBitsDirty |= (wordsBefore != wordsAfter);
-
 	m_bitPosition += bits;
-
-	while(m_bitPosition >= 128)
-	{
-		if(m_size == 0)
-		{
-			assert(0);
-		}
-
-		if((m_size == 0) && (m_bitPosition != 0))
-		{
-			//Humm, this seems to happen when the DMA4 has done the transfer
-			//but we need more data...
-			assert(0);
-		}
-
-		//Discard the read bytes
-		memmove(m_buffer, m_buffer + 16, m_size - 16);
-		m_size -= 16;
-		m_bitPosition -= 128;
-		m_lookupBitsDirty = true;
-	}
+	DiscardReadBlocks();
 }
 
 uint8 CIPU::CINFIFO::GetBitIndex() const
@@ -831,20 +849,43 @@ unsigned int CIPU::CINFIFO::GetAvailableBits()
 void CIPU::CINFIFO::Reset()
 {
 	m_bitPosition = 0;
+	m_readPosition = 0;
 	m_size = 0;
 	m_lookupBits = 0;
-	m_lookupBitsDirty = false;
+	m_lookupPosition = 0;
+	m_lookupBitsDirty = true;
+}
+
+void CIPU::CINFIFO::DiscardReadBlocks()
+{
+	while(m_bitPosition >= 128)
+	{
+		if(m_size == 0)
+		{
+			//Humm, this seems to happen when the DMA4 has done the transfer
+			//but we need more data...
+			assert(0);
+			break;
+		}
+
+		//Discard the read bytes, the data is only moved when more space is needed
+		m_readPosition += 16;
+		m_size -= 16;
+		m_bitPosition -= 128;
+	}
 }
 
-void CIPU::CINFIFO::SyncLookupBits()
+void CIPU::CINFIFO::SyncLookupBits(unsigned int lookupPosition)
 {
-	unsigned int lookupPosition = (m_bitPosition & ~0x1F) / 8;
-	uint8 lookupBytes[8];
+	assert((lookupPosition + 8) <= STORAGESIZE);
+	uint64 lookupBits = 0;
 	for(unsigned int i = 0; i < 8; i++)
 	{
-		lookupBytes[7 - i] = m_buffer[lookupPosition + i];
+		lookupBits = (lookupBits << 8) | m_buffer[lookupPosition + i];
 	}
-	m_lookupBits = *reinterpret_cast<uint64*>(lookupBytes);
+	m_lookupBits = lookupBits;
+	m_lookupPosition = lookupPosition;
+	m_lookupBitsDirty = false;
 }
 
 /////////////////////////////////////////////
@@ -1076,6 +1117,43 @@ CIPU::CBDECCommand::CBDECCommand()
 	m_blocks[5].block = m_crBlock;		m_blocks[5].channel = 2;
 }
 
+void CIPU::CBDECCommand::SetDecoderMode(DECODER_MODE decoderMode)
+{
+	m_decoderMode = decoderMode;
+}
+
+void CIPU::CBDECCommand::TransformBlock(int16* block)
+{
+	int16 blockTemp[0x40];
+	memcpy(blockTemp, block, sizeof(int16) * 0x40);
+
+	switch(m_decoderMode)
+	{
+	case DECODER_MODE_FAST:
+		IPU::FastIdct(blockTemp, block);
+		break;
+	case DECODER_MODE_REFERENCE:
+		IDCT::CIEEE1180::GetInstance()->Transform(blockTemp, block);
+		break;
+	case DECODER_MODE_VERIFY:
+		{
+			int16 fastBlock[0x40];
+			IPU::FastIdct(blockTemp, fastBlock);
+			IDCT::CIEEE1180::GetInstance()->Transform(blockTemp, block);
+			for(unsigned int i = 0; i < 0x40; i++)
+			{
+				//IEEE-1180 allows a peak error of 1
+				if(abs(fastBlock[i] - block[i]) > 1)
+				{
+					CLog::GetInstance().Print(LOG_NAME, "IDCT mismatch at coefficient %d (reference: %d, fast: %d).\r\n", i, block[i], fastBlock[i]);
+					break;
+				}
+			}
+		}
+		break;
+	}
+}
+
 void CIPU::CBDECCommand::Initialize(CINFIFO* inFifo, COUTFIFO* outFifo, uint32 commandCode, bool checkStartCode, const DECODER_CONTEXT& context)
 {
 	m_command <<= commandCode;
@@ -1182,15 +1260,12 @@ bool CIPU::CBDECCommand::Execute()
 				}
 
 				BLOCKENTRY& blockInfo(m_blocks[m_currentBlockIndex]);
-				int16 blockTemp[0x40];
 
 				InverseScan(blockInfo.block, m_context.isZigZag);
 				DequantiseBlock(blockInfo.block, (m_command.mbi != 0), m_command.qsc, 
 					m_context.isLinearQScale, m_context.dcPrecision, m_context.intraIq, m_context.nonIntraIq);
 
-				memcpy(blockTemp, blockInfo.block, sizeof(int16) * 0x40);
-
-				IDCT::CIEEE1180::GetInstance()->Transform(blockTemp, blockInfo.block);
+				TransformBlock(blockInfo.block);
 
 				m_state = STATE_DECODEBLOCK_GOTONEXT;
 			}
@@ -1665,6 +1740,7 @@ void CIPU::CSETIQCommand::Initialize(CINFIFO* fifo, uint8* matrix)
 
 bool CIPU::CSETIQCommand::Execute()
 {
+	m_currentIndex += m_IN_FIFO->TryReadBytes(m_matrix + m_currentIndex, 0x40 - m_currentIndex);
 	while(m_currentIndex != 0x40)
 	{
 		m_matrix[m_currentIndex] = static_cast<uint8>(m_IN_FIFO->GetBits_MSBF(8));
@@ -1694,6 +1770,17 @@ void CIPU::CSETVQCommand::Initialize(CINFIFO* fifo, uint16* clut)
 
 bool CIPU::CSETVQCommand::Execute()
 {
+	unsigned int remainingSize = (0x10 - m_currentIndex) * 2;
+	if(m_IN_FIFO->GetAvailableBits() >= (remainingSize * 8))
+	{
+		uint8 clutBytes[0x20];
+		unsigned int readSize = m_IN_FIFO->TryReadBytes(clutBytes, remainingSize);
+		assert((readSize == 0) || (readSize == remainingSize));
+		for(unsigned int i = 0; i < readSize; i += 2)
+		{
+			m_clut[m_currentIndex++] = static_cast<uint16>((clutBytes[i] << 8) | clutBytes[i + 1]);
+		}
+	}
 	while(m_currentIndex != 0x10)
 	{
 		m_clut[m_currentIndex] = static_cast<uint16>(m_IN_FIFO->GetBits_MSBF(16));
@@ -1754,6 +1841,12 @@ bool CIPU::CCSCCommand::Execute()
 				}
 				else
 				{
+					unsigned int readSize = m_IN_FIFO->TryReadBytes(m_block + m_currentIndex, BLOCK_SIZE - m_currentIndex);
+					if(readSize != 0)
+					{
+						m_currentIndex += readSize;
+						break;
+					}
 					uint32 blockValue = 0;
 					if(!m_IN_FIFO->TryGetBits_MSBF(8, blockValue))
 					{
@@ -1766,62 +1859,27 @@ bool CIPU::CCSCCommand::Execute()
 			break;
 		case STATE_CONVERTBLOCK:
 			{
-				uint32 nPixel[0x100];
-
-				uint8* pY = m_block;
-				uint8* nBlockCb = m_block + 0x100;
-				uint8* nBlockCr = m_block + 0x140;
-
-				uint32* pPixel = nPixel;
-				unsigned int* pCbCrMap = m_nCbCrMap;
-				
-				uint32 alphaTh0 = (m_TH0 & 0xFF) | ((m_TH0 & 0xFF) << 8) | ((m_TH0 & 0xFF) << 16);
-				uint32 alphaTh1 = (m_TH1 & 0xFF) | ((m_TH1 & 0xFF) << 8) | ((m_TH1 & 0xFF) << 16);
-
-				for(unsigned int i = 0; i < 16; i++)
+				if(m_command.ofm)
 				{
-					for(unsigned int j = 0; j < 16; j++)
+					uint16 pixels[0x100];
+					if(m_decoderMode == DECODER_MODE_FAST)
 					{
-						float nY  = pY[j];
-						float nCb = nBlockCb[pCbCrMap[j]];
-						float nCr = nBlockCr[pCbCrMap[j]];
-
-						//nY = nBlockCb[pCbCrMap[j]];
-						//nCb = 128;
-						//nCr = 128;
-
-						float nR = nY								+ 1.402f	* (nCr - 128);
-						float nG = nY - 0.34414f	* (nCb - 128)	- 0.71414f	* (nCr - 128);
-						float nB = nY + 1.772f		* (nCb - 128);
-
-						if(nR < 0) { nR = 0; } if(nR > 255) { nR = 255; }
-						if(nG < 0) { nG = 0; } if(nG > 255) { nG = 255; }
-						if(nB < 0) { nB = 0; } if(nB > 255) { nB = 255; }
-
-						uint8 a = 0;
-						uint32 rgb = (static_cast<uint8>(nB) << 16) | (static_cast<uint8>(nG) << 8) | (static_cast<uint8>(nR) << 0);
-						if(rgb < alphaTh0)
-						{
-							a = 0;
-						}
-						else if(rgb < alphaTh1)
-						{
-							a = 0x40;
-						}
-						else
-						{
-							a = 0x80;
-						}
-
-						pPixel[j] = (a << 24) | rgb;
+						IPU::FastCscRgb16(m_block, pixels, m_TH0, m_TH1, m_command.dte != 0);
 					}
-
-					pY			+= 0x10;
-					pCbCrMap	+= 0x10;
-					pPixel		+= 0x10;
+					else
+					{
+						uint32 rgb32Pixels[0x100];
+						ConvertBlockRgb32(rgb32Pixels);
+						ConvertRgb32ToRgb16Reference(rgb32Pixels, pixels, m_command.dte != 0);
+					}
+					m_OUT_FIFO->Write(pixels, sizeof(uint16) * 0x100);
+				}
+				else
+				{
+					uint32 pixels[0x100];
+					ConvertBlockRgb32(pixels);
+					m_OUT_FIFO->Write(pixels, sizeof(uint32) * 0x100);
 				}
-
-				m_OUT_FIFO->Write(nPixel, sizeof(uint32) * 0x100);
 
 				m_mbCount--;
 				m_state = STATE_FLUSHBLOCK;
@@ -1844,6 +1902,141 @@ bool CIPU::CCSCCommand::Execute()
 	}
 }
 
+void CIPU::CCSCCommand::SetDecoderMode(DECODER_MODE decoderMode)
+{
+	m_decoderMode = decoderMode;
+}
+
+void CIPU::CCSCCommand::ConvertBlockRgb32(uint32* pixels)
+{
+	switch(m_decoderMode)
+	{
+	case DECODER_MODE_FAST:
+		IPU::FastCscRgb32(m_block, pixels, m_TH0, m_TH1);
+		break;
+	case DECODER_MODE_REFERENCE:
+		ConvertBlockReference(pixels);
+		break;
+	case DECODER_MODE_VERIFY:
+		{
+			uint32 fastPixels[0x100];
+			IPU::FastCscRgb32(m_block, fastPixels, m_TH0, m_TH1);
+			ConvertBlockReference(pixels);
+			for(unsigned int i = 0; i < 0x100; i++)
+			{
+				//Fixed-point conversion can be off by one on some components
+				bool matches = true;
+				for(unsigned int shift = 0; shift < 24; shift += 8)
+				{
+					int component = (pixels[i] >> shift) & 0xFF;
+					int fastComponent = (fastPixels[i] >> shift) & 0xFF;
+					matches &= (abs(component - fastComponent) <= 1);
+				}
+				if(!matches)
+				{
+					CLog::GetInstance().Print(LOG_NAME, "CSC mismatch at pixel %d (reference: 0x%0.8X, fast: 0x%0.8X).\r\n", i, pixels[i], fastPixels[i]);
+					break;
+				}
+			}
+		}
+		break;
+	}
+}
+
+void CIPU::CCSCCommand::ConvertBlockReference(uint32* nPixel)
+{
+	uint8* pY = m_block;
+	uint8* nBlockCb = m_block + 0x100;
+	uint8* nBlockCr = m_block + 0x140;
+
+	uint32* pPixel = nPixel;
+	unsigned int* pCbCrMap = m_nCbCrMap;
+	
+	uint32 alphaTh0 = (m_TH0 & 0xFF) | ((m_TH0 & 0xFF) << 8) | ((m_TH0 & 0xFF) << 16);
+	uint32 alphaTh1 = (m_TH1 & 0xFF) | ((m_TH1 & 0xFF) << 8) | ((m_TH1 & 0xFF) << 16);
+
+	for(unsigned int i = 0; i < 16; i++)
+	{
+		for(unsigned int j = 0; j < 16; j++)
+		{
+			float nY  = pY[j];
+			float nCb = nBlockCb[pCbCrMap[j]];
+			float nCr = nBlockCr[pCbCrMap[j]];
+
+			//nY = nBlockCb[pCbCrMap[j]];
+			//nCb = 128;
+			//nCr = 128;
+
+			float nR = nY								+ 1.402f	* (nCr - 128);
+			float nG = nY - 0.34414f	* (nCb - 128)	- 0.71414f	* (nCr - 128);
+			float nB = nY + 1.772f		* (nCb - 128);
+
+			if(nR < 0) { nR = 0; } if(nR > 255) { nR = 255; }
+			if(nG < 0) { nG = 0; } if(nG > 255) { nG = 255; }
+			if(nB < 0) { nB = 0; } if(nB > 255) { nB = 255; }
+
+			uint8 a = 0;
+			uint32 rgb = (static_cast<uint8>(nB) << 16) | (static_cast<uint8>(nG) << 8) | (static_cast<uint8>(nR) << 0);
+			if(rgb < alphaTh0)
+			{
+				a = 0;
+			}
+			else if(rgb < alphaTh1)
+			{
+				a = 0x40;
+			}
+			else
+			{
+				a = 0x80;
+			}
+
+			pPixel[j] = (a << 24) | rgb;
+		}
+
+		pY			+= 0x10;
+		pCbCrMap	+= 0x10;
+		pPixel		+= 0x10;
+	}
+}
+
+void CIPU::CCSCCommand::ConvertRgb32ToRgb16Reference(const uint32* input, uint16* output, bool dither)
+{
+	static const int ditherMatrix[4][4] =
+	{
+		{ -4,  0, -3,  1 },
+		{  2, -2,  3, -1 },
+		{ -3,  1, -4,  0 },
+		{  3, -1,  2, -2 },
+	};
+
+	for(unsigned int y = 0; y < 16; y++)
+	{
+		for(unsigned int x = 0; x < 16; x++)
+		{
+			uint32 pixel = input[(y * 16) + x];
+			uint32 a = pixel >> 24;
+
+			//Transparent pixels are output as 0, semi-transparent ones have their alpha bit set
+			if(a == 0)
+			{
+				output[(y * 16) + x] = 0;
+				continue;
+			}
+
+			int ditherValue = dither ? ditherMatrix[y & 3][x & 3] : 0;
+			int nR = static_cast<int>((pixel >>  0) & 0xFF) + ditherValue;
+			int nG = static_cast<int>((pixel >>  8) & 0xFF) + ditherValue;
+			int nB = static_cast<int>((pixel >> 16) & 0xFF) + ditherValue;
+
+			if(nR < 0) { nR = 0; } if(nR > 255) { nR = 255; }
+			if(nG < 0) { nG = 0; } if(nG > 255) { nG = 255; }
+			if(nB < 0) { nB = 0; } if(nB > 255) { nB = 255; }
+
+			output[(y * 16) + x] = static_cast<uint16>(((a == 0x40) ? 0x8000 : 0) | ((nB >> 3) << 10) | ((nG >> 3) << 5) | (nR >> 3));
+		}
+	}
+}
+
 void CIPU::CCSCCommand::GenerateCbCrMap()
 {
 	unsigned int* pCbCrMap = m_nCbCrMap;
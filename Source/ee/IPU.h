@@ -6,6 +6,7 @@
 #include "MemStream.h"
 #include "mpeg2/VLCTable.h"
 #include "mpeg2/DctCoefficientTable.h"
+#include "IPU_VLCLookupTable.h"
 #include "../MailBox.h"
 #include "Convertible.h"
 
@@ -14,6 +15,13 @@ class CIPU
 public:
 	typedef std::function<uint32 (const void*, uint32)> Dma3ReceiveHandler;
 
+	enum DECODER_MODE
+	{
+		DECODER_MODE_FAST,
+		DECODER_MODE_REFERENCE,
+		DECODER_MODE_VERIFY,
+	};
+
 						CIPU();
 	virtual				~CIPU();
 
@@ -31,6 +39,7 @@ public:
 	uint32				GetRegister(uint32);
 	void				SetRegister(uint32, uint32);
 	void				SetDMA3ReceiveHandler(const Dma3ReceiveHandler&);
+	void				SetDecoderMode(DECODER_MODE);
 	uint32				ReceiveDMA4(uint32, uint32, bool, uint8*);
 
 	void				CountTicks(uint32);
@@ -151,6 +160,8 @@ private:
 		bool				TryPeekBits_LSBF(uint8, uint32&) override;
 		bool				TryPeekBits_MSBF(uint8, uint32&) override;
 
+		unsigned int		TryReadBytes(void*, unsigned int);
+
 		void				SetBitPosition(unsigned int);
 		unsigned int		GetSize();
 		unsigned int		GetAvailableBits();
@@ -162,11 +173,21 @@ private:
 		};
 
 	private:
-		void				SyncLookupBits();
+		enum
+		{
+			//Read blocks are only discarded when the writer runs out of space,
+			//extra bytes at the end allow 64-bit lookups at any position
+			STORAGESIZE = (BUFFERSIZE * 2) + 8,
+		};
 
-		uint8				m_buffer[BUFFERSIZE];
+		void				DiscardReadBlocks();
+		void				SyncLookupBits(unsigned int);
+
+		uint8				m_buffer[STORAGESIZE];
 		uint64				m_lookupBits;
+		unsigned int		m_lookupPosition;
 		bool				m_lookupBitsDirty;
+		unsigned int		m_readPosition;
 		unsigned int		m_size;
 		unsigned int		m_bitPosition;
 	};
@@ -317,6 +338,7 @@ private:
 
 		void							Initialize(CINFIFO*, COUTFIFO*, uint32, bool, const DECODER_CONTEXT&);
 		bool							Execute() override;
+		void							SetDecoderMode(DECODER_MODE);
 
 	private:
 		enum STATE
@@ -353,6 +375,9 @@ private:
 
 		unsigned int					m_currentBlockIndex = 0;
 
+		void							TransformBlock(int16*);
+
+		DECODER_MODE					m_decoderMode = DECODER_MODE_FAST;
 		DECODER_CONTEXT					m_context;
 		CBDECCommand_ReadDct			m_readDctCoeffsCommand;
 	};
@@ -378,7 +403,7 @@ private:
 		uint32*				m_result;
 		CINFIFO*			m_IN_FIFO;
 		STATE				m_state;
-		MPEG2::CVLCTable*	m_table;
+		IPU::CVLCLookupTable*	m_table;
 	};
 
 	//0x04 ------------------------------------------------------------
@@ -442,6 +467,7 @@ private:
 
 		void			Initialize(CINFIFO*, COUTFIFO*, uint32, uint16, uint16);
 		bool			Execute() override;
+		void			SetDecoderMode(DECODER_MODE);
 
 	private:
 		enum STATE
@@ -459,9 +485,13 @@ private:
 		};
 
 		void			GenerateCbCrMap();
+		void			ConvertBlockRgb32(uint32*);
+		void			ConvertBlockReference(uint32*);
+		static void		ConvertRgb32ToRgb16Reference(const uint32*, uint16*, bool);
 
 		STATE			m_state = STATE_DONE;
 		CMD_CSC			m_command = make_convertible<CMD_CSC>(0);
+		DECODER_MODE	m_decoderMode = DECODER_MODE_FAST;
 
 		CINFIFO*		m_IN_FIFO = nullptr;
 		COUTFIFO*		m_OUT_FIFO = nullptr;
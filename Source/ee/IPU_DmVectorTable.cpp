@@ -17,15 +17,15 @@ unsigned int CDmVectorTable::m_pIndexTable[MAXBITS] =
 	1,
 };
 
-CVLCTable* CDmVectorTable::m_pInstance = NULL;
+CVLCLookupTable* CDmVectorTable::m_pInstance = NULL;
 
 CDmVectorTable::CDmVectorTable() :
-CVLCTable(MAXBITS, m_pTable, ENTRYCOUNT, m_pIndexTable)
+CVLCLookupTable(MAXBITS, m_pTable, ENTRYCOUNT, m_pIndexTable)
 {
 
 }
 
-CVLCTable* CDmVectorTable::GetInstance()
+CVLCLookupTable* CDmVectorTable::GetInstance()
 {
 	if(m_pInstance == NULL)
 	{
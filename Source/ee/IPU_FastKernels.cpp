@@ -0,0 +1,696 @@
+#include <algorithm>
+#include "IPU_FastKernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define IPU_KERNELS_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define IPU_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+//IDCT coefficients: round(cos(k * pi / 16) * sqrt(2) * (1 << 14)), W4 is reduced by one to fit
+//pairs of W4 sums in the same range as the other coefficients
+#define IDCT_W1			(22725)
+#define IDCT_W2			(21407)
+#define IDCT_W3			(19266)
+#define IDCT_W4			(16383)
+#define IDCT_W5			(12873)
+#define IDCT_W6			(8867)
+#define IDCT_W7			(4520)
+
+#define IDCT_ROW_SHIFT	(11)
+#define IDCT_COL_SHIFT	(20)
+
+#define IDCT_OUTPUT_MIN	(-256)
+#define IDCT_OUTPUT_MAX	(255)
+
+//YCbCr to RGB coefficients in 2.14 fixed-point
+#define CSC_SHIFT		(14)
+#define CSC_CR_R		(22970)		//1.402
+#define CSC_CB_G		(-5638)		//-0.34414
+#define CSC_CR_G		(-11700)	//-0.71414
+#define CSC_CB_B		(29032)		//1.772
+
+using namespace IPU;
+
+static const int8 g_ditherMatrix[4][4] =
+{
+	{ -4,  0, -3,  1 },
+	{  2, -2,  3, -1 },
+	{ -3,  1, -4,  0 },
+	{  3, -1,  2, -2 },
+};
+
+static uint32 MakeAlphaThreshold(uint16 threshold)
+{
+	return (threshold & 0xFF) | ((threshold & 0xFF) << 8) | ((threshold & 0xFF) << 16);
+}
+
+#if defined(IPU_KERNELS_SSE2)
+
+/////////////////////////////////////////////
+//SSE2 implementation
+/////////////////////////////////////////////
+
+static __m128i MakeCoefficientPair(int16 first, int16 second)
+{
+	return _mm_set1_epi32(static_cast<int32>((static_cast<uint16>(second) << 16) | static_cast<uint16>(first)));
+}
+
+static void Transpose8x8(__m128i* v)
+{
+	__m128i a0 = _mm_unpacklo_epi16(v[0], v[1]);
+	__m128i a1 = _mm_unpackhi_epi16(v[0], v[1]);
+	__m128i a2 = _mm_unpacklo_epi16(v[2], v[3]);
+	__m128i a3 = _mm_unpackhi_epi16(v[2], v[3]);
+	__m128i a4 = _mm_unpacklo_epi16(v[4], v[5]);
+	__m128i a5 = _mm_unpackhi_epi16(v[4], v[5]);
+	__m128i a6 = _mm_unpacklo_epi16(v[6], v[7]);
+	__m128i a7 = _mm_unpackhi_epi16(v[6], v[7]);
+
+	__m128i b0 = _mm_unpacklo_epi32(a0, a2);
+	__m128i b1 = _mm_unpackhi_epi32(a0, a2);
+	__m128i b2 = _mm_unpacklo_epi32(a1, a3);
+	__m128i b3 = _mm_unpackhi_epi32(a1, a3);
+	__m128i b4 = _mm_unpacklo_epi32(a4, a6);
+	__m128i b5 = _mm_unpackhi_epi32(a4, a6);
+	__m128i b6 = _mm_unpacklo_epi32(a5, a7);
+	__m128i b7 = _mm_unpackhi_epi32(a5, a7);
+
+	v[0] = _mm_unpacklo_epi64(b0, b4);
+	v[1] = _mm_unpackhi_epi64(b0, b4);
+	v[2] = _mm_unpacklo_epi64(b1, b5);
+	v[3] = _mm_unpackhi_epi64(b1, b5);
+	v[4] = _mm_unpacklo_epi64(b2, b6);
+	v[5] = _mm_unpackhi_epi64(b2, b6);
+	v[6] = _mm_unpacklo_epi64(b3, b7);
+	v[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+//1D IDCT on 8 columns at once, v[n] contains the nth coefficient of every column
+template <int SHIFT>
+static void Idct1D(__m128i* v)
+{
+	const __m128i w4w4 = MakeCoefficientPair(IDCT_W4, IDCT_W4);
+	const __m128i w4nw4 = MakeCoefficientPair(IDCT_W4, -IDCT_W4);
+	const __m128i w2w6 = MakeCoefficientPair(IDCT_W2, IDCT_W6);
+	const __m128i w6nw2 = MakeCoefficientPair(IDCT_W6, -IDCT_W2);
+	const __m128i nw6w2 = MakeCoefficientPair(-IDCT_W6, IDCT_W2);
+	const __m128i nw2nw6 = MakeCoefficientPair(-IDCT_W2, -IDCT_W6);
+	const __m128i w1w3 = MakeCoefficientPair(IDCT_W1, IDCT_W3);
+	const __m128i w3nw7 = MakeCoefficientPair(IDCT_W3, -IDCT_W7);
+	const __m128i w5nw1 = MakeCoefficientPair(IDCT_W5, -IDCT_W1);
+	const __m128i w7nw5 = MakeCoefficientPair(IDCT_W7, -IDCT_W5);
+	const __m128i w5w7 = MakeCoefficientPair(IDCT_W5, IDCT_W7);
+	const __m128i nw1nw5 = MakeCoefficientPair(-IDCT_W1, -IDCT_W5);
+	const __m128i w7w3 = MakeCoefficientPair(IDCT_W7, IDCT_W3);
+	const __m128i w3nw1 = MakeCoefficientPair(IDCT_W3, -IDCT_W1);
+	const __m128i bias = _mm_set1_epi32(1 << (SHIFT - 1));
+
+	__m128i pairs04[2] = { _mm_unpacklo_epi16(v[0], v[4]), _mm_unpackhi_epi16(v[0], v[4]) };
+	__m128i pairs26[2] = { _mm_unpacklo_epi16(v[2], v[6]), _mm_unpackhi_epi16(v[2], v[6]) };
+	__m128i pairs13[2] = { _mm_unpacklo_epi16(v[1], v[3]), _mm_unpackhi_epi16(v[1], v[3]) };
+	__m128i pairs57[2] = { _mm_unpacklo_epi16(v[5], v[7]), _mm_unpackhi_epi16(v[5], v[7]) };
+
+	__m128i result[8][2];
+	for(unsigned int i = 0; i < 2; i++)
+	{
+		__m128i even0 = _mm_add_epi32(_mm_madd_epi16(pairs04[i], w4w4), bias);
+		__m128i even1 = _mm_add_epi32(_mm_madd_epi16(pairs04[i], w4nw4), bias);
+
+		__m128i a0 = _mm_add_epi32(even0, _mm_madd_epi16(pairs26[i], w2w6));
+		__m128i a1 = _mm_add_epi32(even1, _mm_madd_epi16(pairs26[i], w6nw2));
+		__m128i a2 = _mm_add_epi32(even1, _mm_madd_epi16(pairs26[i], nw6w2));
+		__m128i a3 = _mm_add_epi32(even0, _mm_madd_epi16(pairs26[i], nw2nw6));
+
+		__m128i b0 = _mm_add_epi32(_mm_madd_epi16(pairs13[i], w1w3), _mm_madd_epi16(pairs57[i], w5w7));
+		__m128i b1 = _mm_add_epi32(_mm_madd_epi16(pairs13[i], w3nw7), _mm_madd_epi16(pairs57[i], nw1nw5));
+		__m128i b2 = _mm_add_epi32(_mm_madd_epi16(pairs13[i], w5nw1), _mm_madd_epi16(pairs57[i], w7w3));
+		__m128i b3 = _mm_add_epi32(_mm_madd_epi16(pairs13[i], w7nw5), _mm_madd_epi16(pairs57[i], w3nw1));
+
+		result[0][i] = _mm_srai_epi32(_mm_add_epi32(a0, b0), SHIFT);
+		result[7][i] = _mm_srai_epi32(_mm_sub_epi32(a0, b0), SHIFT);
+		result[1][i] = _mm_srai_epi32(_mm_add_epi32(a1, b1), SHIFT);
+		result[6][i] = _mm_srai_epi32(_mm_sub_epi32(a1, b1), SHIFT);
+		result[2][i] = _mm_srai_epi32(_mm_add_epi32(a2, b2), SHIFT);
+		result[5][i] = _mm_srai_epi32(_mm_sub_epi32(a2, b2), SHIFT);
+		result[3][i] = _mm_srai_epi32(_mm_add_epi32(a3, b3), SHIFT);
+		result[4][i] = _mm_srai_epi32(_mm_sub_epi32(a3, b3), SHIFT);
+	}
+
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		v[i] = _mm_packs_epi32(result[i][0], result[i][1]);
+	}
+}
+
+void IPU::FastIdct(const int16* input, int16* output)
+{
+	__m128i v[8];
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		v[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + (i * 8)));
+	}
+
+	//Rows
+	Transpose8x8(v);
+	Idct1D<IDCT_ROW_SHIFT>(v);
+	Transpose8x8(v);
+
+	//Columns
+	Idct1D<IDCT_COL_SHIFT>(v);
+
+	const __m128i outputMin = _mm_set1_epi16(IDCT_OUTPUT_MIN);
+	const __m128i outputMax = _mm_set1_epi16(IDCT_OUTPUT_MAX);
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		__m128i result = _mm_min_epi16(_mm_max_epi16(v[i], outputMin), outputMax);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(output + (i * 8)), result);
+	}
+}
+
+void IPU::FastCscRgb32(const uint8* block, uint32* output, uint16 th0, uint16 th1)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i chromaBias = _mm_set1_epi16(128);
+	const __m128i coefR = MakeCoefficientPair(0, CSC_CR_R);
+	const __m128i coefG = MakeCoefficientPair(CSC_CB_G, CSC_CR_G);
+	const __m128i coefB = MakeCoefficientPair(CSC_CB_B, 0);
+	const __m128i alphaTh0 = _mm_set1_epi32(MakeAlphaThreshold(th0));
+	const __m128i alphaTh1 = _mm_set1_epi32(MakeAlphaThreshold(th1));
+	const __m128i alphaOpaque = _mm_set1_epi32(0x80000000);
+	const __m128i alphaHalf = _mm_set1_epi32(0x40000000);
+
+	const uint8* blockY = block;
+	const uint8* blockCb = block + 0x100;
+	const uint8* blockCr = block + 0x140;
+
+	for(unsigned int y = 0; y < 16; y++)
+	{
+		const uint8* rowY = blockY + (y * 16);
+		const uint8* rowCb = blockCb + ((y / 2) * 8);
+		const uint8* rowCr = blockCr + ((y / 2) * 8);
+
+		__m128i cb = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(rowCb)), zero), chromaBias);
+		__m128i cr = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(rowCr)), zero), chromaBias);
+		__m128i cbcr[2] = { _mm_unpacklo_epi16(cb, cr), _mm_unpackhi_epi16(cb, cr) };
+
+		//Chroma contributions for the 16 pixels of the row (each chroma sample covers 2 pixels)
+		__m128i chromaR[4], chromaG[4], chromaB[4];
+		for(unsigned int i = 0; i < 2; i++)
+		{
+			__m128i r = _mm_madd_epi16(cbcr[i], coefR);
+			__m128i g = _mm_madd_epi16(cbcr[i], coefG);
+			__m128i b = _mm_madd_epi16(cbcr[i], coefB);
+			chromaR[(i * 2) + 0] = _mm_unpacklo_epi32(r, r);
+			chromaR[(i * 2) + 1] = _mm_unpackhi_epi32(r, r);
+			chromaG[(i * 2) + 0] = _mm_unpacklo_epi32(g, g);
+			chromaG[(i * 2) + 1] = _mm_unpackhi_epi32(g, g);
+			chromaB[(i * 2) + 0] = _mm_unpacklo_epi32(b, b);
+			chromaB[(i * 2) + 1] = _mm_unpackhi_epi32(b, b);
+		}
+
+		__m128i lumaBytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rowY));
+		__m128i luma16[2] = { _mm_unpacklo_epi8(lumaBytes, zero), _mm_unpackhi_epi8(lumaBytes, zero) };
+		__m128i luma[4] =
+		{
+			_mm_slli_epi32(_mm_unpacklo_epi16(luma16[0], zero), CSC_SHIFT),
+			_mm_slli_epi32(_mm_unpackhi_epi16(luma16[0], zero), CSC_SHIFT),
+			_mm_slli_epi32(_mm_unpacklo_epi16(luma16[1], zero), CSC_SHIFT),
+			_mm_slli_epi32(_mm_unpackhi_epi16(luma16[1], zero), CSC_SHIFT),
+		};
+
+		__m128i r16[2], g16[2], b16[2];
+		for(unsigned int i = 0; i < 2; i++)
+		{
+			unsigned int lo = (i * 2) + 0;
+			unsigned int hi = (i * 2) + 1;
+			r16[i] = _mm_packs_epi32(
+				_mm_srai_epi32(_mm_add_epi32(luma[lo], chromaR[lo]), CSC_SHIFT),
+				_mm_srai_epi32(_mm_add_epi32(luma[hi], chromaR[hi]), CSC_SHIFT));
+			g16[i] = _mm_packs_epi32(
+				_mm_srai_epi32(_mm_add_epi32(luma[lo], chromaG[lo]), CSC_SHIFT),
+				_mm_srai_epi32(_mm_add_epi32(luma[hi], chromaG[hi]), CSC_SHIFT));
+			b16[i] = _mm_packs_epi32(
+				_mm_srai_epi32(_mm_add_epi32(luma[lo], chromaB[lo]), CSC_SHIFT),
+				_mm_srai_epi32(_mm_add_epi32(luma[hi], chromaB[hi]), CSC_SHIFT));
+		}
+
+		//Saturating packs take care of clamping to [0, 255]
+		__m128i r8 = _mm_packus_epi16(r16[0], r16[1]);
+		__m128i g8 = _mm_packus_epi16(g16[0], g16[1]);
+		__m128i b8 = _mm_packus_epi16(b16[0], b16[1]);
+
+		__m128i rg[2] = { _mm_unpacklo_epi8(r8, g8), _mm_unpackhi_epi8(r8, g8) };
+		__m128i b0[2] = { _mm_unpacklo_epi8(b8, zero), _mm_unpackhi_epi8(b8, zero) };
+		__m128i pixels[4] =
+		{
+			_mm_unpacklo_epi16(rg[0], b0[0]),
+			_mm_unpackhi_epi16(rg[0], b0[0]),
+			_mm_unpacklo_epi16(rg[1], b0[1]),
+			_mm_unpackhi_epi16(rg[1], b0[1]),
+		};
+
+		uint32* rowOutput = output + (y * 16);
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			//rgb < TH0 -> 0x00, rgb < TH1 -> 0x40, 0x80 otherwise
+			__m128i belowTh0 = _mm_cmplt_epi32(pixels[i], alphaTh0);
+			__m128i belowTh1 = _mm_cmplt_epi32(pixels[i], alphaTh1);
+			__m128i alpha = _mm_andnot_si128(belowTh0, _mm_sub_epi32(alphaOpaque, _mm_and_si128(belowTh1, alphaHalf)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(rowOutput + (i * 4)), _mm_or_si128(pixels[i], alpha));
+		}
+	}
+}
+
+static void ConvertRgb32ToRgb16(const uint32* input, uint16* output, bool dither)
+{
+	const __m128i mask5 = _mm_set1_epi32(0x1F);
+	const __m128i alphaHalf = _mm_set1_epi32(0x40);
+	const __m128i alphaBit = _mm_set1_epi32(0x8000);
+	const __m128i zero = _mm_setzero_si128();
+
+	__m128i ditherAdd[4];
+	__m128i ditherSub[4];
+	for(unsigned int y = 0; y < 4; y++)
+	{
+		uint32 addValues[4] = {};
+		uint32 subValues[4] = {};
+		if(dither)
+		{
+			for(unsigned int x = 0; x < 4; x++)
+			{
+				int8 value = g_ditherMatrix[y][x];
+				uint32 addValue = std::max<int>(value, 0);
+				uint32 subValue = std::max<int>(-value, 0);
+				addValues[x] = addValue | (addValue << 8) | (addValue << 16);
+				subValues[x] = subValue | (subValue << 8) | (subValue << 16);
+			}
+		}
+		ditherAdd[y] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(addValues));
+		ditherSub[y] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(subValues));
+	}
+
+	for(unsigned int y = 0; y < 16; y++)
+	{
+		const uint32* rowInput = input + (y * 16);
+		uint16* rowOutput = output + (y * 16);
+		__m128i result[4];
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rowInput + (i * 4)));
+			pixels = _mm_subs_epu8(_mm_adds_epu8(pixels, ditherAdd[y & 3]), ditherSub[y & 3]);
+
+			__m128i r = _mm_and_si128(_mm_srli_epi32(pixels, 3), mask5);
+			__m128i g = _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(pixels, 11), mask5), 5);
+			__m128i b = _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(pixels, 19), mask5), 10);
+			__m128i alpha = _mm_srli_epi32(pixels, 24);
+			__m128i a = _mm_and_si128(_mm_cmpeq_epi32(alpha, alphaHalf), alphaBit);
+			__m128i transparent = _mm_cmpeq_epi32(alpha, zero);
+
+			__m128i color = _mm_andnot_si128(transparent, _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, a)));
+			//Sign extend so that signed saturation doesn't alter values
+			result[i] = _mm_srai_epi32(_mm_slli_epi32(color, 16), 16);
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(rowOutput + 0), _mm_packs_epi32(result[0], result[1]));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(rowOutput + 8), _mm_packs_epi32(result[2], result[3]));
+	}
+}
+
+#elif defined(IPU_KERNELS_NEON)
+
+/////////////////////////////////////////////
+//NEON implementation
+/////////////////////////////////////////////
+
+static void Transpose8x8(int16x8_t* v)
+{
+	int16x8x2_t t0 = vtrnq_s16(v[0], v[1]);
+	int16x8x2_t t1 = vtrnq_s16(v[2], v[3]);
+	int16x8x2_t t2 = vtrnq_s16(v[4], v[5]);
+	int16x8x2_t t3 = vtrnq_s16(v[6], v[7]);
+
+	int32x4x2_t u0 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[0]), vreinterpretq_s32_s16(t1.val[0]));
+	int32x4x2_t u1 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[1]), vreinterpretq_s32_s16(t1.val[1]));
+	int32x4x2_t u2 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[0]), vreinterpretq_s32_s16(t3.val[0]));
+	int32x4x2_t u3 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[1]), vreinterpretq_s32_s16(t3.val[1]));
+
+	v[0] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u0.val[0]), vget_low_s32(u2.val[0])));
+	v[4] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u0.val[0]), vget_high_s32(u2.val[0])));
+	v[1] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u1.val[0]), vget_low_s32(u3.val[0])));
+	v[5] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u1.val[0]), vget_high_s32(u3.val[0])));
+	v[2] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u0.val[1]), vget_low_s32(u2.val[1])));
+	v[6] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u0.val[1]), vget_high_s32(u2.val[1])));
+	v[3] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u1.val[1]), vget_low_s32(u3.val[1])));
+	v[7] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u1.val[1]), vget_high_s32(u3.val[1])));
+}
+
+//1D IDCT on 8 columns at once, v[n] contains the nth coefficient of every column
+template <int SHIFT>
+static void Idct1D(int16x8_t* v)
+{
+	const int32x4_t bias = vdupq_n_s32(1 << (SHIFT - 1));
+
+	int32x4_t result[8][2];
+	for(unsigned int i = 0; i < 2; i++)
+	{
+		int16x4_t c[8];
+		for(unsigned int j = 0; j < 8; j++)
+		{
+			c[j] = (i == 0) ? vget_low_s16(v[j]) : vget_high_s16(v[j]);
+		}
+
+		int32x4_t even0 = vmlal_n_s16(vmlal_n_s16(bias, c[0], IDCT_W4), c[4], IDCT_W4);
+		int32x4_t even1 = vmlsl_n_s16(vmlal_n_s16(bias, c[0], IDCT_W4), c[4], IDCT_W4);
+
+		int32x4_t a0 = vmlal_n_s16(vmlal_n_s16(even0, c[2], IDCT_W2), c[6], IDCT_W6);
+		int32x4_t a1 = vmlsl_n_s16(vmlal_n_s16(even1, c[2], IDCT_W6), c[6], IDCT_W2);
+		int32x4_t a2 = vmlal_n_s16(vmlsl_n_s16(even1, c[2], IDCT_W6), c[6], IDCT_W2);
+		int32x4_t a3 = vmlsl_n_s16(vmlsl_n_s16(even0, c[2], IDCT_W2), c[6], IDCT_W6);
+
+		int32x4_t b0 = vmlal_n_s16(vmlal_n_s16(vmlal_n_s16(vmull_n_s16(c[1], IDCT_W1), c[3], IDCT_W3), c[5], IDCT_W5), c[7], IDCT_W7);
+		int32x4_t b1 = vmlsl_n_s16(vmlsl_n_s16(vmlsl_n_s16(vmull_n_s16(c[1], IDCT_W3), c[3], IDCT_W7), c[5], IDCT_W1), c[7], IDCT_W5);
+		int32x4_t b2 = vmlal_n_s16(vmlal_n_s16(vmlsl_n_s16(vmull_n_s16(c[1], IDCT_W5), c[3], IDCT_W1), c[5], IDCT_W7), c[7], IDCT_W3);
+		int32x4_t b3 = vmlsl_n_s16(vmlal_n_s16(vmlsl_n_s16(vmull_n_s16(c[1], IDCT_W7), c[3], IDCT_W5), c[5], IDCT_W3), c[7], IDCT_W1);
+
+		result[0][i] = vshrq_n_s32(vaddq_s32(a0, b0), SHIFT);
+		result[7][i] = vshrq_n_s32(vsubq_s32(a0, b0), SHIFT);
+		result[1][i] = vshrq_n_s32(vaddq_s32(a1, b1), SHIFT);
+		result[6][i] = vshrq_n_s32(vsubq_s32(a1, b1), SHIFT);
+		result[2][i] = vshrq_n_s32(vaddq_s32(a2, b2), SHIFT);
+		result[5][i] = vshrq_n_s32(vsubq_s32(a2, b2), SHIFT);
+		result[3][i] = vshrq_n_s32(vaddq_s32(a3, b3), SHIFT);
+		result[4][i] = vshrq_n_s32(vsubq_s32(a3, b3), SHIFT);
+	}
+
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		v[i] = vcombine_s16(vqmovn_s32(result[i][0]), vqmovn_s32(result[i][1]));
+	}
+}
+
+void IPU::FastIdct(const int16* input, int16* output)
+{
+	int16x8_t v[8];
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		v[i] = vld1q_s16(input + (i * 8));
+	}
+
+	//Rows
+	Transpose8x8(v);
+	Idct1D<IDCT_ROW_SHIFT>(v);
+	Transpose8x8(v);
+
+	//Columns
+	Idct1D<IDCT_COL_SHIFT>(v);
+
+	const int16x8_t outputMin = vdupq_n_s16(IDCT_OUTPUT_MIN);
+	const int16x8_t outputMax = vdupq_n_s16(IDCT_OUTPUT_MAX);
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		vst1q_s16(output + (i * 8), vminq_s16(vmaxq_s16(v[i], outputMin), outputMax));
+	}
+}
+
+void IPU::FastCscRgb32(const uint8* block, uint32* output, uint16 th0, uint16 th1)
+{
+	const int16x8_t chromaBias = vdupq_n_s16(128);
+	const uint8x16_t zero = vdupq_n_u8(0);
+	const uint32x4_t alphaTh0 = vdupq_n_u32(MakeAlphaThreshold(th0));
+	const uint32x4_t alphaTh1 = vdupq_n_u32(MakeAlphaThreshold(th1));
+	const uint32x4_t alphaOpaque = vdupq_n_u32(0x80000000);
+	const uint32x4_t alphaHalf = vdupq_n_u32(0x40000000);
+
+	const uint8* blockY = block;
+	const uint8* blockCb = block + 0x100;
+	const uint8* blockCr = block + 0x140;
+
+	for(unsigned int y = 0; y < 16; y++)
+	{
+		const uint8* rowY = blockY + (y * 16);
+		const uint8* rowCb = blockCb + ((y / 2) * 8);
+		const uint8* rowCr = blockCr + ((y / 2) * 8);
+
+		int16x8_t cb = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rowCb))), chromaBias);
+		int16x8_t cr = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rowCr))), chromaBias);
+
+		//Chroma contributions for the 16 pixels of the row (each chroma sample covers 2 pixels)
+		int32x4_t chromaR[4], chromaG[4], chromaB[4];
+		for(unsigned int i = 0; i < 2; i++)
+		{
+			int16x4_t cbHalf = (i == 0) ? vget_low_s16(cb) : vget_high_s16(cb);
+			int16x4_t crHalf = (i == 0) ? vget_low_s16(cr) : vget_high_s16(cr);
+			int32x4_t r = vmull_n_s16(crHalf, CSC_CR_R);
+			int32x4_t g = vmlal_n_s16(vmull_n_s16(cbHalf, CSC_CB_G), crHalf, CSC_CR_G);
+			int32x4_t b = vmull_n_s16(cbHalf, CSC_CB_B);
+			int32x4x2_t rPairs = vzipq_s32(r, r);
+			int32x4x2_t gPairs = vzipq_s32(g, g);
+			int32x4x2_t bPairs = vzipq_s32(b, b);
+			chromaR[(i * 2) + 0] = rPairs.val[0];
+			chromaR[(i * 2) + 1] = rPairs.val[1];
+			chromaG[(i * 2) + 0] = gPairs.val[0];
+			chromaG[(i * 2) + 1] = gPairs.val[1];
+			chromaB[(i * 2) + 0] = bPairs.val[0];
+			chromaB[(i * 2) + 1] = bPairs.val[1];
+		}
+
+		uint8x16_t lumaBytes = vld1q_u8(rowY);
+		int16x8_t luma16[2] =
+		{
+			vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(lumaBytes))),
+			vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(lumaBytes)))
+		};
+		int32x4_t luma[4] =
+		{
+			vshll_n_s16(vget_low_s16(luma16[0]), CSC_SHIFT),
+			vshll_n_s16(vget_high_s16(luma16[0]), CSC_SHIFT),
+			vshll_n_s16(vget_low_s16(luma16[1]), CSC_SHIFT),
+			vshll_n_s16(vget_high_s16(luma16[1]), CSC_SHIFT),
+		};
+
+		int16x8_t r16[2], g16[2], b16[2];
+		for(unsigned int i = 0; i < 2; i++)
+		{
+			unsigned int lo = (i * 2) + 0;
+			unsigned int hi = (i * 2) + 1;
+			r16[i] = vcombine_s16(
+				vqmovn_s32(vshrq_n_s32(vaddq_s32(luma[lo], chromaR[lo]), CSC_SHIFT)),
+				vqmovn_s32(vshrq_n_s32(vaddq_s32(luma[hi], chromaR[hi]), CSC_SHIFT)));
+			g16[i] = vcombine_s16(
+				vqmovn_s32(vshrq_n_s32(vaddq_s32(luma[lo], chromaG[lo]), CSC_SHIFT)),
+				vqmovn_s32(vshrq_n_s32(vaddq_s32(luma[hi], chromaG[hi]), CSC_SHIFT)));
+			b16[i] = vcombine_s16(
+				vqmovn_s32(vshrq_n_s32(vaddq_s32(luma[lo], chromaB[lo]), CSC_SHIFT)),
+				vqmovn_s32(vshrq_n_s32(vaddq_s32(luma[hi], chromaB[hi]), CSC_SHIFT)));
+		}
+
+		//Saturating narrows take care of clamping to [0, 255]
+		uint8x16_t r8 = vcombine_u8(vqmovun_s16(r16[0]), vqmovun_s16(r16[1]));
+		uint8x16_t g8 = vcombine_u8(vqmovun_s16(g16[0]), vqmovun_s16(g16[1]));
+		uint8x16_t b8 = vcombine_u8(vqmovun_s16(b16[0]), vqmovun_s16(b16[1]));
+
+		uint8x16x2_t rg = vzipq_u8(r8, g8);
+		uint8x16x2_t b0 = vzipq_u8(b8, zero);
+		uint16x8x2_t pixelsLo = vzipq_u16(vreinterpretq_u16_u8(rg.val[0]), vreinterpretq_u16_u8(b0.val[0]));
+		uint16x8x2_t pixelsHi = vzipq_u16(vreinterpretq_u16_u8(rg.val[1]), vreinterpretq_u16_u8(b0.val[1]));
+		uint32x4_t pixels[4] =
+		{
+			vreinterpretq_u32_u16(pixelsLo.val[0]),
+			vreinterpretq_u32_u16(pixelsLo.val[1]),
+			vreinterpretq_u32_u16(pixelsHi.val[0]),
+			vreinterpretq_u32_u16(pixelsHi.val[1]),
+		};
+
+		uint32* rowOutput = output + (y * 16);
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			//rgb < TH0 -> 0x00, rgb < TH1 -> 0x40, 0x80 otherwise
+			uint32x4_t belowTh0 = vcltq_u32(pixels[i], alphaTh0);
+			uint32x4_t belowTh1 = vcltq_u32(pixels[i], alphaTh1);
+			uint32x4_t alpha = vbicq_u32(vsubq_u32(alphaOpaque, vandq_u32(belowTh1, alphaHalf)), belowTh0);
+			vst1q_u32(rowOutput + (i * 4), vorrq_u32(pixels[i], alpha));
+		}
+	}
+}
+
+static void ConvertRgb32ToRgb16(const uint32* input, uint16* output, bool dither)
+{
+	const uint32x4_t mask5 = vdupq_n_u32(0x1F);
+	const uint32x4_t alphaHalf = vdupq_n_u32(0x40);
+	const uint32x4_t alphaBit = vdupq_n_u32(0x8000);
+	const uint32x4_t zero = vdupq_n_u32(0);
+
+	uint8x16_t ditherAdd[4];
+	uint8x16_t ditherSub[4];
+	for(unsigned int y = 0; y < 4; y++)
+	{
+		uint32 addValues[4] = {};
+		uint32 subValues[4] = {};
+		if(dither)
+		{
+			for(unsigned int x = 0; x < 4; x++)
+			{
+				int8 value = g_ditherMatrix[y][x];
+				uint32 addValue = std::max<int>(value, 0);
+				uint32 subValue = std::max<int>(-value, 0);
+				addValues[x] = addValue | (addValue << 8) | (addValue << 16);
+				subValues[x] = subValue | (subValue << 8) | (subValue << 16);
+			}
+		}
+		ditherAdd[y] = vreinterpretq_u8_u32(vld1q_u32(addValues));
+		ditherSub[y] = vreinterpretq_u8_u32(vld1q_u32(subValues));
+	}
+
+	for(unsigned int y = 0; y < 16; y++)
+	{
+		const uint32* rowInput = input + (y * 16);
+		uint16* rowOutput = output + (y * 16);
+		for(unsigned int i = 0; i < 4; i += 2)
+		{
+			uint16x4_t result[2];
+			for(unsigned int j = 0; j < 2; j++)
+			{
+				uint8x16_t pixelBytes = vreinterpretq_u8_u32(vld1q_u32(rowInput + ((i + j) * 4)));
+				pixelBytes = vqsubq_u8(vqaddq_u8(pixelBytes, ditherAdd[y & 3]), ditherSub[y & 3]);
+				uint32x4_t pixels = vreinterpretq_u32_u8(pixelBytes);
+
+				uint32x4_t r = vandq_u32(vshrq_n_u32(pixels, 3), mask5);
+				uint32x4_t g = vshlq_n_u32(vandq_u32(vshrq_n_u32(pixels, 11), mask5), 5);
+				uint32x4_t b = vshlq_n_u32(vandq_u32(vshrq_n_u32(pixels, 19), mask5), 10);
+				uint32x4_t alpha = vshrq_n_u32(pixels, 24);
+				uint32x4_t a = vandq_u32(vceqq_u32(alpha, alphaHalf), alphaBit);
+				uint32x4_t transparent = vceqq_u32(alpha, zero);
+
+				uint32x4_t color = vbicq_u32(vorrq_u32(vorrq_u32(r, g), vorrq_u32(b, a)), transparent);
+				result[j] = vmovn_u32(color);
+			}
+			vst1q_u16(rowOutput + (i * 4), vcombine_u16(result[0], result[1]));
+		}
+	}
+}
+
+#else
+
+/////////////////////////////////////////////
+//Generic implementation
+/////////////////////////////////////////////
+
+static int16 SaturateInt16(int32 value)
+{
+	return static_cast<int16>(std::min<int32>(std::max<int32>(value, INT16_MIN), INT16_MAX));
+}
+
+template <int SHIFT>
+static void Idct1D(const int16* input, int16* output, unsigned int inputStride, unsigned int outputStride)
+{
+	const int32 bias = 1 << (SHIFT - 1);
+	int32 c[8];
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		c[i] = input[i * inputStride];
+	}
+
+	int32 even0 = (IDCT_W4 * c[0]) + (IDCT_W4 * c[4]) + bias;
+	int32 even1 = (IDCT_W4 * c[0]) - (IDCT_W4 * c[4]) + bias;
+
+	int32 a0 = even0 + (IDCT_W2 * c[2]) + (IDCT_W6 * c[6]);
+	int32 a1 = even1 + (IDCT_W6 * c[2]) - (IDCT_W2 * c[6]);
+	int32 a2 = even1 - (IDCT_W6 * c[2]) + (IDCT_W2 * c[6]);
+	int32 a3 = even0 - (IDCT_W2 * c[2]) - (IDCT_W6 * c[6]);
+
+	int32 b0 = (IDCT_W1 * c[1]) + (IDCT_W3 * c[3]) + (IDCT_W5 * c[5]) + (IDCT_W7 * c[7]);
+	int32 b1 = (IDCT_W3 * c[1]) - (IDCT_W7 * c[3]) - (IDCT_W1 * c[5]) - (IDCT_W5 * c[7]);
+	int32 b2 = (IDCT_W5 * c[1]) - (IDCT_W1 * c[3]) + (IDCT_W7 * c[5]) + (IDCT_W3 * c[7]);
+	int32 b3 = (IDCT_W7 * c[1]) - (IDCT_W5 * c[3]) + (IDCT_W3 * c[5]) - (IDCT_W1 * c[7]);
+
+	output[0 * outputStride] = SaturateInt16((a0 + b0) >> SHIFT);
+	output[7 * outputStride] = SaturateInt16((a0 - b0) >> SHIFT);
+	output[1 * outputStride] = SaturateInt16((a1 + b1) >> SHIFT);
+	output[6 * outputStride] = SaturateInt16((a1 - b1) >> SHIFT);
+	output[2 * outputStride] = SaturateInt16((a2 + b2) >> SHIFT);
+	output[5 * outputStride] = SaturateInt16((a2 - b2) >> SHIFT);
+	output[3 * outputStride] = SaturateInt16((a3 + b3) >> SHIFT);
+	output[4 * outputStride] = SaturateInt16((a3 - b3) >> SHIFT);
+}
+
+void IPU::FastIdct(const int16* input, int16* output)
+{
+	int16 temp[64];
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		Idct1D<IDCT_ROW_SHIFT>(input + (i * 8), temp + (i * 8), 1, 1);
+	}
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		Idct1D<IDCT_COL_SHIFT>(temp + i, output + i, 8, 8);
+	}
+	for(unsigned int i = 0; i < 64; i++)
+	{
+		output[i] = std::min<int16>(std::max<int16>(output[i], IDCT_OUTPUT_MIN), IDCT_OUTPUT_MAX);
+	}
+}
+
+void IPU::FastCscRgb32(const uint8* block, uint32* output, uint16 th0, uint16 th1)
+{
+	uint32 alphaTh0 = MakeAlphaThreshold(th0);
+	uint32 alphaTh1 = MakeAlphaThreshold(th1);
+
+	const uint8* blockY = block;
+	const uint8* blockCb = block + 0x100;
+	const uint8* blockCr = block + 0x140;
+
+	for(unsigned int y = 0; y < 16; y++)
+	{
+		for(unsigned int x = 0; x < 16; x++)
+		{
+			int32 luma = blockY[(y * 16) + x] << CSC_SHIFT;
+			int32 cb = blockCb[((y / 2) * 8) + (x / 2)] - 128;
+			int32 cr = blockCr[((y / 2) * 8) + (x / 2)] - 128;
+
+			int32 r = (luma + (CSC_CR_R * cr)) >> CSC_SHIFT;
+			int32 g = (luma + (CSC_CB_G * cb) + (CSC_CR_G * cr)) >> CSC_SHIFT;
+			int32 b = (luma + (CSC_CB_B * cb)) >> CSC_SHIFT;
+
+			r = std::min<int32>(std::max<int32>(r, 0), 255);
+			g = std::min<int32>(std::max<int32>(g, 0), 255);
+			b = std::min<int32>(std::max<int32>(b, 0), 255);
+
+			uint32 rgb = (b << 16) | (g << 8) | (r << 0);
+			uint32 a = (rgb < alphaTh0) ? 0 : ((rgb < alphaTh1) ? 0x40 : 0x80);
+			output[(y * 16) + x] = (a << 24) | rgb;
+		}
+	}
+}
+
+static void ConvertRgb32ToRgb16(const uint32* input, uint16* output, bool dither)
+{
+	for(unsigned int y = 0; y < 16; y++)
+	{
+		for(unsigned int x = 0; x < 16; x++)
+		{
+			uint32 pixel = input[(y * 16) + x];
+			uint32 a = (pixel >> 24);
+			if(a == 0)
+			{
+				output[(y * 16) + x] = 0;
+				continue;
+			}
+			int32 ditherValue = dither ? g_ditherMatrix[y & 3][x & 3] : 0;
+			int32 r = std::min<int32>(std::max<int32>(static_cast<int32>((pixel >>  0) & 0xFF) + ditherValue, 0), 255);
+			int32 g = std::min<int32>(std::max<int32>(static_cast<int32>((pixel >>  8) & 0xFF) + ditherValue, 0), 255);
+			int32 b = std::min<int32>(std::max<int32>(static_cast<int32>((pixel >> 16) & 0xFF) + ditherValue, 0), 255);
+			output[(y * 16) + x] = static_cast<uint16>(((a == 0x40) ? 0x8000 : 0) | ((b >> 3) << 10) | ((g >> 3) << 5) | (r >> 3));
+		}
+	}
+}
+
+#endif
+
+void IPU::FastCscRgb16(const uint8* block, uint16* output, uint16 th0, uint16 th1, bool dither)
+{
+	uint32 pixels[0x100];
+	FastCscRgb32(block, pixels, th0, th1);
+	ConvertRgb32ToRgb16(pixels, output, dither);
+}
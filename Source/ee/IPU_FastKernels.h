@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Types.h"
+
+namespace IPU
+{
+	//Fixed-point 8x8 inverse DCT (row/column decomposition using 14-bits coefficients).
+	//Meets the IEEE-1180 accuracy requirements. Output is clamped to [-256, 255].
+	void		FastIdct(const int16*, int16*);
+
+	//Color space conversion of a whole 16x16 macroblock. Input is 256 Y samples followed
+	//by 64 Cb and 64 Cr samples, as received by the CSC command.
+	void		FastCscRgb32(const uint8*, uint32*, uint16, uint16);
+	void		FastCscRgb16(const uint8*, uint16*, uint16, uint16, bool);
+}
@@ -58,15 +58,15 @@ unsigned int CMacroblockAddressIncrementTable::m_pIndexTable[MAXBITS] =
 	21,
 };
 
-CVLCTable* CMacroblockAddressIncrementTable::m_pInstance = NULL;
+CVLCLookupTable* CMacroblockAddressIncrementTable::m_pInstance = NULL;
 
 CMacroblockAddressIncrementTable::CMacroblockAddressIncrementTable() :
-CVLCTable(MAXBITS, m_pTable, ENTRYCOUNT, m_pIndexTable)
+CVLCLookupTable(MAXBITS, m_pTable, ENTRYCOUNT, m_pIndexTable)
 {
 
 }
 
-CVLCTable* CMacroblockAddressIncrementTable::GetInstance()
+CVLCLookupTable* CMacroblockAddressIncrementTable::GetInstance()
 {
 	if(m_pInstance == NULL)
 	{
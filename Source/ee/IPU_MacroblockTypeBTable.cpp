@@ -29,15 +29,15 @@ unsigned int CMacroblockTypeBTable::m_pIndexTable[MAXBITS] =
 	8,
 };
 
-CVLCTable* CMacroblockTypeBTable::m_pInstance = NULL;
+CVLCLookupTable* CMacroblockTypeBTable::m_pInstance = NULL;
 
 CMacroblockTypeBTable::CMacroblockTypeBTable() :
-CVLCTable(MAXBITS, m_pTable, ENTRYCOUNT, m_pIndexTable)
+CVLCLookupTable(MAXBITS, m_pTable, ENTRYCOUNT, m_pIndexTable)
 {
 
 }
 
-CVLCTable* CMacroblockTypeBTable::GetInstance()
+CVLCLookupTable* CMacroblockTypeBTable::GetInstance()
 {
 	if(m_pInstance == NULL)
 	{
@@ -16,15 +16,15 @@ unsigned int CMacroblockTypeITable::m_pIndexTable[MAXBITS] =
 	1,
 };
 
-CVLCTable* CMacroblockTypeITable::m_pInstance = NULL;
+CVLCLookupTable* CMacroblockTypeITable::m_pInstance = NULL;
 
 CMacroblockTypeITable::CMacroblockTypeITable() :
-CVLCTable(MAXBITS, m_pTable, ENTRYCOUNT, m_pIndexTable)
+CVLCLookupTable(MAXBITS, m_pTable, ENTRYCOUNT, m_pIndexTable)
 {
 
 }
 
-CVLCTable* CMacroblockTypeITable::GetInstance()
+CVLCLookupTable* CMacroblockTypeITable::GetInstance()
 {
 	if(m_pInstance == NULL)
 	{
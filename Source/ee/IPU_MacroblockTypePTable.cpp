@@ -25,15 +25,15 @@ unsigned int CMacroblockTypePTable::m_pIndexTable[MAXBITS] =
 	6,
 };
 
-CVLCTable* CMacroblockTypePTable::m_pInstance = NULL;
+CVLCLookupTable* CMacroblockTypePTable::m_pInstance = NULL;
 
 CMacroblockTypePTable::CMacroblockTypePTable() :
-CVLCTable(MAXBITS, m_pTable, ENTRYCOUNT, m_pIndexTable)
+CVLCLookupTable(MAXBITS, m_pTable, ENTRYCOUNT, m_pIndexTable)
 {
 
 }
 
-CVLCTable* CMacroblockTypePTable::GetInstance()
+CVLCLookupTable* CMacroblockTypePTable::GetInstance()
 {
 	if(m_pInstance == NULL)
 	{
@@ -1,16 +1,16 @@
 #ifndef _IPU_MACROBLOCKTYPEPTABLE_H_
 #define _IPU_MACROBLOCKTYPEPTABLE_H_
 
-#include "mpeg2/VLCTable.h"
+#include "IPU_VLCLookupTable.h"
 
 namespace IPU
 {
 
-	class CMacroblockTypePTable : public MPEG2::CVLCTable
+	class CMacroblockTypePTable : public CVLCLookupTable
 	{
 	public:
 									CMacroblockTypePTable();
-		static MPEG2::CVLCTable*	GetInstance();
+		static CVLCLookupTable*	GetInstance();
 
 		enum MAXBITS
 		{
@@ -25,7 +25,7 @@ namespace IPU
 	private:
 		static MPEG2::VLCTABLEENTRY	m_pTable[ENTRYCOUNT];
 		static unsigned int			m_pIndexTable[MAXBITS];
-		static MPEG2::CVLCTable*	m_pInstance;
+		static CVLCLookupTable*	m_pInstance;
 	};
 
 }
@@ -56,15 +56,15 @@ unsigned int CMotionCodeTable::m_pIndexTable[MAXBITS] =
 	21,
 };
 
-CVLCTable* CMotionCodeTable::m_pInstance = NULL;
+CVLCLookupTable* CMotionCodeTable::m_pInstance = NULL;
 
 CMotionCodeTable::CMotionCodeTable() :
-CVLCTable(MAXBITS, m_pTable, ENTRYCOUNT, m_pIndexTable)
+CVLCLookupTable(MAXBITS, m_pTable, ENTRYCOUNT, m_pIndexTable)
 {
 
 }
 
-CVLCTable* CMotionCodeTable::GetInstance()
+CVLCLookupTable* CMotionCodeTable::GetInstance()
 {
 	if(m_pInstance == NULL)
 	{
@@ -1,15 +1,15 @@
 #ifndef _IPU_MOTIONCODETABLE_H_
 #define _IPU_MOTIONCODETABLE_H_
 
-#include "mpeg2/VLCTable.h"
+#include "IPU_VLCLookupTable.h"
 
 namespace IPU
 {
-	class CMotionCodeTable : public MPEG2::CVLCTable
+	class CMotionCodeTable : public CVLCLookupTable
 	{
 	public:
 										CMotionCodeTable();
-		static CVLCTable*				GetInstance();
+		static CVLCLookupTable*		GetInstance();
 
 		enum MAXBITS
 		{
@@ -24,7 +24,7 @@ namespace IPU
 	private:
 		static MPEG2::VLCTABLEENTRY		m_pTable[ENTRYCOUNT];
 		static unsigned int				m_pIndexTable[MAXBITS];
-		static MPEG2::CVLCTable*		m_pInstance;
+		static CVLCLookupTable*		m_pInstance;
 	};
 };
 
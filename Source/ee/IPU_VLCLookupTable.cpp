@@ -0,0 +1,72 @@
+#include <assert.h>
+#include "IPU_VLCLookupTable.h"
+
+using namespace IPU;
+using namespace MPEG2;
+
+CVLCLookupTable::CVLCLookupTable(unsigned int maxBits, VLCTABLEENTRY* entries, unsigned int entryCount, unsigned int* indexTable)
+: CVLCTable(maxBits, entries, entryCount, indexTable)
+, m_entries(entries)
+, m_lookupBits(maxBits)
+{
+	assert(entryCount < INVALID_ENTRY);
+	assert(maxBits <= 16);
+
+	m_lookup.resize(1 << maxBits, INVALID_ENTRY);
+	for(unsigned int i = 0; i < entryCount; i++)
+	{
+		const auto& entry = entries[i];
+		assert(entry.nCodeLength <= maxBits);
+		unsigned int unusedBits = maxBits - entry.nCodeLength;
+		unsigned int first = entry.nCode << unusedBits;
+		unsigned int last = (entry.nCode + 1) << unusedBits;
+		for(unsigned int code = first; code < last; code++)
+		{
+			assert(m_lookup[code] == INVALID_ENTRY);
+			m_lookup[code] = static_cast<uint8>(i);
+		}
+	}
+}
+
+CVLCLookupTable::~CVLCLookupTable()
+{
+
+}
+
+CVLCTable::DECODE_STATUS CVLCLookupTable::TryGetSymbol(Framework::CBitStream* stream, uint32& result)
+{
+	auto entry = TryLookupEntry(stream);
+	if(entry == nullptr)
+	{
+		return CVLCTable::TryGetSymbol(stream, result);
+	}
+	stream->Advance(static_cast<uint8>(entry->nCodeLength));
+	result = entry->nValue;
+	return DECODE_STATUS_SUCCESS;
+}
+
+uint32 CVLCLookupTable::GetSymbol(Framework::CBitStream* stream)
+{
+	auto entry = TryLookupEntry(stream);
+	if(entry == nullptr)
+	{
+		return CVLCTable::GetSymbol(stream);
+	}
+	stream->Advance(static_cast<uint8>(entry->nCodeLength));
+	return entry->nValue;
+}
+
+const VLCTABLEENTRY* CVLCLookupTable::TryLookupEntry(Framework::CBitStream* stream) const
+{
+	uint32 code = 0;
+	if(!stream->TryPeekBits_MSBF(static_cast<uint8>(m_lookupBits), code))
+	{
+		return nullptr;
+	}
+	uint8 index = m_lookup[code];
+	if(index == INVALID_ENTRY)
+	{
+		return nullptr;
+	}
+	return m_entries + index;
+}
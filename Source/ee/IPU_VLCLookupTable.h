@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+#include "mpeg2/VLCTable.h"
+
+namespace IPU
+{
+	//VLC table that decodes a symbol with a single lookup into a table indexed by the
+	//next MAXBITS bits of the stream. Falls back on the generic bit-by-bit decoder when
+	//the stream doesn't hold enough bits for a full lookup or the code is invalid, to
+	//keep the exact same error behavior.
+	class CVLCLookupTable : public MPEG2::CVLCTable
+	{
+	public:
+							CVLCLookupTable(unsigned int, MPEG2::VLCTABLEENTRY*, unsigned int, unsigned int*);
+		virtual				~CVLCLookupTable();
+
+		DECODE_STATUS		TryGetSymbol(Framework::CBitStream*, uint32&) override;
+		uint32				GetSymbol(Framework::CBitStream*) override;
+
+	private:
+		enum
+		{
+			INVALID_ENTRY = 0xFF,
+		};
+
+		const MPEG2::VLCTABLEENTRY*	TryLookupEntry(Framework::CBitStream*) const;
+
+		const MPEG2::VLCTABLEENTRY*	m_entries = nullptr;
+		unsigned int				m_lookupBits = 0;
+		std::vector<uint8>			m_lookup;
+	};
+}
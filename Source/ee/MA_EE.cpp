@@ -112,6 +112,18 @@ void CMA_EE::LQ()
 {
 	if(m_nRT == 0) return;
 
+	bool fastMemory = IsFastMemoryEnabled();
+	if(fastMemory)
+	{
+		BeginFastMemoryAccess();
+		{
+			PushFastMemoryRef(~0x0F);
+			m_codeGen->MD_LoadFromRef();
+			m_codeGen->MD_PullRel(offsetof(CMIPS, m_State.nGPR[m_nRT]));
+		}
+		m_codeGen->Else();
+	}
+
 	ComputeMemAccessAddr();
 
 	m_codeGen->PushCtx();
@@ -120,11 +132,28 @@ void CMA_EE::LQ()
 	m_codeGen->MD_PullRel(offsetof(CMIPS, m_State.nGPR[m_nRT]));
 
 	m_codeGen->PullTop();
+
+	if(fastMemory)
+	{
+		m_codeGen->EndIf();
+	}
 }
 
 //1F
 void CMA_EE::SQ()
 {
+	bool fastMemory = IsFastMemoryEnabled();
+	if(fastMemory)
+	{
+		BeginFastMemoryAccess();
+		{
+			PushFastMemoryRef(~0x0F);
+			m_codeGen->MD_PushRel(offsetof(CMIPS, m_State.nGPR[m_nRT]));
+			m_codeGen->MD_StoreAtRef();
+		}
+		m_codeGen->Else();
+	}
+
 	ComputeMemAccessAddr();
 
 	m_codeGen->PushCtx();
@@ -133,6 +162,11 @@ void CMA_EE::SQ()
 	m_codeGen->Call(reinterpret_cast<void*>(&MemoryUtils_SetQuadProxy), 3, Jitter::CJitter::RETURN_VALUE_NONE);
 
 	m_codeGen->PullTop();
+
+	if(fastMemory)
+	{
+		m_codeGen->EndIf();
+	}
 }
 
 //////////////////////////////////////////////////
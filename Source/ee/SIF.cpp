@@ -136,6 +136,11 @@ uint32 CSIF::ReceiveDMA6(uint32 nSrcAddr, uint32 nSize, uint32 nDstAddr, bool is
 	//Humm, this is kinda odd, but it ors the address with 0x20000000
 	nSrcAddr &= (PS2::EE_RAM_SIZE - 1);
 
+	if(m_transferHandler)
+	{
+		m_transferHandler();
+	}
+
 	if(nDstAddr == RPC_RECVADDR)
 	{
 		//This should be the arguments for the call command
@@ -577,6 +582,11 @@ void CSIF::SetCustomCommandHandler(const CustomCommandHandler& customCommandHand
 	m_customCommandHandler = customCommandHandler;
 }
 
+void CSIF::SetTransferHandler(const TransferHandler& transferHandler)
+{
+	m_transferHandler = transferHandler;
+}
+
 /////////////////////////////////////////////////////////
 //Get/Set Register
 /////////////////////////////////////////////////////////
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <algorithm>
 #include "../Log.h"
 #include "../RegisterStateFile.h"
 #include "Timer.h"
@@ -34,22 +35,7 @@ void CTimer::Count(unsigned int ticks)
 		uint32 previousCount	= timer->nCOUNT;
 		uint32 nextCount		= timer->nCOUNT;
 
-		uint32 divider = 1;
-		switch(timer->nMODE & 0x03)
-		{
-		case 0x00:
-			divider = 1;
-			break;
-		case 0x01:
-			divider = 16;
-			break;
-		case 0x02:
-			divider = 256;
-			break;
-		case 0x03:
-			divider = 9437;		// PAL
-			break;
-		}
+		uint32 divider = GetDivider(timer->nMODE);
 
 		//Compute increment
 		uint32 totalTicks = timer->clockRemain + ticks;
@@ -94,6 +80,49 @@ void CTimer::Count(unsigned int ticks)
 	}
 }
 
+//Used by the scheduler, timers are still only updated by Count
+uint32 CTimer::GetTicksUntilNextInterrupt() const
+{
+	uint32 result = ~0U;
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		const TIMER& timer = m_timer[i];
+
+		if(!(timer.nMODE & MODE_COUNT_ENABLE)) continue;
+		uint32 interruptMask = timer.nMODE & 0x300;
+		if(interruptMask == 0) continue;
+
+		//Counter is checked again after it overflows if the compare value was already passed
+		uint32 target = 0xFFFF;
+		uint32 compare = (timer.nCOMP == 0) ? 0x10000 : timer.nCOMP;
+		if((interruptMask & 0x100) && (timer.nCOUNT < compare))
+		{
+			target = std::min<uint32>(target, compare);
+		}
+		if(timer.nCOUNT >= target) return 0;
+
+		uint64 ticks = (static_cast<uint64>(target - timer.nCOUNT) * GetDivider(timer.nMODE)) - timer.clockRemain;
+		result = static_cast<uint32>(std::min<uint64>(result, ticks));
+	}
+	return result;
+}
+
+uint32 CTimer::GetDivider(uint32 mode)
+{
+	switch(mode & 0x03)
+	{
+	case 0x00:
+	default:
+		return 1;
+	case 0x01:
+		return 16;
+	case 0x02:
+		return 256;
+	case 0x03:
+		return 9437;		// PAL
+	}
+}
+
 uint32 CTimer::GetRegister(uint32 nAddress)
 {
 	DisassembleGet(nAddress);
@@ -23,6 +23,7 @@ public:
 	void					Reset();
 
 	void					Count(unsigned int);
+	uint32					GetTicksUntilNextInterrupt() const;
 
 	uint32					GetRegister(uint32);
 	void					SetRegister(uint32, uint32);
@@ -44,6 +45,8 @@ private:
 		uint32	clockRemain;
 	};
 
+	static uint32			GetDivider(uint32);
+
 	TIMER					m_timer[4];
 	CINTC&					m_intc;
 };
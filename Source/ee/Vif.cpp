@@ -7,6 +7,7 @@
 #include "../MemoryStateFile.h"
 #include "Vpu.h"
 #include "Vif.h"
+#include "VifUnpack.h"
 
 #define LOG_NAME ("vif")
 
@@ -248,6 +249,31 @@ uint32 CVif::ReceiveDMA(uint32 address, uint32 qwc, uint32 unused, bool tagInclu
 	return qwc - remainingSize;
 }
 
+//Same as ReceiveDMA, but with data that was already copied out of EE memory
+uint32 CVif::ReceiveBuffer(uint8* buffer, uint32 qwc, bool tagIncluded)
+{
+	if(m_STAT.nVEW && m_vpu.IsVuRunning())
+	{
+		return 0;
+	}
+
+	if(m_STAT.nVIS && !m_STAT.nVPS)
+	{
+		//Stalled until the EE acknowledges the interrupt, leave the data where it is
+		return 0;
+	}
+
+	m_stream.SetBufferParams(buffer, qwc * 0x10, tagIncluded);
+
+	ProcessPacket(m_stream);
+
+	uint32 remainingSize = m_stream.GetRemainingDmaTransferSize();
+	assert((remainingSize & 0x0F) == 0);
+	remainingSize /= 0x10;
+
+	return qwc - remainingSize;
+}
+
 bool CVif::IsWaitingForProgramEnd() const
 {
 	return (m_STAT.nVEW != 0);
@@ -602,81 +628,113 @@ void CVif::Cmd_UNPACK(StreamType& stream, CODE nCommand, uint32 nDstAddr)
 	}
 
 	nDstAddr *= 0x10;
+	nDstAddr &= (vuMemSize - 1);
+
+	uint32 elementSize = CVifUnpack::GetElementSize(nCommand.nCMD);
+	auto expandFunction = CVifUnpack::GetExpandFunction(nCommand.nCMD, usn);
+	auto writeFunction = CVifUnpack::GetWriteFunction(useMask, m_MODE);
+
+	CVifUnpack::WRITEPARAMS writeParams;
+	writeParams.row = m_R;
+	writeParams.cycleLength = wl;
+	if(useMask)
+	{
+		CVifUnpack::PrepareWriteParams(writeParams, m_MASK, m_C);
+	}
+
+	uint128 values[CVifUnpack::MAX_RUN_SIZE];
 
 	while(currentNum != 0)
 	{
+		//Find how many vectors can be handled in one go
+		bool mustRead = false;
 		bool mustWrite = false;
-		uint128 writeValue;
-		memset(&writeValue, 0, sizeof(writeValue));
+		uint32 count = 0;
 
 		if(cl >= wl)
 		{
-			if(m_readTick < wl || wl == 0)
+			if(m_readTick < wl)
 			{
-				bool success = Unpack_ReadValue(nCommand, stream, writeValue, usn);
-				if(!success) break;
+				mustRead = true;
 				mustWrite = true;
+				//Writes are contiguous across cycles when CL and WL are equal
+				count = (cl == wl) ? currentNum : (wl - m_readTick);
+			}
+			else
+			{
+				//Skipping
+				count = cl - m_readTick;
 			}
 		}
 		else
 		{
+			mustWrite = true;
 			if(m_writeTick < cl)
 			{
-				bool success = Unpack_ReadValue(nCommand, stream, writeValue, usn);
-				if(!success) break;
+				mustRead = true;
+				count = cl - m_writeTick;
+			}
+			else
+			{
+				//Filling
+				count = wl - m_writeTick;
 			}
-
-			mustWrite = true;
 		}
 
 		if(mustWrite)
 		{
-			auto dst = reinterpret_cast<uint128*>(vuMem + nDstAddr);
+			//Destination wraps around at the end of VU memory
+			count = std::min<uint32>(count, currentNum);
+			count = std::min<uint32>(count, CVifUnpack::MAX_RUN_SIZE);
+			count = std::min<uint32>(count, (vuMemSize - nDstAddr) / 0x10);
+		}
+
+		if(mustRead)
+		{
+			if(expandFunction == nullptr)
+			{
+				assert(0);
+				break;
+			}
 
-			for(unsigned int i = 0; i < 4; i++)
+			uint32 directReadSize = stream.GetDirectReadSize();
+			if(directReadSize >= elementSize)
 			{
-				uint32 maskOp = useMask ? GetMaskOp(i, m_writeTick) : MASK_DATA;
-
-				if(maskOp == MASK_DATA)
-				{
-					if(m_MODE == MODE_OFFSET)
-					{
-						writeValue.nV[i] += m_R[i];
-					}
-					else if(m_MODE == MODE_DIFFERENCE)
-					{
-						writeValue.nV[i] += m_R[i];
-						m_R[i] = writeValue.nV[i];
-					}
-
-					dst->nV[i] = writeValue.nV[i];
-				}
-				else if(maskOp == MASK_ROW)
-				{
-					dst->nV[i] = m_R[i];
-				}
-				else if(maskOp == MASK_COL)
-				{
-					int index = (m_writeTick > 3) ? 3 : m_writeTick;
-					dst->nV[i] = m_C[index];
-				}
-				else if(maskOp == MASK_MASK)
-				{
-					//Don't write anything
-				}
-				else
-				{
-					assert(0);
-				}
+				count = std::min<uint32>(count, directReadSize / elementSize);
+				expandFunction(stream.GetDirectReadPointer(), values, count);
+				stream.AdvanceDirectRead(count * elementSize);
 			}
-			
-			currentNum--;
+			else
+			{
+				//Element is split between leftover data and the current packet
+				if(stream.GetAvailableReadBytes() < elementSize) break;
+				uint8 element[0x10];
+				stream.Read(element, elementSize);
+				expandFunction(element, values, 1);
+				count = 1;
+			}
+		}
+		else if(mustWrite)
+		{
+			memset(values, 0, sizeof(uint128) * count);
 		}
 
-		if(cl >= wl)
+		if(mustWrite)
+		{
+			writeParams.writeTick = m_writeTick;
+			writeFunction(values, reinterpret_cast<uint128*>(vuMem + nDstAddr), count, writeParams);
+			currentNum -= count;
+		}
+
+		if(cl == wl)
+		{
+			m_writeTick = (m_writeTick + count) % wl;
+			m_readTick = m_writeTick;
+		}
+		else if(cl > wl)
 		{
-			m_writeTick = std::min<uint32>(m_writeTick + 1, wl);
-			m_readTick = std::min<uint32>(m_readTick + 1, cl);
+			m_writeTick = std::min<uint32>(m_writeTick + count, wl);
+			m_readTick = std::min<uint32>(m_readTick + count, cl);
 
 			if(m_readTick == cl)
 			{
@@ -686,8 +744,8 @@ void CVif::Cmd_UNPACK(StreamType& stream, CODE nCommand, uint32 nDstAddr)
 		}
 		else
 		{
-			m_writeTick = std::min<uint32>(m_writeTick + 1, wl);
-			m_readTick = std::min<uint32>(m_readTick + 1, cl);
+			m_writeTick = std::min<uint32>(m_writeTick + count, wl);
+			m_readTick = std::min<uint32>(m_readTick + count, cl);
 
 			if(m_writeTick == wl)
 			{
@@ -696,7 +754,7 @@ void CVif::Cmd_UNPACK(StreamType& stream, CODE nCommand, uint32 nDstAddr)
 			}
 		}
 
-		nDstAddr += 0x10;
+		nDstAddr += count * 0x10;
 		nDstAddr &= (vuMemSize - 1);
 	}
 
@@ -713,193 +771,6 @@ void CVif::Cmd_UNPACK(StreamType& stream, CODE nCommand, uint32 nDstAddr)
 	m_NUM = static_cast<uint8>(currentNum);
 }
 
-bool CVif::Unpack_ReadValue(const CODE& nCommand, StreamType& stream, uint128& writeValue, bool usn)
-{
-	bool success = false;
-	switch(nCommand.nCMD & 0x0F)
-	{
-	case 0x00:
-		//S-32
-		success = Unpack_S32(stream, writeValue);
-		break;
-	case 0x01:
-		//S-16
-		success = Unpack_S16(stream, writeValue, usn);
-		break;
-	case 0x02:
-		//S-8
-		success = Unpack_S8(stream, writeValue, usn);
-		break;
-	case 0x04:
-		//V2-32
-		success = Unpack_V32(stream, writeValue, 2);
-		break;
-	case 0x05:
-		//V2-16
-		success = Unpack_V16(stream, writeValue, 2, usn);
-		break;
-	case 0x06:
-		//V2-8
-		success = Unpack_V8(stream, writeValue, 2, usn);
-		break;
-	case 0x08:
-		//V3-32
-		success = Unpack_V32(stream, writeValue, 3);
-		break;
-	case 0x09:
-		//V3-16
-		success = Unpack_V16(stream, writeValue, 3, usn);
-		break;
-	case 0x0A:
-		//V3-8
-		success = Unpack_V8(stream, writeValue, 3, usn);
-		break;
-	case 0x0C:
-		//V4-32
-		success = Unpack_V32(stream, writeValue, 4);
-		break;
-	case 0x0D:
-		//V4-16
-		success = Unpack_V16(stream, writeValue, 4, usn);
-		break;
-	case 0x0E:
-		//V4-8
-		success = Unpack_V8(stream, writeValue, 4, usn);
-		break;
-	case 0x0F:
-		//V4-5
-		success = Unpack_V45(stream, writeValue);
-		break;
-	default:
-		assert(0);
-		break;
-	}
-	return success;
-}
-
-bool CVif::Unpack_S32(StreamType& stream, uint128& result)
-{
-	if(stream.GetAvailableReadBytes() < 4) return false;
-
-	uint32 word = 0;
-	stream.Read(&word, 4);
-
-	for(unsigned int i = 0; i < 4; i++)
-	{
-		result.nV[i] = word;
-	}
-
-	return true;
-}
-
-bool CVif::Unpack_S16(StreamType& stream, uint128& result, bool zeroExtend)
-{
-	if(stream.GetAvailableReadBytes() < 2) return false;
-
-	uint32 temp = 0;
-	stream.Read(&temp, 2);
-	if(!zeroExtend)
-	{
-		temp = static_cast<int16>(temp);
-	}
-
-	for(unsigned int i = 0; i < 4; i++)
-	{
-		result.nV[i] = temp;
-	}
-
-	return true;
-}
-
-bool CVif::Unpack_S8(StreamType& stream, uint128& result, bool zeroExtend)
-{
-	if(stream.GetAvailableReadBytes() < 1) return false;
-
-	uint32 temp = 0;
-	stream.Read(&temp, 1);
-	if(!zeroExtend)
-	{
-		temp = static_cast<int8>(temp);
-	}
-
-	for(unsigned int i = 0; i < 4; i++)
-	{
-		result.nV[i] = temp;
-	}
-
-	return true;
-}
-
-bool CVif::Unpack_V8(StreamType& stream, uint128& result, unsigned int fields, bool zeroExtend)
-{
-	if(stream.GetAvailableReadBytes() < (fields)) return false;
-
-	for(unsigned int i = 0; i < fields; i++)
-	{
-		uint32 temp = 0;
-		stream.Read(&temp, 1);
-		if(!zeroExtend)
-		{
-			temp = static_cast<int8>(temp);
-		}
-
-		result.nV[i] = temp;
-	}
-
-	return true;
-}
-
-bool CVif::Unpack_V16(StreamType& stream, uint128& result, unsigned int fields, bool zeroExtend)
-{
-	if(stream.GetAvailableReadBytes() < (fields * 2)) return false;
-
-	for(unsigned int i = 0; i < fields; i++)
-	{
-		uint32 temp = 0;
-		stream.Read(&temp, 2);
-		if(!zeroExtend)
-		{
-			temp = static_cast<int16>(temp);
-		}
-
-		result.nV[i] = temp;
-	}
-
-	return true;
-}
-
-bool CVif::Unpack_V32(StreamType& stream, uint128& result, unsigned int fields)
-{
-	if(stream.GetAvailableReadBytes() < (fields * 4)) return false;
-
-	stream.Read(&result, (fields * 4));
-
-	return true;
-}
-
-bool CVif::Unpack_V45(StreamType& stream, uint128& result)
-{
-	if(stream.GetAvailableReadBytes() < 2) return false;
-
-	uint16 nColor = 0;
-	stream.Read(&nColor, 2);
-
-	result.nV0 = ((nColor >>  0) & 0x1F) << 3;
-	result.nV1 = ((nColor >>  5) & 0x1F) << 3;
-	result.nV2 = ((nColor >> 10) & 0x1F) << 3;
-	result.nV3 = ((nColor >> 15) & 0x01) << 7;
-
-	return true;
-}
-
-uint32 CVif::GetMaskOp(unsigned int row, unsigned int col) const
-{
-	if(col > 3) col = 3;
-	assert(row < 4);
-	unsigned int index = (col * 4) + row;
-	return (m_MASK >> (index * 2)) & 0x03;
-}
-
 void CVif::PrepareMicroProgram()
 {
 	m_ITOP = m_ITOPS;
@@ -1157,6 +1028,7 @@ CVif::CFifoStream::~CFifoStream()
 void CVif::CFifoStream::Reset()
 {
 	m_bufferPosition = BUFFERSIZE;
+	m_bufferFromSource = false;
 	m_nextAddress = 0;
 	m_endAddress = 0;
 	m_tagIncluded = false;
@@ -1186,6 +1058,34 @@ void CVif::CFifoStream::Flush()
 	m_bufferPosition = BUFFERSIZE;
 }
 
+uint32 CVif::CFifoStream::GetDirectReadSize() const
+{
+	if(m_tagIncluded) return 0;
+	//Data left in the buffer might come from a previous source
+	if((m_bufferPosition != BUFFERSIZE) && !m_bufferFromSource) return 0;
+	return GetAvailableReadBytes();
+}
+
+const uint8* CVif::CFifoStream::GetDirectReadPointer() const
+{
+	assert(m_source != nullptr);
+	return m_source + (m_nextAddress + m_bufferPosition - BUFFERSIZE);
+}
+
+void CVif::CFifoStream::AdvanceDirectRead(uint32 size)
+{
+	assert(size <= GetDirectReadSize());
+	uint32 position = m_nextAddress + m_bufferPosition - BUFFERSIZE + size;
+	m_nextAddress = position & ~(BUFFERSIZE - 1);
+	m_bufferPosition = BUFFERSIZE;
+	uint32 bufferPosition = position & (BUFFERSIZE - 1);
+	if(bufferPosition != 0)
+	{
+		SyncBuffer();
+		m_bufferPosition = bufferPosition;
+	}
+}
+
 void CVif::CFifoStream::SetDmaParams(uint32 address, uint32 size, bool tagIncluded)
 {
 	if(address & 0x80000000)
@@ -1203,15 +1103,22 @@ void CVif::CFifoStream::SetDmaParams(uint32 address, uint32 size, bool tagInclud
 	m_nextAddress = address;
 	m_endAddress = address + size;
 	m_tagIncluded = tagIncluded;
+	m_bufferFromSource = false;
 	SyncBuffer();
 }
 
 void CVif::CFifoStream::SetFifoParams(uint8* source, uint32 size)
+{
+	SetBufferParams(source, size, false);
+}
+
+void CVif::CFifoStream::SetBufferParams(uint8* source, uint32 size, bool tagIncluded)
 {
 	m_source = source;
 	m_nextAddress = 0;
 	m_endAddress = size;
-	m_tagIncluded = false;
+	m_tagIncluded = tagIncluded;
+	m_bufferFromSource = false;
 	SyncBuffer();
 }
 
@@ -1245,6 +1152,7 @@ void CVif::CFifoStream::SyncBuffer()
 		m_buffer = *reinterpret_cast<uint128*>(&m_source[m_nextAddress]);
 		m_nextAddress += 0x10;
 		m_bufferPosition = 0;
+		m_bufferFromSource = true;
 		if(m_tagIncluded)
 		{
 			//Skip next 8 bytes
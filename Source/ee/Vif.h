@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include "Types.h"
 #include "Convertible.h"
 #include "../uint128.h"
@@ -56,6 +57,7 @@ public:
 	virtual uint32				GetITOP() const;
 
 	virtual uint32				ReceiveDMA(uint32, uint32, uint32, bool);
+	uint32						ReceiveBuffer(uint8*, uint32, bool);
 
 	bool						IsWaitingForProgramEnd() const;
 	bool						IsStalledByInterrupt() const;
@@ -83,9 +85,16 @@ protected:
 		uint32					GetRemainingDmaTransferSize() const;
 		void					Read(void*, uint32);
 		void					Flush();
+
+		//Allows reading data in place when it's contiguous in memory
+		uint32					GetDirectReadSize() const;
+		const uint8*			GetDirectReadPointer() const;
+		void					AdvanceDirectRead(uint32);
+
 		void					Align32();
 		void					SetDmaParams(uint32, uint32, bool);
 		void					SetFifoParams(uint8*, uint32);
+		void					SetBufferParams(uint8*, uint32, bool);
 
 	private:
 		void					SyncBuffer();
@@ -100,6 +109,7 @@ protected:
 
 		uint128					m_buffer;
 		uint32					m_bufferPosition = BUFFERSIZE;
+		bool					m_bufferFromSource = false;
 		uint32					m_nextAddress = 0;
 		uint32					m_endAddress = 0;
 		bool					m_tagIncluded = false;
@@ -170,17 +180,6 @@ protected:
 	void				Cmd_STCOL(StreamType&, CODE);
 	void				Cmd_STMASK(StreamType&, CODE);
 
-	bool				Unpack_ReadValue(const CODE&, StreamType&, uint128&, bool);
-	bool				Unpack_S32(StreamType&, uint128&);
-	bool				Unpack_S16(StreamType&, uint128&, bool);
-	bool				Unpack_S8(StreamType&, uint128&, bool);
-	bool				Unpack_V16(StreamType&, uint128&, unsigned int, bool);
-	bool				Unpack_V8(StreamType&, uint128&, unsigned int, bool);
-	bool				Unpack_V32(StreamType&, uint128&, unsigned int);
-	bool				Unpack_V45(StreamType&, uint128&);
-
-	uint32				GetMaskOp(unsigned int, unsigned int) const;
-
 	virtual void		PrepareMicroProgram();
 	void				StartMicroProgram(uint32);
 #ifdef DELAYED_MSCAL
@@ -210,7 +209,8 @@ protected:
 	uint32				m_C[4];
 	uint32				m_MASK;
 	uint32				m_MARK;
-	uint32				m_ITOP;
+	//Also read by VU code through XITOP, which isn't necessarily running on the same thread
+	std::atomic<uint32>	m_ITOP;
 	uint32				m_ITOPS;
 	uint32				m_readTick;
 	uint32				m_writeTick;
@@ -32,7 +32,8 @@ private:
 
 	uint32			m_BASE;
 	uint32			m_OFST;
-	uint32			m_TOP;
+	//Also read by VU1 code through XTOP, see m_ITOP
+	std::atomic<uint32>	m_TOP;
 	uint32			m_TOPS;
 
 	ByteArray		m_directBuffer;
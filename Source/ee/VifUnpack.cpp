@@ -0,0 +1,501 @@
+#include <string.h>
+#include <algorithm>
+#include "VifUnpack.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define VIF_UNPACK_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define VIF_UNPACK_NEON
+#include <arm_neon.h>
+#endif
+
+enum FORMAT
+{
+	FORMAT_S32		= 0x00,
+	FORMAT_S16		= 0x01,
+	FORMAT_S8		= 0x02,
+	FORMAT_V2_32	= 0x04,
+	FORMAT_V2_16	= 0x05,
+	FORMAT_V2_8		= 0x06,
+	FORMAT_V3_32	= 0x08,
+	FORMAT_V3_16	= 0x09,
+	FORMAT_V3_8		= 0x0A,
+	FORMAT_V4_32	= 0x0C,
+	FORMAT_V4_16	= 0x0D,
+	FORMAT_V4_8		= 0x0E,
+	FORMAT_V4_5		= 0x0F,
+};
+
+//Same values as CVif's MODE and MASKOP
+enum MODE
+{
+	MODE_NORMAL		= 0,
+	MODE_OFFSET		= 1,
+	MODE_DIFFERENCE	= 2,
+};
+
+enum MASKOP
+{
+	MASK_DATA	= 0,
+	MASK_ROW	= 1,
+	MASK_COL	= 2,
+	MASK_MASK	= 3,
+};
+
+static const uint32 g_elementSizes[0x10] =
+{
+	4, 2, 1, 0,
+	8, 4, 2, 0,
+	12, 6, 3, 0,
+	16, 8, 4, 2,
+};
+
+static inline uint16 Read16(const uint8* src)
+{
+	uint16 value = 0;
+	memcpy(&value, src, sizeof(value));
+	return value;
+}
+
+static inline uint32 Read32(const uint8* src)
+{
+	uint32 value = 0;
+	memcpy(&value, src, sizeof(value));
+	return value;
+}
+
+static inline uint64 Read64(const uint8* src)
+{
+	uint64 value = 0;
+	memcpy(&value, src, sizeof(value));
+	return value;
+}
+
+#if defined(VIF_UNPACK_SSE2)
+
+/////////////////////////////////////////////
+//SSE2 primitives
+/////////////////////////////////////////////
+
+typedef __m128i Vector;
+
+static inline Vector LoadVector(const void* src)
+{
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+
+static inline void StoreVector(void* dst, Vector value)
+{
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), value);
+}
+
+static inline Vector MakeVector(uint32 x, uint32 y, uint32 z, uint32 w)
+{
+	return _mm_setr_epi32(x, y, z, w);
+}
+
+static inline Vector BroadcastVector(uint32 value)
+{
+	return _mm_set1_epi32(value);
+}
+
+//Value goes in the lower part of the vector, upper part is cleared
+static inline Vector VectorFromUint64(uint64 value)
+{
+	return _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&value));
+}
+
+static inline Vector CombineLo64(Vector lo, Vector hi)	{ return _mm_unpacklo_epi64(lo, hi); }
+static inline Vector And(Vector a, Vector b)			{ return _mm_and_si128(a, b); }
+static inline Vector AndNot(Vector a, Vector b)			{ return _mm_andnot_si128(b, a); }
+static inline Vector Or(Vector a, Vector b)				{ return _mm_or_si128(a, b); }
+static inline Vector Add32(Vector a, Vector b)			{ return _mm_add_epi32(a, b); }
+
+//Extends the 4 lower 16-bit values to 32-bit
+template <bool zeroExtend>
+static inline Vector Extend16(Vector value)
+{
+	if(zeroExtend)
+	{
+		return _mm_unpacklo_epi16(value, _mm_setzero_si128());
+	}
+	else
+	{
+		return _mm_srai_epi32(_mm_unpacklo_epi16(value, value), 16);
+	}
+}
+
+//Extends the 4 lower 8-bit values to 32-bit
+template <bool zeroExtend>
+static inline Vector Extend8(Vector value)
+{
+	if(zeroExtend)
+	{
+		auto zero = _mm_setzero_si128();
+		return _mm_unpacklo_epi16(_mm_unpacklo_epi8(value, zero), zero);
+	}
+	else
+	{
+		value = _mm_unpacklo_epi8(value, value);
+		return _mm_srai_epi32(_mm_unpacklo_epi16(value, value), 24);
+	}
+}
+
+#elif defined(VIF_UNPACK_NEON)
+
+/////////////////////////////////////////////
+//NEON primitives
+/////////////////////////////////////////////
+
+typedef uint32x4_t Vector;
+
+static inline Vector LoadVector(const void* src)
+{
+	return vreinterpretq_u32_u8(vld1q_u8(reinterpret_cast<const uint8*>(src)));
+}
+
+static inline void StoreVector(void* dst, Vector value)
+{
+	vst1q_u8(reinterpret_cast<uint8*>(dst), vreinterpretq_u8_u32(value));
+}
+
+static inline Vector MakeVector(uint32 x, uint32 y, uint32 z, uint32 w)
+{
+	const uint32 values[4] = { x, y, z, w };
+	return vld1q_u32(values);
+}
+
+static inline Vector BroadcastVector(uint32 value)
+{
+	return vdupq_n_u32(value);
+}
+
+//Value goes in the lower part of the vector, upper part is cleared
+static inline Vector VectorFromUint64(uint64 value)
+{
+	return vreinterpretq_u32_u64(vcombine_u64(vcreate_u64(value), vcreate_u64(0)));
+}
+
+static inline Vector CombineLo64(Vector lo, Vector hi)	{ return vcombine_u32(vget_low_u32(lo), vget_low_u32(hi)); }
+static inline Vector And(Vector a, Vector b)			{ return vandq_u32(a, b); }
+static inline Vector AndNot(Vector a, Vector b)			{ return vbicq_u32(a, b); }
+static inline Vector Or(Vector a, Vector b)				{ return vorrq_u32(a, b); }
+static inline Vector Add32(Vector a, Vector b)			{ return vaddq_u32(a, b); }
+
+//Extends the 4 lower 16-bit values to 32-bit
+template <bool zeroExtend>
+static inline Vector Extend16(Vector value)
+{
+	if(zeroExtend)
+	{
+		return vmovl_u16(vget_low_u16(vreinterpretq_u16_u32(value)));
+	}
+	else
+	{
+		return vreinterpretq_u32_s32(vmovl_s16(vget_low_s16(vreinterpretq_s16_u32(value))));
+	}
+}
+
+//Extends the 4 lower 8-bit values to 32-bit
+template <bool zeroExtend>
+static inline Vector Extend8(Vector value)
+{
+	if(zeroExtend)
+	{
+		auto value16 = vmovl_u8(vget_low_u8(vreinterpretq_u8_u32(value)));
+		return vmovl_u16(vget_low_u16(value16));
+	}
+	else
+	{
+		auto value16 = vmovl_s8(vget_low_s8(vreinterpretq_s8_u32(value)));
+		return vreinterpretq_u32_s32(vmovl_s16(vget_low_s16(value16)));
+	}
+}
+
+#else
+
+/////////////////////////////////////////////
+//Generic primitives
+/////////////////////////////////////////////
+
+struct Vector
+{
+	uint32 v[4];
+};
+
+static inline Vector LoadVector(const void* src)
+{
+	Vector result;
+	memcpy(result.v, src, sizeof(result.v));
+	return result;
+}
+
+static inline void StoreVector(void* dst, Vector value)
+{
+	memcpy(dst, value.v, sizeof(value.v));
+}
+
+static inline Vector MakeVector(uint32 x, uint32 y, uint32 z, uint32 w)
+{
+	Vector result = { { x, y, z, w } };
+	return result;
+}
+
+static inline Vector BroadcastVector(uint32 value)
+{
+	return MakeVector(value, value, value, value);
+}
+
+//Value goes in the lower part of the vector, upper part is cleared
+static inline Vector VectorFromUint64(uint64 value)
+{
+	Vector result = { { 0, 0, 0, 0 } };
+	memcpy(result.v, &value, sizeof(value));
+	return result;
+}
+
+static inline Vector CombineLo64(Vector lo, Vector hi)
+{
+	return MakeVector(lo.v[0], lo.v[1], hi.v[0], hi.v[1]);
+}
+
+#define VIF_UNPACK_GENERIC_BINARY_OP(name, op) \
+	static inline Vector name(Vector a, Vector b) \
+	{ \
+		Vector result; \
+		for(unsigned int i = 0; i < 4; i++) { result.v[i] = op; } \
+		return result; \
+	}
+
+VIF_UNPACK_GENERIC_BINARY_OP(And, a.v[i] & b.v[i])
+VIF_UNPACK_GENERIC_BINARY_OP(AndNot, a.v[i] & ~b.v[i])
+VIF_UNPACK_GENERIC_BINARY_OP(Or, a.v[i] | b.v[i])
+VIF_UNPACK_GENERIC_BINARY_OP(Add32, a.v[i] + b.v[i])
+
+#undef VIF_UNPACK_GENERIC_BINARY_OP
+
+//Extends the 4 lower 16-bit values to 32-bit
+template <bool zeroExtend>
+static inline Vector Extend16(Vector value)
+{
+	uint16 values[4];
+	memcpy(values, value.v, sizeof(values));
+	Vector result;
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		result.v[i] = zeroExtend ? values[i] : static_cast<int16>(values[i]);
+	}
+	return result;
+}
+
+//Extends the 4 lower 8-bit values to 32-bit
+template <bool zeroExtend>
+static inline Vector Extend8(Vector value)
+{
+	uint8 values[4];
+	memcpy(values, value.v, sizeof(values));
+	Vector result;
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		result.v[i] = zeroExtend ? values[i] : static_cast<int8>(values[i]);
+	}
+	return result;
+}
+
+#endif
+
+/////////////////////////////////////////////
+//Expansion
+/////////////////////////////////////////////
+
+//Components that aren't present in the element are cleared
+template <uint32 format, bool zeroExtend>
+static inline Vector ExpandElement(const uint8* src)
+{
+	switch(format)
+	{
+	case FORMAT_S32:
+		return BroadcastVector(Read32(src));
+	case FORMAT_S16:
+		return BroadcastVector(zeroExtend ? Read16(src) : static_cast<int16>(Read16(src)));
+	case FORMAT_S8:
+		return BroadcastVector(zeroExtend ? src[0] : static_cast<int8>(src[0]));
+	case FORMAT_V2_32:
+		return VectorFromUint64(Read64(src));
+	case FORMAT_V2_16:
+		return Extend16<zeroExtend>(VectorFromUint64(Read32(src)));
+	case FORMAT_V2_8:
+		return Extend8<zeroExtend>(VectorFromUint64(Read16(src)));
+	case FORMAT_V3_32:
+		return CombineLo64(VectorFromUint64(Read64(src)), VectorFromUint64(Read32(src + 8)));
+	case FORMAT_V3_16:
+		return Extend16<zeroExtend>(VectorFromUint64(Read32(src) | (static_cast<uint64>(Read16(src + 4)) << 32)));
+	case FORMAT_V3_8:
+		return Extend8<zeroExtend>(VectorFromUint64(Read16(src) | (src[2] << 16)));
+	case FORMAT_V4_32:
+		return LoadVector(src);
+	case FORMAT_V4_16:
+		return Extend16<zeroExtend>(VectorFromUint64(Read64(src)));
+	case FORMAT_V4_8:
+		return Extend8<zeroExtend>(VectorFromUint64(Read32(src)));
+	case FORMAT_V4_5:
+		{
+			uint16 color = Read16(src);
+			return MakeVector(
+				((color >>  0) & 0x1F) << 3,
+				((color >>  5) & 0x1F) << 3,
+				((color >> 10) & 0x1F) << 3,
+				((color >> 15) & 0x01) << 7);
+		}
+	default:
+		return BroadcastVector(0);
+	}
+}
+
+template <uint32 format, bool zeroExtend>
+static void Expand(const uint8* src, uint128* dst, uint32 count)
+{
+	const uint32 elementSize = g_elementSizes[format];
+	for(uint32 i = 0; i < count; i++)
+	{
+		StoreVector(dst + i, ExpandElement<format, zeroExtend>(src));
+		src += elementSize;
+	}
+}
+
+#define EXPAND_FUNCTIONS(format) { &Expand<format, false>, &Expand<format, true> }
+
+static const CVifUnpack::ExpandFunction g_expandFunctions[0x10][2] =
+{
+	EXPAND_FUNCTIONS(FORMAT_S32),
+	EXPAND_FUNCTIONS(FORMAT_S16),
+	EXPAND_FUNCTIONS(FORMAT_S8),
+	{ nullptr, nullptr },
+	EXPAND_FUNCTIONS(FORMAT_V2_32),
+	EXPAND_FUNCTIONS(FORMAT_V2_16),
+	EXPAND_FUNCTIONS(FORMAT_V2_8),
+	{ nullptr, nullptr },
+	EXPAND_FUNCTIONS(FORMAT_V3_32),
+	EXPAND_FUNCTIONS(FORMAT_V3_16),
+	EXPAND_FUNCTIONS(FORMAT_V3_8),
+	{ nullptr, nullptr },
+	EXPAND_FUNCTIONS(FORMAT_V4_32),
+	EXPAND_FUNCTIONS(FORMAT_V4_16),
+	EXPAND_FUNCTIONS(FORMAT_V4_8),
+	EXPAND_FUNCTIONS(FORMAT_V4_5),
+};
+
+#undef EXPAND_FUNCTIONS
+
+/////////////////////////////////////////////
+//Write
+/////////////////////////////////////////////
+
+//Returns a vector with all bits set in lanes using the mask operation specified
+static inline Vector SelectLanes(uint32 ops, uint32 op)
+{
+	uint32 lanes[4];
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		lanes[i] = (((ops >> (i * 2)) & 0x03) == op) ? ~0U : 0;
+	}
+	return MakeVector(lanes[0], lanes[1], lanes[2], lanes[3]);
+}
+
+template <bool useMask, uint32 mode>
+static void Write(const uint128* src, uint128* dst, uint32 count, const CVifUnpack::WRITEPARAMS& params)
+{
+	Vector row = LoadVector(params.row);
+
+	if(!useMask)
+	{
+		for(uint32 i = 0; i < count; i++)
+		{
+			Vector value = LoadVector(src + i);
+			if(mode != MODE_NORMAL)
+			{
+				value = Add32(value, row);
+			}
+			if(mode == MODE_DIFFERENCE)
+			{
+				row = value;
+			}
+			StoreVector(dst + i, value);
+		}
+	}
+	else
+	{
+		//Writes past the 4th one of a cycle all use the last mask column
+		uint32 writeTick = params.writeTick;
+		for(uint32 i = 0; i < count; i++)
+		{
+			unsigned int col = std::min<uint32>(writeTick, 3);
+			Vector dataLanes = LoadVector(params.dataLanes + col);
+			Vector keepLanes = LoadVector(params.keepLanes + col);
+			Vector value = LoadVector(src + i);
+			if(mode != MODE_NORMAL)
+			{
+				value = Add32(value, row);
+			}
+			if(mode == MODE_DIFFERENCE)
+			{
+				//Only data lanes update the row registers
+				row = Or(And(value, dataLanes), AndNot(row, dataLanes));
+			}
+			Vector result = Or(And(value, dataLanes), And(row, LoadVector(params.rowLanes + col)));
+			result = Or(result, LoadVector(params.colValues + col));
+			result = Or(AndNot(result, keepLanes), And(LoadVector(dst + i), keepLanes));
+			StoreVector(dst + i, result);
+			writeTick++;
+			if(writeTick == params.cycleLength)
+			{
+				writeTick = 0;
+			}
+		}
+	}
+
+	if(mode == MODE_DIFFERENCE)
+	{
+		StoreVector(params.row, row);
+	}
+}
+
+static const CVifUnpack::WriteFunction g_writeFunctions[2][3] =
+{
+	{ &Write<false, MODE_NORMAL>, &Write<false, MODE_OFFSET>, &Write<false, MODE_DIFFERENCE> },
+	{ &Write<true, MODE_NORMAL>, &Write<true, MODE_OFFSET>, &Write<true, MODE_DIFFERENCE> },
+};
+
+/////////////////////////////////////////////
+//Entry points
+/////////////////////////////////////////////
+
+void CVifUnpack::PrepareWriteParams(WRITEPARAMS& params, uint32 mask, const uint32* col)
+{
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		uint32 ops = mask >> (i * 8);
+		StoreVector(params.dataLanes + i, SelectLanes(ops, MASK_DATA));
+		StoreVector(params.rowLanes + i, SelectLanes(ops, MASK_ROW));
+		StoreVector(params.keepLanes + i, SelectLanes(ops, MASK_MASK));
+		StoreVector(params.colValues + i, And(BroadcastVector(col[i]), SelectLanes(ops, MASK_COL)));
+	}
+}
+
+uint32 CVifUnpack::GetElementSize(uint32 format)
+{
+	return g_elementSizes[format & 0x0F];
+}
+
+CVifUnpack::ExpandFunction CVifUnpack::GetExpandFunction(uint32 format, bool zeroExtend)
+{
+	return g_expandFunctions[format & 0x0F][zeroExtend ? 1 : 0];
+}
+
+CVifUnpack::WriteFunction CVifUnpack::GetWriteFunction(bool useMask, uint32 mode)
+{
+	//Undefined mode behaves like the normal one
+	if(mode > MODE_DIFFERENCE) mode = MODE_NORMAL;
+	return g_writeFunctions[useMask ? 1 : 0][mode];
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Types.h"
+#include "../uint128.h"
+
+//Kernels used by VIF UNPACK commands. Unpacking is done in two steps, both specialized at
+//compile time: elements are first expanded to quadwords according to their format, expanded
+//quadwords are then written to VU memory according to the mask and addition mode.
+class CVifUnpack
+{
+public:
+	enum
+	{
+		MAX_RUN_SIZE = 0x40,
+	};
+
+	//Lane selectors are computed from the MASK and COL registers by PrepareWriteParams
+	struct WRITEPARAMS
+	{
+		uint32*			row = nullptr;
+		uint32			writeTick = 0;
+		uint32			cycleLength = 0;
+
+		uint128			dataLanes[4];
+		uint128			rowLanes[4];
+		uint128			keepLanes[4];
+		uint128			colValues[4];
+	};
+
+	//Source pointer, destination buffer, element count
+	typedef void (*ExpandFunction)(const uint8*, uint128*, uint32);
+
+	//Expanded quadwords, destination in VU memory, quadword count, parameters
+	//Row registers are updated when using the difference mode.
+	typedef void (*WriteFunction)(const uint128*, uint128*, uint32, const WRITEPARAMS&);
+
+	static void					PrepareWriteParams(WRITEPARAMS&, uint32, const uint32*);
+
+	static uint32				GetElementSize(uint32);
+	static ExpandFunction		GetExpandFunction(uint32, bool);
+	static WriteFunction		GetWriteFunction(bool, uint32);
+};
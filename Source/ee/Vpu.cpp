@@ -1,3 +1,7 @@
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <fenv.h>
 #include "make_unique.h"
 #include "../Log.h"
 #include "../RegisterStateFile.h"
@@ -6,12 +10,15 @@
 #include "Vif.h"
 #include "Vif1.h"
 #include "GIF.h"
+#include "Dmac_Channel.h"
 #include "Vpu.h"
 
 #define LOG_NAME				("vpu")
 
 CVpu::CVpu(unsigned int number, const VPUINIT& vpuInit, CGIF& gif, uint8* ram, uint8* spr)
 : m_number(number)
+, m_ram(ram)
+, m_spr(spr)
 , m_vif((number == 0) ? std::make_unique<CVif>(0, *this, ram, spr) : std::make_unique<CVif1>(1, *this, gif, ram, spr))
 , m_microMem(vpuInit.microMem)
 , m_vuMem(vpuInit.vuMem)
@@ -20,6 +27,8 @@ CVpu::CVpu(unsigned int number, const VPUINIT& vpuInit, CGIF& gif, uint8* ram, u
 , m_gif(gif)
 , m_executor(*vpuInit.context)
 , m_vuProfilerZone(CProfiler::GetInstance().RegisterZone("VU"))
+, m_threadWaiting(false)
+, m_vifStalled(false)
 #ifdef DEBUGGER_INCLUDED
 , m_microMemMiniState(new uint8[(number == 0) ? PS2::MICROMEM0SIZE : PS2::MICROMEM1SIZE])
 , m_vuMemMiniState(new uint8[(number == 0) ? PS2::VUMEM0SIZE : PS2::VUMEM1SIZE])
@@ -32,6 +41,7 @@ CVpu::CVpu(unsigned int number, const VPUINIT& vpuInit, CGIF& gif, uint8* ram, u
 
 CVpu::~CVpu()
 {
+	StopThread();
 #ifdef DEBUGGER_INCLUDED
 	delete [] m_microMemMiniState;
 	delete [] m_vuMemMiniState;
@@ -39,6 +49,13 @@ CVpu::~CVpu()
 }
 
 void CVpu::Execute(bool singleStep)
+{
+	//VPU thread takes care of running micro programs
+	if(m_threaded) return;
+	ExecuteQuota(singleStep ? 1 : VU_QUOTA);
+}
+
+void CVpu::ExecuteQuota(unsigned int quota)
 {
 	if(!m_running) return;
 
@@ -46,7 +63,6 @@ void CVpu::Execute(bool singleStep)
 	CProfilerZone profilerZone(m_vuProfilerZone);
 #endif
 
-	unsigned int quota = singleStep ? 1 : 5000;
 	m_executor.Execute(quota);
 	if(m_ctx->m_State.nHasException)
 	{
@@ -105,9 +121,19 @@ uint32 CVpu::GetVuItopMiniState() const
 
 void CVpu::Reset()
 {
+	//Don't wait for the thread to be idle, it might be running a micro program that never ends.
+	//Only wait for the unit of work it's doing, it won't start another one while we hold the mutex.
+	std::unique_lock<std::mutex> threadLock(m_threadMutex, std::defer_lock);
+	if(m_threaded)
+	{
+		threadLock.lock();
+		m_threadIdleCondition.wait(threadLock, [this] () { return !m_threadBusy; });
+		DiscardPendingTransfers();
+	}
 	m_running = false;
 	m_executor.Reset();
 	m_vif->Reset();
+	m_vifStalled = false;
 }
 
 void CVpu::SaveState(Framework::CZipArchiveWriter& archive)
@@ -117,9 +143,247 @@ void CVpu::SaveState(Framework::CZipArchiveWriter& archive)
 
 void CVpu::LoadState(Framework::CZipArchiveReader& archive)
 {
+	//Transfers held back by an interrupt belong to the previous state
+	DiscardPendingTransfers();
 	m_vif->LoadState(archive);
 }
 
+void CVpu::SetThreaded(bool threaded)
+{
+#if defined(DEBUGGER_INCLUDED) || defined(PROFILE)
+	//Debugger and profiler expect everything to run on the emulation thread
+	threaded = false;
+#endif
+	assert(!threaded || (m_number == 1));
+	if(threaded == m_threaded) return;
+	if(threaded)
+	{
+		StartThread();
+	}
+	else
+	{
+		StopThread();
+	}
+}
+
+bool CVpu::IsThreaded() const
+{
+	return m_threaded;
+}
+
+uint32 CVpu::ReceiveDMA(uint32 address, uint32 qwc, uint32 direction, bool tagIncluded)
+{
+	if(!m_threaded || (direction == Dmac::CChannel::CHCR_DIR_TO))
+	{
+		CThreadSync threadSync(*this);
+		return m_vif->ReceiveDMA(address, qwc, direction, tagIncluded);
+	}
+
+	//VIF won't take anything until the EE acknowledges its interrupt
+	if(m_vifStalled) return 0;
+	if(qwc == 0) return 0;
+
+	uint32 maxQwc = (m_dmaRing->GetMaxPacketSize() - sizeof(DMATRANSFER)) / 0x10;
+	qwc = std::min<uint32>(qwc, maxQwc);
+	uint32 size = qwc * 0x10;
+	uint32 packetSize = sizeof(DMATRANSFER) + size;
+
+	//Don't wait for space, the thread might be held back by an interrupt. Transfer will be retried later.
+	if(!m_dmaRing->CanBeginPacket(packetSize)) return 0;
+
+	const uint8* source = nullptr;
+	if(address & 0x80000000)
+	{
+		source = m_spr;
+		address &= (PS2::EE_SPR_SIZE - 1);
+		assert((address + size) <= PS2::EE_SPR_SIZE);
+	}
+	else
+	{
+		source = m_ram;
+		address &= (PS2::EE_RAM_SIZE - 1);
+		assert((address + size) <= PS2::EE_RAM_SIZE);
+	}
+
+	auto transfer = reinterpret_cast<DMATRANSFER*>(m_dmaRing->BeginPacket(0, packetSize));
+	transfer->qwc = qwc;
+	transfer->tagIncluded = tagIncluded ? 1 : 0;
+	memcpy(transfer + 1, source + address, size);
+	m_dmaRing->EndPacket();
+
+	//Sequentially consistent store (in EndPacket) and load pair makes sure we can't miss the thread going to sleep
+	if(m_threadWaiting.load())
+	{
+		std::lock_guard<std::mutex> threadLock(m_threadMutex);
+		m_threadWorkCondition.notify_one();
+	}
+
+	return qwc;
+}
+
+bool CVpu::IsVifStalled() const
+{
+	return m_threaded ? m_vifStalled.load() : m_vif->IsStalledByInterrupt();
+}
+
+void CVpu::StartThread()
+{
+	assert(!m_thread.joinable());
+	if(!m_dmaRing)
+	{
+		m_dmaRing = std::make_unique<CCommandRing>(DMA_RING_SIZE);
+	}
+	m_threadDone = false;
+	m_threadBusy = false;
+	m_threadBlocked = false;
+	m_dmaTransferOffset = 0;
+	m_vifStalled = m_vif->IsStalledByInterrupt();
+	m_threaded = true;
+	m_thread = std::thread([this] () { ThreadProc(); });
+}
+
+void CVpu::StopThread()
+{
+	if(!m_threaded) return;
+	{
+		std::lock_guard<std::mutex> threadLock(m_threadMutex);
+		m_threadDone = true;
+		m_threadWorkCondition.notify_one();
+	}
+	m_thread.join();
+	m_threaded = false;
+	if(m_dmaRing->GetReadPosition() != m_dmaRing->GetWritePosition())
+	{
+		CLog::GetInstance().Print(LOG_NAME, "Discarding pending VIF transfers while leaving threaded mode.\r\n");
+	}
+	DiscardPendingTransfers();
+}
+
+void CVpu::ThreadProc()
+{
+	//Same rounding mode as the emulation thread
+	fesetround(FE_TOWARDZERO);
+	std::unique_lock<std::mutex> threadLock(m_threadMutex);
+	while(1)
+	{
+		if(!m_threadDone && !CanStartThreadWork())
+		{
+			m_threadIdleCondition.notify_all();
+			m_threadWaiting = true;
+			m_threadWorkCondition.wait(threadLock, [this] () { return m_threadDone || CanStartThreadWork(); });
+			m_threadWaiting = false;
+		}
+		if(m_threadDone) break;
+		//Mutex is only held to hand over state, the emulation thread can wait for us without
+		//competing with the next unit of work for it
+		bool runningQuota = m_running;
+		m_threadBusy = true;
+		threadLock.unlock();
+		ProcessThreadWork();
+		threadLock.lock();
+		m_threadBusy = false;
+		if(runningQuota)
+		{
+			m_threadQuotaCount++;
+		}
+		m_threadIdleCondition.notify_all();
+	}
+}
+
+bool CVpu::HasPendingTransfers() const
+{
+	return !m_threadBlocked && (m_dmaRing->GetReadPosition() != m_dmaRing->GetWritePosition());
+}
+
+bool CVpu::HasThreadWork() const
+{
+	return m_running || HasPendingTransfers();
+}
+
+bool CVpu::CanStartThreadWork() const
+{
+	//Let the emulation thread in as soon as it got what it was waiting for
+	if(m_threadSyncWaiting && IsThreadSynced()) return false;
+	return HasThreadWork();
+}
+
+bool CVpu::IsThreadSynced() const
+{
+	if(HasPendingTransfers()) return false;
+	return !m_running || ((m_threadQuotaCount - m_threadSyncQuotaCount) >= MICROPROGRAM_MAX_QUOTA_COUNT);
+}
+
+//Does one unit of work: either a quota of micro program or one go at the first pending transfer.
+//Called without holding the thread mutex.
+void CVpu::ProcessThreadWork()
+{
+	if(m_running)
+	{
+		ExecuteQuota(VU_QUOTA);
+		return;
+	}
+
+	auto packet = m_dmaRing->ReadPacket();
+	if(packet == nullptr) return;
+
+	auto transfer = reinterpret_cast<DMATRANSFER*>(packet->GetData());
+	uint32 qwc = transfer->qwc - m_dmaTransferOffset;
+	auto data = reinterpret_cast<uint8*>(transfer + 1) + (m_dmaTransferOffset * 0x10);
+	bool tagIncluded = (transfer->tagIncluded != 0) && (m_dmaTransferOffset == 0);
+	uint32 processed = m_vif->ReceiveBuffer(data, qwc, tagIncluded);
+	m_dmaTransferOffset += processed;
+	if(m_dmaTransferOffset == transfer->qwc)
+	{
+		m_dmaRing->ReleasePacket();
+		m_dmaTransferOffset = 0;
+	}
+	else if((processed == 0) && !m_running)
+	{
+		//Held back by an interrupt, wait for the EE to do something about it
+		m_threadBlocked = true;
+	}
+	m_vifStalled = m_vif->IsStalledByInterrupt();
+}
+
+//Must be called with the thread mutex held or with the thread stopped
+void CVpu::DiscardPendingTransfers()
+{
+	if(!m_dmaRing) return;
+	while(m_dmaRing->ReadPacket() != nullptr)
+	{
+		m_dmaRing->ReleasePacket();
+	}
+	m_dmaTransferOffset = 0;
+	m_threadBlocked = false;
+}
+
+CVpu::CThreadSync::CThreadSync(CVpu& vpu)
+: m_vpu(vpu)
+{
+	if(!m_vpu.m_threaded) return;
+	//Only used by the emulation thread, no need to protect the depth
+	m_nested = (m_vpu.m_threadSyncDepth++ != 0);
+	if(m_nested) return;
+	m_lock = std::unique_lock<std::mutex>(m_vpu.m_threadMutex);
+	m_vpu.m_threadSyncQuotaCount = m_vpu.m_threadQuotaCount;
+	m_vpu.m_threadSyncWaiting = true;
+	m_vpu.m_threadIdleCondition.wait(m_lock, [this] () { return !m_vpu.m_threadBusy && m_vpu.IsThreadSynced(); });
+	m_vpu.m_threadSyncWaiting = false;
+}
+
+CVpu::CThreadSync::~CThreadSync()
+{
+	if(m_nested || m_lock.owns_lock())
+	{
+		m_vpu.m_threadSyncDepth--;
+	}
+	if(!m_lock.owns_lock()) return;
+	//EE might have changed the VIF's state (ie.: cancelled a stall), let the thread take another look
+	m_vpu.m_threadBlocked = false;
+	m_vpu.m_vifStalled = m_vpu.m_vif->IsStalledByInterrupt();
+	m_vpu.m_threadWorkCondition.notify_one();
+}
+
 CMIPS& CVpu::GetContext() const
 {
 	return *m_ctx;
@@ -164,9 +428,10 @@ void CVpu::ExecuteMicroProgram(uint32 nAddress)
 
 	assert(!m_running);
 	m_running = true;
-	for(unsigned int i = 0; i < 100; i++)
+	//Also done when threaded, VIF sees the same state after MSCAL in both modes
+	for(unsigned int i = 0; i < MICROPROGRAM_MAX_QUOTA_COUNT; i++)
 	{
-		Execute(false);
+		ExecuteQuota(VU_QUOTA);
 		if(!m_running) break;
 	}
 }
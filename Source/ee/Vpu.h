@@ -1,8 +1,14 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include "Types.h"
 #include "../MIPS.h"
 #include "../Profiler.h"
+#include "../CommandRing.h"
 #include "VuExecutor.h"
 #include "Convertible.h"
 #include "zip/ZipArchiveWriter.h"
@@ -36,14 +42,39 @@ public:
 		CMIPS* context;
 	};
 
+	//Waits for the VPU thread to be done with the transfers it was given and keeps it
+	//from running while alive. Does nothing if the VPU isn't threaded or if the emulation
+	//thread already holds another sync.
+	class CThreadSync
+	{
+	public:
+								CThreadSync(CVpu&);
+								~CThreadSync();
+
+	private:
+		CVpu&							m_vpu;
+		std::unique_lock<std::mutex>	m_lock;
+		bool							m_nested = false;
+	};
+
 							CVpu(unsigned int, const VPUINIT&, CGIF&, uint8*, uint8*);
 	virtual					~CVpu();
 
 	virtual void			Execute(bool);
 	void					Reset();
+	//VPU thread must be synced by the caller
 	void					SaveState(Framework::CZipArchiveWriter&);
 	void					LoadState(Framework::CZipArchiveReader&);
 
+	//When threaded, VIF packets and micro programs are processed on a thread of their own.
+	//DMA transfers are queued and the EE only waits for the thread when it needs to look at
+	//the VIF or VU state.
+	void					SetThreaded(bool);
+	bool					IsThreaded() const;
+
+	uint32					ReceiveDMA(uint32, uint32, uint32, bool);
+	bool					IsVifStalled() const;
+
 	CMIPS&					GetContext() const;
 	uint8*					GetMicroMemory() const;
 	uint8*					GetVuMemory() const;
@@ -71,6 +102,39 @@ public:
 
 protected:
 	typedef std::unique_ptr<CVif> VifPtr;
+	typedef std::unique_ptr<CCommandRing> CommandRingPtr;
+
+	enum
+	{
+		VU_QUOTA = 5000,
+		DMA_RING_SIZE = 0x400000,
+		//Quotas run right away when a micro program starts, also how long the EE waits for one to end
+		MICROPROGRAM_MAX_QUOTA_COUNT = 100,
+	};
+
+	//Header of DMA transfers queued in the ring, followed by the data
+	struct DMATRANSFER
+	{
+		uint32				qwc;
+		uint32				tagIncluded;
+		uint32				reserved[2];
+	};
+	static_assert(sizeof(DMATRANSFER) == 0x10, "Size of DMATRANSFER struct must be 16 bytes.");
+
+	void					ExecuteQuota(unsigned int);
+
+	void					StartThread();
+	void					StopThread();
+	void					ThreadProc();
+	bool					HasThreadWork() const;
+	bool					CanStartThreadWork() const;
+	bool					HasPendingTransfers() const;
+	bool					IsThreadSynced() const;
+	void					ProcessThreadWork();
+	void					DiscardPendingTransfers();
+
+	uint8*					m_ram = nullptr;
+	uint8*					m_spr = nullptr;
 
 	uint8*					m_microMem = nullptr;
 	uint8*					m_vuMem = nullptr;
@@ -92,4 +156,23 @@ protected:
 	bool					m_running = false;
 
 	CProfiler::ZoneHandle	m_vuProfilerZone = 0;
+
+	//Threaded mode, members below are protected by m_threadMutex unless atomic. Units of work are
+	//done without holding it, the thread owns the VIF, VU and transfer state while m_threadBusy is set.
+	bool					m_threaded = false;
+	std::thread				m_thread;
+	std::mutex				m_threadMutex;
+	std::condition_variable	m_threadWorkCondition;
+	std::condition_variable	m_threadIdleCondition;
+	std::atomic<bool>		m_threadWaiting;
+	std::atomic<bool>		m_vifStalled;
+	bool					m_threadDone = false;
+	bool					m_threadBusy = false;
+	bool					m_threadBlocked = false;
+	bool					m_threadSyncWaiting = false;
+	unsigned int			m_threadSyncDepth = 0;
+	uint32					m_threadSyncQuotaCount = 0;
+	uint32					m_threadQuotaCount = 0;
+	CommandRingPtr			m_dmaRing;
+	uint32					m_dmaTransferOffset = 0;
 };
@@ -7,6 +7,8 @@
 #include "../GsPixelFormats.h"
 #include "GSH_OpenGL.h"
 
+#define LOG_NAME ("gsh_opengl")
+
 #define NUM_SAMPLES 8
 
 const GLenum CGSH_OpenGL::g_nativeClampModes[CGSHandler::CLAMP_MODE_MAX] =
@@ -65,11 +67,6 @@ void CGSH_OpenGL::InitializeImpl()
 
 	m_nVtxCount = 0;
 
-	for(unsigned int i = 0; i < MAX_TEXTURE_CACHE; i++)
-	{
-		m_textureCache.push_back(TexturePtr(new CTexture()));
-	}
-
 	for(unsigned int i = 0; i < MAX_PALETTE_CACHE; i++)
 	{
 		m_paletteCache.push_back(PalettePtr(new CPalette()));
@@ -84,7 +81,15 @@ void CGSH_OpenGL::ReleaseImpl()
 {
 	ResetImpl();
 
-	m_textureCache.clear();
+	{
+		const auto& stats = m_textureCache.GetStats();
+		CLog::GetInstance().Print(LOG_NAME, "Texture cache: %llu hits, %llu misses, %llu evictions.\r\n",
+			static_cast<unsigned long long>(stats.hitCount), static_cast<unsigned long long>(stats.missCount),
+			static_cast<unsigned long long>(stats.evictionCount));
+		m_textureCache.ResetStats();
+	}
+
+	m_textureCache.Flush();
 	m_paletteCache.clear();
 	m_shaders.clear();
 	m_presentProgram.reset();
@@ -282,11 +287,11 @@ void CGSH_OpenGL::FlipImpl()
 	CGSHandler::FlipImpl();
 }
 
-void CGSH_OpenGL::LoadState(Framework::CZipArchiveReader& archive)
+void CGSH_OpenGL::LoadState(Framework::CZipArchiveReader& archive, bool loadMemoryAreas)
 {
-	CGSHandler::LoadState(archive);
+	CGSHandler::LoadState(archive, loadMemoryAreas);
 
-	m_mailBox.SendCall(std::bind(&CGSH_OpenGL::TexCache_InvalidateTextures, this, 0, RAMSIZE));
+	SendGSCall(std::bind(&CGSH_OpenGL::TexCache_InvalidateTextures, this, 0, RAMSIZE));
 }
 
 void CGSH_OpenGL::RegisterPreferences()
@@ -294,6 +299,7 @@ void CGSH_OpenGL::RegisterPreferences()
 	CGSHandler::RegisterPreferences();
 	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_CGSH_OPENGL_ENABLEHIGHRESMODE, false);
 	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_CGSH_OPENGL_FORCEBILINEARTEXTURES, false);
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_CGSH_OPENGL_TEXTURECACHESIZE, MAX_TEXTURE_CACHE);
 }
 
 void CGSH_OpenGL::NotifyPreferencesChangedImpl()
@@ -310,6 +316,7 @@ void CGSH_OpenGL::LoadPreferences()
 {
 	m_fbScale = CAppConfig::GetInstance().GetPreferenceBoolean(PREF_CGSH_OPENGL_ENABLEHIGHRESMODE) ? 2 : 1;
 	m_forceBilinearTextures = CAppConfig::GetInstance().GetPreferenceBoolean(PREF_CGSH_OPENGL_FORCEBILINEARTEXTURES);
+	m_textureCache.SetCapacity(CAppConfig::GetInstance().GetPreferenceInteger(PREF_CGSH_OPENGL_TEXTURECACHESIZE));
 }
 
 void CGSH_OpenGL::InitializeRC()
@@ -4,6 +4,7 @@
 #include <unordered_map>
 #include "../GSHandler.h"
 #include "../GsCachedArea.h"
+#include "../GsTextureCache.h"
 #include "opengl/OpenGlDef.h"
 #include "opengl/Program.h"
 #include "opengl/Shader.h"
@@ -11,6 +12,7 @@
 
 #define PREF_CGSH_OPENGL_ENABLEHIGHRESMODE        "renderer.opengl.enablehighresmode"
 #define PREF_CGSH_OPENGL_FORCEBILINEARTEXTURES    "renderer.opengl.forcebilineartextures"
+#define PREF_CGSH_OPENGL_TEXTURECACHESIZE         "renderer.opengl.texturecachesize"
 
 class CGSH_OpenGL : public CGSHandler
 {
@@ -20,7 +22,7 @@ public:
 
 	static void						RegisterPreferences();
 
-	virtual void					LoadState(Framework::CZipArchiveReader&) override;
+	virtual void					LoadState(Framework::CZipArchiveReader&, bool = true) override;
 	
 	void							ProcessHostToLocalTransfer() override;
 	void							ProcessLocalToHostTransfer() override;
@@ -187,8 +189,7 @@ private:
 
 		CGsCachedArea				m_cachedArea;
 	};
-	typedef std::shared_ptr<CTexture> TexturePtr;
-	typedef std::list<TexturePtr> TextureList;
+	typedef CGsTextureCache<CTexture> TextureCache;
 
 	class CPalette
 	{
@@ -362,6 +363,10 @@ private:
 	template <typename> void		TexUpdater_Psm48(uint32, uint32, unsigned int, unsigned int, unsigned int, unsigned int);
 	template <uint32, uint32> void	TexUpdater_Psm48H(uint32, uint32, unsigned int, unsigned int, unsigned int, unsigned int);
 
+	static void						ConvertPsm16Pixels(uint16*, unsigned int);
+	template <uint32, uint32>
+	static void						ExtractPsm48HPixels(uint8*, unsigned int);
+
 	//Context variables (put this in a struct or something?)
 	float							m_nPrimOfsX;
 	float							m_nPrimOfsY;
@@ -402,7 +407,7 @@ private:
 	GLint							m_copyToFbSrcPositionUniform = -1;
 	GLint							m_copyToFbSrcSizeUniform = -1;
 
-	TextureList						m_textureCache;
+	TextureCache					m_textureCache;
 	PaletteList						m_paletteCache;
 	FramebufferList					m_framebuffers;
 	DepthbufferList					m_depthbuffers;
@@ -7,6 +7,7 @@
 #include "StdStream.h"
 #include "bitmap/BMP.h"
 #include "../GsPixelFormats.h"
+#include "../GsSwizzle.h"
 
 #define TEX0_CLUTINFO_MASK (~0xFFFFFFE000000000ULL)
 
@@ -24,22 +25,22 @@ void CGSH_OpenGL::SetupTextureUploaders()
 
 	m_textureUploader[PSMCT32]		= &CGSH_OpenGL::TexUploader_Psm32;
 	m_textureUploader[PSMCT24]		= &CGSH_OpenGL::TexUploader_Psm32;
-	m_textureUploader[PSMCT16]		= &CGSH_OpenGL::TexUploader_Psm16<CGsPixelFormats::CPixelIndexorPSMCT16>;
+	m_textureUploader[PSMCT16]		= &CGSH_OpenGL::TexUploader_Psm16<CGsPixelFormats::STORAGEPSMCT16>;
 	m_textureUploader[PSMCT24_UNK]	= &CGSH_OpenGL::TexUploader_Psm32;
-	m_textureUploader[PSMCT16S]		= &CGSH_OpenGL::TexUploader_Psm16<CGsPixelFormats::CPixelIndexorPSMCT16S>;
-	m_textureUploader[PSMT8]		= &CGSH_OpenGL::TexUploader_Psm48<CGsPixelFormats::CPixelIndexorPSMT8>;
-	m_textureUploader[PSMT4]		= &CGSH_OpenGL::TexUploader_Psm48<CGsPixelFormats::CPixelIndexorPSMT4>;
+	m_textureUploader[PSMCT16S]		= &CGSH_OpenGL::TexUploader_Psm16<CGsPixelFormats::STORAGEPSMCT16S>;
+	m_textureUploader[PSMT8]		= &CGSH_OpenGL::TexUploader_Psm48<CGsPixelFormats::STORAGEPSMT8>;
+	m_textureUploader[PSMT4]		= &CGSH_OpenGL::TexUploader_Psm48<CGsPixelFormats::STORAGEPSMT4>;
 	m_textureUploader[PSMT8H]		= &CGSH_OpenGL::TexUploader_Psm48H<24, 0xFF>;
 	m_textureUploader[PSMT4HL]		= &CGSH_OpenGL::TexUploader_Psm48H<24, 0x0F>;
 	m_textureUploader[PSMT4HH]		= &CGSH_OpenGL::TexUploader_Psm48H<28, 0x0F>;
 
 	m_textureUpdater[PSMCT32]		= &CGSH_OpenGL::TexUpdater_Psm32;
 	m_textureUpdater[PSMCT24]		= &CGSH_OpenGL::TexUpdater_Psm32;
-	m_textureUpdater[PSMCT16]		= &CGSH_OpenGL::TexUpdater_Psm16<CGsPixelFormats::CPixelIndexorPSMCT16>;
+	m_textureUpdater[PSMCT16]		= &CGSH_OpenGL::TexUpdater_Psm16<CGsPixelFormats::STORAGEPSMCT16>;
 	m_textureUpdater[PSMCT24_UNK]	= &CGSH_OpenGL::TexUpdater_Psm32;
-	m_textureUpdater[PSMCT16S]		= &CGSH_OpenGL::TexUpdater_Psm16<CGsPixelFormats::CPixelIndexorPSMCT16S>;
-	m_textureUpdater[PSMT8]			= &CGSH_OpenGL::TexUpdater_Psm48<CGsPixelFormats::CPixelIndexorPSMT8>;
-	m_textureUpdater[PSMT4]			= &CGSH_OpenGL::TexUpdater_Psm48<CGsPixelFormats::CPixelIndexorPSMT4>;
+	m_textureUpdater[PSMCT16S]		= &CGSH_OpenGL::TexUpdater_Psm16<CGsPixelFormats::STORAGEPSMCT16S>;
+	m_textureUpdater[PSMT8]			= &CGSH_OpenGL::TexUpdater_Psm48<CGsPixelFormats::STORAGEPSMT8>;
+	m_textureUpdater[PSMT4]			= &CGSH_OpenGL::TexUpdater_Psm48<CGsPixelFormats::STORAGEPSMT4>;
 	m_textureUpdater[PSMT8H]		= &CGSH_OpenGL::TexUpdater_Psm48H<24, 0xFF>;
 	m_textureUpdater[PSMT4HL]		= &CGSH_OpenGL::TexUpdater_Psm48H<24, 0x0F>;
 	m_textureUpdater[PSMT4HH]		= &CGSH_OpenGL::TexUpdater_Psm48H<28, 0x0F>;
@@ -305,64 +306,26 @@ void CGSH_OpenGL::TexUploader_Invalid(uint32, uint32, unsigned int, unsigned int
 
 void CGSH_OpenGL::TexUploader_Psm32(uint32 bufPtr, uint32 bufWidth, unsigned int texWidth, unsigned int texHeight)
 {
-	CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, bufPtr, bufWidth);
-
-	uint32* dst = reinterpret_cast<uint32*>(m_pCvtBuffer);
-	for(unsigned int j = 0; j < texHeight; j++)
-	{
-		for(unsigned int i = 0; i < texWidth; i++)
-		{
-			dst[i] = indexor.GetPixel(i, j);
-		}
-
-		dst += texWidth;
-	}
+	CGsSwizzle::ReadRect<CGsPixelFormats::STORAGEPSMCT32>(m_pRAM, bufPtr, bufWidth, 0, 0, texWidth, texHeight, m_pCvtBuffer, texWidth * sizeof(uint32));
 
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texWidth, texHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, m_pCvtBuffer);
 	CHECKGLERROR();
 }
 
-template <typename IndexorType>
+template <typename Storage>
 void CGSH_OpenGL::TexUploader_Psm16(uint32 bufPtr, uint32 bufWidth, unsigned int texWidth, unsigned int texHeight)
 {
-	IndexorType indexor(m_pRAM, bufPtr, bufWidth);
-
-	auto dst = reinterpret_cast<uint16*>(m_pCvtBuffer);
-	for(unsigned int j = 0; j < texHeight; j++)
-	{
-		for(unsigned int i = 0; i < texWidth; i++)
-		{
-			auto pixel = indexor.GetPixel(i, j);
-			auto cvtPixel = 
-				(((pixel & 0x001F) >>  0) << 11) |	//R
-				(((pixel & 0x03E0) >>  5) <<  6) |	//G
-				(((pixel & 0x7C00) >> 10) <<  1) |	//B
-				(pixel >> 15);						//A
-			dst[i] = cvtPixel;
-		}
-
-		dst += texWidth;
-	}
+	CGsSwizzle::ReadRect<Storage>(m_pRAM, bufPtr, bufWidth, 0, 0, texWidth, texHeight, m_pCvtBuffer, texWidth * sizeof(uint16));
+	ConvertPsm16Pixels(reinterpret_cast<uint16*>(m_pCvtBuffer), texWidth * texHeight);
 
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB5_A1, texWidth, texHeight, 0, GL_RGBA, GL_UNSIGNED_SHORT_5_5_5_1, m_pCvtBuffer);
 	CHECKGLERROR();
 }
 
-template <typename IndexorType>
+template <typename Storage>
 void CGSH_OpenGL::TexUploader_Psm48(uint32 bufPtr, uint32 bufWidth, unsigned int texWidth, unsigned int texHeight)
 {
-	IndexorType indexor(m_pRAM, bufPtr, bufWidth);
-
-	uint8* dst = m_pCvtBuffer;
-	for(unsigned int j = 0; j < texHeight; j++)
-	{
-		for(unsigned int i = 0; i < texWidth; i++)
-		{
-			dst[i] = indexor.GetPixel(i, j);
-		}
-
-		dst += texWidth;
-	}
+	CGsSwizzle::ReadRect<Storage>(m_pRAM, bufPtr, bufWidth, 0, 0, texWidth, texHeight, m_pCvtBuffer, texWidth);
 
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, texWidth, texHeight, 0, GL_RED, GL_UNSIGNED_BYTE, m_pCvtBuffer);
 	CHECKGLERROR();
@@ -371,20 +334,8 @@ void CGSH_OpenGL::TexUploader_Psm48(uint32 bufPtr, uint32 bufWidth, unsigned int
 template <uint32 shiftAmount, uint32 mask>
 void CGSH_OpenGL::TexUploader_Psm48H(uint32 bufPtr, uint32 bufWidth, unsigned int texWidth, unsigned int texHeight)
 {
-	CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, bufPtr, bufWidth);
-
-	uint8* dst = m_pCvtBuffer;
-	for(unsigned int j = 0; j < texHeight; j++)
-	{
-		for(unsigned int i = 0; i < texWidth; i++)
-		{
-			uint32 pixel = indexor.GetPixel(i, j);
-			pixel = (pixel >> shiftAmount) & mask;
-			dst[i] = static_cast<uint8>(pixel);
-		}
-
-		dst += texWidth;
-	}
+	CGsSwizzle::ReadRect<CGsPixelFormats::STORAGEPSMCT32>(m_pRAM, bufPtr, bufWidth, 0, 0, texWidth, texHeight, m_pCvtBuffer, texWidth * sizeof(uint32));
+	ExtractPsm48HPixels<shiftAmount, mask>(m_pCvtBuffer, texWidth * texHeight);
 
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, texWidth, texHeight, 0, GL_RED, GL_UNSIGNED_BYTE, m_pCvtBuffer);
 	CHECKGLERROR();
@@ -397,65 +348,26 @@ void CGSH_OpenGL::TexUpdater_Invalid(uint32 bufPtr, uint32 bufWidth, unsigned in
 
 void CGSH_OpenGL::TexUpdater_Psm32(uint32 bufPtr, uint32 bufWidth, unsigned int texX, unsigned int texY, unsigned int texWidth, unsigned int texHeight)
 {
-	CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, bufPtr, bufWidth);
-
-	uint32* dst = reinterpret_cast<uint32*>(m_pCvtBuffer);
-	for(unsigned int y = 0; y < texHeight; y++)
-	{
-		for(unsigned int x = 0; x < texWidth; x++)
-		{
-			dst[x] = indexor.GetPixel(texX + x, texY + y);
-		}
-
-		dst += texWidth;
-	}
+	CGsSwizzle::ReadRect<CGsPixelFormats::STORAGEPSMCT32>(m_pRAM, bufPtr, bufWidth, texX, texY, texWidth, texHeight, m_pCvtBuffer, texWidth * sizeof(uint32));
 
 	glTexSubImage2D(GL_TEXTURE_2D, 0, texX, texY, texWidth, texHeight, GL_RGBA, GL_UNSIGNED_BYTE, m_pCvtBuffer);
 	CHECKGLERROR();
 }
 
-template <typename IndexorType>
+template <typename Storage>
 void CGSH_OpenGL::TexUpdater_Psm16(uint32 bufPtr, uint32 bufWidth, unsigned int texX, unsigned int texY, unsigned int texWidth, unsigned int texHeight)
 {
-	IndexorType indexor(m_pRAM, bufPtr, bufWidth);
-
-	auto dst = reinterpret_cast<uint16*>(m_pCvtBuffer);
-	for(unsigned int y = 0; y < texHeight; y++)
-	{
-		for(unsigned int x = 0; x < texWidth; x++)
-		{
-			auto pixel = indexor.GetPixel(texX + x, texY + y);
-			auto cvtPixel = 
-				(((pixel & 0x001F) >>  0) << 11) |	//R
-				(((pixel & 0x03E0) >>  5) <<  6) |	//G
-				(((pixel & 0x7C00) >> 10) <<  1) |	//B
-				(pixel >> 15);						//A
-			dst[x] = cvtPixel;
-		}
-
-		dst += texWidth;
-	}
+	CGsSwizzle::ReadRect<Storage>(m_pRAM, bufPtr, bufWidth, texX, texY, texWidth, texHeight, m_pCvtBuffer, texWidth * sizeof(uint16));
+	ConvertPsm16Pixels(reinterpret_cast<uint16*>(m_pCvtBuffer), texWidth * texHeight);
 
 	glTexSubImage2D(GL_TEXTURE_2D, 0, texX, texY, texWidth, texHeight, GL_RGBA, GL_UNSIGNED_SHORT_5_5_5_1, m_pCvtBuffer);
 	CHECKGLERROR();
 }
 
-template <typename IndexorType>
+template <typename Storage>
 void CGSH_OpenGL::TexUpdater_Psm48(uint32 bufPtr, uint32 bufWidth, unsigned int texX, unsigned int texY, unsigned int texWidth, unsigned int texHeight)
 {
-	IndexorType indexor(m_pRAM, bufPtr, bufWidth);
-
-	uint8* dst = m_pCvtBuffer;
-	for(unsigned int y = 0; y < texHeight; y++)
-	{
-		for(unsigned int x = 0; x < texWidth; x++)
-		{
-			uint8 pixel = indexor.GetPixel(texX + x, texY + y);
-			dst[x] = pixel;
-		}
-
-		dst += texWidth;
-	}
+	CGsSwizzle::ReadRect<Storage>(m_pRAM, bufPtr, bufWidth, texX, texY, texWidth, texHeight, m_pCvtBuffer, texWidth);
 
 	glTexSubImage2D(GL_TEXTURE_2D, 0, texX, texY, texWidth, texHeight, GL_RED, GL_UNSIGNED_BYTE, m_pCvtBuffer);
 	CHECKGLERROR();
@@ -464,23 +376,37 @@ void CGSH_OpenGL::TexUpdater_Psm48(uint32 bufPtr, uint32 bufWidth, unsigned int
 template <uint32 shiftAmount, uint32 mask>
 void CGSH_OpenGL::TexUpdater_Psm48H(uint32 bufPtr, uint32 bufWidth, unsigned int texX, unsigned int texY, unsigned int texWidth, unsigned int texHeight)
 {
-	CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, bufPtr, bufWidth);
+	CGsSwizzle::ReadRect<CGsPixelFormats::STORAGEPSMCT32>(m_pRAM, bufPtr, bufWidth, texX, texY, texWidth, texHeight, m_pCvtBuffer, texWidth * sizeof(uint32));
+	ExtractPsm48HPixels<shiftAmount, mask>(m_pCvtBuffer, texWidth * texHeight);
 
-	uint8* dst = m_pCvtBuffer;
-	for(unsigned int y = 0; y < texHeight; y++)
-	{
-		for(unsigned int x = 0; x < texWidth; x++)
-		{
-			uint32 pixel = indexor.GetPixel(texX + x, texY + y);
-			pixel = (pixel >> shiftAmount) & mask;
-			dst[x] = static_cast<uint8>(pixel);
-		}
+	glTexSubImage2D(GL_TEXTURE_2D, 0, texX, texY, texWidth, texHeight, GL_RED, GL_UNSIGNED_BYTE, m_pCvtBuffer);
+	CHECKGLERROR();
+}
 
-		dst += texWidth;
+void CGSH_OpenGL::ConvertPsm16Pixels(uint16* pixels, unsigned int pixelCount)
+{
+	for(unsigned int i = 0; i < pixelCount; i++)
+	{
+		auto pixel = pixels[i];
+		auto cvtPixel = 
+			(((pixel & 0x001F) >>  0) << 11) |	//R
+			(((pixel & 0x03E0) >>  5) <<  6) |	//G
+			(((pixel & 0x7C00) >> 10) <<  1) |	//B
+			(pixel >> 15);						//A
+		pixels[i] = cvtPixel;
 	}
+}
 
-	glTexSubImage2D(GL_TEXTURE_2D, 0, texX, texY, texWidth, texHeight, GL_RED, GL_UNSIGNED_BYTE, m_pCvtBuffer);
-	CHECKGLERROR();
+//Packs the indices held in 32-bits pixels into bytes, in place
+template <uint32 shiftAmount, uint32 mask>
+void CGSH_OpenGL::ExtractPsm48HPixels(uint8* buffer, unsigned int pixelCount)
+{
+	auto src = reinterpret_cast<const uint32*>(buffer);
+	for(unsigned int i = 0; i < pixelCount; i++)
+	{
+		uint32 pixel = src[i];
+		buffer[i] = static_cast<uint8>((pixel >> shiftAmount) & mask);
+	}
 }
 
 /////////////////////////////////////////////////////////////
@@ -518,46 +444,24 @@ void CGSH_OpenGL::CTexture::Free()
 CGSH_OpenGL::CTexture* CGSH_OpenGL::TexCache_Search(const TEX0& tex0)
 {
 	uint64 maskedTex0 = static_cast<uint64>(tex0) & TEX0_CLUTINFO_MASK;
-
-	for(auto textureIterator(m_textureCache.begin());
-		textureIterator != m_textureCache.end(); textureIterator++)
-	{
-		auto texture = *textureIterator;
-		if(!texture->m_live) continue;
-		if(maskedTex0 != texture->m_tex0) continue;
-		m_textureCache.erase(textureIterator);
-		m_textureCache.push_front(texture);
-		return texture.get();
-	}
-
-	return nullptr;
+	return m_textureCache.Search(maskedTex0);
 }
 
 void CGSH_OpenGL::TexCache_Insert(const TEX0& tex0, GLuint textureHandle)
 {
-	auto texture = *m_textureCache.rbegin();
-	texture->Free();
-
-	texture->m_cachedArea.SetArea(tex0.nPsm, tex0.GetBufPtr(), tex0.GetBufWidth(), tex0.GetHeight());
-
-	texture->m_tex0			= static_cast<uint64>(tex0) & TEX0_CLUTINFO_MASK;
-	texture->m_texture		= textureHandle;
-	texture->m_live			= true;
-
-	m_textureCache.pop_back();
-	m_textureCache.push_front(texture);
+	uint64 maskedTex0 = static_cast<uint64>(tex0) & TEX0_CLUTINFO_MASK;
+	auto texture = m_textureCache.Insert(maskedTex0, tex0);
+	texture->m_texture = textureHandle;
 }
 
 void CGSH_OpenGL::TexCache_InvalidateTextures(uint32 start, uint32 size)
 {
-	std::for_each(std::begin(m_textureCache), std::end(m_textureCache), 
-		[start, size] (TexturePtr& texture) { if(texture->m_live) { texture->m_cachedArea.Invalidate(start, size); } });
+	m_textureCache.InvalidateRange(start, size);
 }
 
 void CGSH_OpenGL::TexCache_Flush()
 {
-	std::for_each(std::begin(m_textureCache), std::end(m_textureCache), 
-		[] (TexturePtr& texture) { texture->Free(); });
+	m_textureCache.Flush();
 }
 
 /////////////////////////////////////////////////////////////
@@ -0,0 +1,1593 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "../Log.h"
+#include "GsPixelFormats.h"
+#include "GSH_Software.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define GS_SOFTWARE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define GS_SOFTWARE_NEON
+#include <arm_neon.h>
+#endif
+
+#define LOG_NAME ("gs_software")
+
+static int ClampColor(int value)
+{
+	return std::min<int>(std::max<int>(value, 0), 255);
+}
+
+static uint16 PackColor16(uint32 color)
+{
+	return static_cast<uint16>(
+		((color >>  3) & 0x001F) |
+		((color >>  6) & 0x03E0) |
+		((color >>  9) & 0x7C00) |
+		((color >> 16) & 0x8000));
+}
+
+static uint32 UnpackColor16(uint16 color, uint32 alpha)
+{
+	return ((color & 0x001F) << 3) | ((color & 0x03E0) << 6) | ((color & 0x7C00) << 9) | (alpha << 24);
+}
+
+static uint32 ExpandTexel16(uint16 color, const CGSHandler::TEXA& texa)
+{
+	uint32 alpha = (color & 0x8000) ? texa.nTA1 : texa.nTA0;
+	if(texa.nAEM && ((color & 0x7FFF) == 0)) alpha = 0;
+	return UnpackColor16(color, alpha);
+}
+
+static uint32 GetSurfaceSize(unsigned int psm, uint32 width, uint32 height)
+{
+	//Z16S has the same layout as CT16S
+	if(psm == CGSHandler::PSMZ16S) psm = CGSHandler::PSMCT16S;
+	auto pageSize = CGsPixelFormats::GetPsmPageSize(psm);
+	uint32 pageCountX = std::max<uint32>((width + pageSize.first - 1) / pageSize.first, 1);
+	uint32 pageCountY = (height + pageSize.second - 1) / pageSize.second;
+	return pageCountX * pageCountY * CGsPixelFormats::PAGESIZE;
+}
+
+static uint32 GetDepthMax(unsigned int psm)
+{
+	switch(psm | 0x30)
+	{
+	case CGSHandler::PSMZ24:
+		return 0x00FFFFFF;
+	case CGSHandler::PSMZ16:
+	case CGSHandler::PSMZ16S:
+		return 0x0000FFFF;
+	default:
+		return 0xFFFFFFFF;
+	}
+}
+
+template <typename PlaneType, typename Type>
+static void SetupPlane(PlaneType& plane, const double* x, const double* y, Type value0, Type value1, Type value2)
+{
+	double det = ((x[1] - x[0]) * (y[2] - y[0])) - ((x[2] - x[0]) * (y[1] - y[0]));
+	double dx = (((value1 - value0) * (y[2] - y[0])) - ((value2 - value0) * (y[1] - y[0]))) / det;
+	double dy = (((value2 - value0) * (x[1] - x[0])) - ((value1 - value0) * (x[2] - x[0]))) / det;
+	plane.c = static_cast<Type>(value0 - (dx * x[0]) - (dy * y[0]));
+	plane.dx = static_cast<Type>(dx);
+	plane.dy = static_cast<Type>(dy);
+}
+
+template <typename PlaneType, typename Type>
+static void SetupConstantPlane(PlaneType& plane, Type value)
+{
+	plane.c = value;
+	plane.dx = 0;
+	plane.dy = 0;
+}
+
+//Fills pixels [x0, x1) of a row. In a PSMCT32 column, the pixels of a row are stored
+//in pairs (0, 1, 4, 5, 8, 9, 12, 13 - see m_nColumnSwizzleTable), which means that
+//8 aligned pixels can be filled with 4 64-bit stores.
+static void FillSpanPSMCT32(CGsPixelFormats::CPixelIndexorPSMCT32& indexor, int32 y, int32 x0, int32 x1, uint32 color)
+{
+	int32 x = x0;
+	for(; (x < x1) && ((x & 7) != 0); x++)
+	{
+		indexor.SetPixel(x, y, color);
+	}
+#if defined(GS_SOFTWARE_SSE2)
+	__m128i colorVector = _mm_set1_epi32(color);
+	for(; (x + 8) <= x1; x += 8)
+	{
+		auto pixels = indexor.GetPixelAddress(x, y);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(pixels + 0), colorVector);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(pixels + 4), colorVector);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(pixels + 8), colorVector);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(pixels + 12), colorVector);
+	}
+#elif defined(GS_SOFTWARE_NEON)
+	uint32x2_t colorVector = vdup_n_u32(color);
+	for(; (x + 8) <= x1; x += 8)
+	{
+		auto pixels = indexor.GetPixelAddress(x, y);
+		vst1_u32(pixels + 0, colorVector);
+		vst1_u32(pixels + 4, colorVector);
+		vst1_u32(pixels + 8, colorVector);
+		vst1_u32(pixels + 12, colorVector);
+	}
+#else
+	for(; (x + 8) <= x1; x += 8)
+	{
+		auto pixels = indexor.GetPixelAddress(x, y);
+		pixels[0] = pixels[1] = color;
+		pixels[4] = pixels[5] = color;
+		pixels[8] = pixels[9] = color;
+		pixels[12] = pixels[13] = color;
+	}
+#endif
+	for(; x < x1; x++)
+	{
+		indexor.SetPixel(x, y, color);
+	}
+}
+
+//Fills pixels [x0, x1) of two rows starting on an even row. Both rows share the same
+//columns, aligned groups of 8 pixels are a full 64 bytes column.
+static void FillSpanPairPSMCT32(CGsPixelFormats::CPixelIndexorPSMCT32& indexor, int32 y, int32 x0, int32 x1, uint32 color)
+{
+	assert((y & 1) == 0);
+	int32 alignedX0 = std::min<int32>((x0 + 7) & ~7, x1);
+	int32 alignedX1 = std::max<int32>(x1 & ~7, alignedX0);
+	for(int32 row = y; row < (y + 2); row++)
+	{
+		for(int32 x = x0; x < alignedX0; x++) indexor.SetPixel(x, row, color);
+		for(int32 x = alignedX1; x < x1; x++) indexor.SetPixel(x, row, color);
+	}
+#if defined(GS_SOFTWARE_SSE2)
+	__m128i colorVector = _mm_set1_epi32(color);
+	for(int32 x = alignedX0; x < alignedX1; x += 8)
+	{
+		auto column = reinterpret_cast<__m128i*>(indexor.GetPixelAddress(x, y));
+		_mm_storeu_si128(column + 0, colorVector);
+		_mm_storeu_si128(column + 1, colorVector);
+		_mm_storeu_si128(column + 2, colorVector);
+		_mm_storeu_si128(column + 3, colorVector);
+	}
+#elif defined(GS_SOFTWARE_NEON)
+	uint32x4_t colorVector = vdupq_n_u32(color);
+	for(int32 x = alignedX0; x < alignedX1; x += 8)
+	{
+		auto column = indexor.GetPixelAddress(x, y);
+		vst1q_u32(column + 0, colorVector);
+		vst1q_u32(column + 4, colorVector);
+		vst1q_u32(column + 8, colorVector);
+		vst1q_u32(column + 12, colorVector);
+	}
+#else
+	for(int32 x = alignedX0; x < alignedX1; x += 8)
+	{
+		auto column = indexor.GetPixelAddress(x, y);
+		std::fill(column, column + 16, color);
+	}
+#endif
+}
+
+template <typename Indexor>
+static void CopyPixels(uint8* ram, uint32 srcPtr, uint32 srcWidth, uint32 dstPtr, uint32 dstWidth,
+	uint32 srcX, uint32 srcY, uint32 dstX, uint32 dstY, uint32 width, uint32 height)
+{
+	Indexor srcIndexor(ram, srcPtr, srcWidth);
+	Indexor dstIndexor(ram, dstPtr, dstWidth);
+
+	//Source and destination might overlap, read everything first
+	std::vector<decltype(srcIndexor.GetPixel(0, 0))> pixels(width * height);
+	for(uint32 y = 0; y < height; y++)
+	{
+		for(uint32 x = 0; x < width; x++)
+		{
+			pixels[x + (y * width)] = srcIndexor.GetPixel((srcX + x) % 2048, (srcY + y) % 2048);
+		}
+	}
+	for(uint32 y = 0; y < height; y++)
+	{
+		for(uint32 x = 0; x < width; x++)
+		{
+			dstIndexor.SetPixel((dstX + x) % 2048, (dstY + y) % 2048, pixels[x + (y * width)]);
+		}
+	}
+}
+
+CGSH_Software::CGSH_Software()
+: m_nextActiveTile(0)
+{
+	memset(&m_vtxBuffer, 0, sizeof(m_vtxBuffer));
+	m_primitiveMode <<= 0;
+
+	//Observers of new frames (frame dumps, for instance) read RAM directly,
+	//everything that was drawn needs to be in there at that point
+	OnNewFrame.connect([this] (uint32) { FlushPrimitives(); });
+}
+
+CGSH_Software::~CGSH_Software()
+{
+
+}
+
+void CGSH_Software::InitializeImpl()
+{
+	//Build the swizzling tables here, workers will only read them
+	CGsPixelFormats::CPixelIndexorPSMCT32 indexorPSMCT32(m_pRAM, 0, 0);
+	CGsPixelFormats::CPixelIndexorPSMCT16 indexorPSMCT16(m_pRAM, 0, 0);
+	CGsPixelFormats::CPixelIndexorPSMCT16S indexorPSMCT16S(m_pRAM, 0, 0);
+	CGsPixelFormats::CPixelIndexorPSMT8 indexorPSMT8(m_pRAM, 0, 0);
+	CGsPixelFormats::CPixelIndexorPSMT4 indexorPSMT4(m_pRAM, 0, 0);
+
+	m_tileBins.resize(TILE_GRID_SIZE * TILE_GRID_SIZE);
+	m_activeTiles.reserve(TILE_GRID_SIZE * TILE_GRID_SIZE);
+	m_primitives.reserve(MAX_BATCH_PRIMITIVES);
+
+	StartWorkerThreads();
+	CLog::GetInstance().Print(LOG_NAME, "Rasterizing with %d thread(s).\r\n", GetWorkerThreadCount());
+}
+
+void CGSH_Software::ReleaseImpl()
+{
+	FlushPrimitives();
+	StopWorkerThreads();
+}
+
+void CGSH_Software::ResetImpl()
+{
+	ClearBatch();
+	m_vtxCount = 0;
+	m_primitiveType = PRIM_INVALID;
+	m_paletteDirty = true;
+}
+
+void CGSH_Software::FlipImpl()
+{
+	FlushPrimitives();
+	CGSHandler::FlipImpl();
+}
+
+void CGSH_Software::SaveState(Framework::CZipArchiveWriter& archive, bool saveMemoryAreas)
+{
+	SendGSCall([this] () { FlushPrimitives(); }, true);
+	CGSHandler::SaveState(archive, saveMemoryAreas);
+}
+
+unsigned int CGSH_Software::GetWorkerThreadCount() const
+{
+	//The GS thread also rasterizes tiles
+	return static_cast<unsigned int>(m_workerThreads.size()) + 1;
+}
+
+CGSHandler::FactoryFunction CGSH_Software::GetFactoryFunction()
+{
+	return std::bind(&CGSH_Software::GSHandlerFactory);
+}
+
+CGSHandler* CGSH_Software::GSHandlerFactory()
+{
+	return new CGSH_Software();
+}
+
+/////////////////////////////////////////////////////////////
+// Vertex Assembly
+/////////////////////////////////////////////////////////////
+
+void CGSH_Software::WriteRegisterImpl(uint8 nRegister, uint64 nData)
+{
+	switch(nRegister)
+	{
+	case GS_REG_TEX0_1:
+	case GS_REG_TEX0_2:
+	case GS_REG_TEX2_1:
+	case GS_REG_TEX2_2:
+		{
+			//CLUT might be loaded from an area that is still being drawn to (CLUT fields are at the same place in TEX2)
+			auto tex0 = make_convertible<TEX0>(nData);
+			if((tex0.nCLD != 0) && IsBatchWriteOverlapping(tex0.GetCLUTPtr(), CGsPixelFormats::PAGESIZE))
+			{
+				FlushPrimitives();
+			}
+		}
+		break;
+	case GS_REG_TRXDIR:
+		//Transfers access RAM directly
+		FlushPrimitives();
+		break;
+	}
+
+	CGSHandler::WriteRegisterImpl(nRegister, nData);
+
+	switch(nRegister)
+	{
+	case GS_REG_PRIM:
+		m_primitiveType = static_cast<unsigned int>(nData & 0x07);
+		switch(m_primitiveType)
+		{
+		case PRIM_POINT:
+			m_vtxCount = 1;
+			break;
+		case PRIM_LINE:
+		case PRIM_LINESTRIP:
+			m_vtxCount = 2;
+			break;
+		case PRIM_TRIANGLE:
+		case PRIM_TRIANGLESTRIP:
+		case PRIM_TRIANGLEFAN:
+			m_vtxCount = 3;
+			break;
+		case PRIM_SPRITE:
+			m_vtxCount = 2;
+			break;
+		default:
+			m_vtxCount = 0;
+			break;
+		}
+		break;
+
+	case GS_REG_XYZ2:
+	case GS_REG_XYZ3:
+	case GS_REG_XYZF2:
+	case GS_REG_XYZF3:
+		VertexKick(nRegister, nData);
+		break;
+	}
+}
+
+void CGSH_Software::VertexKick(uint8 nRegister, uint64 nValue)
+{
+	if(m_vtxCount == 0) return;
+
+	bool drawingKick = (nRegister == GS_REG_XYZ2) || (nRegister == GS_REG_XYZF2);
+	bool fog = (nRegister == GS_REG_XYZF2) || (nRegister == GS_REG_XYZF3);
+
+	if(!m_drawEnabled) drawingKick = false;
+
+	//Fog isn't supported, only keep the 24-bit Z value of XYZF writes
+	auto& vertex = m_vtxBuffer[m_vtxCount - 1];
+	vertex.position	= fog ? (nValue & 0x00FFFFFFFFFFFFFFULL) : nValue;
+	vertex.rgbaq	= m_nReg[GS_REG_RGBAQ];
+	vertex.uv		= m_nReg[GS_REG_UV];
+	vertex.st		= m_nReg[GS_REG_ST];
+
+	m_vtxCount--;
+
+	if(m_vtxCount == 0)
+	{
+		if((m_nReg[GS_REG_PRMODECONT] & 1) != 0)
+		{
+			m_primitiveMode <<= m_nReg[GS_REG_PRIM];
+		}
+		else
+		{
+			m_primitiveMode <<= m_nReg[GS_REG_PRMODE];
+		}
+
+		switch(m_primitiveType)
+		{
+		case PRIM_POINT:
+			if(drawingKick) Prim_Point();
+			m_vtxCount = 1;
+			break;
+		case PRIM_LINE:
+			if(drawingKick) Prim_Line();
+			m_vtxCount = 2;
+			break;
+		case PRIM_LINESTRIP:
+			if(drawingKick) Prim_Line();
+			m_vtxBuffer[1] = m_vtxBuffer[0];
+			m_vtxCount = 1;
+			break;
+		case PRIM_TRIANGLE:
+			if(drawingKick) Prim_Triangle();
+			m_vtxCount = 3;
+			break;
+		case PRIM_TRIANGLESTRIP:
+			if(drawingKick) Prim_Triangle();
+			m_vtxBuffer[2] = m_vtxBuffer[1];
+			m_vtxBuffer[1] = m_vtxBuffer[0];
+			m_vtxCount = 1;
+			break;
+		case PRIM_TRIANGLEFAN:
+			if(drawingKick) Prim_Triangle();
+			m_vtxBuffer[1] = m_vtxBuffer[0];
+			m_vtxCount = 1;
+			break;
+		case PRIM_SPRITE:
+			if(drawingKick) Prim_Sprite();
+			m_vtxCount = 2;
+			break;
+		}
+	}
+}
+
+CGSH_Software::RASTERVERTEX CGSH_Software::MakeRasterVertex(const VERTEX& vertex, const XYOFFSET& offset) const
+{
+	auto position = make_convertible<XYZ>(vertex.position);
+	auto rgbaq = make_convertible<RGBAQ>(vertex.rgbaq);
+
+	RASTERVERTEX result;
+	result.x = static_cast<int32>(position.nX) - static_cast<int32>(offset.nOffsetX);
+	result.y = static_cast<int32>(position.nY) - static_cast<int32>(offset.nOffsetY);
+	result.z = static_cast<double>(position.nZ);
+	result.color[0] = rgbaq.nR;
+	result.color[1] = rgbaq.nG;
+	result.color[2] = rgbaq.nB;
+	result.color[3] = rgbaq.nA;
+	if(m_primitiveMode.nUseUV)
+	{
+		auto uv = make_convertible<UV>(vertex.uv);
+		result.s = uv.GetU();
+		result.t = uv.GetV();
+		result.q = 1;
+	}
+	else
+	{
+		auto st = make_convertible<ST>(vertex.st);
+		result.s = st.nS;
+		result.t = st.nT;
+		result.q = rgbaq.nQ;
+	}
+	return result;
+}
+
+void CGSH_Software::Prim_Point()
+{
+	auto offset = make_convertible<XYOFFSET>(m_nReg[GS_REG_XYOFFSET_1 + m_primitiveMode.nContext]);
+
+	PRIMITIVE primitive;
+	primitive.type = PRIMITIVE_TYPE_POINT;
+	primitive.vertices[0] = MakeRasterVertex(m_vtxBuffer[0], offset);
+	primitive.minX = primitive.maxX = (primitive.vertices[0].x + 8) >> 4;
+	primitive.minY = primitive.maxY = (primitive.vertices[0].y + 8) >> 4;
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		SetupConstantPlane(primitive.colorPlanes[i], primitive.vertices[0].color[i]);
+	}
+	AddPrimitive(primitive);
+}
+
+void CGSH_Software::Prim_Line()
+{
+	auto offset = make_convertible<XYOFFSET>(m_nReg[GS_REG_XYOFFSET_1 + m_primitiveMode.nContext]);
+
+	PRIMITIVE primitive;
+	primitive.type = PRIMITIVE_TYPE_LINE;
+	primitive.vertices[0] = MakeRasterVertex(m_vtxBuffer[1], offset);
+	primitive.vertices[1] = MakeRasterVertex(m_vtxBuffer[0], offset);
+	if(!m_primitiveMode.nShading)
+	{
+		memcpy(primitive.vertices[0].color, primitive.vertices[1].color, sizeof(primitive.vertices[0].color));
+	}
+
+	int32 x0 = (primitive.vertices[0].x + 8) >> 4;
+	int32 y0 = (primitive.vertices[0].y + 8) >> 4;
+	int32 x1 = (primitive.vertices[1].x + 8) >> 4;
+	int32 y1 = (primitive.vertices[1].y + 8) >> 4;
+	primitive.minX = std::min(x0, x1);
+	primitive.minY = std::min(y0, y1);
+	primitive.maxX = std::max(x0, x1);
+	primitive.maxY = std::max(y0, y1);
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		SetupConstantPlane(primitive.colorPlanes[i], primitive.vertices[1].color[i]);
+	}
+	AddPrimitive(primitive);
+}
+
+void CGSH_Software::Prim_Triangle()
+{
+	auto offset = make_convertible<XYOFFSET>(m_nReg[GS_REG_XYOFFSET_1 + m_primitiveMode.nContext]);
+
+	PRIMITIVE primitive;
+	primitive.type = PRIMITIVE_TYPE_TRIANGLE;
+	primitive.vertices[0] = MakeRasterVertex(m_vtxBuffer[2], offset);
+	primitive.vertices[1] = MakeRasterVertex(m_vtxBuffer[1], offset);
+	primitive.vertices[2] = MakeRasterVertex(m_vtxBuffer[0], offset);
+	SetupTriangle(primitive);
+	AddPrimitive(primitive);
+}
+
+void CGSH_Software::Prim_Sprite()
+{
+	auto offset = make_convertible<XYOFFSET>(m_nReg[GS_REG_XYOFFSET_1 + m_primitiveMode.nContext]);
+
+	PRIMITIVE primitive;
+	primitive.type = PRIMITIVE_TYPE_SPRITE;
+	primitive.vertices[0] = MakeRasterVertex(m_vtxBuffer[1], offset);
+	primitive.vertices[1] = MakeRasterVertex(m_vtxBuffer[0], offset);
+	SetupSprite(primitive);
+	AddPrimitive(primitive);
+}
+
+void CGSH_Software::SetupTriangle(PRIMITIVE& primitive) const
+{
+	const auto& v0 = primitive.vertices[0];
+	const auto& v1 = primitive.vertices[1];
+	const auto& v2 = primitive.vertices[2];
+
+	int64 area = (static_cast<int64>(v1.x - v0.x) * (v2.y - v0.y)) - (static_cast<int64>(v2.x - v0.x) * (v1.y - v0.y));
+	if(area == 0)
+	{
+		primitive.minX = primitive.minY = 0;
+		primitive.maxX = primitive.maxY = -1;
+		return;
+	}
+
+	//Edge functions are positive inside the triangle, pixels exactly on an edge
+	//are only drawn if it's a top or left edge
+	const RASTERVERTEX* edgeVertices[3] = { &v0, &v1, &v2 };
+	if(area < 0) std::swap(edgeVertices[1], edgeVertices[2]);
+	for(unsigned int i = 0; i < 3; i++)
+	{
+		const auto& start = *edgeVertices[i];
+		const auto& end = *edgeVertices[(i + 1) % 3];
+		auto& edge = primitive.edges[i];
+		edge.a = -static_cast<int64>(end.y - start.y);
+		edge.b = static_cast<int64>(end.x - start.x);
+		edge.c = -((edge.a * start.x) + (edge.b * start.y));
+		bool topLeft = (edge.a > 0) || ((edge.a == 0) && (edge.b > 0));
+		if(!topLeft) edge.c -= 1;
+	}
+
+	int32 minX = std::min(v0.x, std::min(v1.x, v2.x));
+	int32 minY = std::min(v0.y, std::min(v1.y, v2.y));
+	int32 maxX = std::max(v0.x, std::max(v1.x, v2.x));
+	int32 maxY = std::max(v0.y, std::max(v1.y, v2.y));
+	primitive.minX = (minX + 15) >> 4;
+	primitive.minY = (minY + 15) >> 4;
+	primitive.maxX = maxX >> 4;
+	primitive.maxY = maxY >> 4;
+
+	double x[3] = { v0.x / 16.0, v1.x / 16.0, v2.x / 16.0 };
+	double y[3] = { v0.y / 16.0, v1.y / 16.0, v2.y / 16.0 };
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		if(m_primitiveMode.nShading)
+		{
+			SetupPlane(primitive.colorPlanes[i], x, y, v0.color[i], v1.color[i], v2.color[i]);
+		}
+		else
+		{
+			SetupConstantPlane(primitive.colorPlanes[i], v2.color[i]);
+		}
+	}
+	SetupPlane(primitive.stPlanes[0], x, y, v0.s, v1.s, v2.s);
+	SetupPlane(primitive.stPlanes[1], x, y, v0.t, v1.t, v2.t);
+	SetupPlane(primitive.stPlanes[2], x, y, v0.q, v1.q, v2.q);
+	SetupPlane(primitive.zPlane, x, y, v0.z, v1.z, v2.z);
+}
+
+void CGSH_Software::SetupSprite(PRIMITIVE& primitive) const
+{
+	const auto& v0 = primitive.vertices[0];
+	const auto& v1 = primitive.vertices[1];
+
+	//Sprites cover [x0, x1[ and [y0, y1[
+	primitive.minX = (std::min(v0.x, v1.x) + 15) >> 4;
+	primitive.minY = (std::min(v0.y, v1.y) + 15) >> 4;
+	primitive.maxX = ((std::max(v0.x, v1.x) + 15) >> 4) - 1;
+	primitive.maxY = ((std::max(v0.y, v1.y) + 15) >> 4) - 1;
+
+	//Color and depth come from the last vertex
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		SetupConstantPlane(primitive.colorPlanes[i], v1.color[i]);
+	}
+	SetupConstantPlane(primitive.zPlane, v1.z);
+
+	//Texture coordinates vary along one axis only, STQ coordinates are projected per vertex
+	float s0 = v0.s / v0.q;
+	float s1 = v1.s / v1.q;
+	float t0 = v0.t / v0.q;
+	float t1 = v1.t / v1.q;
+	float x0 = v0.x / 16.0f;
+	float x1 = v1.x / 16.0f;
+	float y0 = v0.y / 16.0f;
+	float y1 = v1.y / 16.0f;
+	SetupConstantPlane(primitive.stPlanes[0], s0);
+	SetupConstantPlane(primitive.stPlanes[1], t0);
+	SetupConstantPlane(primitive.stPlanes[2], 1.0f);
+	if(x1 != x0)
+	{
+		primitive.stPlanes[0].dx = (s1 - s0) / (x1 - x0);
+		primitive.stPlanes[0].c = s0 - (primitive.stPlanes[0].dx * x0);
+	}
+	if(y1 != y0)
+	{
+		primitive.stPlanes[1].dy = (t1 - t0) / (y1 - y0);
+		primitive.stPlanes[1].c = t0 - (primitive.stPlanes[1].dy * y0);
+	}
+}
+
+/////////////////////////////////////////////////////////////
+// Batching
+/////////////////////////////////////////////////////////////
+
+void CGSH_Software::AddPrimitive(PRIMITIVE& primitive)
+{
+	unsigned int context = m_primitiveMode.nContext;
+	auto scissor = make_convertible<SCISSOR>(m_nReg[GS_REG_SCISSOR_1 + context]);
+
+	primitive.minX = std::max<int32>(primitive.minX, scissor.scax0);
+	primitive.minY = std::max<int32>(primitive.minY, scissor.scay0);
+	primitive.maxX = std::min<int32>(primitive.maxX, scissor.scax1);
+	primitive.maxY = std::min<int32>(primitive.maxY, scissor.scay1);
+	if((primitive.minX > primitive.maxX) || (primitive.minY > primitive.maxY)) return;
+
+	auto frame = make_convertible<FRAME>(m_nReg[GS_REG_FRAME_1 + context]);
+	auto zbuf = make_convertible<ZBUF>(m_nReg[GS_REG_ZBUF_1 + context]);
+	auto test = make_convertible<TEST>(m_nReg[GS_REG_TEST_1 + context]);
+	auto tex0 = make_convertible<TEX0>(m_nReg[GS_REG_TEX0_1 + context]);
+
+	//Lower half of FRAME and ZBUF hold the buffer's address, width and format
+	uint32 frameKey = static_cast<uint32>(m_nReg[GS_REG_FRAME_1 + context]);
+	uint32 zbufKey = static_cast<uint32>(m_nReg[GS_REG_ZBUF_1 + context]);
+	bool usesDepth = (test.nDepthEnabled != 0);
+
+	if(!m_primitives.empty())
+	{
+		//Tiles can only be rasterized independently if every primitive of the batch uses the same buffers
+		bool needsFlush = (m_primitives.size() >= MAX_BATCH_PRIMITIVES);
+		needsFlush |= (frameKey != m_batchFrame);
+		needsFlush |= usesDepth && m_batchUsesDepth && (zbufKey != m_batchZbuf);
+		if(m_primitiveMode.nTexture)
+		{
+			//Sampling from something drawn by this batch
+			needsFlush |= IsBatchWriteOverlapping(tex0.GetBufPtr(), GetSurfaceSize(tex0.nPsm, tex0.GetBufWidth(), tex0.GetHeight()));
+		}
+		if(needsFlush)
+		{
+			FlushPrimitives();
+		}
+	}
+
+	if(m_primitives.empty())
+	{
+		m_batchFrame = frameKey;
+		m_batchUsesDepth = false;
+		m_batchWriteStart = ~0U;
+		m_batchWriteEnd = 0;
+	}
+
+	{
+		uint32 frameSize = GetSurfaceSize(frame.nPsm, frame.GetWidth(), primitive.maxY + 1);
+		m_batchWriteStart = std::min(m_batchWriteStart, frame.GetBasePtr());
+		m_batchWriteEnd = std::max(m_batchWriteEnd, frame.GetBasePtr() + frameSize);
+	}
+
+	if(usesDepth)
+	{
+		m_batchZbuf = zbufKey;
+		m_batchUsesDepth = true;
+		uint32 zbufSize = GetSurfaceSize(zbuf.nPsm | 0x30, frame.GetWidth(), primitive.maxY + 1);
+		m_batchWriteStart = std::min(m_batchWriteStart, zbuf.GetBasePtr());
+		m_batchWriteEnd = std::max(m_batchWriteEnd, zbuf.GetBasePtr() + zbufSize);
+	}
+
+	primitive.stateIndex = MakeDrawState();
+
+	{
+		const auto& state = m_drawStates[primitive.stateIndex];
+		bool flatColor = (primitive.type == PRIMITIVE_TYPE_SPRITE) || ((primitive.type == PRIMITIVE_TYPE_TRIANGLE) && !m_primitiveMode.nShading);
+		bool depthPassthrough = !test.nDepthEnabled || ((test.nDepthMethod == DEPTH_TEST_ALWAYS) && zbuf.nMask);
+		bool alphaPassthrough = !test.nAlphaEnabled || (test.nAlphaMethod == ALPHA_TEST_ALWAYS);
+		primitive.flatFill = flatColor && !state.textured && !state.alphaBlend &&
+			(frame.nPsm == PSMCT32) && (frame.nMask == 0) && depthPassthrough && alphaPassthrough;
+		primitive.fillColor = 0;
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			primitive.fillColor |= static_cast<uint32>(ClampColor(static_cast<int>(primitive.colorPlanes[i].c))) << (i * 8);
+		}
+	}
+
+	uint32 primitiveIndex = static_cast<uint32>(m_primitives.size());
+	m_primitives.push_back(primitive);
+
+	for(int32 tileY = (primitive.minY >> TILE_SIZE_SHIFT); tileY <= (primitive.maxY >> TILE_SIZE_SHIFT); tileY++)
+	{
+		for(int32 tileX = (primitive.minX >> TILE_SIZE_SHIFT); tileX <= (primitive.maxX >> TILE_SIZE_SHIFT); tileX++)
+		{
+			uint32 tileIndex = tileX + (tileY * TILE_GRID_SIZE);
+			auto& bin = m_tileBins[tileIndex];
+			if(bin.empty())
+			{
+				m_activeTiles.push_back(tileIndex);
+			}
+			bin.push_back(primitiveIndex);
+		}
+	}
+}
+
+uint32 CGSH_Software::MakeDrawState()
+{
+	unsigned int context = m_primitiveMode.nContext;
+
+	DRAWSTATE state;
+	memset(&state, 0, sizeof(DRAWSTATE));
+	state.frame = m_nReg[GS_REG_FRAME_1 + context];
+	state.zbuf = m_nReg[GS_REG_ZBUF_1 + context];
+	state.test = m_nReg[GS_REG_TEST_1 + context];
+	state.textured = m_primitiveMode.nTexture;
+	state.alphaBlend = m_primitiveMode.nAlpha;
+	if(state.alphaBlend)
+	{
+		state.alpha = m_nReg[GS_REG_ALPHA_1 + context];
+	}
+	if(state.textured)
+	{
+		auto tex0 = make_convertible<TEX0>(m_nReg[GS_REG_TEX0_1 + context]);
+		auto texa = make_convertible<TEXA>(m_nReg[GS_REG_TEXA]);
+		state.tex0 = tex0;
+		state.clamp = m_nReg[GS_REG_CLAMP_1 + context];
+		state.texa = texa;
+		state.useUv = m_primitiveMode.nUseUV;
+		if(CGsPixelFormats::IsPsmIDTEX(tex0.nPsm))
+		{
+			state.paletteIndex = CapturePalette(tex0, texa);
+		}
+	}
+
+	if(!m_drawStates.empty() && (memcmp(&m_drawStates.back(), &state, sizeof(DRAWSTATE)) == 0))
+	{
+		return static_cast<uint32>(m_drawStates.size() - 1);
+	}
+	m_drawStates.push_back(state);
+	return static_cast<uint32>(m_drawStates.size() - 1);
+}
+
+uint32 CGSH_Software::CapturePalette(const TEX0& tex0, const TEXA& texa)
+{
+	bool isIdx4 = CGsPixelFormats::IsPsmIDTEX4(tex0.nPsm);
+
+	//The CLUT buffer gets reloaded while primitives using a previous state are still waiting to be drawn,
+	//keep a copy of the palette as it is now
+	if(!m_paletteDirty && !m_palettes.empty())
+	{
+		auto paletteTex0 = make_convertible<TEX0>(m_paletteTex0);
+		if(
+			(paletteTex0.nCPSM == tex0.nCPSM) &&
+			(paletteTex0.nCSA == tex0.nCSA) &&
+			(CGsPixelFormats::IsPsmIDTEX4(paletteTex0.nPsm) == isIdx4) &&
+			(m_paletteTexa == static_cast<uint64>(texa))
+			)
+		{
+			return static_cast<uint32>(m_palettes.size() - 1);
+		}
+	}
+
+	Palette palette;
+	palette.fill(0);
+	unsigned int entryCount = isIdx4 ? 16 : 256;
+	uint32 clutOffset = isIdx4 ? (tex0.nCSA * 16) : 0;
+	if((tex0.nCPSM == PSMCT32) || (tex0.nCPSM == PSMCT24))
+	{
+		for(unsigned int i = 0; i < entryCount; i++)
+		{
+			uint32 entry = (i + clutOffset) & 0xFF;
+			palette[i] =
+				(static_cast<uint32>(m_pCLUT[entry + 0x000])) |
+				(static_cast<uint32>(m_pCLUT[entry + 0x100]) << 16);
+		}
+	}
+	else
+	{
+		for(unsigned int i = 0; i < entryCount; i++)
+		{
+			uint32 entry = (i + clutOffset) & 0x1FF;
+			palette[i] = ExpandTexel16(m_pCLUT[entry], texa);
+		}
+	}
+
+	m_palettes.push_back(palette);
+	m_paletteTex0 = tex0;
+	m_paletteTexa = texa;
+	m_paletteDirty = false;
+	return static_cast<uint32>(m_palettes.size() - 1);
+}
+
+bool CGSH_Software::IsBatchWriteOverlapping(uint32 start, uint32 size) const
+{
+	if(m_primitives.empty()) return false;
+	return (start < m_batchWriteEnd) && ((start + size) > m_batchWriteStart);
+}
+
+void CGSH_Software::FlushPrimitives()
+{
+	if(m_primitives.empty()) return;
+
+	m_drawCallCount++;
+	m_nextActiveTile = 0;
+	if(m_workerThreads.empty())
+	{
+		ProcessTiles();
+	}
+	else
+	{
+		{
+			std::lock_guard<std::mutex> workerLock(m_workerMutex);
+			m_workerBatchId++;
+			m_busyWorkerCount = static_cast<unsigned int>(m_workerThreads.size());
+		}
+		m_workerCondition.notify_all();
+		ProcessTiles();
+		{
+			std::unique_lock<std::mutex> workerLock(m_workerMutex);
+			m_workerDoneCondition.wait(workerLock, [this] () { return m_busyWorkerCount == 0; });
+		}
+	}
+
+	ClearBatch();
+}
+
+void CGSH_Software::ClearBatch()
+{
+	for(auto tileIndex : m_activeTiles)
+	{
+		m_tileBins[tileIndex].clear();
+	}
+	m_activeTiles.clear();
+	m_primitives.clear();
+	m_drawStates.clear();
+	m_palettes.clear();
+	m_paletteDirty = true;
+}
+
+/////////////////////////////////////////////////////////////
+// Worker Threads
+/////////////////////////////////////////////////////////////
+
+void CGSH_Software::StartWorkerThreads()
+{
+	assert(m_workerThreads.empty());
+	unsigned int threadCount = std::max<unsigned int>(std::thread::hardware_concurrency(), 1);
+	threadCount = std::min<unsigned int>(threadCount, MAX_WORKER_THREADS);
+	m_workerTerminate = false;
+	for(unsigned int i = 1; i < threadCount; i++)
+	{
+		m_workerThreads.emplace_back([this] () { WorkerThreadProc(); });
+	}
+}
+
+void CGSH_Software::StopWorkerThreads()
+{
+	{
+		std::lock_guard<std::mutex> workerLock(m_workerMutex);
+		m_workerTerminate = true;
+	}
+	m_workerCondition.notify_all();
+	for(auto& workerThread : m_workerThreads)
+	{
+		workerThread.join();
+	}
+	m_workerThreads.clear();
+}
+
+void CGSH_Software::WorkerThreadProc()
+{
+	std::unique_lock<std::mutex> workerLock(m_workerMutex);
+	uint32 batchId = m_workerBatchId;
+	while(1)
+	{
+		m_workerCondition.wait(workerLock, [&] () { return m_workerTerminate || (m_workerBatchId != batchId); });
+		if(m_workerTerminate) break;
+		batchId = m_workerBatchId;
+
+		workerLock.unlock();
+		ProcessTiles();
+		workerLock.lock();
+
+		assert(m_busyWorkerCount != 0);
+		m_busyWorkerCount--;
+		if(m_busyWorkerCount == 0)
+		{
+			m_workerDoneCondition.notify_one();
+		}
+	}
+}
+
+void CGSH_Software::ProcessTiles()
+{
+	uint32 activeTileCount = static_cast<uint32>(m_activeTiles.size());
+	while(1)
+	{
+		uint32 activeTileIndex = m_nextActiveTile++;
+		if(activeTileIndex >= activeTileCount) break;
+		RasterizeTile(m_activeTiles[activeTileIndex]);
+	}
+}
+
+/////////////////////////////////////////////////////////////
+// Rasterization
+/////////////////////////////////////////////////////////////
+
+void CGSH_Software::RasterizeTile(uint32 tileIndex)
+{
+	int32 tileX0 = (tileIndex % TILE_GRID_SIZE) * TILE_SIZE;
+	int32 tileY0 = (tileIndex / TILE_GRID_SIZE) * TILE_SIZE;
+	int32 tileX1 = tileX0 + TILE_SIZE - 1;
+	int32 tileY1 = tileY0 + TILE_SIZE - 1;
+
+	for(auto primitiveIndex : m_tileBins[tileIndex])
+	{
+		const auto& primitive = m_primitives[primitiveIndex];
+		int32 x0 = std::max(tileX0, primitive.minX);
+		int32 y0 = std::max(tileY0, primitive.minY);
+		int32 x1 = std::min(tileX1, primitive.maxX);
+		int32 y1 = std::min(tileY1, primitive.maxY);
+		if((x0 > x1) || (y0 > y1)) continue;
+
+		switch(primitive.type)
+		{
+		case PRIMITIVE_TYPE_POINT:
+			RasterizePoint(primitive, x0, y0, x1, y1);
+			break;
+		case PRIMITIVE_TYPE_LINE:
+			RasterizeLine(primitive, x0, y0, x1, y1);
+			break;
+		case PRIMITIVE_TYPE_TRIANGLE:
+			if(primitive.flatFill)
+			{
+				FillTriangle(primitive, x0, y0, x1, y1);
+			}
+			else
+			{
+				RasterizeTriangle(primitive, x0, y0, x1, y1);
+			}
+			break;
+		case PRIMITIVE_TYPE_SPRITE:
+			if(primitive.flatFill)
+			{
+				FillSprite(primitive, x0, y0, x1, y1);
+			}
+			else
+			{
+				RasterizeSprite(primitive, x0, y0, x1, y1);
+			}
+			break;
+		}
+	}
+}
+
+void CGSH_Software::RasterizePoint(const PRIMITIVE& primitive, int32 x0, int32 y0, int32, int32)
+{
+	const auto& vertex = primitive.vertices[0];
+	FRAGMENT fragment;
+	fragment.z = vertex.z;
+	memcpy(fragment.color, vertex.color, sizeof(fragment.color));
+	fragment.s = vertex.s;
+	fragment.t = vertex.t;
+	fragment.q = vertex.q;
+	DrawPixel(primitive, x0, y0, fragment);
+}
+
+void CGSH_Software::RasterizeLine(const PRIMITIVE& primitive, int32 x0, int32 y0, int32 x1, int32 y1)
+{
+	const auto& start = primitive.vertices[0];
+	const auto& end = primitive.vertices[1];
+
+	//Step one pixel at a time along the major axis, the last pixel isn't drawn
+	int32 deltaX = end.x - start.x;
+	int32 deltaY = end.y - start.y;
+	int32 stepCount = std::max(std::abs(deltaX), std::abs(deltaY)) / 16;
+	stepCount = std::max(stepCount, 1);
+	for(int32 step = 0; step < stepCount; step++)
+	{
+		float ratio = static_cast<float>(step) / static_cast<float>(stepCount);
+		int32 x = (start.x + static_cast<int32>(deltaX * ratio) + 8) >> 4;
+		int32 y = (start.y + static_cast<int32>(deltaY * ratio) + 8) >> 4;
+		if((x < x0) || (x > x1) || (y < y0) || (y > y1)) continue;
+
+		FRAGMENT fragment;
+		fragment.z = start.z + ((end.z - start.z) * ratio);
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			fragment.color[i] = start.color[i] + ((end.color[i] - start.color[i]) * ratio);
+		}
+		fragment.s = start.s + ((end.s - start.s) * ratio);
+		fragment.t = start.t + ((end.t - start.t) * ratio);
+		fragment.q = start.q + ((end.q - start.q) * ratio);
+		DrawPixel(primitive, x, y, fragment);
+	}
+}
+
+void CGSH_Software::RasterizeTriangle(const PRIMITIVE& primitive, int32 x0, int32 y0, int32 x1, int32 y1)
+{
+	const auto& edges = primitive.edges;
+	for(int32 y = y0; y <= y1; y++)
+	{
+		int64 sampleX = static_cast<int64>(x0) * 16;
+		int64 sampleY = static_cast<int64>(y) * 16;
+		int64 e0 = (edges[0].a * sampleX) + (edges[0].b * sampleY) + edges[0].c;
+		int64 e1 = (edges[1].a * sampleX) + (edges[1].b * sampleY) + edges[1].c;
+		int64 e2 = (edges[2].a * sampleX) + (edges[2].b * sampleY) + edges[2].c;
+		for(int32 x = x0; x <= x1; x++)
+		{
+			if((e0 | e1 | e2) >= 0)
+			{
+				float fx = static_cast<float>(x);
+				float fy = static_cast<float>(y);
+				FRAGMENT fragment;
+				fragment.z = primitive.zPlane.Evaluate(fx, fy);
+				for(unsigned int i = 0; i < 4; i++)
+				{
+					fragment.color[i] = primitive.colorPlanes[i].Evaluate(fx, fy);
+				}
+				fragment.s = primitive.stPlanes[0].Evaluate(fx, fy);
+				fragment.t = primitive.stPlanes[1].Evaluate(fx, fy);
+				fragment.q = primitive.stPlanes[2].Evaluate(fx, fy);
+				DrawPixel(primitive, x, y, fragment);
+			}
+			e0 += edges[0].a * 16;
+			e1 += edges[1].a * 16;
+			e2 += edges[2].a * 16;
+		}
+	}
+}
+
+void CGSH_Software::RasterizeSprite(const PRIMITIVE& primitive, int32 x0, int32 y0, int32 x1, int32 y1)
+{
+	FRAGMENT fragment;
+	fragment.z = primitive.zPlane.c;
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		fragment.color[i] = primitive.colorPlanes[i].c;
+	}
+	fragment.q = 1;
+	for(int32 y = y0; y <= y1; y++)
+	{
+		fragment.t = primitive.stPlanes[1].Evaluate(0, static_cast<float>(y));
+		for(int32 x = x0; x <= x1; x++)
+		{
+			fragment.s = primitive.stPlanes[0].Evaluate(static_cast<float>(x), 0);
+			DrawPixel(primitive, x, y, fragment);
+		}
+	}
+}
+
+void CGSH_Software::FillTriangle(const PRIMITIVE& primitive, int32 x0, int32 y0, int32 x1, int32 y1)
+{
+	auto frame = make_convertible<FRAME>(m_drawStates[primitive.stateIndex].frame);
+	CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, frame.GetBasePtr(), frame.nWidth);
+
+	const auto& edges = primitive.edges;
+	for(int32 y = y0; y <= y1; y++)
+	{
+		int64 sampleX = static_cast<int64>(x0) * 16;
+		int64 sampleY = static_cast<int64>(y) * 16;
+		int64 e0 = (edges[0].a * sampleX) + (edges[0].b * sampleY) + edges[0].c;
+		int64 e1 = (edges[1].a * sampleX) + (edges[1].b * sampleY) + edges[1].c;
+		int64 e2 = (edges[2].a * sampleX) + (edges[2].b * sampleY) + edges[2].c;
+
+		//Covered pixels of a row are contiguous, find where they start and end
+		int32 spanStart = x1 + 1;
+		int32 spanEnd = x0;
+		for(int32 x = x0; x <= x1; x++)
+		{
+			if((e0 | e1 | e2) >= 0)
+			{
+				spanStart = std::min(spanStart, x);
+				spanEnd = x + 1;
+			}
+			else if(spanStart <= x1)
+			{
+				break;
+			}
+			e0 += edges[0].a * 16;
+			e1 += edges[1].a * 16;
+			e2 += edges[2].a * 16;
+		}
+
+		if(spanStart < spanEnd)
+		{
+			FillSpanPSMCT32(indexor, y, spanStart, spanEnd, primitive.fillColor);
+		}
+	}
+}
+
+void CGSH_Software::FillSprite(const PRIMITIVE& primitive, int32 x0, int32 y0, int32 x1, int32 y1)
+{
+	auto frame = make_convertible<FRAME>(m_drawStates[primitive.stateIndex].frame);
+	CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, frame.GetBasePtr(), frame.nWidth);
+
+	int32 y = y0;
+	while(y <= y1)
+	{
+		if(((y & 1) == 0) && (y < y1))
+		{
+			FillSpanPairPSMCT32(indexor, y, x0, x1 + 1, primitive.fillColor);
+			y += 2;
+		}
+		else
+		{
+			FillSpanPSMCT32(indexor, y, x0, x1 + 1, primitive.fillColor);
+			y += 1;
+		}
+	}
+}
+
+void CGSH_Software::DrawPixel(const PRIMITIVE& primitive, int32 x, int32 y, const FRAGMENT& fragment)
+{
+	const auto& state = m_drawStates[primitive.stateIndex];
+	auto frame = make_convertible<FRAME>(state.frame);
+	auto zbuf = make_convertible<ZBUF>(state.zbuf);
+	auto test = make_convertible<TEST>(state.test);
+
+	int color[4];
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		color[i] = ClampColor(static_cast<int>(fragment.color[i]));
+	}
+
+	if(state.textured)
+	{
+		auto tex0 = make_convertible<TEX0>(state.tex0);
+		uint32 texel = SampleTexture(state, fragment);
+		int texColor[4] =
+		{
+			static_cast<int>((texel >>  0) & 0xFF),
+			static_cast<int>((texel >>  8) & 0xFF),
+			static_cast<int>((texel >> 16) & 0xFF),
+			static_cast<int>((texel >> 24) & 0xFF),
+		};
+		switch(tex0.nFunction)
+		{
+		case TEX0_FUNCTION_MODULATE:
+			for(unsigned int i = 0; i < 3; i++)
+			{
+				color[i] = ClampColor((texColor[i] * color[i]) >> 7);
+			}
+			if(tex0.nColorComp) color[3] = ClampColor((texColor[3] * color[3]) >> 7);
+			break;
+		case TEX0_FUNCTION_DECAL:
+			for(unsigned int i = 0; i < 3; i++)
+			{
+				color[i] = texColor[i];
+			}
+			if(tex0.nColorComp) color[3] = texColor[3];
+			break;
+		case TEX0_FUNCTION_HIGHLIGHT:
+		case TEX0_FUNCTION_HIGHLIGHT2:
+			for(unsigned int i = 0; i < 3; i++)
+			{
+				color[i] = ClampColor(((texColor[i] * color[i]) >> 7) + color[3]);
+			}
+			if(tex0.nColorComp)
+			{
+				color[3] = (tex0.nFunction == TEX0_FUNCTION_HIGHLIGHT) ? ClampColor(texColor[3] + color[3]) : texColor[3];
+			}
+			break;
+		}
+	}
+
+	bool writeFrame = true;
+	bool writeAlpha = true;
+	bool writeDepth = test.nDepthEnabled && !zbuf.nMask;
+
+	if(test.nAlphaEnabled)
+	{
+		bool alphaPassed = true;
+		int alphaRef = test.nAlphaRef;
+		switch(test.nAlphaMethod)
+		{
+		case ALPHA_TEST_NEVER:		alphaPassed = false;				break;
+		case ALPHA_TEST_ALWAYS:		alphaPassed = true;					break;
+		case ALPHA_TEST_LESS:		alphaPassed = color[3] < alphaRef;	break;
+		case ALPHA_TEST_LEQUAL:		alphaPassed = color[3] <= alphaRef;	break;
+		case ALPHA_TEST_EQUAL:		alphaPassed = color[3] == alphaRef;	break;
+		case ALPHA_TEST_GEQUAL:		alphaPassed = color[3] >= alphaRef;	break;
+		case ALPHA_TEST_GREATER:	alphaPassed = color[3] > alphaRef;	break;
+		case ALPHA_TEST_NOTEQUAL:	alphaPassed = color[3] != alphaRef;	break;
+		}
+		if(!alphaPassed)
+		{
+			switch(test.nAlphaFail)
+			{
+			case ALPHA_TEST_FAIL_KEEP:
+				return;
+			case ALPHA_TEST_FAIL_FBONLY:
+				writeDepth = false;
+				break;
+			case ALPHA_TEST_FAIL_ZBONLY:
+				writeFrame = false;
+				break;
+			case ALPHA_TEST_FAIL_RGBONLY:
+				writeDepth = false;
+				writeAlpha = false;
+				break;
+			}
+		}
+	}
+
+	if(test.nDepthEnabled)
+	{
+		uint32 depthMax = GetDepthMax(zbuf.nPsm);
+		uint32 depth = static_cast<uint32>(std::min<double>(std::max<double>(fragment.z, 0), depthMax));
+		uint32 currentDepth = 0;
+		uint32* depthPixel32 = nullptr;
+		uint16* depthPixel16 = nullptr;
+		switch(zbuf.nPsm | 0x30)
+		{
+		case PSMZ16:
+			{
+				CGsPixelFormats::CPixelIndexorPSMCT16 indexor(m_pRAM, zbuf.GetBasePtr(), frame.nWidth);
+				depthPixel16 = indexor.GetPixelAddress(x, y);
+				currentDepth = *depthPixel16;
+			}
+			break;
+		case PSMZ16S:
+			{
+				CGsPixelFormats::CPixelIndexorPSMCT16S indexor(m_pRAM, zbuf.GetBasePtr(), frame.nWidth);
+				depthPixel16 = indexor.GetPixelAddress(x, y);
+				currentDepth = *depthPixel16;
+			}
+			break;
+		default:
+			{
+				CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, zbuf.GetBasePtr(), frame.nWidth);
+				depthPixel32 = indexor.GetPixelAddress(x, y);
+				currentDepth = *depthPixel32 & depthMax;
+			}
+			break;
+		}
+
+		switch(test.nDepthMethod)
+		{
+		case DEPTH_TEST_NEVER:
+			return;
+		case DEPTH_TEST_ALWAYS:
+			break;
+		case DEPTH_TEST_GEQUAL:
+			if(depth < currentDepth) return;
+			break;
+		case DEPTH_TEST_GREATER:
+			if(depth <= currentDepth) return;
+			break;
+		}
+
+		if(writeDepth)
+		{
+			if(depthPixel16)
+			{
+				*depthPixel16 = static_cast<uint16>(depth);
+			}
+			else
+			{
+				*depthPixel32 = (*depthPixel32 & ~depthMax) | depth;
+			}
+		}
+	}
+
+	if(!writeFrame) return;
+
+	uint32* framePixel32 = nullptr;
+	uint16* framePixel16 = nullptr;
+	uint32 destColor = 0;
+	switch(frame.nPsm)
+	{
+	case PSMCT16:
+	case PSMZ16:
+		{
+			CGsPixelFormats::CPixelIndexorPSMCT16 indexor(m_pRAM, frame.GetBasePtr(), frame.nWidth);
+			framePixel16 = indexor.GetPixelAddress(x, y);
+		}
+		break;
+	case PSMCT16S:
+	case PSMZ16S:
+		{
+			CGsPixelFormats::CPixelIndexorPSMCT16S indexor(m_pRAM, frame.GetBasePtr(), frame.nWidth);
+			framePixel16 = indexor.GetPixelAddress(x, y);
+		}
+		break;
+	default:
+		{
+			CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, frame.GetBasePtr(), frame.nWidth);
+			framePixel32 = indexor.GetPixelAddress(x, y);
+		}
+		break;
+	}
+
+	if(framePixel16)
+	{
+		uint16 pixel = *framePixel16;
+		destColor = UnpackColor16(pixel, (pixel & 0x8000) ? 0x80 : 0);
+	}
+	else
+	{
+		destColor = *framePixel32;
+		if((frame.nPsm == PSMCT24) || (frame.nPsm == PSMZ24)) destColor = (destColor & 0x00FFFFFF) | 0x80000000;
+	}
+
+	if(state.alphaBlend)
+	{
+		auto alpha = make_convertible<ALPHA>(state.alpha);
+		int destAlpha = static_cast<int>(destColor >> 24);
+		int factor = 0;
+		switch(alpha.nC)
+		{
+		case ALPHABLEND_C_AS:	factor = color[3];		break;
+		case ALPHABLEND_C_AD:	factor = destAlpha;		break;
+		default:				factor = alpha.nFix;	break;
+		}
+		for(unsigned int i = 0; i < 3; i++)
+		{
+			int sourceValue = color[i];
+			int destValue = static_cast<int>((destColor >> (i * 8)) & 0xFF);
+			int values[3] = { sourceValue, destValue, 0 };
+			int a = values[std::min<unsigned int>(alpha.nA, ALPHABLEND_ABD_ZERO)];
+			int b = values[std::min<unsigned int>(alpha.nB, ALPHABLEND_ABD_ZERO)];
+			int d = values[std::min<unsigned int>(alpha.nD, ALPHABLEND_ABD_ZERO)];
+			color[i] = ClampColor((((a - b) * factor) >> 7) + d);
+		}
+	}
+
+	uint32 newColor = 0;
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		newColor |= static_cast<uint32>(color[i]) << (i * 8);
+	}
+	uint32 writeMask = ~frame.nMask;
+	if(!writeAlpha) writeMask &= 0x00FFFFFF;
+
+	if(framePixel16)
+	{
+		uint16 writeMask16 = PackColor16(writeMask);
+		*framePixel16 = (*framePixel16 & ~writeMask16) | (PackColor16(newColor) & writeMask16);
+	}
+	else
+	{
+		if((frame.nPsm == PSMCT24) || (frame.nPsm == PSMZ24)) writeMask &= 0x00FFFFFF;
+		*framePixel32 = (*framePixel32 & ~writeMask) | (newColor & writeMask);
+	}
+}
+
+uint32 CGSH_Software::SampleTexture(const DRAWSTATE& state, const FRAGMENT& fragment) const
+{
+	auto tex0 = make_convertible<TEX0>(state.tex0);
+	auto clamp = make_convertible<CLAMP>(state.clamp);
+	int32 width = tex0.GetWidth();
+	int32 height = tex0.GetHeight();
+
+	float u = fragment.s;
+	float v = fragment.t;
+	if(!state.useUv)
+	{
+		float q = (fragment.q != 0) ? fragment.q : 1.0f;
+		u = (fragment.s / q) * width;
+		v = (fragment.t / q) * height;
+	}
+
+	int32 texelX = static_cast<int32>(std::floor(u));
+	int32 texelY = static_cast<int32>(std::floor(v));
+
+	switch(clamp.nWMS)
+	{
+	case CLAMP_MODE_REPEAT:
+		texelX &= (width - 1);
+		break;
+	case CLAMP_MODE_CLAMP:
+		texelX = std::min<int32>(std::max<int32>(texelX, 0), width - 1);
+		break;
+	case CLAMP_MODE_REGION_CLAMP:
+		texelX = std::min<int32>(std::max<int32>(texelX, clamp.GetMinU()), clamp.GetMaxU());
+		break;
+	case CLAMP_MODE_REGION_REPEAT:
+		texelX = (texelX & clamp.GetMinU()) | clamp.GetMaxU();
+		break;
+	}
+
+	switch(clamp.nWMT)
+	{
+	case CLAMP_MODE_REPEAT:
+		texelY &= (height - 1);
+		break;
+	case CLAMP_MODE_CLAMP:
+		texelY = std::min<int32>(std::max<int32>(texelY, 0), height - 1);
+		break;
+	case CLAMP_MODE_REGION_CLAMP:
+		texelY = std::min<int32>(std::max<int32>(texelY, clamp.GetMinV()), clamp.GetMaxV());
+		break;
+	case CLAMP_MODE_REGION_REPEAT:
+		texelY = (texelY & clamp.GetMinV()) | clamp.GetMaxV();
+		break;
+	}
+
+	return FetchTexel(state, texelX & 0x7FF, texelY & 0x7FF);
+}
+
+uint32 CGSH_Software::FetchTexel(const DRAWSTATE& state, uint32 x, uint32 y) const
+{
+	auto tex0 = make_convertible<TEX0>(state.tex0);
+	auto texa = make_convertible<TEXA>(state.texa);
+
+	switch(tex0.nPsm)
+	{
+	case PSMCT32:
+	case PSMZ32:
+		{
+			CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+			return indexor.GetPixel(x, y);
+		}
+	case PSMCT24:
+	case PSMZ24:
+		{
+			CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+			uint32 color = indexor.GetPixel(x, y) & 0x00FFFFFF;
+			uint32 alpha = (texa.nAEM && (color == 0)) ? 0 : texa.nTA0;
+			return color | (alpha << 24);
+		}
+	case PSMCT16:
+	case PSMZ16:
+		{
+			CGsPixelFormats::CPixelIndexorPSMCT16 indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+			return ExpandTexel16(indexor.GetPixel(x, y), texa);
+		}
+	case PSMCT16S:
+	case PSMZ16S:
+		{
+			CGsPixelFormats::CPixelIndexorPSMCT16S indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+			return ExpandTexel16(indexor.GetPixel(x, y), texa);
+		}
+	case PSMT8:
+		{
+			CGsPixelFormats::CPixelIndexorPSMT8 indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+			return m_palettes[state.paletteIndex][indexor.GetPixel(x, y)];
+		}
+	case PSMT4:
+		{
+			CGsPixelFormats::CPixelIndexorPSMT4 indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+			return m_palettes[state.paletteIndex][indexor.GetPixel(x, y) & 0x0F];
+		}
+	case PSMT8H:
+		{
+			CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+			return m_palettes[state.paletteIndex][indexor.GetPixel(x, y) >> 24];
+		}
+	case PSMT4HL:
+		{
+			CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+			return m_palettes[state.paletteIndex][(indexor.GetPixel(x, y) >> 24) & 0x0F];
+		}
+	case PSMT4HH:
+		{
+			CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+			return m_palettes[state.paletteIndex][indexor.GetPixel(x, y) >> 28];
+		}
+	default:
+		return 0;
+	}
+}
+
+/////////////////////////////////////////////////////////////
+// Transfers
+/////////////////////////////////////////////////////////////
+
+void CGSH_Software::ProcessHostToLocalTransfer()
+{
+	//Data has already been written to RAM, nothing is cached here
+}
+
+void CGSH_Software::ProcessLocalToHostTransfer()
+{
+	//Data will be read from RAM, which is up to date since we flushed when the transfer started
+}
+
+void CGSH_Software::ProcessLocalToLocalTransfer()
+{
+	auto bltBuf = make_convertible<BITBLTBUF>(m_nReg[GS_REG_BITBLTBUF]);
+	auto trxPos = make_convertible<TRXPOS>(m_nReg[GS_REG_TRXPOS]);
+	auto trxReg = make_convertible<TRXREG>(m_nReg[GS_REG_TRXREG]);
+
+	//Formats with the same storage can be copied pixel per pixel
+	auto getStorageFormat =
+		[] (unsigned int psm)
+		{
+			switch(psm)
+			{
+			case PSMCT24:
+			case PSMZ32:
+			case PSMZ24:
+			case PSMT8H:
+			case PSMT4HL:
+			case PSMT4HH:
+				return static_cast<unsigned int>(PSMCT32);
+			case PSMZ16:
+				return static_cast<unsigned int>(PSMCT16);
+			case PSMZ16S:
+				return static_cast<unsigned int>(PSMCT16S);
+			default:
+				return psm;
+			}
+		};
+
+	unsigned int storageFormat = getStorageFormat(bltBuf.nSrcPsm);
+	if(storageFormat != getStorageFormat(bltBuf.nDstPsm))
+	{
+		CLog::GetInstance().Print(LOG_NAME, "Unsupported local to local transfer (0x%0.2X to 0x%0.2X).\r\n",
+			bltBuf.nSrcPsm, bltBuf.nDstPsm);
+		return;
+	}
+
+	switch(storageFormat)
+	{
+	case PSMCT32:
+		CopyPixels<CGsPixelFormats::CPixelIndexorPSMCT32>(m_pRAM, bltBuf.GetSrcPtr(), bltBuf.nSrcWidth, bltBuf.GetDstPtr(), bltBuf.nDstWidth,
+			trxPos.nSSAX, trxPos.nSSAY, trxPos.nDSAX, trxPos.nDSAY, trxReg.nRRW, trxReg.nRRH);
+		break;
+	case PSMCT16:
+		CopyPixels<CGsPixelFormats::CPixelIndexorPSMCT16>(m_pRAM, bltBuf.GetSrcPtr(), bltBuf.nSrcWidth, bltBuf.GetDstPtr(), bltBuf.nDstWidth,
+			trxPos.nSSAX, trxPos.nSSAY, trxPos.nDSAX, trxPos.nDSAY, trxReg.nRRW, trxReg.nRRH);
+		break;
+	case PSMCT16S:
+		CopyPixels<CGsPixelFormats::CPixelIndexorPSMCT16S>(m_pRAM, bltBuf.GetSrcPtr(), bltBuf.nSrcWidth, bltBuf.GetDstPtr(), bltBuf.nDstWidth,
+			trxPos.nSSAX, trxPos.nSSAY, trxPos.nDSAX, trxPos.nDSAY, trxReg.nRRW, trxReg.nRRH);
+		break;
+	case PSMT8:
+		CopyPixels<CGsPixelFormats::CPixelIndexorPSMT8>(m_pRAM, bltBuf.GetSrcPtr(), bltBuf.nSrcWidth, bltBuf.GetDstPtr(), bltBuf.nDstWidth,
+			trxPos.nSSAX, trxPos.nSSAY, trxPos.nDSAX, trxPos.nDSAY, trxReg.nRRW, trxReg.nRRH);
+		break;
+	case PSMT4:
+		CopyPixels<CGsPixelFormats::CPixelIndexorPSMT4>(m_pRAM, bltBuf.GetSrcPtr(), bltBuf.nSrcWidth, bltBuf.GetDstPtr(), bltBuf.nDstWidth,
+			trxPos.nSSAX, trxPos.nSSAY, trxPos.nDSAX, trxPos.nDSAY, trxReg.nRRW, trxReg.nRRH);
+		break;
+	default:
+		CLog::GetInstance().Print(LOG_NAME, "Unsupported local to local transfer format (0x%0.2X).\r\n", bltBuf.nSrcPsm);
+		break;
+	}
+}
+
+void CGSH_Software::ProcessClutTransfer(uint32, uint32)
+{
+	m_paletteDirty = true;
+}
+
+void CGSH_Software::ReadFramebuffer(uint32 width, uint32 height, void* buffer)
+{
+	FlushPrimitives();
+
+	DISPFB fb;
+	{
+		std::lock_guard<std::recursive_mutex> registerMutexLock(m_registerMutex);
+		//Same circuit selection as the OpenGL handler
+		fb <<= ((m_nPMODE & 0x3) == 0x2) ? m_nDISPFB2.value.q : m_nDISPFB1.value.q;
+	}
+
+	//Output matches what glReadPixels gives: 24-bit BGR, bottom row first
+	auto output = reinterpret_cast<uint8*>(buffer);
+	for(uint32 y = 0; y < height; y++)
+	{
+		uint8* row = output + ((height - y - 1) * width * 3);
+		for(uint32 x = 0; x < width; x++)
+		{
+			uint32 color = 0;
+			switch(fb.nPSM)
+			{
+			case PSMCT16:
+				{
+					CGsPixelFormats::CPixelIndexorPSMCT16 indexor(m_pRAM, fb.GetBufPtr(), fb.nBufWidth);
+					color = UnpackColor16(indexor.GetPixel(x, y), 0);
+				}
+				break;
+			case PSMCT16S:
+				{
+					CGsPixelFormats::CPixelIndexorPSMCT16S indexor(m_pRAM, fb.GetBufPtr(), fb.nBufWidth);
+					color = UnpackColor16(indexor.GetPixel(x, y), 0);
+				}
+				break;
+			default:
+				{
+					CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, fb.GetBufPtr(), fb.nBufWidth);
+					color = indexor.GetPixel(x, y);
+				}
+				break;
+			}
+			row[(x * 3) + 0] = static_cast<uint8>(color >> 16);
+			row[(x * 3) + 1] = static_cast<uint8>(color >> 8);
+			row[(x * 3) + 2] = static_cast<uint8>(color >> 0);
+		}
+	}
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "GSHandler.h"
+
+//Rasterizes primitives on the CPU, directly into GS RAM. Primitives are accumulated
+//in batches and binned into screen tiles, tiles are then rasterized in parallel by a
+//pool of worker threads. Everything drawn is visible in RAM after a flush point (flip,
+//transfers, new frame, etc.), which makes this handler usable without any GPU.
+class CGSH_Software : public CGSHandler
+{
+public:
+								CGSH_Software();
+	virtual						~CGSH_Software();
+
+	virtual void				SaveState(Framework::CZipArchiveWriter&, bool = true) override;
+
+	virtual void				ProcessHostToLocalTransfer() override;
+	virtual void				ProcessLocalToHostTransfer() override;
+	virtual void				ProcessLocalToLocalTransfer() override;
+	virtual void				ProcessClutTransfer(uint32, uint32) override;
+	virtual void				ReadFramebuffer(uint32, uint32, void*) override;
+
+	unsigned int				GetWorkerThreadCount() const;
+
+	static FactoryFunction		GetFactoryFunction();
+
+protected:
+	virtual void				WriteRegisterImpl(uint8, uint64) override;
+
+private:
+	enum
+	{
+		TILE_SIZE_SHIFT = 5,
+		TILE_SIZE = (1 << TILE_SIZE_SHIFT),
+		TILE_GRID_SIZE = (2048 / TILE_SIZE),
+		MAX_BATCH_PRIMITIVES = 0x4000,
+		MAX_WORKER_THREADS = 8,
+	};
+
+	enum PRIMITIVE_TYPE
+	{
+		PRIMITIVE_TYPE_POINT,
+		PRIMITIVE_TYPE_LINE,
+		PRIMITIVE_TYPE_TRIANGLE,
+		PRIMITIVE_TYPE_SPRITE,
+	};
+
+	enum DEPTH_TEST_METHOD
+	{
+		DEPTH_TEST_NEVER,
+		DEPTH_TEST_ALWAYS,
+		DEPTH_TEST_GEQUAL,
+		DEPTH_TEST_GREATER,
+	};
+
+	struct VERTEX
+	{
+		uint64					position;
+		uint64					rgbaq;
+		uint64					uv;
+		uint64					st;
+	};
+
+	//Vertex in window coordinates (12.4 fixed point), ready to be rasterized
+	struct RASTERVERTEX
+	{
+		int32					x;
+		int32					y;
+		double					z;
+		float					color[4];
+		float					s;
+		float					t;
+		float					q;
+	};
+
+	//Attribute that varies linearly in screen space: value = c + dx * x + dy * y
+	template <typename Type> struct PLANE
+	{
+		Type					c;
+		Type					dx;
+		Type					dy;
+
+		Type					Evaluate(float x, float y) const { return c + (dx * x) + (dy * y); }
+	};
+
+	struct EDGE
+	{
+		int64					a;
+		int64					b;
+		int64					c;
+	};
+
+	//Registers needed to draw a primitive, shared by all the primitives that use the same values
+	struct DRAWSTATE
+	{
+		uint64					frame;
+		uint64					zbuf;
+		uint64					test;
+		uint64					alpha;
+		uint64					tex0;
+		uint64					clamp;
+		uint64					texa;
+		uint32					textured;
+		uint32					useUv;
+		uint32					alphaBlend;
+		uint32					paletteIndex;
+	};
+
+	struct PRIMITIVE
+	{
+		PRIMITIVE_TYPE			type;
+		uint32					stateIndex;
+		bool					flatFill;
+		uint32					fillColor;
+		int32					minX;
+		int32					minY;
+		int32					maxX;
+		int32					maxY;
+		RASTERVERTEX			vertices[3];
+		EDGE					edges[3];
+		PLANE<float>			colorPlanes[4];
+		PLANE<float>			stPlanes[3];
+		PLANE<double>			zPlane;
+	};
+
+	//Interpolated values for a single pixel
+	struct FRAGMENT
+	{
+		double					z;
+		float					color[4];
+		float					s;
+		float					t;
+		float					q;
+	};
+
+	typedef std::array<uint32, 256> Palette;
+	typedef std::vector<uint32> TileBin;
+
+	virtual void				InitializeImpl() override;
+	virtual void				ReleaseImpl() override;
+	virtual void				ResetImpl() override;
+	virtual void				FlipImpl() override;
+
+	void						VertexKick(uint8, uint64);
+	void						Prim_Point();
+	void						Prim_Line();
+	void						Prim_Triangle();
+	void						Prim_Sprite();
+
+	RASTERVERTEX				MakeRasterVertex(const VERTEX&, const XYOFFSET&) const;
+	uint32						MakeDrawState();
+	void						AddPrimitive(PRIMITIVE&);
+	void						SetupTriangle(PRIMITIVE&) const;
+	void						SetupSprite(PRIMITIVE&) const;
+	uint32						CapturePalette(const TEX0&, const TEXA&);
+	bool						IsBatchWriteOverlapping(uint32, uint32) const;
+
+	void						FlushPrimitives();
+	void						ClearBatch();
+	void						ProcessTiles();
+	void						RasterizeTile(uint32);
+	void						RasterizePoint(const PRIMITIVE&, int32, int32, int32, int32);
+	void						RasterizeLine(const PRIMITIVE&, int32, int32, int32, int32);
+	void						RasterizeTriangle(const PRIMITIVE&, int32, int32, int32, int32);
+	void						RasterizeSprite(const PRIMITIVE&, int32, int32, int32, int32);
+	void						FillTriangle(const PRIMITIVE&, int32, int32, int32, int32);
+	void						FillSprite(const PRIMITIVE&, int32, int32, int32, int32);
+	void						DrawPixel(const PRIMITIVE&, int32, int32, const FRAGMENT&);
+	uint32						SampleTexture(const DRAWSTATE&, const FRAGMENT&) const;
+	uint32						FetchTexel(const DRAWSTATE&, uint32, uint32) const;
+
+	void						StartWorkerThreads();
+	void						StopWorkerThreads();
+	void						WorkerThreadProc();
+
+	static CGSHandler*			GSHandlerFactory();
+
+	unsigned int				m_primitiveType = PRIM_INVALID;
+	unsigned int				m_vtxCount = 0;
+	VERTEX						m_vtxBuffer[3];
+	PRMODE						m_primitiveMode;
+
+	std::vector<PRIMITIVE>		m_primitives;
+	std::vector<DRAWSTATE>		m_drawStates;
+	std::vector<Palette>		m_palettes;
+	bool						m_paletteDirty = true;
+	uint64						m_paletteTex0 = 0;
+	uint64						m_paletteTexa = 0;
+
+	std::vector<TileBin>		m_tileBins;
+	std::vector<uint32>			m_activeTiles;
+	std::atomic<uint32>			m_nextActiveTile;
+
+	//Buffers used by the current batch and range of GS RAM they cover
+	uint32						m_batchFrame = 0;
+	uint32						m_batchZbuf = 0;
+	bool						m_batchUsesDepth = false;
+	uint32						m_batchWriteStart = 0;
+	uint32						m_batchWriteEnd = 0;
+
+	std::vector<std::thread>	m_workerThreads;
+	std::mutex					m_workerMutex;
+	std::condition_variable		m_workerCondition;
+	std::condition_variable		m_workerDoneCondition;
+	uint32						m_workerBatchId = 0;
+	unsigned int				m_busyWorkerCount = 0;
+	bool						m_workerTerminate = false;
+};
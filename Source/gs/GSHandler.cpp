@@ -1,7 +1,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <functional>
-#include <boost/scoped_array.hpp>
+#include <algorithm>
 #include "../AppConfig.h"
 #include "../Log.h"
 #include "../MemoryStateFile.h"
@@ -9,6 +9,7 @@
 #include "../FrameDump.h"
 #include "GSHandler.h"
 #include "GsPixelFormats.h"
+#include "GsSwizzle.h"
 #include "string_format.h"
 
 #define R_REG(a, v, r)					\
@@ -51,6 +52,15 @@
 
 #define LOG_NAME						("gs")
 
+#define COMMAND_RING_SIZE				(0x400000)
+
+enum COMMAND_TYPE
+{
+	COMMAND_WRITEREGISTER,
+	COMMAND_FEEDIMAGEDATA,
+	COMMAND_WRITEREGISTERMASSIVELY,
+};
+
 struct MASSIVEWRITE_INFO
 {
 #ifdef DEBUGGER_INCLUDED
@@ -61,7 +71,9 @@ struct MASSIVEWRITE_INFO
 };
 
 CGSHandler::CGSHandler()
-: m_threadDone(false)
+: m_commandRing(COMMAND_RING_SIZE)
+, m_pendingCallCount(0)
+, m_threadDone(false)
 , m_drawCallCount(0)
 , m_pCLUT(nullptr)
 , m_pRAM(nullptr)
@@ -112,13 +124,13 @@ void CGSHandler::RegisterPreferences()
 
 void CGSHandler::NotifyPreferencesChanged()
 {
-	m_mailBox.SendCall([this] () { NotifyPreferencesChangedImpl(); });
+	SendGSCall([this] () { NotifyPreferencesChangedImpl(); });
 }
 
 void CGSHandler::Reset()
 {
 	ResetBase();
-	m_mailBox.SendCall(std::bind(&CGSHandler::ResetImpl, this), true);
+	SendGSCall(std::bind(&CGSHandler::ResetImpl, this), true);
 }
 
 void CGSHandler::ResetBase()
@@ -161,9 +173,14 @@ void CGSHandler::SetPresentationParams(const PRESENTATION_PARAMS& presentationPa
 	m_presentationParams = presentationParams;
 }
 
-void CGSHandler::SaveState(Framework::CZipArchiveWriter& archive)
+void CGSHandler::SaveState(Framework::CZipArchiveWriter& archive, bool saveMemoryAreas)
 {
-	archive.InsertFile(new CMemoryStateFile(STATE_RAM,		m_pRAM,		RAMSIZE));
+	if(saveMemoryAreas)
+	{
+		CMemoryStateFile::MemoryAreaList memoryAreas;
+		GetMemoryAreas(memoryAreas);
+		CMemoryStateFile::InsertMemoryAreas(archive, memoryAreas);
+	}
 	archive.InsertFile(new CMemoryStateFile(STATE_REGS,		m_nReg,		sizeof(uint64) * CGSHandler::REGISTER_MAX));
 	archive.InsertFile(new CMemoryStateFile(STATE_TRXCTX,	&m_trxCtx,	sizeof(TRXCONTEXT)));
 
@@ -185,9 +202,14 @@ void CGSHandler::SaveState(Framework::CZipArchiveWriter& archive)
 	}
 }
 
-void CGSHandler::LoadState(Framework::CZipArchiveReader& archive)
+void CGSHandler::LoadState(Framework::CZipArchiveReader& archive, bool loadMemoryAreas)
 {
-	archive.BeginReadFile(STATE_RAM		)->Read(m_pRAM,		RAMSIZE);
+	if(loadMemoryAreas)
+	{
+		CMemoryStateFile::MemoryAreaList memoryAreas;
+		GetMemoryAreas(memoryAreas);
+		CMemoryStateFile::ReadMemoryAreas(archive, memoryAreas);
+	}
 	archive.BeginReadFile(STATE_REGS	)->Read(m_nReg,		sizeof(uint64) * 0x80);
 	archive.BeginReadFile(STATE_TRXCTX	)->Read(&m_trxCtx,	sizeof(TRXCONTEXT));
 
@@ -206,6 +228,11 @@ void CGSHandler::LoadState(Framework::CZipArchiveReader& archive)
 	}
 }
 
+void CGSHandler::GetMemoryAreas(CMemoryStateFile::MemoryAreaList& memoryAreas)
+{
+	memoryAreas.push_back({ STATE_RAM, m_pRAM, RAMSIZE });
+}
+
 void CGSHandler::SetFrameDump(CFrameDump* frameDump)
 {
 	m_frameDump = frameDump;
@@ -246,6 +273,7 @@ int CGSHandler::GetPendingTransferCount() const
 
 bool CGSHandler::IsInterruptPending()
 {
+	std::lock_guard<std::recursive_mutex> registerMutexLock(m_registerMutex);
 	uint32 mask = (~m_nIMR >> 8) & 0x1F;
 	return (m_nCSR & mask) != 0;
 }
@@ -267,7 +295,10 @@ uint32 CGSHandler::ReadPrivRegister(uint32 nAddress)
 		R_REG(nAddress, nData, m_nIMR);
 		break;
 	case GS_SIGLBLID:
-		R_REG(nAddress, nData, m_nSIGLBLID);
+		{
+			std::lock_guard<std::recursive_mutex> registerMutexLock(m_registerMutex);
+			R_REG(nAddress, nData, m_nSIGLBLID);
+		}
 		break;
 	default:
 		CLog::GetInstance().Print(LOG_NAME, "Read an unhandled priviledged register (0x%0.8X).\r\n", nAddress);
@@ -335,7 +366,10 @@ void CGSHandler::WritePrivRegister(uint32 nAddress, uint32 nData)
 		W_REG(nAddress, nData, m_nIMR);
 		break;
 	case GS_SIGLBLID:
-		W_REG(nAddress, nData, m_nSIGLBLID);
+		{
+			std::lock_guard<std::recursive_mutex> registerMutexLock(m_registerMutex);
+			W_REG(nAddress, nData, m_nSIGLBLID);
+		}
 		break;
 	default:
 		CLog::GetInstance().Print(LOG_NAME, "Wrote to an unhandled priviledged register (0x%0.8X, 0x%0.8X).\r\n", nAddress, nData);
@@ -352,22 +386,22 @@ void CGSHandler::WritePrivRegister(uint32 nAddress, uint32 nData)
 
 void CGSHandler::Initialize()
 {
-	m_mailBox.SendCall(std::bind(&CGSHandler::InitializeImpl, this), true);
+	SendGSCall(std::bind(&CGSHandler::InitializeImpl, this), true);
 }
 
 void CGSHandler::Release()
 {
-	m_mailBox.SendCall(std::bind(&CGSHandler::ReleaseImpl, this), true);
+	SendGSCall(std::bind(&CGSHandler::ReleaseImpl, this), true);
 }
 
 void CGSHandler::Flip(bool showOnly)
 {
 	if(!showOnly)
 	{
-		m_mailBox.FlushCalls();
-		m_mailBox.SendCall(std::bind(&CGSHandler::MarkNewFrame, this));
+		SendGSCall([] () { }, true);
+		SendGSCall(std::bind(&CGSHandler::MarkNewFrame, this));
 	}
-	m_mailBox.SendCall(std::bind(&CGSHandler::FlipImpl, this), true);
+	SendGSCall(std::bind(&CGSHandler::FlipImpl, this), true);
 }
 
 void CGSHandler::FlipImpl()
@@ -406,25 +440,99 @@ void CGSHandler::SetSMODE2(uint64 value)
 
 void CGSHandler::WriteRegister(uint8 registerId, uint64 value)
 {
-	m_mailBox.SendCall(std::bind(&CGSHandler::WriteRegisterImpl, this, registerId, value));
+	auto write = reinterpret_cast<RegisterWrite*>(m_commandRing.BeginPacket(COMMAND_WRITEREGISTER, sizeof(RegisterWrite)));
+	write->first = registerId;
+	write->second = value;
+	m_commandRing.EndPacket();
 }
 
 void CGSHandler::FeedImageData(const void* data, uint32 length)
 {
-	m_transferCount++;
+	//Big transfers are split in chunks that don't cut through 24-bits pixels
+	uint32 maxChunkSize = m_commandRing.GetMaxPacketSize();
+	maxChunkSize -= maxChunkSize % 0x30;
+
+	auto src = reinterpret_cast<const uint8*>(data);
+	while(length != 0)
+	{
+		uint32 chunkSize = std::min<uint32>(length, maxChunkSize);
+
+		m_transferCount++;
 
-	uint8* buffer = new uint8[length];
-	memcpy(buffer, data, length);
-	m_mailBox.SendCall(std::bind(&CGSHandler::FeedImageDataImpl, this, buffer, length));
+		void* buffer = m_commandRing.BeginPacket(COMMAND_FEEDIMAGEDATA, chunkSize);
+		memcpy(buffer, src, chunkSize);
+		m_commandRing.EndPacket();
+
+		src += chunkSize;
+		length -= chunkSize;
+	}
 }
 
 void CGSHandler::ReadImageData(void* data, uint32 length)
 {
-	m_mailBox.SendCall([this, data, length] () { ReadImageDataImpl(data, length); }, true);
+	SendGSCall([this, data, length] () { ReadImageDataImpl(data, length); }, true);
 }
 
 void CGSHandler::WriteRegisterMassively(const RegisterWrite* writeList, unsigned int count, const CGsPacketMetadata* metadata)
 {
+	//Packets are copied in the command ring as is, splitting them if they're too big to fit in a single command
+	unsigned int maxChunkCount = GetMaxRegisterWriteCount();
+	while(count != 0)
+	{
+		unsigned int chunkCount = std::min<unsigned int>(count, maxChunkCount);
+
+		auto writes = BeginRegisterWrites(chunkCount);
+		memcpy(writes, writeList, sizeof(CGSHandler::RegisterWrite) * chunkCount);
+		EndRegisterWrites(chunkCount, metadata);
+
+		writeList += chunkCount;
+		count -= chunkCount;
+	}
+}
+
+unsigned int CGSHandler::GetMaxRegisterWriteCount() const
+{
+	return static_cast<unsigned int>((m_commandRing.GetMaxPacketSize() - offsetof(MASSIVEWRITE_INFO, writes)) / sizeof(RegisterWrite));
+}
+
+CGSHandler::RegisterWrite* CGSHandler::BeginRegisterWrites(unsigned int count)
+{
+	assert(m_pendingMassiveWrite == nullptr);
+	assert(count <= GetMaxRegisterWriteCount());
+	uint32 packetSize = static_cast<uint32>(offsetof(MASSIVEWRITE_INFO, writes) + (count * sizeof(RegisterWrite)));
+	m_pendingMassiveWrite = reinterpret_cast<MASSIVEWRITE_INFO*>(m_commandRing.BeginPacket(COMMAND_WRITEREGISTERMASSIVELY, packetSize));
+	return m_pendingMassiveWrite->writes;
+}
+
+void CGSHandler::EndRegisterWrites(unsigned int count, const CGsPacketMetadata* metadata)
+{
+	assert(m_pendingMassiveWrite != nullptr);
+	auto massiveWrite = m_pendingMassiveWrite;
+	m_pendingMassiveWrite = nullptr;
+
+	ProcessEventWrites(massiveWrite->writes, count);
+
+	m_transferCount++;
+
+	massiveWrite->count = count;
+#ifdef DEBUGGER_INCLUDED
+	if(metadata != nullptr)
+	{
+		memcpy(&massiveWrite->metadata, metadata, sizeof(CGsPacketMetadata));
+	}
+	else
+	{
+		massiveWrite->metadata = CGsPacketMetadata();
+	}
+#endif
+	m_commandRing.EndPacket(static_cast<uint32>(offsetof(MASSIVEWRITE_INFO, writes) + (count * sizeof(RegisterWrite))));
+}
+
+//SIGNAL, FINISH and LABEL update privileged registers, these need to be visible as soon as the packet is sent
+//Packets can come from the VU1 thread while the EE accesses the same registers, hence the lock
+void CGSHandler::ProcessEventWrites(const RegisterWrite* writeList, unsigned int count)
+{
+	std::lock_guard<std::recursive_mutex> registerMutexLock(m_registerMutex);
 	for(unsigned int i = 0; i < count; i++)
 	{
 		const auto& write = writeList[i];
@@ -454,24 +562,6 @@ void CGSHandler::WriteRegisterMassively(const RegisterWrite* writeList, unsigned
 			break;
 		}
 	}
-
-	m_transferCount++;
-
-	auto massiveWrite = reinterpret_cast<MASSIVEWRITE_INFO*>(malloc(sizeof(MASSIVEWRITE_INFO) + (count * sizeof(RegisterWrite))));
-	memcpy(massiveWrite->writes, writeList, sizeof(CGSHandler::RegisterWrite) * count);
-	massiveWrite->count = count;
-#ifdef DEBUGGER_INCLUDED
-	if(metadata != nullptr)
-	{
-		memcpy(&massiveWrite->metadata, metadata, sizeof(CGsPacketMetadata));
-	}
-	else
-	{
-		massiveWrite->metadata = CGsPacketMetadata();
-	}
-#endif
-	//Bind is used here because using a lambda seems to cause problems on Android/clang
-	m_mailBox.SendCall(std::bind(&CGSHandler::WriteRegisterMassivelyImpl, this, massiveWrite));
 }
 
 void CGSHandler::WriteRegisterImpl(uint8 nRegister, uint64 nData)
@@ -524,8 +614,6 @@ void CGSHandler::WriteRegisterImpl(uint8 nRegister, uint64 nData)
 
 void CGSHandler::FeedImageDataImpl(void* pData, uint32 nLength)
 {
-	boost::scoped_array<uint8> dataPtr(reinterpret_cast<uint8*>(pData));
-
 	if(m_trxCtx.nSize == 0)
 	{
 #ifdef _DEBUG
@@ -577,7 +665,19 @@ void CGSHandler::ReadImageDataImpl(void* ptr, uint32 size)
 	case PSMCT32:
 		{
 			CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, bltBuf.GetSrcPtr(), bltBuf.nSrcWidth);
-			for(uint32 i = 0; i < size / sizeof(uint32); i++)
+			uint32 pixelCount = size / sizeof(uint32);
+			uint32 i = 0;
+			//Read complete rows in one go
+			if((m_trxCtx.nRRX == 0) && (trxReg.nRRW != 0))
+			{
+				uint32 rowCount = pixelCount / trxReg.nRRW;
+				uint32 y = (m_trxCtx.nRRY + trxPos.nSSAY) % 2048;
+				CGsSwizzle::ReadRect<CGsPixelFormats::STORAGEPSMCT32>(m_pRAM, bltBuf.GetSrcPtr(), bltBuf.nSrcWidth,
+					trxPos.nSSAX, y, trxReg.nRRW, rowCount, ptr, trxReg.nRRW * sizeof(uint32));
+				i = rowCount * trxReg.nRRW;
+				m_trxCtx.nRRY += rowCount;
+			}
+			for(; i < pixelCount; i++)
 			{
 				uint32 x = (m_trxCtx.nRRX + trxPos.nSSAX) % 2048;
 				uint32 y = (m_trxCtx.nRRY + trxPos.nSSAY) % 2048;
@@ -613,7 +713,6 @@ void CGSHandler::WriteRegisterMassivelyImpl(MASSIVEWRITE_INFO* massiveWrite)
 		WriteRegisterImpl(writeIterator->first, writeIterator->second);
 		writeIterator++;
 	}
-	free(massiveWrite);
 
 	assert(m_transferCount != 0);
 	m_transferCount--;
@@ -704,8 +803,24 @@ bool CGSHandler::TrxHandlerCopy(void* pData, uint32 nLength)
 
 	auto pSrc = reinterpret_cast<typename Storage::Unit*>(pData);
 
-	for(unsigned int i = 0; i < nLength; i++)
+	unsigned int i = 0;
+	while(i < nLength)
 	{
+		//Copy as many complete rows as we can in one go
+		if((m_trxCtx.nRRX == 0) && (trxReg.nRRW != 0))
+		{
+			uint32 rowCount = (nLength - i) / trxReg.nRRW;
+			if(rowCount != 0)
+			{
+				uint32 nY = (m_trxCtx.nRRY + trxPos.nDSAY) % 2048;
+				nDirty |= CGsSwizzle::WriteRect<Storage>(m_pRAM, trxBuf.GetDstPtr(), trxBuf.nDstWidth,
+					trxPos.nDSAX, nY, trxReg.nRRW, rowCount, pSrc + i, trxReg.nRRW * sizeof(typename Storage::Unit));
+				i += rowCount * trxReg.nRRW;
+				m_trxCtx.nRRY += rowCount;
+				continue;
+			}
+		}
+
 		uint32 nX = (m_trxCtx.nRRX + trxPos.nDSAX) % 2048;
 		uint32 nY = (m_trxCtx.nRRY + trxPos.nDSAY) % 2048;
 
@@ -723,6 +838,7 @@ bool CGSHandler::TrxHandlerCopy(void* pData, uint32 nLength)
 			m_trxCtx.nRRX = 0;
 			m_trxCtx.nRRY++;
 		}
+		i++;
 	}
 
 	return nDirty;
@@ -770,8 +886,25 @@ bool CGSHandler::TrxHandlerPSMT4(void* pData, uint32 nLength)
 
 	uint8* pSrc = (uint8*)pData;
 
-	for(unsigned int i = 0; i < nLength; i++)
+	unsigned int i = 0;
+	while(i < nLength)
 	{
+		//Copy as many complete rows as we can in one go, rows must start on a byte boundary
+		if((m_trxCtx.nRRX == 0) && (trxReg.nRRW != 0) && ((trxReg.nRRW & 1) == 0))
+		{
+			uint32 rowSize = trxReg.nRRW / 2;
+			uint32 rowCount = (nLength - i) / rowSize;
+			if(rowCount != 0)
+			{
+				uint32 nY = (m_trxCtx.nRRY + trxPos.nDSAY) % 2048;
+				dirty |= CGsSwizzle::WriteRect<CGsPixelFormats::STORAGEPSMT4>(m_pRAM, trxBuf.GetDstPtr(), trxBuf.nDstWidth,
+					trxPos.nDSAX, nY, trxReg.nRRW, rowCount, pSrc + i, rowSize);
+				i += rowCount * rowSize;
+				m_trxCtx.nRRY += rowCount;
+				continue;
+			}
+		}
+
 		uint8 nPixel[2];
 
 		nPixel[0] = (pSrc[i] >> 0) & 0x0F;
@@ -796,6 +929,7 @@ bool CGSHandler::TrxHandlerPSMT4(void* pData, uint32 nLength)
 				m_trxCtx.nRRY++;
 			}
 		}
+		i++;
 	}
 
 	return dirty;
@@ -1505,14 +1639,77 @@ void CGSHandler::WriteToDelayedRegister(uint32 address, uint32 value, DELAYED_RE
 	}
 }
 
+void CGSHandler::SendGSCall(const CMailBox::FunctionType& function, bool waitForCompletion)
+{
+	//Calls must see the effects of commands sent before them and none of those sent after them.
+	//The GS thread stops pulling commands as soon as a call is pending and the call itself
+	//processes the commands that were queued before it was sent.
+	m_pendingCallCount++;
+	uint64 commandPosition = m_commandRing.GetWritePosition();
+	m_commandRing.Notify();
+	m_mailBox.SendCall(
+		[this, function, commandPosition] ()
+		{
+			ProcessCommands(commandPosition);
+			function();
+			m_pendingCallCount--;
+		},
+		waitForCompletion
+	);
+}
+
+void CGSHandler::ProcessCommand(CCommandRing::PACKET* packet)
+{
+	switch(packet->type)
+	{
+	case COMMAND_WRITEREGISTER:
+		{
+			auto write = reinterpret_cast<const RegisterWrite*>(packet->GetData());
+			WriteRegisterImpl(write->first, write->second);
+		}
+		break;
+	case COMMAND_FEEDIMAGEDATA:
+		FeedImageDataImpl(packet->GetData(), packet->size);
+		break;
+	case COMMAND_WRITEREGISTERMASSIVELY:
+		WriteRegisterMassivelyImpl(reinterpret_cast<MASSIVEWRITE_INFO*>(packet->GetData()));
+		break;
+	default:
+		assert(false);
+		break;
+	}
+	m_commandRing.ReleasePacket();
+}
+
+void CGSHandler::ProcessCommands(uint64 endPosition)
+{
+	while(auto packet = m_commandRing.ReadPacket())
+	{
+		//Reading might have skipped padding, check position afterwards
+		if(m_commandRing.GetReadPosition() >= endPosition) break;
+		ProcessCommand(packet);
+	}
+}
+
 void CGSHandler::ThreadProc()
 {
 	while(!m_threadDone)
 	{
-		m_mailBox.WaitForCall(100);
-		while(m_mailBox.IsPending())
+		if(m_pendingCallCount != 0)
+		{
+			m_mailBox.WaitForCall(100);
+			while(m_mailBox.IsPending())
+			{
+				m_mailBox.ReceiveCall();
+			}
+		}
+		else if(auto packet = m_commandRing.ReadPacket())
+		{
+			ProcessCommand(packet);
+		}
+		else
 		{
-			m_mailBox.ReceiveCall();
+			m_commandRing.WaitForPacket(100);
 		}
 	}
 }
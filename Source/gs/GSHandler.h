@@ -9,9 +9,11 @@
 #include "Types.h"
 #include "Convertible.h"
 #include "../MailBox.h"
+#include "../CommandRing.h"
 #include "../Integer64.h"
 #include "zip/ZipArchiveWriter.h"
 #include "zip/ZipArchiveReader.h"
+#include "../MemoryStateFile.h"
 
 class CFrameDump;
 class CGsPacketMetadata;
@@ -526,8 +528,10 @@ public:
 	void									Reset();
 	void									SetPresentationParams(const PRESENTATION_PARAMS&);
 
-	virtual void							SaveState(Framework::CZipArchiveWriter&);
-	virtual void							LoadState(Framework::CZipArchiveReader&);
+	//Memory areas are left out of the archive if the caller saves them by itself
+	virtual void							SaveState(Framework::CZipArchiveWriter&, bool = true);
+	virtual void							LoadState(Framework::CZipArchiveReader&, bool = true);
+	void									GetMemoryAreas(CMemoryStateFile::MemoryAreaList&);
 
 	void									SetFrameDump(CFrameDump*);
 
@@ -548,6 +552,13 @@ public:
 	void									ReadImageData(void*, uint32);
 	void									WriteRegisterMassively(const RegisterWrite*, unsigned int, const CGsPacketMetadata*);
 
+	//Lets register writes be decoded directly in the command ring. BeginRegisterWrites returns room
+	//for the requested amount of writes (GetMaxRegisterWriteCount at most) and EndRegisterWrites sends
+	//the ones that were filled in. Nothing else can be sent to the GS in between.
+	unsigned int							GetMaxRegisterWriteCount() const;
+	RegisterWrite*							BeginRegisterWrites(unsigned int);
+	void									EndRegisterWrites(unsigned int, const CGsPacketMetadata*);
+
 	virtual void							SetCrt(bool, unsigned int, bool);
 	void									Initialize();
 	void									Release();
@@ -717,7 +728,12 @@ protected:
 	void									ReadImageDataImpl(void*, uint32);
 	virtual void							WriteRegisterMassivelyImpl(MASSIVEWRITE_INFO*);
 
+	void									SendGSCall(const CMailBox::FunctionType&, bool = false);
+	void									ProcessCommand(CCommandRing::PACKET*);
+	void									ProcessCommands(uint64);
+
 	void									BeginTransfer();
+	void									ProcessEventWrites(const RegisterWrite*, unsigned int);
 
 	TRANSFERHANDLER							m_pTransferHandler[PSM_MAX];
 
@@ -763,6 +779,9 @@ protected:
 	std::recursive_mutex					m_registerMutex;
 	std::atomic<int>						m_transferCount;
 	CMailBox								m_mailBox;
+	CCommandRing							m_commandRing;
+	MASSIVEWRITE_INFO*						m_pendingMassiveWrite = nullptr;
+	std::atomic<int>						m_pendingCallCount;
 	bool									m_threadDone;
 	CFrameDump*								m_frameDump;
 	bool									m_drawEnabled = true;
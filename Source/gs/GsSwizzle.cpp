@@ -0,0 +1,640 @@
+#include <string.h>
+#include "GsSwizzle.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define GS_SWIZZLE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define GS_SWIZZLE_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(GS_SWIZZLE_SSE2) || defined(GS_SWIZZLE_NEON)
+#define GS_SWIZZLE_SIMD
+#endif
+
+#define GS_COORD_MAX	(2048)
+
+typedef CGsPixelFormats::STORAGEPSMCT32 STORAGEPSMCT32;
+typedef CGsPixelFormats::STORAGEPSMCT16 STORAGEPSMCT16;
+typedef CGsPixelFormats::STORAGEPSMCT16S STORAGEPSMCT16S;
+typedef CGsPixelFormats::STORAGEPSMT8 STORAGEPSMT8;
+typedef CGsPixelFormats::STORAGEPSMT4 STORAGEPSMT4;
+
+#if defined(GS_SWIZZLE_SSE2)
+
+/////////////////////////////////////////////
+//SSE2 primitives
+/////////////////////////////////////////////
+
+typedef __m128i Vector;
+
+static inline Vector LoadVector(const uint8* src)
+{
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+
+static inline void StoreVector(uint8* dst, Vector value)
+{
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), value);
+}
+
+static inline Vector InterleaveLo8(Vector a, Vector b)	{ return _mm_unpacklo_epi8(a, b); }
+static inline Vector InterleaveHi8(Vector a, Vector b)	{ return _mm_unpackhi_epi8(a, b); }
+static inline Vector InterleaveLo16(Vector a, Vector b)	{ return _mm_unpacklo_epi16(a, b); }
+static inline Vector InterleaveHi16(Vector a, Vector b)	{ return _mm_unpackhi_epi16(a, b); }
+static inline Vector InterleaveLo64(Vector a, Vector b)	{ return _mm_unpacklo_epi64(a, b); }
+static inline Vector InterleaveHi64(Vector a, Vector b)	{ return _mm_unpackhi_epi64(a, b); }
+
+static inline Vector DeinterleaveEven8(Vector a, Vector b)
+{
+	__m128i mask = _mm_set1_epi16(0x00FF);
+	return _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+}
+
+static inline Vector DeinterleaveOdd8(Vector a, Vector b)
+{
+	return _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+}
+
+static inline Vector DeinterleaveEven16(Vector a, Vector b)
+{
+	//Sign extension makes the saturation in packs a no-op
+	return _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+}
+
+static inline Vector DeinterleaveOdd16(Vector a, Vector b)
+{
+	return _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+}
+
+//Swaps 32-bits elements inside every 64-bits element
+static inline Vector SwapDwords(Vector value)
+{
+	return _mm_shuffle_epi32(value, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+//Swaps 16-bits elements inside every 32-bits element
+static inline Vector SwapWords(Vector value)
+{
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(value, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+static inline Vector LowNibbles(Vector value)		{ return _mm_and_si128(value, _mm_set1_epi8(0x0F)); }
+static inline Vector HighNibbles(Vector value)		{ return _mm_and_si128(value, _mm_set1_epi8(static_cast<char>(0xF0))); }
+static inline Vector ShiftNibblesUp(Vector value)	{ return HighNibbles(_mm_slli_epi16(value, 4)); }
+static inline Vector ShiftNibblesDown(Vector value)	{ return LowNibbles(_mm_srli_epi16(value, 4)); }
+static inline Vector Or(Vector a, Vector b)			{ return _mm_or_si128(a, b); }
+
+#elif defined(GS_SWIZZLE_NEON)
+
+/////////////////////////////////////////////
+//NEON primitives
+/////////////////////////////////////////////
+
+typedef uint8x16_t Vector;
+
+static inline Vector LoadVector(const uint8* src)
+{
+	return vld1q_u8(src);
+}
+
+static inline void StoreVector(uint8* dst, Vector value)
+{
+	vst1q_u8(dst, value);
+}
+
+static inline Vector InterleaveLo8(Vector a, Vector b)	{ return vzipq_u8(a, b).val[0]; }
+static inline Vector InterleaveHi8(Vector a, Vector b)	{ return vzipq_u8(a, b).val[1]; }
+static inline Vector InterleaveLo16(Vector a, Vector b)	{ return vreinterpretq_u8_u16(vzipq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b)).val[0]); }
+static inline Vector InterleaveHi16(Vector a, Vector b)	{ return vreinterpretq_u8_u16(vzipq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b)).val[1]); }
+static inline Vector InterleaveLo64(Vector a, Vector b)	{ return vcombine_u8(vget_low_u8(a), vget_low_u8(b)); }
+static inline Vector InterleaveHi64(Vector a, Vector b)	{ return vcombine_u8(vget_high_u8(a), vget_high_u8(b)); }
+
+static inline Vector DeinterleaveEven8(Vector a, Vector b)	{ return vuzpq_u8(a, b).val[0]; }
+static inline Vector DeinterleaveOdd8(Vector a, Vector b)	{ return vuzpq_u8(a, b).val[1]; }
+static inline Vector DeinterleaveEven16(Vector a, Vector b)	{ return vreinterpretq_u8_u16(vuzpq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b)).val[0]); }
+static inline Vector DeinterleaveOdd16(Vector a, Vector b)	{ return vreinterpretq_u8_u16(vuzpq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b)).val[1]); }
+
+static inline Vector SwapDwords(Vector value)		{ return vreinterpretq_u8_u32(vrev64q_u32(vreinterpretq_u32_u8(value))); }
+static inline Vector SwapWords(Vector value)		{ return vreinterpretq_u8_u16(vrev32q_u16(vreinterpretq_u16_u8(value))); }
+
+static inline Vector LowNibbles(Vector value)		{ return vandq_u8(value, vdupq_n_u8(0x0F)); }
+static inline Vector HighNibbles(Vector value)		{ return vandq_u8(value, vdupq_n_u8(0xF0)); }
+static inline Vector ShiftNibblesUp(Vector value)	{ return vshlq_n_u8(value, 4); }
+static inline Vector ShiftNibblesDown(Vector value)	{ return vshrq_n_u8(value, 4); }
+static inline Vector Or(Vector a, Vector b)			{ return vorrq_u8(a, b); }
+
+#endif
+
+#ifdef GS_SWIZZLE_SIMD
+
+/////////////////////////////////////////////
+//Column kernels
+/////////////////////////////////////////////
+
+//A column is 64 bytes of GS memory. In all formats, memory words are laid out like
+//PSMCT32 pixels in a column: pairs of words from the first row alternate with pairs
+//of words from the second row. Other formats first pack their pixels into such words.
+
+static inline void StoreColumn(uint8* dst, Vector row0Lo, Vector row0Hi, Vector row1Lo, Vector row1Hi)
+{
+	StoreVector(dst + 0x00, InterleaveLo64(row0Lo, row1Lo));
+	StoreVector(dst + 0x10, InterleaveHi64(row0Lo, row1Lo));
+	StoreVector(dst + 0x20, InterleaveLo64(row0Hi, row1Hi));
+	StoreVector(dst + 0x30, InterleaveHi64(row0Hi, row1Hi));
+}
+
+static inline void LoadColumn(const uint8* src, Vector& row0Lo, Vector& row0Hi, Vector& row1Lo, Vector& row1Hi)
+{
+	Vector m0 = LoadVector(src + 0x00);
+	Vector m1 = LoadVector(src + 0x10);
+	Vector m2 = LoadVector(src + 0x20);
+	Vector m3 = LoadVector(src + 0x30);
+	row0Lo = InterleaveLo64(m0, m1);
+	row1Lo = InterleaveHi64(m0, m1);
+	row0Hi = InterleaveLo64(m2, m3);
+	row1Hi = InterleaveHi64(m2, m3);
+}
+
+static void SwizzleColumnPSMCT32(uint8* dst, const uint8* src, uint32 pitch)
+{
+	StoreColumn(dst,
+		LoadVector(src), LoadVector(src + 0x10),
+		LoadVector(src + pitch), LoadVector(src + pitch + 0x10));
+}
+
+static void UnswizzleColumnPSMCT32(const uint8* src, uint8* dst, uint32 pitch)
+{
+	Vector row0Lo, row0Hi, row1Lo, row1Hi;
+	LoadColumn(src, row0Lo, row0Hi, row1Lo, row1Hi);
+	StoreVector(dst, row0Lo);
+	StoreVector(dst + 0x10, row0Hi);
+	StoreVector(dst + pitch, row1Lo);
+	StoreVector(dst + pitch + 0x10, row1Hi);
+}
+
+//Words hold pixels x and x + 8 of a row
+static void SwizzleColumnPSMCT16(uint8* dst, const uint8* src, uint32 pitch)
+{
+	Vector r0a = LoadVector(src);
+	Vector r0b = LoadVector(src + 0x10);
+	Vector r1a = LoadVector(src + pitch);
+	Vector r1b = LoadVector(src + pitch + 0x10);
+	StoreColumn(dst,
+		InterleaveLo16(r0a, r0b), InterleaveHi16(r0a, r0b),
+		InterleaveLo16(r1a, r1b), InterleaveHi16(r1a, r1b));
+}
+
+static void UnswizzleColumnPSMCT16(const uint8* src, uint8* dst, uint32 pitch)
+{
+	Vector row0Lo, row0Hi, row1Lo, row1Hi;
+	LoadColumn(src, row0Lo, row0Hi, row1Lo, row1Hi);
+	StoreVector(dst, DeinterleaveEven16(row0Lo, row0Hi));
+	StoreVector(dst + 0x10, DeinterleaveOdd16(row0Lo, row0Hi));
+	StoreVector(dst + pitch, DeinterleaveEven16(row1Lo, row1Hi));
+	StoreVector(dst + pitch + 0x10, DeinterleaveOdd16(row1Lo, row1Hi));
+}
+
+//Words hold pixels x and x + 8 of rows y and y + 2. Rows 2 and 3 of even columns
+//(rows 0 and 1 of odd columns) are stored with 4 pixels groups swapped.
+static void SwizzleColumnPSMT8(uint8* dst, const uint8* src, uint32 pitch, bool odd)
+{
+	Vector r0 = LoadVector(src);
+	Vector r1 = LoadVector(src + pitch);
+	Vector r2 = LoadVector(src + (pitch * 2));
+	Vector r3 = LoadVector(src + (pitch * 3));
+	if(odd)
+	{
+		r0 = SwapDwords(r0);
+		r1 = SwapDwords(r1);
+	}
+	else
+	{
+		r2 = SwapDwords(r2);
+		r3 = SwapDwords(r3);
+	}
+	Vector p0 = InterleaveLo8(r0, r2);
+	Vector q0 = InterleaveHi8(r0, r2);
+	Vector p1 = InterleaveLo8(r1, r3);
+	Vector q1 = InterleaveHi8(r1, r3);
+	StoreColumn(dst,
+		InterleaveLo16(p0, q0), InterleaveHi16(p0, q0),
+		InterleaveLo16(p1, q1), InterleaveHi16(p1, q1));
+}
+
+static void UnswizzleColumnPSMT8(const uint8* src, uint8* dst, uint32 pitch, bool odd)
+{
+	Vector u0, v0, u1, v1;
+	LoadColumn(src, u0, v0, u1, v1);
+	Vector p0 = DeinterleaveEven16(u0, v0);
+	Vector q0 = DeinterleaveOdd16(u0, v0);
+	Vector p1 = DeinterleaveEven16(u1, v1);
+	Vector q1 = DeinterleaveOdd16(u1, v1);
+	Vector r0 = DeinterleaveEven8(p0, q0);
+	Vector r2 = DeinterleaveOdd8(p0, q0);
+	Vector r1 = DeinterleaveEven8(p1, q1);
+	Vector r3 = DeinterleaveOdd8(p1, q1);
+	if(odd)
+	{
+		r0 = SwapDwords(r0);
+		r1 = SwapDwords(r1);
+	}
+	else
+	{
+		r2 = SwapDwords(r2);
+		r3 = SwapDwords(r3);
+	}
+	StoreVector(dst, r0);
+	StoreVector(dst + pitch, r1);
+	StoreVector(dst + (pitch * 2), r2);
+	StoreVector(dst + (pitch * 3), r3);
+}
+
+//Same as PSMT8, with pixels of rows y and y + 2 first paired in bytes, words then
+//hold pixel pairs x, x + 8, x + 16 and x + 24.
+static inline void PackPSMT4Rows(Vector ra, Vector rb, Vector& u, Vector& v)
+{
+	Vector even = Or(LowNibbles(ra), ShiftNibblesUp(rb));
+	Vector odd = Or(ShiftNibblesDown(ra), HighNibbles(rb));
+	Vector pairsLo = InterleaveLo8(even, odd);
+	Vector pairsHi = InterleaveHi8(even, odd);
+	Vector p = InterleaveLo8(pairsLo, InterleaveHi64(pairsLo, pairsLo));
+	Vector q = InterleaveLo8(pairsHi, InterleaveHi64(pairsHi, pairsHi));
+	u = InterleaveLo16(p, q);
+	v = InterleaveHi16(p, q);
+}
+
+static void SwizzleColumnPSMT4(uint8* dst, const uint8* src, uint32 pitch, bool odd)
+{
+	Vector r0 = LoadVector(src);
+	Vector r1 = LoadVector(src + pitch);
+	Vector r2 = LoadVector(src + (pitch * 2));
+	Vector r3 = LoadVector(src + (pitch * 3));
+	if(odd)
+	{
+		r0 = SwapWords(r0);
+		r1 = SwapWords(r1);
+	}
+	else
+	{
+		r2 = SwapWords(r2);
+		r3 = SwapWords(r3);
+	}
+	Vector u0, v0, u1, v1;
+	PackPSMT4Rows(r0, r2, u0, v0);
+	PackPSMT4Rows(r1, r3, u1, v1);
+	StoreColumn(dst, u0, v0, u1, v1);
+}
+
+//Outputs one pixel per byte
+static inline void UnpackPSMT4Rows(Vector u, Vector v, uint8* dstA, uint8* dstB, bool swapB)
+{
+	Vector p = DeinterleaveEven16(u, v);
+	Vector q = DeinterleaveOdd16(u, v);
+	Vector e = DeinterleaveEven8(p, q);
+	Vector o = DeinterleaveOdd8(p, q);
+	Vector pairsLo = InterleaveLo64(e, o);
+	Vector pairsHi = InterleaveHi64(e, o);
+	Vector a0 = LowNibbles(pairsLo);
+	Vector a1 = LowNibbles(pairsHi);
+	Vector b0 = ShiftNibblesDown(pairsLo);
+	Vector b1 = ShiftNibblesDown(pairsHi);
+	if(swapB)
+	{
+		b0 = SwapDwords(b0);
+		b1 = SwapDwords(b1);
+	}
+	else
+	{
+		a0 = SwapDwords(a0);
+		a1 = SwapDwords(a1);
+	}
+	StoreVector(dstA, a0);
+	StoreVector(dstA + 0x10, a1);
+	StoreVector(dstB, b0);
+	StoreVector(dstB + 0x10, b1);
+}
+
+static void UnswizzleColumnPSMT4(const uint8* src, uint8* dst, uint32 pitch, bool odd)
+{
+	Vector u0, v0, u1, v1;
+	LoadColumn(src, u0, v0, u1, v1);
+	UnpackPSMT4Rows(u0, v0, dst, dst + (pitch * 2), !odd);
+	UnpackPSMT4Rows(u1, v1, dst + pitch, dst + (pitch * 3), !odd);
+}
+
+/////////////////////////////////////////////
+//Block kernels
+/////////////////////////////////////////////
+
+template <typename Storage>
+struct CBlockKernels
+{
+
+};
+
+template <>
+struct CBlockKernels<STORAGEPSMCT32>
+{
+	static void Swizzle(uint8* dst, const uint8* src, uint32 pitch)
+	{
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			SwizzleColumnPSMCT32(dst + (i * CGsPixelFormats::COLUMNSIZE), src + (i * 2 * pitch), pitch);
+		}
+	}
+
+	static void Unswizzle(const uint8* src, uint8* dst, uint32 pitch)
+	{
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			UnswizzleColumnPSMCT32(src + (i * CGsPixelFormats::COLUMNSIZE), dst + (i * 2 * pitch), pitch);
+		}
+	}
+};
+
+template <>
+struct CBlockKernels<STORAGEPSMCT16>
+{
+	static void Swizzle(uint8* dst, const uint8* src, uint32 pitch)
+	{
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			SwizzleColumnPSMCT16(dst + (i * CGsPixelFormats::COLUMNSIZE), src + (i * 2 * pitch), pitch);
+		}
+	}
+
+	static void Unswizzle(const uint8* src, uint8* dst, uint32 pitch)
+	{
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			UnswizzleColumnPSMCT16(src + (i * CGsPixelFormats::COLUMNSIZE), dst + (i * 2 * pitch), pitch);
+		}
+	}
+};
+
+//PSMCT16S only differs from PSMCT16 by the placement of blocks in a page
+template <>
+struct CBlockKernels<STORAGEPSMCT16S> : public CBlockKernels<STORAGEPSMCT16>
+{
+
+};
+
+template <>
+struct CBlockKernels<STORAGEPSMT8>
+{
+	static void Swizzle(uint8* dst, const uint8* src, uint32 pitch)
+	{
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			SwizzleColumnPSMT8(dst + (i * CGsPixelFormats::COLUMNSIZE), src + (i * 4 * pitch), pitch, (i & 1) != 0);
+		}
+	}
+
+	static void Unswizzle(const uint8* src, uint8* dst, uint32 pitch)
+	{
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			UnswizzleColumnPSMT8(src + (i * CGsPixelFormats::COLUMNSIZE), dst + (i * 4 * pitch), pitch, (i & 1) != 0);
+		}
+	}
+};
+
+template <>
+struct CBlockKernels<STORAGEPSMT4>
+{
+	static void Swizzle(uint8* dst, const uint8* src, uint32 pitch)
+	{
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			SwizzleColumnPSMT4(dst + (i * CGsPixelFormats::COLUMNSIZE), src + (i * 4 * pitch), pitch, (i & 1) != 0);
+		}
+	}
+
+	static void Unswizzle(const uint8* src, uint8* dst, uint32 pitch)
+	{
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			UnswizzleColumnPSMT4(src + (i * CGsPixelFormats::COLUMNSIZE), dst + (i * 4 * pitch), pitch, (i & 1) != 0);
+		}
+	}
+};
+
+#endif
+
+/////////////////////////////////////////////
+//Linear buffer helpers
+/////////////////////////////////////////////
+
+//Offset, in bytes, of a pixel in a row of pixels coming from the host
+template <typename Storage>
+static uint32 GetPackedOffset(uint32 x)
+{
+	return x * sizeof(typename Storage::Unit);
+}
+
+template <>
+uint32 GetPackedOffset<STORAGEPSMT4>(uint32 x)
+{
+	return x / 2;
+}
+
+//Packed PSMT4 rows can only be split on byte boundaries
+template <typename Storage>
+static bool IsPackedOffsetAligned(uint32)
+{
+	return true;
+}
+
+template <>
+bool IsPackedOffsetAligned<STORAGEPSMT4>(uint32 x)
+{
+	return (x & 1) == 0;
+}
+
+template <typename Storage>
+static typename Storage::Unit GetPackedPixel(const uint8* row, uint32 x)
+{
+	return reinterpret_cast<const typename Storage::Unit*>(row)[x];
+}
+
+template <>
+uint8 GetPackedPixel<STORAGEPSMT4>(const uint8* row, uint32 x)
+{
+	return (row[x / 2] >> ((x & 1) * 4)) & 0x0F;
+}
+
+template <typename Storage>
+static uint32 GetBlockAddress(uint32 bufPtr, uint32 bufWidth, uint32 x, uint32 y)
+{
+	uint32 pageNum = (x / Storage::PAGEWIDTH) + (y / Storage::PAGEHEIGHT) * (bufWidth * 64) / Storage::PAGEWIDTH;
+
+	x %= Storage::PAGEWIDTH;
+	y %= Storage::PAGEHEIGHT;
+
+	uint32 blockNum = Storage::m_nBlockSwizzleTable[y / Storage::BLOCKHEIGHT][x / Storage::BLOCKWIDTH];
+
+	return (bufPtr + (pageNum * CGsPixelFormats::PAGESIZE) + (blockNum * CGsPixelFormats::BLOCKSIZE)) & (CGSHandler::RAMSIZE - 1);
+}
+
+//Area of a rectangle made of whole blocks. Left empty if the rectangle wraps around or goes
+//past the buffer's width, pixels could then share the same location and the order in which
+//they are written would matter.
+struct BLOCKAREA
+{
+	uint32	startX;
+	uint32	startY;
+	uint32	endX;
+	uint32	endY;
+
+	bool	IsEmpty() const { return (startX >= endX) || (startY >= endY); }
+};
+
+template <typename Storage>
+static BLOCKAREA GetBlockArea(uint32 bufWidth, uint32 x, uint32 y, uint32 width, uint32 height)
+{
+	BLOCKAREA area;
+	area.startX = ((x + Storage::BLOCKWIDTH - 1) / Storage::BLOCKWIDTH) * Storage::BLOCKWIDTH;
+	area.startY = ((y + Storage::BLOCKHEIGHT - 1) / Storage::BLOCKHEIGHT) * Storage::BLOCKHEIGHT;
+	area.endX = ((x + width) / Storage::BLOCKWIDTH) * Storage::BLOCKWIDTH;
+	area.endY = ((y + height) / Storage::BLOCKHEIGHT) * Storage::BLOCKHEIGHT;
+	if(((x + width) > GS_COORD_MAX) || ((y + height) > GS_COORD_MAX) || ((x + width) > (bufWidth * 64)))
+	{
+		area.startX = area.endX = 0;
+	}
+	return area;
+}
+
+template <typename Storage>
+static bool WritePixels(CGsPixelFormats::CPixelIndexor<Storage>& indexor, uint32 x, uint32 y,
+	uint32 offsetX, uint32 offsetY, uint32 width, uint32 height, const uint8* src, uint32 srcPitch)
+{
+	bool dirty = false;
+	for(uint32 j = offsetY; j < (offsetY + height); j++)
+	{
+		const uint8* srcRow = src + (j * srcPitch);
+		uint32 dstY = (y + j) % GS_COORD_MAX;
+		for(uint32 i = offsetX; i < (offsetX + width); i++)
+		{
+			uint32 dstX = (x + i) % GS_COORD_MAX;
+			auto pixel = GetPackedPixel<Storage>(srcRow, i);
+			if(indexor.GetPixel(dstX, dstY) != pixel)
+			{
+				indexor.SetPixel(dstX, dstY, pixel);
+				dirty = true;
+			}
+		}
+	}
+	return dirty;
+}
+
+template <typename Storage>
+static void ReadPixels(CGsPixelFormats::CPixelIndexor<Storage>& indexor, uint32 x, uint32 y,
+	uint32 offsetX, uint32 offsetY, uint32 width, uint32 height, uint8* dst, uint32 dstPitch)
+{
+	for(uint32 j = offsetY; j < (offsetY + height); j++)
+	{
+		auto dstRow = reinterpret_cast<typename Storage::Unit*>(dst + (j * dstPitch));
+		uint32 srcY = (y + j) % GS_COORD_MAX;
+		for(uint32 i = offsetX; i < (offsetX + width); i++)
+		{
+			dstRow[i] = indexor.GetPixel((x + i) % GS_COORD_MAX, srcY);
+		}
+	}
+}
+
+/////////////////////////////////////////////
+//CGsSwizzle
+/////////////////////////////////////////////
+
+template <typename Storage>
+bool CGsSwizzle::WriteRect(uint8* ram, uint32 bufPtr, uint32 bufWidth, uint32 x, uint32 y, uint32 width, uint32 height, const void* src, uint32 srcPitch)
+{
+	CGsPixelFormats::CPixelIndexor<Storage> indexor(ram, bufPtr, bufWidth);
+	auto srcBytes = reinterpret_cast<const uint8*>(src);
+
+#ifdef GS_SWIZZLE_SIMD
+	auto area = GetBlockArea<Storage>(bufWidth, x, y, width, height);
+	if(!area.IsEmpty() && IsPackedOffsetAligned<Storage>(area.startX - x))
+	{
+		uint32 areaX = area.startX - x;
+		uint32 areaY = area.startY - y;
+		uint32 areaWidth = area.endX - area.startX;
+		uint32 areaHeight = area.endY - area.startY;
+
+		bool dirty = false;
+		dirty |= WritePixels(indexor, x, y, 0, 0, width, areaY, srcBytes, srcPitch);
+		dirty |= WritePixels(indexor, x, y, 0, areaY + areaHeight, width, height - (areaY + areaHeight), srcBytes, srcPitch);
+		dirty |= WritePixels(indexor, x, y, 0, areaY, areaX, areaHeight, srcBytes, srcPitch);
+		dirty |= WritePixels(indexor, x, y, areaX + areaWidth, areaY, width - (areaX + areaWidth), areaHeight, srcBytes, srcPitch);
+
+		alignas(16) uint8 swizzledBlock[CGsPixelFormats::BLOCKSIZE];
+		for(uint32 blockY = area.startY; blockY < area.endY; blockY += Storage::BLOCKHEIGHT)
+		{
+			const uint8* srcRow = srcBytes + ((blockY - y) * srcPitch);
+			for(uint32 blockX = area.startX; blockX < area.endX; blockX += Storage::BLOCKWIDTH)
+			{
+				uint8* block = ram + GetBlockAddress<Storage>(bufPtr, bufWidth, blockX, blockY);
+				CBlockKernels<Storage>::Swizzle(swizzledBlock, srcRow + GetPackedOffset<Storage>(blockX - x), srcPitch);
+				if(memcmp(block, swizzledBlock, CGsPixelFormats::BLOCKSIZE))
+				{
+					memcpy(block, swizzledBlock, CGsPixelFormats::BLOCKSIZE);
+					dirty = true;
+				}
+			}
+		}
+		return dirty;
+	}
+#endif
+
+	return WritePixels(indexor, x, y, 0, 0, width, height, srcBytes, srcPitch);
+}
+
+template <typename Storage>
+void CGsSwizzle::ReadRect(uint8* ram, uint32 bufPtr, uint32 bufWidth, uint32 x, uint32 y, uint32 width, uint32 height, void* dst, uint32 dstPitch)
+{
+	CGsPixelFormats::CPixelIndexor<Storage> indexor(ram, bufPtr, bufWidth);
+	auto dstBytes = reinterpret_cast<uint8*>(dst);
+
+#ifdef GS_SWIZZLE_SIMD
+	auto area = GetBlockArea<Storage>(bufWidth, x, y, width, height);
+	if(!area.IsEmpty())
+	{
+		uint32 areaX = area.startX - x;
+		uint32 areaY = area.startY - y;
+		uint32 areaWidth = area.endX - area.startX;
+		uint32 areaHeight = area.endY - area.startY;
+
+		ReadPixels(indexor, x, y, 0, 0, width, areaY, dstBytes, dstPitch);
+		ReadPixels(indexor, x, y, 0, areaY + areaHeight, width, height - (areaY + areaHeight), dstBytes, dstPitch);
+		ReadPixels(indexor, x, y, 0, areaY, areaX, areaHeight, dstBytes, dstPitch);
+		ReadPixels(indexor, x, y, areaX + areaWidth, areaY, width - (areaX + areaWidth), areaHeight, dstBytes, dstPitch);
+
+		for(uint32 blockY = area.startY; blockY < area.endY; blockY += Storage::BLOCKHEIGHT)
+		{
+			uint8* dstRow = dstBytes + ((blockY - y) * dstPitch);
+			for(uint32 blockX = area.startX; blockX < area.endX; blockX += Storage::BLOCKWIDTH)
+			{
+				const uint8* block = ram + GetBlockAddress<Storage>(bufPtr, bufWidth, blockX, blockY);
+				CBlockKernels<Storage>::Unswizzle(block, dstRow + ((blockX - x) * sizeof(typename Storage::Unit)), dstPitch);
+			}
+		}
+		return;
+	}
+#endif
+
+	ReadPixels(indexor, x, y, 0, 0, width, height, dstBytes, dstPitch);
+}
+
+template bool CGsSwizzle::WriteRect<STORAGEPSMCT32>(uint8*, uint32, uint32, uint32, uint32, uint32, uint32, const void*, uint32);
+template bool CGsSwizzle::WriteRect<STORAGEPSMCT16>(uint8*, uint32, uint32, uint32, uint32, uint32, uint32, const void*, uint32);
+template bool CGsSwizzle::WriteRect<STORAGEPSMCT16S>(uint8*, uint32, uint32, uint32, uint32, uint32, uint32, const void*, uint32);
+template bool CGsSwizzle::WriteRect<STORAGEPSMT8>(uint8*, uint32, uint32, uint32, uint32, uint32, uint32, const void*, uint32);
+template bool CGsSwizzle::WriteRect<STORAGEPSMT4>(uint8*, uint32, uint32, uint32, uint32, uint32, uint32, const void*, uint32);
+
+template void CGsSwizzle::ReadRect<STORAGEPSMCT32>(uint8*, uint32, uint32, uint32, uint32, uint32, uint32, void*, uint32);
+template void CGsSwizzle::ReadRect<STORAGEPSMCT16>(uint8*, uint32, uint32, uint32, uint32, uint32, uint32, void*, uint32);
+template void CGsSwizzle::ReadRect<STORAGEPSMCT16S>(uint8*, uint32, uint32, uint32, uint32, uint32, uint32, void*, uint32);
+template void CGsSwizzle::ReadRect<STORAGEPSMT8>(uint8*, uint32, uint32, uint32, uint32, uint32, uint32, void*, uint32);
+template void CGsSwizzle::ReadRect<STORAGEPSMT4>(uint8*, uint32, uint32, uint32, uint32, uint32, uint32, void*, uint32);
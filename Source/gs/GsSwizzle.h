@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Types.h"
+#include "GsPixelFormats.h"
+
+//Moves rectangles of pixels between linear buffers and GS memory. Blocks entirely covered
+//by the rectangle are swizzled or unswizzled in one go (using vector instructions when
+//available), pixels in partially covered blocks go through the pixel indexors.
+class CGsSwizzle
+{
+public:
+	//Source pixels are packed like they are sent by the host (2 pixels per byte for PSMT4).
+	//Returns true if the contents of GS memory changed.
+	template <typename Storage>
+	static bool		WriteRect(uint8*, uint32, uint32, uint32, uint32, uint32, uint32, const void*, uint32);
+
+	//PSMT4 pixels are expanded to a byte each.
+	template <typename Storage>
+	static void		ReadRect(uint8*, uint32, uint32, uint32, uint32, uint32, uint32, void*, uint32);
+};
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "Types.h"
+#include "make_unique.h"
+#include "GSHandler.h"
+#include "GsPixelFormats.h"
+
+//Texture cache shared by the GS handlers that keep copies of textures. Textures are
+//indexed by their TEX0 value (with the CLUT information masked out by the user) and
+//each GS page keeps the list of textures it overlaps. Looking up a texture and
+//invalidating textures after a transfer thus only touch the textures concerned.
+//
+//TextureType must provide m_tex0, m_live, m_cachedArea and Free().
+template <typename TextureType>
+class CGsTextureCache
+{
+public:
+	struct STATS
+	{
+		uint64		hitCount = 0;
+		uint64		missCount = 0;
+		uint64		evictionCount = 0;
+	};
+
+	unsigned int GetCapacity() const
+	{
+		return static_cast<unsigned int>(m_textures.size());
+	}
+
+	//Frees every texture if the capacity changes
+	void SetCapacity(unsigned int capacity)
+	{
+		capacity = std::max<unsigned int>(capacity, 1);
+		if(capacity == m_textures.size()) return;
+
+		Flush();
+		m_textures.resize(capacity);
+		m_entries.resize(capacity);
+		m_lru.clear();
+		for(unsigned int i = 0; i < capacity; i++)
+		{
+			if(!m_textures[i])
+			{
+				m_textures[i] = std::make_unique<TextureType>();
+			}
+			m_entries[i].lruIterator = m_lru.insert(m_lru.end(), i);
+		}
+		m_pageTextures.resize(PAGE_COUNT);
+	}
+
+	TextureType* Search(uint64 key)
+	{
+		auto textureIterator = m_textureIndex.find(key);
+		if(textureIterator == std::end(m_textureIndex))
+		{
+			m_stats.missCount++;
+			return nullptr;
+		}
+		m_stats.hitCount++;
+		unsigned int textureIndex = textureIterator->second;
+		TouchEntry(textureIndex);
+		return m_textures[textureIndex].get();
+	}
+
+	//Recycles the least recently used texture. The returned texture is live, only
+	//the user specific data (ie.: texture handle) needs to be filled in.
+	TextureType* Insert(uint64 key, const CGSHandler::TEX0& tex0)
+	{
+		assert(!m_textures.empty());
+
+		//Shouldn't happen since textures are only inserted after a failed search
+		auto existingIterator = m_textureIndex.find(key);
+		if(existingIterator != std::end(m_textureIndex))
+		{
+			unsigned int existingIndex = existingIterator->second;
+			Unregister(existingIndex);
+			m_textures[existingIndex]->Free();
+		}
+
+		unsigned int textureIndex = m_lru.back();
+		auto& texture = m_textures[textureIndex];
+		if(texture->m_live)
+		{
+			m_stats.evictionCount++;
+			Unregister(textureIndex);
+		}
+		texture->Free();
+
+		texture->m_cachedArea.SetArea(tex0.nPsm, tex0.GetBufPtr(), tex0.GetBufWidth(), tex0.GetHeight());
+		texture->m_tex0 = key;
+		texture->m_live = true;
+
+		Register(textureIndex, tex0.GetBufPtr());
+		TouchEntry(textureIndex);
+		return texture.get();
+	}
+
+	void InvalidateRange(uint32 start, uint32 size)
+	{
+		if(size == 0) return;
+
+		//Areas going past the end of RAM are all registered in the last page
+		uint32 firstPage = std::min<uint32>(start / CGsPixelFormats::PAGESIZE, PAGE_COUNT - 1);
+		uint32 lastPage = std::min<uint32>((start + size - 1) / CGsPixelFormats::PAGESIZE, PAGE_COUNT - 1);
+
+		//Textures spanning many pages would be visited many times, stamp them once visited
+		m_invalidationStamp++;
+		for(uint32 page = firstPage; page <= lastPage; page++)
+		{
+			for(auto textureIndex : m_pageTextures[page])
+			{
+				auto& entry = m_entries[textureIndex];
+				if(entry.invalidationStamp == m_invalidationStamp) continue;
+				entry.invalidationStamp = m_invalidationStamp;
+				m_textures[textureIndex]->m_cachedArea.Invalidate(start, size);
+			}
+		}
+	}
+
+	void Flush()
+	{
+		for(auto& texture : m_textures)
+		{
+			texture->Free();
+		}
+		for(auto& entry : m_entries)
+		{
+			entry.firstPage = entry.endPage = 0;
+		}
+		for(auto& pageTextures : m_pageTextures)
+		{
+			pageTextures.clear();
+		}
+		m_textureIndex.clear();
+	}
+
+	const STATS& GetStats() const
+	{
+		return m_stats;
+	}
+
+	void ResetStats()
+	{
+		m_stats = STATS();
+	}
+
+private:
+	enum
+	{
+		PAGE_COUNT = CGSHandler::RAMSIZE / CGsPixelFormats::PAGESIZE,
+	};
+
+	struct ENTRY
+	{
+		std::list<unsigned int>::iterator	lruIterator;
+		uint32								firstPage = 0;
+		uint32								endPage = 0;
+		uint32								invalidationStamp = 0;
+	};
+
+	void Register(unsigned int textureIndex, uint32 bufPtr)
+	{
+		auto& texture = m_textures[textureIndex];
+		auto& entry = m_entries[textureIndex];
+
+		m_textureIndex[texture->m_tex0] = textureIndex;
+
+		//Same range as the one checked by CGsCachedArea::Invalidate
+		uint32 areaSize = texture->m_cachedArea.GetSize();
+		entry.firstPage = entry.endPage = 0;
+		if(areaSize == 0) return;
+		entry.firstPage = std::min<uint32>(bufPtr / CGsPixelFormats::PAGESIZE, PAGE_COUNT - 1);
+		entry.endPage = std::min<uint32>(((bufPtr + areaSize - 1) / CGsPixelFormats::PAGESIZE) + 1, PAGE_COUNT);
+		for(uint32 page = entry.firstPage; page < entry.endPage; page++)
+		{
+			m_pageTextures[page].push_back(textureIndex);
+		}
+	}
+
+	void Unregister(unsigned int textureIndex)
+	{
+		auto& texture = m_textures[textureIndex];
+		auto& entry = m_entries[textureIndex];
+
+		m_textureIndex.erase(texture->m_tex0);
+		for(uint32 page = entry.firstPage; page < entry.endPage; page++)
+		{
+			auto& pageTextures = m_pageTextures[page];
+			auto textureIterator = std::find(std::begin(pageTextures), std::end(pageTextures), textureIndex);
+			assert(textureIterator != std::end(pageTextures));
+			*textureIterator = pageTextures.back();
+			pageTextures.pop_back();
+		}
+		entry.firstPage = entry.endPage = 0;
+	}
+
+	void TouchEntry(unsigned int textureIndex)
+	{
+		m_lru.splice(m_lru.begin(), m_lru, m_entries[textureIndex].lruIterator);
+	}
+
+	typedef std::unique_ptr<TextureType> TexturePtr;
+
+	std::vector<TexturePtr>						m_textures;
+	std::vector<ENTRY>							m_entries;
+	std::list<unsigned int>						m_lru;
+	std::unordered_map<uint64, unsigned int>	m_textureIndex;
+	std::vector<std::vector<unsigned int>>		m_pageTextures;
+	uint32										m_invalidationStamp = 0;
+	STATS										m_stats;
+};
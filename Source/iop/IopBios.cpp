@@ -716,6 +716,7 @@ void CIopBios::ProcessModuleReset(const std::string& imagePath)
 #ifdef _IOP_EMULATE_MODULES
 	m_fileIo->SetModuleVersion(imageVersion);
 #endif
+	OnModuleReset(imagePath);
 }
 
 bool CIopBios::TryGetImageVersionFromPath(const std::string& imagePath, unsigned int* result)
@@ -1394,6 +1395,7 @@ uint64 CIopBios::ClockToMicroSec(uint64 clock)
 void CIopBios::CountTicks(uint32 ticks)
 {
 	CurrentTime() += ticks;
+	m_cdvdman->ProcessReads();
 }
 
 void CIopBios::NotifyVBlankStart()
@@ -1421,7 +1423,6 @@ void CIopBios::NotifyVBlankEnd()
 		}
 	}
 #ifdef _IOP_EMULATE_MODULES
-	m_cdvdfsv->ProcessCommands(m_sifMan.get());
 	m_fileIo->ProcessCommands();
 #endif
 }
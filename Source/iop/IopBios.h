@@ -204,8 +204,10 @@ public:
 #endif
 
 	typedef boost::signals2::signal<void (uint32)> ModuleStartedEvent;
+	typedef boost::signals2::signal<void (const std::string&)> ModuleResetEvent;
 
 	ModuleStartedEvent			OnModuleStarted;
+	ModuleResetEvent			OnModuleReset;
 
 private:
 	enum DEFAULT_STACKSIZE
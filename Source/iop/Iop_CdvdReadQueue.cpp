@@ -0,0 +1,146 @@
+#include <cassert>
+#include <cstring>
+#include "Iop_CdvdReadQueue.h"
+#include "../ISO9660/BlockProvider.h"
+#include "../Log.h"
+
+using namespace Iop;
+
+#define LOG_NAME ("iop_cdvdreadqueue")
+
+CCdvdReadQueue::CCdvdReadQueue()
+{
+	m_thread = std::thread([this] () { ThreadProc(); });
+}
+
+CCdvdReadQueue::~CCdvdReadQueue()
+{
+	m_mailBox.SendCall([this] () { m_threadDone = true; });
+	m_thread.join();
+}
+
+void CCdvdReadQueue::SetImage(CISO9660* image)
+{
+	Flush();
+	//Make sure the worker thread isn't touching the previous image anymore
+	m_mailBox.FlushCalls();
+	m_image = image;
+}
+
+void CCdvdReadQueue::Read(uint32 sector, uint32 count, uint8* dst, uint64 completionTime, const CompletionHandler& completionHandler)
+{
+	auto request = std::make_shared<REQUEST>();
+	request->sector = sector;
+	request->count = count;
+	request->completionTime = completionTime;
+	request->completionHandler = completionHandler;
+	request->dataReady = false;
+	//Leave the destination untouched if there's no disk to read from
+	if(m_image != nullptr)
+	{
+		request->dst = dst;
+		request->data.resize(static_cast<size_t>(count) * ISO9660::CBlockProvider::BLOCKSIZE);
+	}
+	m_requests.push_back(request);
+
+	m_stats.requestCount++;
+	m_stats.sectorCount += count;
+
+	auto image = m_image;
+	m_mailBox.SendCall(
+		[request, image] ()
+		{
+			try
+			{
+				if(image != nullptr)
+				{
+					image->ReadBlocks(request->sector, request->count, request->data.data());
+				}
+			}
+			catch(const std::exception& exception)
+			{
+				CLog::GetInstance().Print(LOG_NAME, "Failed to read sectors 0x%0.8X to 0x%0.8X: %s\r\n",
+					request->sector, request->sector + request->count - 1, exception.what());
+			}
+			request->dataReady = true;
+		}
+	);
+}
+
+void CCdvdReadQueue::Update(uint64 currentTime)
+{
+	while(!m_requests.empty())
+	{
+		auto request = m_requests.front();
+		if(currentTime < request->completionTime) break;
+		WaitForData(request);
+		Complete(request);
+	}
+}
+
+void CCdvdReadQueue::Flush()
+{
+	//Completion handlers might queue new requests
+	while(!m_requests.empty())
+	{
+		auto request = m_requests.front();
+		WaitForData(request);
+		Complete(request);
+	}
+}
+
+void CCdvdReadQueue::Reset()
+{
+	//Requests being read by the worker thread are kept alive by its own reference
+	m_requests.clear();
+	m_mailBox.FlushCalls();
+}
+
+bool CCdvdReadQueue::IsEmpty() const
+{
+	return m_requests.empty();
+}
+
+const CCdvdReadQueue::STATS& CCdvdReadQueue::GetStats() const
+{
+	return m_stats;
+}
+
+void CCdvdReadQueue::ResetStats()
+{
+	m_stats = STATS();
+}
+
+void CCdvdReadQueue::WaitForData(const RequestPtr& request)
+{
+	if(request->dataReady) return;
+	m_stats.stallCount++;
+	m_mailBox.FlushCalls();
+	assert(request->dataReady);
+}
+
+void CCdvdReadQueue::Complete(const RequestPtr& request)
+{
+	assert(!m_requests.empty() && (m_requests.front() == request));
+	m_requests.pop_front();
+	if(request->dst != nullptr)
+	{
+		memcpy(request->dst, request->data.data(), request->data.size());
+	}
+	if(request->completionHandler)
+	{
+		request->completionHandler();
+	}
+}
+
+void CCdvdReadQueue::ThreadProc()
+{
+	while(!m_threadDone)
+	{
+		m_mailBox.WaitForCall();
+		while(m_mailBox.IsPending())
+		{
+			m_mailBox.ReceiveCall();
+		}
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Types.h"
+#include "../MailBox.h"
+#include "../ISO9660/ISO9660.h"
+
+namespace Iop
+{
+	//Reads sectors of a disk image on a worker thread. Data is kept in a staging buffer until the
+	//emulation thread completes the request, which copies it to its destination and runs the
+	//completion handler. Requests are completed in the order they were queued, at the emulated
+	//time they were given, no matter how long the host took to read them.
+	class CCdvdReadQueue
+	{
+	public:
+		typedef std::function<void ()> CompletionHandler;
+
+		struct STATS
+		{
+			uint32		requestCount = 0;
+			uint64		sectorCount = 0;
+			//Requests that had to wait for the worker thread to be completed
+			uint32		stallCount = 0;
+		};
+
+							CCdvdReadQueue();
+		virtual				~CCdvdReadQueue();
+
+		//Pending requests are completed before the image is replaced
+		void				SetImage(CISO9660*);
+
+		//Completion happens once the current time reached the given time, waiting for the data if it isn't read yet
+		void				Read(uint32, uint32, uint8*, uint64, const CompletionHandler&);
+		void				Update(uint64);
+		//Completes every pending request right away, waiting for their data if needed
+		void				Flush();
+		//Drops pending requests without completing them
+		void				Reset();
+
+		bool				IsEmpty() const;
+
+		const STATS&		GetStats() const;
+		void				ResetStats();
+
+	private:
+		struct REQUEST
+		{
+			uint32				sector = 0;
+			uint32				count = 0;
+			uint8*				dst = nullptr;
+			uint64				completionTime = 0;
+			CompletionHandler	completionHandler;
+			std::vector<uint8>	data;
+			std::atomic<bool>	dataReady;
+		};
+		typedef std::shared_ptr<REQUEST> RequestPtr;
+		typedef std::deque<RequestPtr> RequestQueue;
+
+		void				WaitForData(const RequestPtr&);
+		void				Complete(const RequestPtr&);
+		void				ThreadProc();
+
+		CISO9660*			m_image = nullptr;
+		RequestQueue		m_requests;
+		STATS				m_stats;
+
+		CMailBox			m_mailBox;
+		std::thread			m_thread;
+		bool				m_threadDone = false;
+	};
+}
@@ -3,14 +3,14 @@
 #include "../Ps2Const.h"
 #include "Iop_Cdvdfsv.h"
 #include "Iop_Cdvdman.h"
-#include "Iop_SifManPs2.h"
 
 using namespace Iop;
 
 #define LOG_NAME "iop_cdvdfsv"
 
 CCdvdfsv::CCdvdfsv(CSifMan& sif, CCdvdman& cdvdman, uint8* iopRam)
-: m_cdvdman(cdvdman)
+: m_sifMan(sif)
+, m_cdvdman(cdvdman)
 , m_iopRam(iopRam)
 {
 	m_module592 = CSifModuleAdapter(std::bind(&CCdvdfsv::Invoke592, this,
@@ -52,43 +52,6 @@ std::string CCdvdfsv::GetFunctionName(unsigned int) const
 	return "unknown";
 }
 
-void CCdvdfsv::ProcessCommands(CSifMan* sifMan)
-{
-	if(m_pendingCommand != COMMAND_NONE)
-	{
-		static const uint32 sectorSize = 0x800;
-
-		if(m_pendingCommand == COMMAND_READ)
-		{
-			auto sifManPs2 = dynamic_cast<CSifManPs2*>(sifMan);
-			assert(sifManPs2 != nullptr);
-
-			uint8* eeRam = sifManPs2->GetEeRam();
-
-			if(m_iso != nullptr)
-			{
-				for(unsigned int i = 0; i < m_pendingReadCount; i++)
-				{
-					m_iso->ReadBlock(m_pendingReadSector + i, eeRam + (m_pendingReadAddr + (i * sectorSize)));
-				}
-			}
-		}
-		else if(m_pendingCommand == COMMAND_READIOP)
-		{
-			if(m_iso != nullptr)
-			{
-				for(unsigned int i = 0; i < m_pendingReadCount; i++)
-				{
-					m_iso->ReadBlock(m_pendingReadSector + i, m_iopRam + (m_pendingReadAddr + (i * sectorSize)));
-				}
-			}
-		}
-
-		m_pendingCommand = COMMAND_NONE;
-		sifMan->SendCallReply(MODULE_ID_4, nullptr);
-	}
-}
-
 void CCdvdfsv::SetIsoImage(CISO9660* iso)
 {
 	m_iso = iso;
@@ -212,7 +175,7 @@ bool CCdvdfsv::Invoke595(uint32 method, uint32* args, uint32 argsSize, uint32* r
 		break;
 
 	case 0x09:
-		StreamCmd(args, argsSize, ret, retSize, ram);
+		return StreamCmd(args, argsSize, ret, retSize, ram);
 		break;
 
 	case 0x0D:
@@ -224,7 +187,7 @@ bool CCdvdfsv::Invoke595(uint32 method, uint32* args, uint32 argsSize, uint32* r
 		//DiskReady (returns 2 if ready, 6 if not ready)
 		assert(retSize >= 4);
 		CLog::GetInstance().Print(LOG_NAME, "NDiskReady();\r\n");
-		if(m_pendingCommand != COMMAND_NONE)
+		if(m_cdvdman.IsReading())
 		{
 			ret[0x00] = 6;
 		}
@@ -309,11 +272,12 @@ void CCdvdfsv::Read(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize,
 		ret[0] = 0;
 	}
 
-	assert(m_pendingCommand == COMMAND_NONE);
-	m_pendingCommand = COMMAND_READ;
-	m_pendingReadSector = sector;
-	m_pendingReadCount = count;
-	m_pendingReadAddr = dstAddr & 0x1FFFFFFF;
+	m_cdvdman.QueueRead(sector, count, ram + (dstAddr & 0x1FFFFFFF),
+		[this] ()
+		{
+			m_sifMan.SendCallReply(MODULE_ID_4, nullptr);
+		}
+	);
 }
 
 void CCdvdfsv::ReadIopMem(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize, uint8* ram)
@@ -331,14 +295,15 @@ void CCdvdfsv::ReadIopMem(uint32* args, uint32 argsSize, uint32* ret, uint32 ret
 		ret[0] = 0;
 	}
 
-	assert(m_pendingCommand == COMMAND_NONE);
-	m_pendingCommand = COMMAND_READIOP;
-	m_pendingReadSector = sector;
-	m_pendingReadCount = count;
-	m_pendingReadAddr = dstAddr & 0x1FFFFFFF;
+	m_cdvdman.QueueRead(sector, count, m_iopRam + (dstAddr & 0x1FFFFFFF),
+		[this] ()
+		{
+			m_sifMan.SendCallReply(MODULE_ID_4, nullptr);
+		}
+	);
 }
 
-void CCdvdfsv::StreamCmd(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize, uint8* ram)
+bool CCdvdfsv::StreamCmd(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize, uint8* ram)
 {
 	uint32 sector	= args[0x00];
 	uint32 count	= args[0x01];
@@ -362,18 +327,22 @@ void CCdvdfsv::StreamCmd(uint32* args, uint32 argsSize, uint32* ret, uint32 retS
 		//Read
 		dstAddr &= (PS2::EE_RAM_SIZE - 1);
 
-		if(m_iso != NULL)
-		{
-			for(unsigned int i = 0; i < count; i++)
-			{
-				m_iso->ReadBlock(m_streamPos, ram + (dstAddr + (i * 0x800)));
-				m_streamPos++;
-			}
-		}
-
 		ret[0] = count;
 		CLog::GetInstance().Print(LOG_NAME, "StreamRead(count = 0x%0.8X, dest = 0x%0.8X);\r\n",
 			count, dstAddr);
+
+		if(m_iso != NULL)
+		{
+			//Reply is sent once the data is transferred
+			m_cdvdman.QueueRead(m_streamPos, count, ram + dstAddr,
+				[this] ()
+				{
+					m_sifMan.SendCallReply(MODULE_ID_4, nullptr);
+				}
+			);
+			m_streamPos += count;
+			return false;
+		}
 		break;
 	case 3:
 		//Stop
@@ -398,6 +367,7 @@ void CCdvdfsv::StreamCmd(uint32* args, uint32 argsSize, uint32* ret, uint32 retS
 		CLog::GetInstance().Print(LOG_NAME, "Unknown stream command used.\r\n");
 		break;
 	}
+	return true;
 }
 
 void CCdvdfsv::SearchFile(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize, uint8* ram)
@@ -19,7 +19,6 @@ namespace Iop
 		std::string			GetFunctionName(unsigned int) const override;
 		void				Invoke(CMIPS&, unsigned int) override;
 
-		void				ProcessCommands(CSifMan*);
 		void				SetIsoImage(CISO9660*);
 
 		enum MODULE_ID
@@ -35,13 +34,6 @@ namespace Iop
 		};
 
 	private:
-		enum COMMAND
-		{
-			COMMAND_NONE,
-			COMMAND_READ,
-			COMMAND_READIOP
-		};
-
 		bool				Invoke592(uint32, uint32*, uint32, uint32*, uint32, uint8*);
 		bool				Invoke593(uint32, uint32*, uint32, uint32*, uint32, uint8*);
 		bool				Invoke595(uint32, uint32*, uint32, uint32*, uint32, uint8*);
@@ -53,18 +45,15 @@ namespace Iop
 		//Methods
 		void				Read(uint32*, uint32, uint32*, uint32, uint8*);
 		void				ReadIopMem(uint32*, uint32, uint32*, uint32, uint8*);
-		void				StreamCmd(uint32*, uint32, uint32*, uint32, uint8*);
+		bool				StreamCmd(uint32*, uint32, uint32*, uint32, uint8*);
 		void				SearchFile(uint32*, uint32, uint32*, uint32, uint8*);
 
+		CSifMan&			m_sifMan;
 		CCdvdman&			m_cdvdman;
 		uint32				m_streamPos = 0;
 		uint8*				m_iopRam = nullptr;
 		CISO9660*			m_iso = nullptr;
 
-		COMMAND				m_pendingCommand = COMMAND_NONE;
-		uint32				m_pendingReadSector = 0;
-		uint32				m_pendingReadCount = 0;
-		uint32				m_pendingReadAddr = 0;
 		bool				m_streaming = false;
 
 		CSifModuleAdapter	m_module592;
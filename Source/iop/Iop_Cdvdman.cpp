@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "../Log.h"
 #include "../RegisterStateFile.h"
 #include "IopBios.h"
@@ -8,6 +9,14 @@
 #define STATE_FILENAME			("iop_cdvdman/state.xml")
 #define STATE_CALLBACK_ADDRESS	("CallbackAddress")
 #define STATE_STATUS			("Status")
+#define STATE_NEXT_READ_SECTOR	("NextReadSector")
+#define STATE_READ_END_TIME		("ReadEndTime")
+
+//Rough figures for a 4x DVD drive, in microseconds
+#define SECTOR_READ_TIME		(370)
+#define SEEK_TIME_MIN			(20000)
+#define SEEK_TIME_MAX			(120000)
+#define DVD_LAYER_SECTOR_COUNT	(2295104)
 
 #define FUNCTION_CDINIT				"CdInit"
 #define FUNCTION_CDREAD				"CdRead"
@@ -34,7 +43,12 @@ CCdvdman::CCdvdman(CIopBios& bios, uint8* ram)
 
 CCdvdman::~CCdvdman()
 {
-
+	const auto& readStats = m_readQueue.GetStats();
+	if(readStats.requestCount != 0)
+	{
+		CLog::GetInstance().Print(LOG_NAME, "Read %llu sectors in %u requests, %u requests had to wait for the disk image.\r\n",
+			static_cast<unsigned long long>(readStats.sectorCount), readStats.requestCount, readStats.stallCount);
+	}
 }
 
 void CCdvdman::LoadState(Framework::CZipArchiveReader& archive)
@@ -42,6 +56,11 @@ void CCdvdman::LoadState(Framework::CZipArchiveReader& archive)
 	CRegisterStateFile registerFile(*archive.BeginReadFile(STATE_FILENAME));
 	m_callbackPtr = registerFile.GetRegister32(STATE_CALLBACK_ADDRESS);
 	m_status = registerFile.GetRegister32(STATE_STATUS);
+	m_nextReadSector = registerFile.GetRegister32(STATE_NEXT_READ_SECTOR);
+	m_readEndTime = registerFile.GetRegister64(STATE_READ_END_TIME);
+
+	//Reads are completed before saving, those still pending belong to the discarded state
+	m_readQueue.Reset();
 }
 
 void CCdvdman::SaveState(Framework::CZipArchiveWriter& archive)
@@ -49,6 +68,8 @@ void CCdvdman::SaveState(Framework::CZipArchiveWriter& archive)
 	auto registerFile = new CRegisterStateFile(STATE_FILENAME);
 	registerFile->SetRegister32(STATE_CALLBACK_ADDRESS, m_callbackPtr);
 	registerFile->SetRegister32(STATE_STATUS, m_status);
+	registerFile->SetRegister32(STATE_NEXT_READ_SECTOR, m_nextReadSector);
+	registerFile->SetRegister64(STATE_READ_END_TIME, m_readEndTime);
 	archive.InsertFile(registerFile);
 }
 
@@ -193,6 +214,56 @@ void CCdvdman::Invoke(CMIPS& ctx, unsigned int functionId)
 void CCdvdman::SetIsoImage(CISO9660* image)
 {
 	m_image = image;
+	m_readQueue.SetImage(image);
+}
+
+void CCdvdman::SetReadTimingEnabled(bool readTimingEnabled)
+{
+	m_readTimingEnabled = readTimingEnabled;
+}
+
+void CCdvdman::QueueRead(uint32 sector, uint32 count, uint8* dst, const CCdvdReadQueue::CompletionHandler& completionHandler)
+{
+	uint64 completionTime = 0;
+	if(m_readTimingEnabled)
+	{
+		//The drive handles one request at a time
+		uint64 startTime = std::max(m_bios.GetCurrentTime(), m_readEndTime);
+		completionTime = startTime + GetReadTime(sector, count);
+		m_readEndTime = completionTime;
+	}
+	m_nextReadSector = sector + count;
+	m_readQueue.Read(sector, count, dst, completionTime, completionHandler);
+}
+
+bool CCdvdman::IsReading() const
+{
+	return !m_readQueue.IsEmpty();
+}
+
+void CCdvdman::ProcessReads()
+{
+	if(m_readQueue.IsEmpty()) return;
+	m_readQueue.Update(m_bios.GetCurrentTime());
+}
+
+void CCdvdman::FlushReads()
+{
+	//The drive stays busy until the flushed reads would have been done, the timing of the
+	//following reads doesn't depend on whether a state was saved or not
+	m_readQueue.Flush();
+}
+
+uint64 CCdvdman::GetReadTime(uint32 sector, uint32 count) const
+{
+	uint32 seekTime = 0;
+	if(sector != m_nextReadSector)
+	{
+		uint32 distance = (sector > m_nextReadSector) ? (sector - m_nextReadSector) : (m_nextReadSector - sector);
+		distance = std::min<uint32>(distance, DVD_LAYER_SECTOR_COUNT);
+		seekTime = SEEK_TIME_MIN + static_cast<uint32>((static_cast<uint64>(SEEK_TIME_MAX - SEEK_TIME_MIN) * distance) / DVD_LAYER_SECTOR_COUNT);
+	}
+	return m_bios.MicroSecToClock(seekTime + (count * SECTOR_READ_TIME));
 }
 
 uint32 CCdvdman::CdInit(uint32 mode)
@@ -217,13 +288,19 @@ uint32 CCdvdman::CdRead(uint32 startSector, uint32 sectorCount, uint32 bufferPtr
 	}
 	if(m_image != NULL && bufferPtr != 0)
 	{
-		uint8* buffer = &m_ram[bufferPtr];
-		uint32 sectorSize = 2048;
-		for(unsigned int i = 0; i < sectorCount; i++)
-		{
-			m_image->ReadBlock(startSector + i, buffer);
-			buffer += sectorSize;
-		}
+		m_status = CDVD_STATUS_READING;
+		QueueRead(startSector, sectorCount, &m_ram[bufferPtr],
+			[this] ()
+			{
+				m_status = CDVD_STATUS_PAUSED;
+				if(m_callbackPtr != 0)
+				{
+					static const uint32 callbackTypeCdRead = 1;
+					m_bios.TriggerCallback(m_callbackPtr, callbackTypeCdRead, 0);
+				}
+			}
+		);
+		return 1;
 	}
 	if(m_callbackPtr != 0)
 	{
@@ -287,8 +364,8 @@ uint32 CCdvdman::CdSearchFile(uint32 fileInfoPtr, uint32 namePtr)
 			fixedPath[slashPos] = '/';
 			slashPos = fixedPath.find('\\', slashPos + 1);
 		}
-
-		ISO9660::CDirectoryRecord record;
+
+		ISO9660::CDirectoryRecord record;
 		if(m_image->GetFileRecord(&record, fixedPath.c_str()))
 		{
 			fileInfo->sector	= record.GetPosition();
@@ -308,6 +385,15 @@ uint32 CCdvdman::CdSync(uint32 mode)
 {
 	CLog::GetInstance().Print(LOG_NAME, FUNCTION_CDSYNC "(mode = %i);\r\n",
 		mode);
+	if((mode & 1) == 0)
+	{
+		//Blocking wait, the calling thread can't be suspended from here, complete reads right away
+		FlushReads();
+	}
+	else if(IsReading())
+	{
+		return 1;
+	}
 	if(m_status == CDVD_STATUS_READING)
 	{
 		m_status = CDVD_STATUS_PAUSED;
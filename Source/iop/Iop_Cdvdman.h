@@ -2,6 +2,7 @@
 
 #include "Iop_Module.h"
 #include "../ISO9660/ISO9660.h"
+#include "Iop_CdvdReadQueue.h"
 #include "zip/ZipArchiveWriter.h"
 #include "zip/ZipArchiveReader.h"
 
@@ -29,6 +30,14 @@ namespace Iop
 		virtual void			Invoke(CMIPS&, unsigned int) override;
 
 		void					SetIsoImage(CISO9660*);
+		void					SetReadTimingEnabled(bool);
+
+		//Reads are completed by ProcessReads once the time needed by the drive to seek and transfer
+		//the sectors elapsed (right away if read timing is disabled), waiting for the disk image if needed
+		void					QueueRead(uint32, uint32, uint8*, const CCdvdReadQueue::CompletionHandler&);
+		bool					IsReading() const;
+		void					ProcessReads();
+		void					FlushReads();
 
 		void					LoadState(Framework::CZipArchiveReader&);
 		void					SaveState(Framework::CZipArchiveWriter&);
@@ -50,12 +59,19 @@ namespace Iop
 		uint32					CdSetMmode(uint32);
 		uint32					CdLayerSearchFile(uint32, uint32, uint32);
 
+		uint64					GetReadTime(uint32, uint32) const;
+
 		CIopBios&				m_bios;
 		CISO9660*				m_image = nullptr;
 		uint8*					m_ram = nullptr;
 
 		uint32					m_callbackPtr = 0;
 		uint32					m_status = CDVD_STATUS_STOPPED;
+
+		bool					m_readTimingEnabled = true;
+		uint32					m_nextReadSector = 0;
+		uint64					m_readEndTime = 0;
+		CCdvdReadQueue			m_readQueue;
 	};
 
 	typedef std::shared_ptr<CCdvdman> CdvdmanPtr;
@@ -6,6 +6,14 @@
 #include "../RegisterStateFile.h"
 #include "Iop_SpuBase.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define SPU_MIX_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SPU_MIX_NEON
+#include <arm_neon.h>
+#endif
+
 using namespace Iop;
 
 #define INIT_SAMPLE_RATE (44100)
@@ -530,13 +538,29 @@ int32 CSpuBase::ComputeChannelVolume(const CHANNEL_VOLUME& volume, int32 current
 	return volumeLevel;
 }
 
-void CSpuBase::MixSamples(int32 inputSample, int32 volumeLevel, int16* output)
+void CSpuBase::AccumulateSamples(int16* output, const int16* input, unsigned int sampleCount)
 {
-	inputSample = (inputSample * volumeLevel) / 0x7FFF;
-	int32 resultSample = inputSample + static_cast<int32>(*output);
-	resultSample = std::max<int32>(resultSample, SHRT_MIN);
-	resultSample = std::min<int32>(resultSample, SHRT_MAX);
-	*output = static_cast<int16>(resultSample);
+	unsigned int i = 0;
+#if defined(SPU_MIX_SSE2)
+	for(; (i + 8) <= sampleCount; i += 8)
+	{
+		__m128i outputSamples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(output + i));
+		__m128i inputSamples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_adds_epi16(outputSamples, inputSamples));
+	}
+#elif defined(SPU_MIX_NEON)
+	for(; (i + 8) <= sampleCount; i += 8)
+	{
+		vst1q_s16(output + i, vqaddq_s16(vld1q_s16(output + i), vld1q_s16(input + i)));
+	}
+#endif
+	for(; i < sampleCount; i++)
+	{
+		int32 resultSample = static_cast<int32>(output[i]) + static_cast<int32>(input[i]);
+		resultSample = std::max<int32>(resultSample, SHRT_MIN);
+		resultSample = std::min<int32>(resultSample, SHRT_MAX);
+		output[i] = static_cast<int16>(resultSample);
+	}
 }
 
 void CSpuBase::Render(int16* samples, unsigned int sampleCount, unsigned int sampleRate)
@@ -544,77 +568,41 @@ void CSpuBase::Render(int16* samples, unsigned int sampleCount, unsigned int sam
 	assert((sampleCount & 0x01) == 0);
 	//ticks are 44100Hz ticks
 	unsigned int ticks = sampleCount / 2;
-	memset(samples, 0, sizeof(int16) * sampleCount);
-
-	for(unsigned int j = 0; j < ticks; j++)
+	while(ticks != 0)
 	{
-		int16 reverbSample[2] = { 0, 0 };
-		//Update channels
-		for(unsigned int i = 0; i < 24; i++)
-		{
-			CHANNEL& channel(m_channel[i]);
-			if(channel.status == STOPPED) continue;
-			CSampleReader& reader(m_reader[i]);
-			if(channel.status == KEY_ON)
-			{
-				reader.SetParams(channel.address, channel.repeat);
-				reader.ClearEndFlag();
-				channel.status = ATTACK;
-				channel.adsrVolume = 0;
-			}
-			else
-			{
-				if(reader.IsDone())
-				{
-					channel.status = STOPPED;
-					channel.adsrVolume = 0;
-					continue;
-				}
-				if(reader.DidChangeRepeat())
-				{
-					channel.repeat = reader.GetRepeat();
-					reader.ClearDidChangeRepeat();
-				}
-				//Update repeat in case it has been changed externally (needed for FFX)
-				reader.SetRepeat(channel.repeat);
-			}
-
-			reader.SetIrqAddress(m_irqAddr);
-
-			int16 readSample = 0;
-			reader.SetPitch(m_baseSamplingRate, channel.pitch);
-			reader.GetSamples(&readSample, 1, sampleRate);
-			channel.current = reader.GetCurrent();
-
-			if((m_ctrl & CONTROL_IRQ) && reader.GetIrqPending())
-			{
-				m_irqPending = true;
-			}
-
-			reader.ClearIrqPending();
+		unsigned int blockTicks = std::min<unsigned int>(ticks, MAX_BLOCK_TICKS);
+		RenderBlock(samples, blockTicks, sampleRate);
+		samples += blockTicks * 2;
+		ticks -= blockTicks;
+	}
+}
 
-			//Mix samples
-			UpdateAdsr(channel);
-			int32 inputSample = static_cast<int32>(readSample);
-			//Mix adsrVolume
-			{
-				inputSample = (inputSample * static_cast<int32>(channel.adsrVolume >> 16)) / static_cast<int32>(MAX_ADSR_VOLUME >> 16);
-			}
+void CSpuBase::RenderBlock(int16* samples, unsigned int ticks, unsigned int sampleRate)
+{
+	assert(ticks <= MAX_BLOCK_TICKS);
+	memset(samples, 0, sizeof(int16) * ticks * 2);
 
-			channel.volumeLeftAbs	= ComputeChannelVolume(channel.volumeLeft, channel.volumeLeftAbs);
-			channel.volumeRightAbs	= ComputeChannelVolume(channel.volumeRight, channel.volumeRightAbs);
+	int16 reverbSamples[MAX_BLOCK_TICKS * 2];
+	memset(reverbSamples, 0, sizeof(int16) * ticks * 2);
 
-			int32 adjustedLeftVolume = std::min<int32>(0x7FFF, static_cast<int32>(static_cast<float>(channel.volumeLeftAbs >> 16) * m_volumeAdjust));
-			int32 adjustedRightVolume = std::min<int32>(0x7FFF, static_cast<int32>(static_cast<float>(channel.volumeRightAbs >> 16) * m_volumeAdjust));
-			MixSamples(inputSample, adjustedLeftVolume, samples + 0);
-			MixSamples(inputSample, adjustedRightVolume, samples + 1);
-			//Mix in reverb if enabled for this channel
-			if(m_reverbEnabled && (m_channelReverb.f & (1 << i)))
-			{
-				MixSamples(inputSample, adjustedLeftVolume,	reverbSample + 0);
-				MixSamples(inputSample, adjustedRightVolume, reverbSample + 1);
-			}
+	//Voices are independent from each other, render them one after the other for the whole block.
+	//They are always mixed in channel order, saturation results don't depend on the block size.
+	for(unsigned int i = 0; i < MAX_CHANNEL; i++)
+	{
+		int16 voiceSamples[MAX_BLOCK_TICKS * 2];
+		unsigned int voiceTicks = RenderVoice(i, voiceSamples, ticks, sampleRate);
+		if(voiceTicks == 0) continue;
+		AccumulateSamples(samples, voiceSamples, voiceTicks * 2);
+		//Mix in reverb if enabled for this channel
+		if(m_reverbEnabled && (m_channelReverb.f & (1 << i)))
+		{
+			AccumulateSamples(reverbSamples, voiceSamples, voiceTicks * 2);
 		}
+	}
+
+	for(unsigned int j = 0; j < ticks; j++)
+	{
+		const int16* reverbSample = reverbSamples + (j * 2);
 		//Update reverb
 		if(m_reverbEnabled)
 		{
@@ -746,6 +734,96 @@ void CSpuBase::Render(int16* samples, unsigned int sampleCount, unsigned int sam
 	}
 }
 
+unsigned int CSpuBase::RenderVoice(unsigned int channelIndex, int16* output, unsigned int ticks, unsigned int sampleRate)
+{
+	CHANNEL& channel(m_channel[channelIndex]);
+	if(channel.status == STOPPED) return 0;
+	CSampleReader& reader(m_reader[channelIndex]);
+	if(channel.status == KEY_ON)
+	{
+		reader.SetParams(channel.address, channel.repeat);
+		reader.ClearEndFlag();
+		channel.status = ATTACK;
+		channel.adsrVolume = 0;
+	}
+	else
+	{
+		if(reader.IsDone())
+		{
+			channel.status = STOPPED;
+			channel.adsrVolume = 0;
+			return 0;
+		}
+		if(reader.DidChangeRepeat())
+		{
+			channel.repeat = reader.GetRepeat();
+			reader.ClearDidChangeRepeat();
+		}
+		//Update repeat in case it has been changed externally (needed for FFX)
+		reader.SetRepeat(channel.repeat);
+	}
+
+	reader.SetIrqAddress(m_irqAddr);
+	reader.SetPitch(m_baseSamplingRate, channel.pitch);
+
+	//Run the envelope first since it tells us when the voice stops
+	int32 adsrLevels[MAX_BLOCK_TICKS];
+	unsigned int envelopeTicks = 0;
+	while(envelopeTicks < ticks)
+	{
+		UpdateAdsr(channel);
+		adsrLevels[envelopeTicks++] = static_cast<int32>(channel.adsrVolume >> 16);
+		if(channel.status == STOPPED) break;
+	}
+
+	//The reader stops early when it reaches the end of the data or changes the repeat address
+	int16 readSamples[MAX_BLOCK_TICKS];
+	unsigned int voiceTicks = 0;
+	while(voiceTicks < envelopeTicks)
+	{
+		if(voiceTicks != 0)
+		{
+			if(reader.IsDone())
+			{
+				channel.status = STOPPED;
+				channel.adsrVolume = 0;
+				break;
+			}
+			if(reader.DidChangeRepeat())
+			{
+				channel.repeat = reader.GetRepeat();
+				reader.ClearDidChangeRepeat();
+			}
+		}
+		voiceTicks += reader.GetSamples(readSamples + voiceTicks, envelopeTicks - voiceTicks, sampleRate);
+	}
+	channel.current = reader.GetCurrent();
+
+	if((m_ctrl & CONTROL_IRQ) && reader.GetIrqPending())
+	{
+		m_irqPending = true;
+	}
+
+	reader.ClearIrqPending();
+
+	for(unsigned int j = 0; j < voiceTicks; j++)
+	{
+		int32 inputSample = static_cast<int32>(readSamples[j]);
+		//Mix adsrVolume
+		inputSample = (inputSample * adsrLevels[j]) / static_cast<int32>(MAX_ADSR_VOLUME >> 16);
+
+		channel.volumeLeftAbs	= ComputeChannelVolume(channel.volumeLeft, channel.volumeLeftAbs);
+		channel.volumeRightAbs	= ComputeChannelVolume(channel.volumeRight, channel.volumeRightAbs);
+
+		int32 adjustedLeftVolume = std::min<int32>(0x7FFF, static_cast<int32>(static_cast<float>(channel.volumeLeftAbs >> 16) * m_volumeAdjust));
+		int32 adjustedRightVolume = std::min<int32>(0x7FFF, static_cast<int32>(static_cast<float>(channel.volumeRightAbs >> 16) * m_volumeAdjust));
+		output[(j * 2) + 0] = static_cast<int16>((inputSample * adjustedLeftVolume) / 0x7FFF);
+		output[(j * 2) + 1] = static_cast<int16>((inputSample * adjustedRightVolume) / 0x7FFF);
+	}
+
+	return voiceTicks;
+}
+
 uint32 CSpuBase::GetAdsrDelta(unsigned int index) const
 {
 	return m_adsrLogTable[index + 32];
@@ -951,15 +1029,19 @@ void CSpuBase::CSampleReader::SetPitch(uint32 baseSamplingRate, uint16 pitch)
 	m_srcSamplingRate = baseSamplingRate * pitch / 4096;
 }
 
-void CSpuBase::CSampleReader::GetSamples(int16* samples, unsigned int sampleCount, unsigned int dstSamplingRate)
+unsigned int CSpuBase::CSampleReader::GetSamples(int16* samples, unsigned int sampleCount, unsigned int dstSamplingRate)
 {
+	uint32 sampleStep = (m_srcSamplingRate * TIME_SCALE) / dstSamplingRate;
 	for(unsigned int i = 0; i < sampleCount; i++)
 	{
-		samples[i] = GetSample(dstSamplingRate);
+		samples[i] = GetSample(sampleStep);
+		//Let the caller handle these before going further
+		if(m_done || m_didChangeRepeat) return i + 1;
 	}
+	return sampleCount;
 }
 
-int16 CSpuBase::CSampleReader::GetSample(unsigned int dstSamplingRate)
+int16 CSpuBase::CSampleReader::GetSample(uint32 sampleStep)
 {
 	uint32 srcSampleIdx = m_srcSampleIdx / TIME_SCALE;
 	int32 srcSampleAlpha = m_srcSampleIdx % TIME_SCALE;
@@ -967,7 +1049,7 @@ int16 CSpuBase::CSampleReader::GetSample(unsigned int dstSamplingRate)
 	int32 nextSample = m_buffer[srcSampleIdx + 1];
 	int32 resultSample = (currentSample * (TIME_SCALE - srcSampleAlpha) / TIME_SCALE) +
 		(nextSample * srcSampleAlpha / TIME_SCALE);
-	m_srcSampleIdx += (m_srcSamplingRate * TIME_SCALE) / dstSamplingRate;
+	m_srcSampleIdx += sampleStep;
 	if(srcSampleIdx >= BUFFER_SAMPLES)
 	{
 		m_srcSampleIdx -= BUFFER_SAMPLES * TIME_SCALE;
@@ -216,6 +216,9 @@ namespace Iop
 
 		void			Render(int16*, unsigned int, unsigned int);
 
+		//Adds samples to output with saturation
+		static void		AccumulateSamples(int16*, const int16*, unsigned int);
+
 		static bool		g_reverbParamIsAddress[REVERB_PARAM_COUNT];
 
 	private:
@@ -230,7 +233,7 @@ namespace Iop
 
 			void			SetParams(uint32, uint32);
 			void			SetPitch(uint32, uint16);
-			void			GetSamples(int16*, unsigned int, unsigned int);
+			unsigned int	GetSamples(int16*, unsigned int, unsigned int);
 			uint32			GetRepeat() const;
 			void			SetRepeat(uint32);
 			uint32			GetCurrent() const;
@@ -252,7 +255,7 @@ namespace Iop
 
 			void			UnpackSamples(int16*);
 			void			AdvanceBuffer();
-			int16			GetSample(unsigned int);
+			int16			GetSample(uint32);
 
 			uint8*			m_ram = nullptr;
 			uint32			m_ramSize = 0;
@@ -278,6 +281,13 @@ namespace Iop
 			MAX_ADSR_VOLUME = 0x7FFFFFFF,
 		};
 
+		enum
+		{
+			MAX_BLOCK_TICKS = 0x100,
+		};
+
+		void				RenderBlock(int16*, unsigned int, unsigned int);
+		unsigned int		RenderVoice(unsigned int, int16*, unsigned int, unsigned int);
 		void				UpdateAdsr(CHANNEL&);
 		uint32				GetAdsrDelta(unsigned int) const;
 		float				GetReverbSample(uint32) const;
@@ -285,7 +295,6 @@ namespace Iop
 		uint32				GetReverbOffset(unsigned int) const;
 		float				GetReverbCoef(unsigned int) const;
 
-		static void			MixSamples(int32, int32, int16*);
 		int32				ComputeChannelVolume(const CHANNEL_VOLUME&, int32);
 
 		static const uint32	g_linearIncreaseSweepDeltas[0x80];
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "Iop_SubSystem.h"
 #include "../MemoryStateFile.h"
 #include "../Ps2Const.h"
@@ -14,6 +15,10 @@ using namespace PS2;
 #define STATE_SCRATCH		("iop_scratch")
 #define STATE_SPURAM		("iop_spuram")
 
+#define DMA_UPDATE_DELAY	(10000)
+
+#define IOPORT_STATS_LOG_COUNT	(16)
+
 CSubSystem::CSubSystem(bool ps2Mode) 
 : m_cpu(MEMORYMAP_ENDIAN_LSBF)
 , m_executor(m_cpu, (IOP_RAM_SIZE * 4))
@@ -32,6 +37,7 @@ CSubSystem::CSubSystem(bool ps2Mode)
 , m_cpuArch(MIPS_REGSIZE_32)
 , m_copScu(MIPS_REGSIZE_32)
 , m_dmaUpdateTicks(0)
+, m_ioPorts(HW_REG_BEGIN, HW_REG_END)
 {
 	//Read memory map
 	m_cpu.m_pMemoryMap->InsertReadMap((0 * IOP_RAM_SIZE),    (0 * IOP_RAM_SIZE) + IOP_RAM_SIZE - 1,      m_ram,                                                                  0x01);
@@ -55,6 +61,8 @@ CSubSystem::CSubSystem(bool ps2Mode)
 	m_cpu.m_pMemoryMap->InsertInstructionMap((2 * IOP_RAM_SIZE),    (2 * IOP_RAM_SIZE) + IOP_RAM_SIZE - 1,    m_ram,    0x03);
 	m_cpu.m_pMemoryMap->InsertInstructionMap((3 * IOP_RAM_SIZE),    (3 * IOP_RAM_SIZE) + IOP_RAM_SIZE - 1,    m_ram,    0x04);
 
+	InsertIoRegisterHandlers();
+
 	m_cpu.m_pArch = &m_cpuArch;
 	m_cpu.m_pCOP[0] = &m_copScu;
 	m_cpu.m_pAddrTranslator = &CMIPS::TranslateAddress64;
@@ -88,12 +96,15 @@ void CSubSystem::NotifyVBlankEnd()
 	m_intc.AssertLine(Iop::CIntc::LINE_EVBLANK);
 }
 
-void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive)
+void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive, bool saveMemoryAreas)
 {
 	archive.InsertFile(new CMemoryStateFile(STATE_CPU,		&m_cpu.m_State, sizeof(MIPSSTATE)));
-	archive.InsertFile(new CMemoryStateFile(STATE_RAM,		m_ram,			IOP_RAM_SIZE));
-	archive.InsertFile(new CMemoryStateFile(STATE_SCRATCH,	m_scratchPad,	IOP_SCRATCH_SIZE));
-	archive.InsertFile(new CMemoryStateFile(STATE_SPURAM,	m_spuRam,		SPU_RAM_SIZE));
+	if(saveMemoryAreas)
+	{
+		CMemoryStateFile::MemoryAreaList memoryAreas;
+		GetMemoryAreas(memoryAreas);
+		CMemoryStateFile::InsertMemoryAreas(archive, memoryAreas);
+	}
 	m_intc.SaveState(archive);
 	m_counters.SaveState(archive);
 	m_spuCore0.SaveState(archive);
@@ -101,12 +112,15 @@ void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive)
 	m_bios->SaveState(archive);
 }
 
-void CSubSystem::LoadState(Framework::CZipArchiveReader& archive)
+void CSubSystem::LoadState(Framework::CZipArchiveReader& archive, bool loadMemoryAreas)
 {
 	archive.BeginReadFile(STATE_CPU			)->Read(&m_cpu.m_State,	sizeof(MIPSSTATE));
-	archive.BeginReadFile(STATE_RAM			)->Read(m_ram,			IOP_RAM_SIZE);
-	archive.BeginReadFile(STATE_SCRATCH		)->Read(m_scratchPad,	IOP_SCRATCH_SIZE);
-	archive.BeginReadFile(STATE_SPURAM		)->Read(m_spuRam,		SPU_RAM_SIZE);
+	if(loadMemoryAreas)
+	{
+		CMemoryStateFile::MemoryAreaList memoryAreas;
+		GetMemoryAreas(memoryAreas);
+		CMemoryStateFile::ReadMemoryAreas(archive, memoryAreas);
+	}
 	m_intc.LoadState(archive);
 	m_counters.LoadState(archive);
 	m_spuCore0.LoadState(archive);
@@ -114,6 +128,13 @@ void CSubSystem::LoadState(Framework::CZipArchiveReader& archive)
 	m_bios->LoadState(archive);
 }
 
+void CSubSystem::GetMemoryAreas(CMemoryStateFile::MemoryAreaList& memoryAreas)
+{
+	memoryAreas.push_back({ STATE_RAM,		m_ram,			IOP_RAM_SIZE });
+	memoryAreas.push_back({ STATE_SCRATCH,	m_scratchPad,	IOP_SCRATCH_SIZE });
+	memoryAreas.push_back({ STATE_SPURAM,	m_spuRam,		SPU_RAM_SIZE });
+}
+
 void CSubSystem::Reset()
 {
 	memset(m_ram, 0, IOP_RAM_SIZE);
@@ -137,96 +158,55 @@ void CSubSystem::Reset()
 	m_cpu.m_Comments.RemoveTags();
 	m_cpu.m_Functions.RemoveTags();
 
+	m_ioPorts.LogStats(LOG_NAME, IOPORT_STATS_LOG_COUNT);
+	m_ioPorts.ResetStats();
+
 	m_dmaUpdateTicks = 0;
 }
 
-uint32 CSubSystem::ReadIoRegister(uint32 address)
+void CSubSystem::InsertIoRegisterHandlers()
 {
-	if(address == 0x1F801814)
-	{
-		return 0x14802000;
-	}
-	else if(address >= CSpu::SPU_BEGIN && address <= CSpu::SPU_END)
-	{
-		return m_spu.ReadRegister(address);
-	}
-	else if(address >= CDmac::DMAC_ZONE1_START && address <= CDmac::DMAC_ZONE1_END)
-	{
-		return m_dmac.ReadRegister(address);
-	}
-	else if(address >= CDmac::DMAC_ZONE2_START && address <= CDmac::DMAC_ZONE2_END)
-	{
-		return m_dmac.ReadRegister(address);
-	}
-	else if(address >= CIntc::ADDR_BEGIN && address <= CIntc::ADDR_END)
-	{
-		return m_intc.ReadRegister(address);
-	}
-	else if(
-		(address >= CRootCounters::ADDR_BEGIN1 && address <= CRootCounters::ADDR_END1) ||
-		(address >= CRootCounters::ADDR_BEGIN2 && address <= CRootCounters::ADDR_END2)
-		)
-	{
-		return m_counters.ReadRegister(address);
-	}
+	//Read handlers
+	m_ioPorts.InsertReadHandler(0x1F801814, 0x1F801814, [] (uint32) { return 0x14802000; });
+	m_ioPorts.InsertReadHandler(CSpu::SPU_BEGIN, CSpu::SPU_END, [this] (uint32 address) { return m_spu.ReadRegister(address); });
+	m_ioPorts.InsertReadHandler(CDmac::DMAC_ZONE1_START, CDmac::DMAC_ZONE1_END, [this] (uint32 address) { return m_dmac.ReadRegister(address); });
+	m_ioPorts.InsertReadHandler(CDmac::DMAC_ZONE2_START, CDmac::DMAC_ZONE2_END, [this] (uint32 address) { return m_dmac.ReadRegister(address); });
+	m_ioPorts.InsertReadHandler(CIntc::ADDR_BEGIN, CIntc::ADDR_END, [this] (uint32 address) { return m_intc.ReadRegister(address); });
+	m_ioPorts.InsertReadHandler(CRootCounters::ADDR_BEGIN1, CRootCounters::ADDR_END1, [this] (uint32 address) { return m_counters.ReadRegister(address); });
+	m_ioPorts.InsertReadHandler(CRootCounters::ADDR_BEGIN2, CRootCounters::ADDR_END2, [this] (uint32 address) { return m_counters.ReadRegister(address); });
 #ifdef _IOP_EMULATE_MODULES
-	else if(address >= CSio2::ADDR_BEGIN && address <= CSio2::ADDR_END)
-	{
-		return m_sio2.ReadRegister(address);
-	}
+	m_ioPorts.InsertReadHandler(CSio2::ADDR_BEGIN, CSio2::ADDR_END, [this] (uint32 address) { return m_sio2.ReadRegister(address); });
 #endif
-	else if(address >= CSpu2::REGS_BEGIN && address <= CSpu2::REGS_END)
-	{
-		return m_spu2.ReadRegister(address);
-	}
-	else if(address >= 0x1F808400 && address <= 0x1F808500)
-	{
-		//iLink (aka Firewire) stuff
-		return 0x08;
-	}
-	else
+	m_ioPorts.InsertReadHandler(CSpu2::REGS_BEGIN, CSpu2::REGS_END, [this] (uint32 address) { return m_spu2.ReadRegister(address); });
+	//iLink (aka Firewire) stuff
+	m_ioPorts.InsertReadHandler(0x1F808400, 0x1F808500, [] (uint32) { return 0x08; });
+
+	//Write handlers
+	m_ioPorts.InsertWriteHandler(CDmac::DMAC_ZONE1_START, CDmac::DMAC_ZONE1_END, [this] (uint32 address, uint32 value) { m_dmac.WriteRegister(address, value); });
+	m_ioPorts.InsertWriteHandler(CSpu::SPU_BEGIN, CSpu::SPU_END, [this] (uint32 address, uint32 value) { m_spu.WriteRegister(address, static_cast<uint16>(value)); });
+	m_ioPorts.InsertWriteHandler(CDmac::DMAC_ZONE2_START, CDmac::DMAC_ZONE2_END, [this] (uint32 address, uint32 value) { m_dmac.WriteRegister(address, value); });
+	m_ioPorts.InsertWriteHandler(CIntc::ADDR_BEGIN, CIntc::ADDR_END, [this] (uint32 address, uint32 value) { m_intc.WriteRegister(address, value); });
+	m_ioPorts.InsertWriteHandler(CRootCounters::ADDR_BEGIN1, CRootCounters::ADDR_END1, [this] (uint32 address, uint32 value) { m_counters.WriteRegister(address, value); });
+	m_ioPorts.InsertWriteHandler(CRootCounters::ADDR_BEGIN2, CRootCounters::ADDR_END2, [this] (uint32 address, uint32 value) { m_counters.WriteRegister(address, value); });
+#ifdef _IOP_EMULATE_MODULES
+	m_ioPorts.InsertWriteHandler(CSio2::ADDR_BEGIN, CSio2::ADDR_END, [this] (uint32 address, uint32 value) { m_sio2.WriteRegister(address, value); });
+#endif
+	m_ioPorts.InsertWriteHandler(CSpu2::REGS_BEGIN, CSpu2::REGS_END, [this] (uint32 address, uint32 value) { m_spu2.WriteRegister(address, value); });
+}
+
+uint32 CSubSystem::ReadIoRegister(uint32 address)
+{
+	uint32 result = 0;
+	if(!m_ioPorts.Read(address, result))
 	{
 		CLog::GetInstance().Print(LOG_NAME, "Reading an unknown hardware register (0x%0.8X).\r\n", address);
 	}
-	return 0;
+	return result;
 }
 
 uint32 CSubSystem::WriteIoRegister(uint32 address, uint32 value)
 {
-	if(address >= CDmac::DMAC_ZONE1_START && address <= CDmac::DMAC_ZONE1_END)
-	{
-		m_dmac.WriteRegister(address, value);
-	}
-	else if(address >= CSpu::SPU_BEGIN && address <= CSpu::SPU_END)
-	{
-		m_spu.WriteRegister(address, static_cast<uint16>(value));
-	}
-	else if(address >= CDmac::DMAC_ZONE2_START && address <= CDmac::DMAC_ZONE2_END)
-	{
-		m_dmac.WriteRegister(address, value);
-	}
-	else if(address >= CIntc::ADDR_BEGIN && address <= CIntc::ADDR_END)
-	{
-		m_intc.WriteRegister(address, value);
-	}
-	else if(
-		(address >= CRootCounters::ADDR_BEGIN1 && address <= CRootCounters::ADDR_END1) ||
-		(address >= CRootCounters::ADDR_BEGIN2 && address <= CRootCounters::ADDR_END2)
-		)
-	{
-		m_counters.WriteRegister(address, value);
-	}
-#ifdef _IOP_EMULATE_MODULES
-	else if(address >= CSio2::ADDR_BEGIN && address <= CSio2::ADDR_END)
-	{
-		m_sio2.WriteRegister(address, value);
-	}
-#endif
-	else if(address >= CSpu2::REGS_BEGIN && address <= CSpu2::REGS_END)
-	{
-		return m_spu2.WriteRegister(address, value);
-	}
-	else
+	if(!m_ioPorts.Write(address, value))
 	{
 		CLog::GetInstance().Print(LOG_NAME, "Writing to an unknown hardware register (0x%0.8X, 0x%0.8X).\r\n", address, value);
 	}
@@ -254,15 +234,14 @@ bool CSubSystem::IsCpuIdle()
 
 void CSubSystem::CountTicks(int ticks)
 {
-	static int g_dmaUpdateDelay = 10000;
 	m_counters.Update(ticks);
 	m_bios->CountTicks(ticks);
 	m_dmaUpdateTicks += ticks;
-	if(m_dmaUpdateTicks >= g_dmaUpdateDelay)
+	if(m_dmaUpdateTicks >= DMA_UPDATE_DELAY)
 	{
 		m_dmac.ResumeDma(4);
 		m_dmac.ResumeDma(8);
-		m_dmaUpdateTicks -= g_dmaUpdateDelay;
+		m_dmaUpdateTicks -= DMA_UPDATE_DELAY;
 	}
 	{
 		bool irqPending = false;
@@ -279,6 +258,12 @@ void CSubSystem::CountTicks(int ticks)
 	}
 }
 
+uint32 CSubSystem::GetTicksUntilNextEvent() const
+{
+	uint32 dmaTicks = (m_dmaUpdateTicks < DMA_UPDATE_DELAY) ? (DMA_UPDATE_DELAY - m_dmaUpdateTicks) : 0;
+	return std::min(m_counters.GetTicksUntilNextInterrupt(), dmaTicks);
+}
+
 int CSubSystem::ExecuteCpu(int quota)
 {
 	int executed = 0;
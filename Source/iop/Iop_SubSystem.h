@@ -13,6 +13,8 @@
 #include "Iop_RootCounters.h"
 #include "Iop_BiosBase.h"
 #include "zip/ZipArchiveWriter.h"
+#include "../MemoryStateFile.h"
+#include "../IoPortMap.h"
 #include "zip/ZipArchiveReader.h"
 
 namespace Iop
@@ -27,14 +29,17 @@ namespace Iop
 		int					ExecuteCpu(int);
 		bool				IsCpuIdle();
 		void				CountTicks(int);
+		uint32				GetTicksUntilNextEvent() const;
 
 		void				SetBios(const BiosBasePtr&);
 
 		void				NotifyVBlankStart();
 		void				NotifyVBlankEnd();
 
-		void				SaveState(Framework::CZipArchiveWriter&);
-		void				LoadState(Framework::CZipArchiveReader&);
+		//Memory areas are left out of the archive if the caller saves them by itself
+		void				SaveState(Framework::CZipArchiveWriter&, bool = true);
+		void				LoadState(Framework::CZipArchiveReader&, bool = true);
+		void				GetMemoryAreas(CMemoryStateFile::MemoryAreaList&);
 
 		uint8*				m_ram;
 		uint8*				m_scratchPad;
@@ -62,9 +67,11 @@ namespace Iop
 			HW_REG_END		= 0x1F9FFFFF
 		};
 
+		void				InsertIoRegisterHandlers();
 		uint32				ReadIoRegister(uint32);
 		uint32				WriteIoRegister(uint32, uint32);
 
 		int					m_dmaUpdateTicks;
+		CIoPortMap			m_ioPorts;
 	};
 }
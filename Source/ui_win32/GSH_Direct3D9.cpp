@@ -36,14 +36,14 @@ CGSH_Direct3D9::~CGSH_Direct3D9()
 Framework::CBitmap CGSH_Direct3D9::GetFramebuffer(uint64 frameReg)
 {
 	Framework::CBitmap result;
-	m_mailBox.SendCall([&] () { GetFramebufferImpl(result, frameReg); }, true );
+	SendGSCall([&] () { GetFramebufferImpl(result, frameReg); }, true );
 	return result;
 }
 
 Framework::CBitmap CGSH_Direct3D9::GetTexture(uint64 tex0Reg, uint64 tex1Reg, uint64 clamp)
 {
 	Framework::CBitmap result;
-	m_mailBox.SendCall([&] () { GetTextureImpl(result, tex0Reg, tex1Reg, clamp); }, true);
+	SendGSCall([&] () { GetTextureImpl(result, tex0Reg, tex1Reg, clamp); }, true);
 	return result;
 }
 
@@ -39,6 +39,7 @@ include $(CLEAR_VARS)
 LOCAL_MODULE			:= libPlay
 LOCAL_SRC_FILES			:=	../../Source/AppConfig.cpp \
 							../../Source/BasicBlock.cpp \
+							../../Source/CommandRing.cpp \
 							../../Source/ControllerInfo.cpp \
 							../../Source/COP_FPU.cpp \
 							../../Source/COP_FPU_Reflection.cpp \
@@ -59,11 +60,13 @@ LOCAL_SRC_FILES			:=	../../Source/AppConfig.cpp \
 							../../Source/ee/INTC.cpp \
 							../../Source/ee/IPU.cpp \
 							../../Source/ee/IPU_DmVectorTable.cpp \
+							../../Source/ee/IPU_FastKernels.cpp \
 							../../Source/ee/IPU_MacroblockAddressIncrementTable.cpp \
 							../../Source/ee/IPU_MacroblockTypeBTable.cpp \
 							../../Source/ee/IPU_MacroblockTypeITable.cpp \
 							../../Source/ee/IPU_MacroblockTypePTable.cpp \
 							../../Source/ee/IPU_MotionCodeTable.cpp \
+							../../Source/ee/IPU_VLCLookupTable.cpp \
 							../../Source/ee/MA_EE.cpp \
 							../../Source/ee/MA_EE_Reflection.cpp \
 							../../Source/ee/MA_VU.cpp \
@@ -76,6 +79,7 @@ LOCAL_SRC_FILES			:=	../../Source/AppConfig.cpp \
 							../../Source/ee/Timer.cpp \
 							../../Source/ee/Vif.cpp \
 							../../Source/ee/Vif1.cpp \
+							../../Source/ee/VifUnpack.cpp \
 							../../Source/ee/Vpu.cpp \
 							../../Source/ee/VuAnalysis.cpp \
 							../../Source/ee/VuBasicBlock.cpp \
@@ -84,18 +88,23 @@ LOCAL_SRC_FILES			:=	../../Source/AppConfig.cpp \
 							../../Source/ee/VUShared_Reflection.cpp \
 							../../Source/ELF.cpp \
 							../../Source/ElfFile.cpp \
+							../../Source/EventScheduler.cpp \
 							../../Source/FrameDump.cpp \
 							../../Source/gs/GsCachedArea.cpp \
 							../../Source/gs/GSH_Null.cpp \
+							../../Source/gs/GSH_Software.cpp \
 							../../Source/gs/GSHandler.cpp \
 							../../Source/gs/GSH_OpenGL/GSH_OpenGL.cpp \
 							../../Source/gs/GSH_OpenGL/GSH_OpenGL_Shader.cpp \
 							../../Source/gs/GSH_OpenGL/GSH_OpenGL_Texture.cpp \
 							../../Source/gs/GsPixelFormats.cpp \
+							../../Source/gs/GsSwizzle.cpp \
+							../../Source/ImageFrameCache.cpp \
 							../../Source/iop/ArgumentIterator.cpp \
 							../../Source/iop/DirectoryDevice.cpp \
 							../../Source/iop/Iop_Cdvdfsv.cpp \
 							../../Source/iop/Iop_Cdvdman.cpp \
+							../../Source/iop/Iop_CdvdReadQueue.cpp \
 							../../Source/iop/Iop_Dmac.cpp \
 							../../Source/iop/Iop_DmacChannel.cpp \
 							../../Source/iop/Iop_Dynamic.cpp \
@@ -136,6 +145,9 @@ LOCAL_SRC_FILES			:=	../../Source/AppConfig.cpp \
 							../../Source/iop/Iop_Vblank.cpp \
 							../../Source/iop/IopBios.cpp \
 							../../Source/iop/IsoDevice.cpp \
+							../../Source/IoPortMap.cpp \
+							../../Source/ISO9660/BlockProviderMapped.cpp \
+							../../Source/ISO9660/DirectoryIndex.cpp \
 							../../Source/ISO9660/DirectoryRecord.cpp \
 							../../Source/ISO9660/File.cpp \
 							../../Source/ISO9660/ISO9660.cpp \
@@ -143,6 +155,7 @@ LOCAL_SRC_FILES			:=	../../Source/AppConfig.cpp \
 							../../Source/ISO9660/PathTableRecord.cpp \
 							../../Source/ISO9660/VolumeDescriptor.cpp \
 							../../Source/IszImageStream.cpp \
+							../../Source/JitBlockCache.cpp \
 							../../Source/Log.cpp \
 							../../Source/MA_MIPSIV.cpp \
 							../../Source/MA_MIPSIV_Reflection.cpp \
@@ -167,6 +180,8 @@ LOCAL_SRC_FILES			:=	../../Source/AppConfig.cpp \
 							../../Source/Profiler.cpp \
 							../../Source/PS2VM.cpp \
 							../../Source/RegisterStateFile.cpp \
+							../../Source/RewindBuffer.cpp \
+							../../Source/StateSnapshot.cpp \
 							../../Source/StructCollectionStateFile.cpp \
 							../../Source/StructFile.cpp \
 							../../Source/VirtualPad.cpp \
@@ -0,0 +1,190 @@
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include "Types.h"
+#include "MailBox.h"
+#include "CommandRing.h"
+
+//Compares the cost of sending GS style commands (small register writes and
+//image data transfers) through CMailBox and through CCommandRing.
+
+#define REGISTER_WRITE_COUNT	(2000000)
+#define IMAGE_CHUNK_SIZE		(0x1000)
+#define IMAGE_CHUNK_COUNT		(50000)
+#define RING_SIZE				(0x400000)
+
+typedef std::pair<uint8, uint64> RegisterWrite;
+
+struct RESULT
+{
+	double		seconds;
+	uint64		checksum;
+};
+
+class CConsumer
+{
+public:
+	void WriteRegister(uint8 registerId, uint64 value)
+	{
+		m_checksum += registerId + value;
+	}
+
+	void FeedImageData(const uint8* data, uint32 length)
+	{
+		for(uint32 i = 0; i < length; i += 0x40)
+		{
+			m_checksum += data[i];
+		}
+	}
+
+	uint64 m_checksum = 0;
+};
+
+static RESULT RunMailBox(bool imageData)
+{
+	CMailBox mailBox;
+	CConsumer consumer;
+	bool done = false;
+
+	std::thread consumerThread(
+		[&] ()
+		{
+			while(!done)
+			{
+				mailBox.WaitForCall(100);
+				while(mailBox.IsPending())
+				{
+					mailBox.ReceiveCall();
+				}
+			}
+		}
+	);
+
+	uint8 imageChunk[IMAGE_CHUNK_SIZE];
+	memset(imageChunk, 0x5A, sizeof(imageChunk));
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	if(imageData)
+	{
+		for(unsigned int i = 0; i < IMAGE_CHUNK_COUNT; i++)
+		{
+			uint8* buffer = new uint8[IMAGE_CHUNK_SIZE];
+			memcpy(buffer, imageChunk, IMAGE_CHUNK_SIZE);
+			mailBox.SendCall(
+				[&consumer, buffer] ()
+				{
+					consumer.FeedImageData(buffer, IMAGE_CHUNK_SIZE);
+					delete [] buffer;
+				}
+			);
+		}
+	}
+	else
+	{
+		for(unsigned int i = 0; i < REGISTER_WRITE_COUNT; i++)
+		{
+			mailBox.SendCall(std::bind(&CConsumer::WriteRegister, &consumer, static_cast<uint8>(i), static_cast<uint64>(i)));
+		}
+	}
+	mailBox.SendCall([&done] () { done = true; }, true);
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	consumerThread.join();
+
+	RESULT result;
+	result.seconds = std::chrono::duration<double>(endTime - startTime).count();
+	result.checksum = consumer.m_checksum;
+	return result;
+}
+
+static RESULT RunCommandRing(bool imageData)
+{
+	enum
+	{
+		COMMAND_WRITEREGISTER,
+		COMMAND_FEEDIMAGEDATA,
+		COMMAND_QUIT,
+	};
+
+	CCommandRing commandRing(RING_SIZE);
+	CConsumer consumer;
+
+	std::thread consumerThread(
+		[&] ()
+		{
+			while(1)
+			{
+				auto packet = commandRing.ReadPacket();
+				if(packet == nullptr)
+				{
+					commandRing.WaitForPacket(100);
+					continue;
+				}
+				if(packet->type == COMMAND_QUIT) break;
+				if(packet->type == COMMAND_WRITEREGISTER)
+				{
+					auto write = reinterpret_cast<const RegisterWrite*>(packet->GetData());
+					consumer.WriteRegister(write->first, write->second);
+				}
+				else
+				{
+					consumer.FeedImageData(reinterpret_cast<const uint8*>(packet->GetData()), packet->size);
+				}
+				commandRing.ReleasePacket();
+			}
+		}
+	);
+
+	uint8 imageChunk[IMAGE_CHUNK_SIZE];
+	memset(imageChunk, 0x5A, sizeof(imageChunk));
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	if(imageData)
+	{
+		for(unsigned int i = 0; i < IMAGE_CHUNK_COUNT; i++)
+		{
+			void* buffer = commandRing.BeginPacket(COMMAND_FEEDIMAGEDATA, IMAGE_CHUNK_SIZE);
+			memcpy(buffer, imageChunk, IMAGE_CHUNK_SIZE);
+			commandRing.EndPacket();
+		}
+	}
+	else
+	{
+		for(unsigned int i = 0; i < REGISTER_WRITE_COUNT; i++)
+		{
+			auto write = reinterpret_cast<RegisterWrite*>(commandRing.BeginPacket(COMMAND_WRITEREGISTER, sizeof(RegisterWrite)));
+			write->first = static_cast<uint8>(i);
+			write->second = i;
+			commandRing.EndPacket();
+		}
+	}
+	commandRing.BeginPacket(COMMAND_QUIT, 0);
+	commandRing.EndPacket();
+	consumerThread.join();
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	RESULT result;
+	result.seconds = std::chrono::duration<double>(endTime - startTime).count();
+	result.checksum = consumer.m_checksum;
+	return result;
+}
+
+static void PrintResult(const char* name, const RESULT& result, unsigned int count, unsigned int itemSize)
+{
+	double itemsPerSecond = static_cast<double>(count) / result.seconds;
+	double bytesPerSecond = itemsPerSecond * itemSize;
+	printf("%-28s %8.3fs %12.0f items/s %10.1f MB/s (checksum: 0x%016llX)\r\n",
+		name, result.seconds, itemsPerSecond, bytesPerSecond / (1024.0 * 1024.0), static_cast<unsigned long long>(result.checksum));
+}
+
+int main(int argc, const char** argv)
+{
+	PrintResult("MailBox, register writes", RunMailBox(false), REGISTER_WRITE_COUNT, sizeof(RegisterWrite));
+	PrintResult("CommandRing, register writes", RunCommandRing(false), REGISTER_WRITE_COUNT, sizeof(RegisterWrite));
+	PrintResult("MailBox, image data", RunMailBox(true), IMAGE_CHUNK_COUNT, IMAGE_CHUNK_SIZE);
+	PrintResult("CommandRing, image data", RunCommandRing(true), IMAGE_CHUNK_COUNT, IMAGE_CHUNK_SIZE);
+	return 0;
+}
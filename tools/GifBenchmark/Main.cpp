@@ -0,0 +1,170 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "Types.h"
+#include "Ps2Const.h"
+#include "ee/GIF.h"
+#include "gs/GSH_Null.h"
+
+//Sends GIF packets through CGIF to a null GS handler and reports how fast they
+//get decoded and handed over to the GS thread.
+
+#define DEFAULT_ITERATION_COUNT		(200)
+#define PACKET_ADDRESS				(0x100000)
+#define PACKET_SIZE					(0x40000)
+
+typedef std::chrono::high_resolution_clock Clock;
+
+struct PACKET_INFO
+{
+	const char*		name;
+	uint32			mode;
+	uint32			regCount;
+	uint64			regs;
+};
+
+static const PACKET_INFO g_packets[] =
+{
+	{ "PACKED ST/RGBAQ/XYZF2",	0,	3,	0x412 },
+	{ "PACKED RGBAQ/XYZ2",		0,	2,	0x51 },
+	{ "PACKED A+D",				0,	1,	0xE },
+	{ "REGLIST",				1,	4,	0x5141 },
+	{ "IMAGE",					2,	1,	0 },
+};
+
+static void WriteTag(std::vector<uint8>& packet, uint32 loops, bool eop, uint32 mode, uint32 regCount, uint64 regs)
+{
+	CGIF::TAG tag;
+	memset(&tag, 0, sizeof(tag));
+	tag.loops = loops;
+	tag.eop = eop ? 1 : 0;
+	tag.pre = (mode != 2) ? 1 : 0;
+	tag.prim = 0x3;
+	tag.cmd = mode;
+	tag.nreg = regCount & 0x0F;
+	tag.regs = regs;
+	packet.insert(packet.end(), reinterpret_cast<uint8*>(&tag), reinterpret_cast<uint8*>(&tag) + sizeof(tag));
+}
+
+//Builds a packet made of tags of 90 loops each, returns the amount of register writes it produces
+static uint32 MakePacket(std::vector<uint8>& packet, const PACKET_INFO& packetInfo)
+{
+	static const uint32 loopCount = 90;
+
+	uint32 loopSize = 0;
+	switch(packetInfo.mode)
+	{
+	case 0:
+		loopSize = packetInfo.regCount * 0x10;
+		break;
+	case 1:
+		loopSize = packetInfo.regCount * 0x08;
+		break;
+	default:
+		loopSize = 0x10;
+		break;
+	}
+
+	uint32 writeCount = 0;
+	uint32 tagSize = 0x10 + (((loopCount * loopSize) + 0x0F) & ~0x0F);
+	while((packet.size() + tagSize) <= PACKET_SIZE)
+	{
+		bool eop = (packet.size() + (tagSize * 2)) > PACKET_SIZE;
+		WriteTag(packet, loopCount, eop, packetInfo.mode, packetInfo.regCount, packetInfo.regs);
+		for(uint32 i = 0; i < (tagSize - 0x10); i++)
+		{
+			packet.push_back(static_cast<uint8>(rand()));
+		}
+		if(packetInfo.regs == 0xE)
+		{
+			//A+D writes need to target a valid register, use TEST_1
+			for(uint32 i = 0; i < loopCount; i++)
+			{
+				packet[packet.size() - tagSize + 0x10 + (i * 0x10) + 8] = GS_REG_TEST_1;
+			}
+		}
+		if(packetInfo.mode != 2)
+		{
+			writeCount += 1 + (loopCount * packetInfo.regCount);
+		}
+	}
+
+	return writeCount;
+}
+
+int main(int argc, const char** argv)
+{
+	unsigned int iterationCount = DEFAULT_ITERATION_COUNT;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "--iterations") && ((i + 1) < argc))
+		{
+			iterationCount = std::max(atoi(argv[i + 1]), 1);
+			i++;
+		}
+		else
+		{
+			printf("Usage: GifBenchmark [options]\r\n");
+			printf("Options: \r\n");
+			printf("\t --iterations <count>\t Number of times each packet is sent (default is %d).\r\n", DEFAULT_ITERATION_COUNT);
+			return -1;
+		}
+	}
+
+	auto ram = new uint8[PS2::EE_RAM_SIZE];
+	auto spr = new uint8[PS2::EE_SPR_SIZE];
+	memset(ram, 0, PS2::EE_RAM_SIZE);
+	memset(spr, 0, PS2::EE_SPR_SIZE);
+
+	CGSHandler* gs = new CGSH_Null();
+	gs->Initialize();
+
+	{
+		CGIF gif(gs, ram, spr);
+
+		printf("%d iteration(s) of 0x%X bytes packets.\r\n", iterationCount, PACKET_SIZE);
+		printf("\r\n%-24s %12s %12s %16s\r\n", "Packet", "Time (ms)", "MB/s", "Mwrites/s");
+
+		for(const auto& packetInfo : g_packets)
+		{
+			std::vector<uint8> packet;
+			uint32 writeCount = MakePacket(packet, packetInfo);
+			memcpy(ram + PACKET_ADDRESS, packet.data(), packet.size());
+			uint32 qwc = static_cast<uint32>(packet.size() / 0x10);
+
+			gs->Reset();
+
+			//Warm up once
+			gif.ReceiveDMA(PACKET_ADDRESS, qwc, 0, false);
+			gs->Flip();
+
+			auto startTime = Clock::now();
+			for(unsigned int i = 0; i < iterationCount; i++)
+			{
+				gif.ReceiveDMA(PACKET_ADDRESS, qwc, 0, false);
+			}
+			//Flip waits for the GS thread to be done with everything that was sent before
+			gs->Flip();
+			auto endTime = Clock::now();
+
+			double seconds = std::chrono::duration<double>(endTime - startTime).count();
+			double size = static_cast<double>(packet.size()) * iterationCount;
+			double writes = static_cast<double>(writeCount) * iterationCount;
+			printf("%-24s %12.3f %12.3f %16.3f\r\n", packetInfo.name, seconds * 1000.0,
+				(seconds != 0) ? (size / (seconds * 1024.0 * 1024.0)) : 0.0,
+				(seconds != 0) ? (writes / (seconds * 1e6)) : 0.0);
+		}
+	}
+
+	gs->Release();
+	delete gs;
+
+	delete [] spr;
+	delete [] ram;
+
+	return 0;
+}
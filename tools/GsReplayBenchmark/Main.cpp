@@ -0,0 +1,330 @@
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "Types.h"
+#include "StdStreamUtils.h"
+#include "FrameDump.h"
+#include "gs/GSH_Null.h"
+#include "gs/GSH_Software.h"
+
+//Replays a frame dump through a GS handler a number of times and reports how fast
+//the handler went through it. Register writes can also be timed individually to
+//find out where the time is spent.
+
+#define DEFAULT_ITERATION_COUNT		(10)
+
+typedef std::chrono::high_resolution_clock Clock;
+
+struct REGISTER_STATS
+{
+	uint64		count = 0;
+	double		seconds = 0;
+};
+
+typedef std::vector<REGISTER_STATS> RegisterStatsArray;
+
+struct DUMP_INFO
+{
+	uint32		packetCount = 0;
+	uint32		writeCount = 0;
+	uint32		primitiveCount = 0;
+	uint64		transferSize = 0;
+};
+
+//Times every register write done on the GS thread when given somewhere to store the results
+template <typename BaseHandlerType>
+class CProfilingHandler : public BaseHandlerType
+{
+public:
+	CProfilingHandler(RegisterStatsArray* registerStats)
+		: m_registerStats(registerStats)
+	{
+
+	}
+
+protected:
+	void WriteRegisterImpl(uint8 registerId, uint64 value) override
+	{
+		if(!m_registerStats)
+		{
+			BaseHandlerType::WriteRegisterImpl(registerId, value);
+			return;
+		}
+		auto startTime = Clock::now();
+		BaseHandlerType::WriteRegisterImpl(registerId, value);
+		auto endTime = Clock::now();
+		auto& stats = (*m_registerStats)[registerId];
+		stats.count++;
+		stats.seconds += std::chrono::duration<double>(endTime - startTime).count();
+	}
+
+private:
+	RegisterStatsArray*		m_registerStats = nullptr;
+};
+
+static CGSHandler* CreateHandler(const std::string& handlerName, RegisterStatsArray* registerStats)
+{
+	if(handlerName == "null")
+	{
+		return new CProfilingHandler<CGSH_Null>(registerStats);
+	}
+	else if(handlerName == "software")
+	{
+		return new CProfilingHandler<CGSH_Software>(registerStats);
+	}
+	return nullptr;
+}
+
+static uint32 GetPixelSize(uint32 psm)
+{
+	switch(psm)
+	{
+	case CGSHandler::PSMCT32:
+	case CGSHandler::PSMZ32:
+		return 32;
+	case CGSHandler::PSMCT24:
+	case CGSHandler::PSMZ24:
+		return 24;
+	case CGSHandler::PSMCT16:
+	case CGSHandler::PSMCT16S:
+	case CGSHandler::PSMZ16:
+	case CGSHandler::PSMZ16S:
+		return 16;
+	case CGSHandler::PSMT8:
+	case CGSHandler::PSMT8H:
+		return 8;
+	default:
+		return 4;
+	}
+}
+
+static DUMP_INFO AnalyzeFrameDump(CFrameDump& frameDump)
+{
+	DUMP_INFO info;
+
+	frameDump.IdentifyDrawingKicks();
+	info.primitiveCount = static_cast<uint32>(frameDump.GetDrawingKicks().size());
+
+	//Only local to local transfers carry their data in the dump, image data sent
+	//by the host isn't recorded
+	uint64 bitBltBuf = frameDump.GetInitialGsRegisters()[GS_REG_BITBLTBUF];
+	uint64 trxReg = frameDump.GetInitialGsRegisters()[GS_REG_TRXREG];
+	for(const auto& packet : frameDump.GetPackets())
+	{
+		info.packetCount++;
+		info.writeCount += static_cast<uint32>(packet.writes.size());
+		for(const auto& registerWrite : packet.writes)
+		{
+			switch(registerWrite.first)
+			{
+			case GS_REG_BITBLTBUF:
+				bitBltBuf = registerWrite.second;
+				break;
+			case GS_REG_TRXREG:
+				trxReg = registerWrite.second;
+				break;
+			case GS_REG_TRXDIR:
+				if((registerWrite.second & 0x03) == 2)
+				{
+					auto bltBuf = make_convertible<CGSHandler::BITBLTBUF>(bitBltBuf);
+					auto trx = make_convertible<CGSHandler::TRXREG>(trxReg);
+					uint64 pixelCount = static_cast<uint64>(trx.nRRW) * static_cast<uint64>(trx.nRRH);
+					info.transferSize += (pixelCount * GetPixelSize(bltBuf.nDstPsm)) / 8;
+				}
+				break;
+			}
+		}
+	}
+
+	return info;
+}
+
+static double ReplayFrameDump(CFrameDump& frameDump, CGSHandler* gs, unsigned int iterationCount)
+{
+	double seconds = 0;
+	for(unsigned int i = 0; i < iterationCount; i++)
+	{
+		gs->Reset();
+		memcpy(gs->GetRam(), frameDump.GetInitialGsRam(), CGSHandler::RAMSIZE);
+		memcpy(gs->GetRegisters(), frameDump.GetInitialGsRegisters(), CGSHandler::REGISTER_MAX * sizeof(uint64));
+		gs->SetSMODE2(frameDump.GetInitialSMODE2());
+
+		auto startTime = Clock::now();
+		for(const auto& packet : frameDump.GetPackets())
+		{
+			gs->WriteRegisterMassively(packet.writes.data(), static_cast<unsigned int>(packet.writes.size()), nullptr);
+		}
+		//Flip waits for the GS thread to be done with everything that was sent before
+		gs->Flip();
+		auto endTime = Clock::now();
+
+		seconds += std::chrono::duration<double>(endTime - startTime).count();
+	}
+	return seconds;
+}
+
+static double RunReplay(CFrameDump& frameDump, const std::string& handlerName, unsigned int iterationCount, RegisterStatsArray* registerStats)
+{
+	auto gs = CreateHandler(handlerName, registerStats);
+	gs->Initialize();
+	if(auto softwareGs = dynamic_cast<CGSH_Software*>(gs))
+	{
+		if(!registerStats)
+		{
+			printf("Software rasterizer running with %d thread(s).\r\n", softwareGs->GetWorkerThreadCount());
+		}
+	}
+	double seconds = ReplayFrameDump(frameDump, gs, iterationCount);
+	gs->Release();
+	delete gs;
+	return seconds;
+}
+
+static std::string GetRegisterName(uint8 registerId)
+{
+	auto name = CGSHandler::DisassembleWrite(registerId, 0);
+	auto parenPosition = name.find('(');
+	if((parenPosition != std::string::npos) && (parenPosition != 0))
+	{
+		name.erase(parenPosition);
+	}
+	return name;
+}
+
+static void PrintRegisterStats(const RegisterStatsArray& registerStats, double totalSeconds)
+{
+	std::vector<uint8> registerIds;
+	double registerSeconds = 0;
+	for(unsigned int i = 0; i < registerStats.size(); i++)
+	{
+		if(registerStats[i].count == 0) continue;
+		registerIds.push_back(static_cast<uint8>(i));
+		registerSeconds += registerStats[i].seconds;
+	}
+	std::sort(registerIds.begin(), registerIds.end(),
+		[&] (uint8 id1, uint8 id2) { return registerStats[id1].seconds > registerStats[id2].seconds; });
+
+	printf("\r\n%-24s %12s %12s %10s %8s\r\n", "Register", "Writes", "Total (ms)", "ns/write", "Share");
+	for(auto registerId : registerIds)
+	{
+		const auto& stats = registerStats[registerId];
+		printf("%-24s %12llu %12.3f %10.1f %7.2f%%\r\n",
+			GetRegisterName(registerId).c_str(),
+			static_cast<unsigned long long>(stats.count),
+			stats.seconds * 1000.0,
+			(stats.seconds * 1e9) / static_cast<double>(stats.count),
+			(totalSeconds != 0) ? (stats.seconds * 100.0 / totalSeconds) : 0.0);
+	}
+
+	//Whatever isn't spent handling writes goes to dispatching them and to
+	//the work done when flipping (ie.: flushing pending primitives)
+	double otherSeconds = std::max(totalSeconds - registerSeconds, 0.0);
+	printf("%-24s %12s %12.3f %10s %7.2f%%\r\n", "(dispatch, flip)", "", otherSeconds * 1000.0, "",
+		(totalSeconds != 0) ? (otherSeconds * 100.0 / totalSeconds) : 0.0);
+}
+
+int main(int argc, const char** argv)
+{
+	if(argc < 2)
+	{
+		printf("Usage: GsReplayBenchmark [options] dumpFile\r\n");
+		printf("Options: \r\n");
+		printf("\t --handler <name>\t GS handler used to replay the dump (null or software, default is software).\r\n");
+		printf("\t --iterations <count>\t Number of times the dump is replayed (default is %d).\r\n", DEFAULT_ITERATION_COUNT);
+		printf("\t --registers\t\t Times every register write in an additional pass.\r\n");
+		return -1;
+	}
+
+	std::string handlerName = "software";
+	unsigned int iterationCount = DEFAULT_ITERATION_COUNT;
+	bool profileRegisters = false;
+	std::string dumpPath;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "--handler"))
+		{
+			if((i + 1) >= argc)
+			{
+				printf("Error: Name must be specified for --handler option.\r\n");
+				return -1;
+			}
+			handlerName = argv[i + 1];
+			i++;
+		}
+		else if(!strcmp(argv[i], "--iterations"))
+		{
+			if((i + 1) >= argc)
+			{
+				printf("Error: Count must be specified for --iterations option.\r\n");
+				return -1;
+			}
+			iterationCount = std::max(atoi(argv[i + 1]), 1);
+			i++;
+		}
+		else if(!strcmp(argv[i], "--registers"))
+		{
+			profileRegisters = true;
+		}
+		else
+		{
+			dumpPath = argv[i];
+		}
+	}
+
+	if(dumpPath.empty())
+	{
+		printf("Error: No dump file specified.\r\n");
+		return -1;
+	}
+
+	if((handlerName != "null") && (handlerName != "software"))
+	{
+		//The OpenGL handler needs a window and a context provided by the UI, it can't run here
+		printf("Error: Unsupported GS handler '%s'.\r\n", handlerName.c_str());
+		return -1;
+	}
+
+	CFrameDump frameDump;
+	try
+	{
+		auto inputStream = Framework::CreateInputStdStream(dumpPath);
+		frameDump.Read(inputStream);
+	}
+	catch(const std::exception& exception)
+	{
+		printf("Error: Failed to load frame dump '%s': %s\r\n", dumpPath.c_str(), exception.what());
+		return -1;
+	}
+
+	auto dumpInfo = AnalyzeFrameDump(frameDump);
+	printf("Dump: %d packets, %d register writes, %d primitives, %d bytes transferred.\r\n",
+		dumpInfo.packetCount, dumpInfo.writeCount, dumpInfo.primitiveCount, static_cast<int>(dumpInfo.transferSize));
+
+	//Warm up once, first replay pays for thread creation, page faults, etc.
+	RunReplay(frameDump, handlerName, 1, nullptr);
+	double seconds = RunReplay(frameDump, handlerName, iterationCount, nullptr);
+
+	double iterations = static_cast<double>(iterationCount);
+	printf("Handler: %s, %d iteration(s), %f ms per replay.\r\n", handlerName.c_str(), iterationCount, (seconds * 1000.0) / iterations);
+	if(seconds != 0)
+	{
+		printf("%f packets/s, %f primitives/s, %f register writes/s, %f MB/s transferred.\r\n",
+			(dumpInfo.packetCount * iterations) / seconds,
+			(dumpInfo.primitiveCount * iterations) / seconds,
+			(dumpInfo.writeCount * iterations) / seconds,
+			(static_cast<double>(dumpInfo.transferSize) * iterations) / (seconds * 1024.0 * 1024.0));
+	}
+
+	if(profileRegisters)
+	{
+		RegisterStatsArray registerStats(CGSHandler::REGISTER_MAX);
+		double profileSeconds = RunReplay(frameDump, handlerName, iterationCount, &registerStats);
+		PrintRegisterStats(registerStats, profileSeconds);
+	}
+
+	return 0;
+}
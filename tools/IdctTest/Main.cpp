@@ -0,0 +1,201 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include "Types.h"
+#include "ee/IPU_FastKernels.h"
+
+//Checks the IPU's fast IDCT against the accuracy requirements of the IEEE-1180 standard.
+//Blocks of random pixels go through a double precision forward DCT and the results
+//of the fast IDCT are compared to a double precision reference IDCT.
+
+#define BLOCK_COUNT		(10000)
+
+struct RANGE
+{
+	long	low;
+	long	high;
+};
+
+static const RANGE g_ranges[] =
+{
+	{ 256,	255 },
+	{ 5,	5 },
+	{ 300,	300 },
+};
+
+static double g_cosTable[8][8];
+static long g_randomSeed = 1;
+
+//Random number generator given by the standard
+static long GetRandom(long low, long high)
+{
+	static const double z = static_cast<double>(0x7FFFFFFF);
+	g_randomSeed = (g_randomSeed * 1103515245) + 12345;
+	long i = g_randomSeed & 0x7FFFFFFE;
+	double x = (static_cast<double>(i) / z) * static_cast<double>(low + high + 1);
+	long j = static_cast<long>(x);
+	return j - low;
+}
+
+static void InitializeCosTable()
+{
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		double scale = (i == 0) ? sqrt(0.125) : 0.5;
+		for(unsigned int j = 0; j < 8; j++)
+		{
+			g_cosTable[i][j] = scale * cos((M_PI / 8.0) * i * (j + 0.5));
+		}
+	}
+}
+
+static int16 RoundAndClamp(double value, int16 minValue, int16 maxValue)
+{
+	double result = floor(value + 0.5);
+	result = std::max<double>(result, minValue);
+	result = std::min<double>(result, maxValue);
+	return static_cast<int16>(result);
+}
+
+static void ReferenceFdct(const int16* input, int16* output)
+{
+	double temp[64];
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		for(unsigned int j = 0; j < 8; j++)
+		{
+			double sum = 0;
+			for(unsigned int k = 0; k < 8; k++)
+			{
+				sum += g_cosTable[j][k] * input[(i * 8) + k];
+			}
+			temp[(i * 8) + j] = sum;
+		}
+	}
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		for(unsigned int j = 0; j < 8; j++)
+		{
+			double sum = 0;
+			for(unsigned int k = 0; k < 8; k++)
+			{
+				sum += g_cosTable[i][k] * temp[(k * 8) + j];
+			}
+			output[(i * 8) + j] = RoundAndClamp(sum, -2048, 2047);
+		}
+	}
+}
+
+static void ReferenceIdct(const int16* input, int16* output)
+{
+	double temp[64];
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		for(unsigned int j = 0; j < 8; j++)
+		{
+			double sum = 0;
+			for(unsigned int k = 0; k < 8; k++)
+			{
+				sum += g_cosTable[k][j] * input[(i * 8) + k];
+			}
+			temp[(i * 8) + j] = sum;
+		}
+	}
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		for(unsigned int j = 0; j < 8; j++)
+		{
+			double sum = 0;
+			for(unsigned int k = 0; k < 8; k++)
+			{
+				sum += g_cosTable[k][i] * temp[(k * 8) + j];
+			}
+			output[(i * 8) + j] = RoundAndClamp(sum, -256, 255);
+		}
+	}
+}
+
+static bool TestRange(const RANGE& range, int sign)
+{
+	long errorSum[64] = {};
+	long squareErrorSum[64] = {};
+	int peakError = 0;
+
+	g_randomSeed = 1;
+	for(unsigned int n = 0; n < BLOCK_COUNT; n++)
+	{
+		int16 block[64];
+		int16 coefficients[64];
+		int16 referenceOutput[64];
+		int16 output[64];
+		for(unsigned int i = 0; i < 64; i++)
+		{
+			block[i] = static_cast<int16>(GetRandom(range.low, range.high) * sign);
+		}
+		ReferenceFdct(block, coefficients);
+		ReferenceIdct(coefficients, referenceOutput);
+		IPU::FastIdct(coefficients, output);
+		for(unsigned int i = 0; i < 64; i++)
+		{
+			int error = output[i] - referenceOutput[i];
+			peakError = std::max(peakError, abs(error));
+			errorSum[i] += error;
+			squareErrorSum[i] += error * error;
+		}
+	}
+
+	double peakMse = 0;
+	double overallMse = 0;
+	double peakMean = 0;
+	double overallMean = 0;
+	for(unsigned int i = 0; i < 64; i++)
+	{
+		double mse = static_cast<double>(squareErrorSum[i]) / BLOCK_COUNT;
+		double mean = static_cast<double>(errorSum[i]) / BLOCK_COUNT;
+		peakMse = std::max(peakMse, mse);
+		peakMean = std::max(peakMean, fabs(mean));
+		overallMse += mse;
+		overallMean += mean;
+	}
+	overallMse /= 64;
+	overallMean = fabs(overallMean / 64);
+
+	bool passed =
+		(peakError <= 1) &&
+		(peakMse <= 0.06) &&
+		(overallMse <= 0.02) &&
+		(peakMean <= 0.015) &&
+		(overallMean <= 0.0015);
+
+	printf("Range [%ld, %ld], sign %+d: peak error %d, peak mse %.4f, overall mse %.4f, peak mean %.4f, overall mean %.5f: %s\r\n",
+		-range.low, range.high, sign, peakError, peakMse, overallMse, peakMean, overallMean, passed ? "passed" : "FAILED");
+
+	return passed;
+}
+
+int main(int argc, const char** argv)
+{
+	InitializeCosTable();
+
+	bool passed = true;
+	for(int sign = 1; sign >= -1; sign -= 2)
+	{
+		for(const auto& range : g_ranges)
+		{
+			passed &= TestRange(range, sign);
+		}
+	}
+
+	//All zero input must give an all zero output
+	{
+		int16 input[64] = {};
+		int16 output[64];
+		IPU::FastIdct(input, output);
+		bool zeroPassed = std::all_of(output, output + 64, [] (int16 value) { return value == 0; });
+		printf("Zero input: %s\r\n", zeroPassed ? "passed" : "FAILED");
+		passed &= zeroPassed;
+	}
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,196 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "Types.h"
+#include "Ps2Const.h"
+#include "MemoryMap.h"
+
+//Reports the cost of memory map lookups in every region of the EE and IOP
+//address spaces, comparing the page table against a search of the elements.
+
+#define DEFAULT_ITERATION_COUNT		(2000000)
+#define IO_REGISTER_COUNT			(0x40)
+//Best of a few runs is kept to filter out scheduling noise
+#define RUN_COUNT					(5)
+
+typedef std::chrono::high_resolution_clock Clock;
+
+class CBenchmarkMemoryMap : public CMemoryMap_LSBF
+{
+public:
+	const MEMORYMAPELEMENT* SearchReadMap(uint32 address) const
+	{
+		return FindMap(m_readMap.elements, address);
+	}
+};
+
+struct REGION
+{
+	const char*		name;
+	uint32			address;
+	uint32			size;
+};
+
+struct RESULT
+{
+	double			searchTime;
+	double			pageTableTime;
+	double			getWordTime;
+	uint32			checksum;
+};
+
+static uint32 g_ioRegisters[IO_REGISTER_COUNT];
+
+static uint32 ReadIoRegister(uint32 address, uint32)
+{
+	return g_ioRegisters[(address / 4) & (IO_REGISTER_COUNT - 1)];
+}
+
+static uint32 WriteIoRegister(uint32 address, uint32 value)
+{
+	g_ioRegisters[(address / 4) & (IO_REGISTER_COUNT - 1)] = value;
+	return 0;
+}
+
+static double GetNsPerAccess(Clock::time_point startTime, Clock::time_point endTime, unsigned int iterationCount)
+{
+	return std::chrono::duration<double, std::nano>(endTime - startTime).count() / iterationCount;
+}
+
+template <typename LookupFunction>
+static double MeasureLookup(const REGION& region, unsigned int iterationCount, uint32& checksum, const LookupFunction& lookup)
+{
+	//Walk through the region word by word, wrapping around at its end
+	uint32 addressMask = std::min<uint32>(region.size, 0x10000) - 1;
+	double bestTime = 0;
+	for(unsigned int run = 0; run < RUN_COUNT; run++)
+	{
+		auto startTime = Clock::now();
+		for(unsigned int i = 0; i < iterationCount; i++)
+		{
+			checksum += lookup(region.address + ((i * 4) & addressMask));
+		}
+		double time = GetNsPerAccess(startTime, Clock::now(), iterationCount);
+		bestTime = (run == 0) ? time : std::min(bestTime, time);
+	}
+	return bestTime;
+}
+
+static RESULT RunRegion(CBenchmarkMemoryMap& memoryMap, const REGION& region, unsigned int iterationCount)
+{
+	RESULT result = {};
+	result.searchTime = MeasureLookup(region, iterationCount, result.checksum,
+		[&] (uint32 address)
+		{
+			auto element = memoryMap.SearchReadMap(address);
+			return (element != nullptr) ? element->nStart : 0;
+		}
+	);
+	result.pageTableTime = MeasureLookup(region, iterationCount, result.checksum,
+		[&] (uint32 address)
+		{
+			auto element = memoryMap.GetReadMap(address);
+			return (element != nullptr) ? element->nStart : 0;
+		}
+	);
+	result.getWordTime = MeasureLookup(region, iterationCount, result.checksum,
+		[&] (uint32 address)
+		{
+			return memoryMap.GetWord(address);
+		}
+	);
+	return result;
+}
+
+static void RunLayout(const char* layoutName, CBenchmarkMemoryMap& memoryMap, const std::vector<REGION>& regions, unsigned int iterationCount)
+{
+	printf("\r\n%s\r\n", layoutName);
+	printf("%-16s %14s %14s %14s\r\n", "Region", "Search (ns)", "Table (ns)", "GetWord (ns)");
+
+	uint32 checksum = 0;
+	for(const auto& region : regions)
+	{
+		auto result = RunRegion(memoryMap, region, iterationCount);
+		printf("%-16s %14.2f %14.2f %14.2f\r\n", region.name, result.searchTime, result.pageTableTime, result.getWordTime);
+		checksum += result.checksum;
+	}
+	printf("Checksum: 0x%08X\r\n", checksum);
+}
+
+int main(int argc, const char** argv)
+{
+	unsigned int iterationCount = DEFAULT_ITERATION_COUNT;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "--iterations") && ((i + 1) < argc))
+		{
+			iterationCount = std::max(atoi(argv[i + 1]), 1);
+			i++;
+		}
+		else
+		{
+			printf("Usage: MemoryMapBenchmark [options]\r\n");
+			printf("Options: \r\n");
+			printf("\t --iterations <count>\t Number of lookups done in every region (default is %d).\r\n", DEFAULT_ITERATION_COUNT);
+			return -1;
+		}
+	}
+
+	std::vector<uint8> eeRam(PS2::EE_RAM_SIZE);
+	std::vector<uint8> eeSpr(PS2::EE_SPR_SIZE);
+	std::vector<uint8> vuMem0(PS2::VUMEM0SIZE);
+	std::vector<uint8> eeBios(PS2::EE_BIOS_SIZE);
+	std::vector<uint8> iopRam(PS2::IOP_RAM_SIZE);
+	std::vector<uint8> iopScratch(PS2::IOP_SCRATCH_SIZE);
+
+	//Same layout as the one set up by the EE subsystem
+	{
+		CBenchmarkMemoryMap memoryMap;
+		memoryMap.InsertReadMap(0x00000000,            0x01FFFFFF,                                     eeRam.data(),       0x00);
+		memoryMap.InsertReadMap(PS2::EE_SPR_ADDR,      PS2::EE_SPR_ADDR + PS2::EE_SPR_SIZE - 1,        eeSpr.data(),       0x01);
+		memoryMap.InsertReadMap(0x10000000,            0x10FFFFFF,                                     &ReadIoRegister,    0x02);
+		memoryMap.InsertReadMap(PS2::VUMEM0ADDR,       PS2::VUMEM0ADDR + PS2::VUMEM0SIZE - 1,          vuMem0.data(),      0x04);
+		memoryMap.InsertReadMap(0x12000000,            0x12FFFFFF,                                     &ReadIoRegister,    0x07);
+		memoryMap.InsertReadMap(0x1FC00000,            0x1FFFFFFF,                                     eeBios.data(),      0x09);
+		memoryMap.InsertWriteMap(0x10000000,           0x10FFFFFF,                                     &WriteIoRegister,   0x02);
+
+		std::vector<REGION> regions =
+		{
+			{ "RAM",			0x00100000,				PS2::EE_RAM_SIZE - 0x00100000 },
+			{ "Scratchpad",		PS2::EE_SPR_ADDR,		PS2::EE_SPR_SIZE },
+			{ "I/O registers",	0x10003000,				0x1000 },
+			{ "VU0 memory",		PS2::VUMEM0ADDR,		PS2::VUMEM0SIZE },
+			{ "GS registers",	0x12000000,				0x2000 },
+			{ "BIOS",			0x1FC00000,				PS2::EE_BIOS_SIZE },
+		};
+
+		RunLayout("EE", memoryMap, regions, iterationCount);
+	}
+
+	//Same layout as the one set up by the IOP subsystem
+	{
+		CBenchmarkMemoryMap memoryMap;
+		for(uint32 i = 0; i < 4; i++)
+		{
+			memoryMap.InsertReadMap((i * PS2::IOP_RAM_SIZE), (i * PS2::IOP_RAM_SIZE) + PS2::IOP_RAM_SIZE - 1, iopRam.data(), i + 1);
+		}
+		memoryMap.InsertReadMap(PS2::IOP_SCRATCH_ADDR, PS2::IOP_SCRATCH_ADDR + PS2::IOP_SCRATCH_SIZE - 1, iopScratch.data(), 0x05);
+		memoryMap.InsertReadMap(0x1F801000, 0x1F9FFFFF, &ReadIoRegister, 0x06);
+
+		std::vector<REGION> regions =
+		{
+			{ "RAM",			0x00010000,				PS2::IOP_RAM_SIZE - 0x00010000 },
+			{ "RAM mirror",		0x00610000,				PS2::IOP_RAM_SIZE - 0x00010000 },
+			{ "Scratchpad",		PS2::IOP_SCRATCH_ADDR,	PS2::IOP_SCRATCH_SIZE },
+			{ "I/O registers",	0x1F801000,				0x1000 },
+		};
+
+		RunLayout("IOP", memoryMap, regions, iterationCount);
+	}
+
+	return 0;
+}
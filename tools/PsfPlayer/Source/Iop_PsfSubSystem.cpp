@@ -102,14 +102,7 @@ void CPsfSubSystem::Update(bool singleStep, CSoundHandler* soundHandler)
 			{
 				int16 samplesSpu1[BLOCK_SIZE];
 				m_iop.m_spuCore1.Render(samplesSpu1, BLOCK_SIZE, 44100);
-
-				for(unsigned int i = 0; i < BLOCK_SIZE; i++)
-				{
-					int32 resultSample = static_cast<int32>(samplesSpu0[i]) + static_cast<int32>(samplesSpu1[i]);
-					resultSample = std::max<int32>(resultSample, SHRT_MIN);
-					resultSample = std::min<int32>(resultSample, SHRT_MAX);
-					samplesSpu0[i] = static_cast<int16>(resultSample);
-				}
+				CSpuBase::AccumulateSamples(samplesSpu0, samplesSpu1, BLOCK_SIZE);
 			}
 
 			m_currentBlock++;
@@ -0,0 +1,138 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "Types.h"
+#include "StateSnapshot.h"
+#include "MemStream.h"
+#include "PtrStream.h"
+#include "zip/ZipArchiveWriter.h"
+#include "zip/ZipArchiveReader.h"
+#include "RegisterStateFile.h"
+
+//Captures snapshots of a few memory areas, restores them and makes sure we get back what was captured.
+//Also checks that a snapshot written as a state archive can be read back like a regular state.
+
+#define STATE_REGS			("regs.xml")
+#define STATE_REGS_VALUE	("value")
+
+#define AREA_LARGE_SIZE		(0x100000)
+//Not a multiple of the chunk size
+#define AREA_ODD_SIZE		(CStateSnapshot::CHUNK_SIZE + 1000)
+
+struct AREAS
+{
+	AREAS()
+	: large(AREA_LARGE_SIZE)
+	, odd(AREA_ODD_SIZE)
+	{
+
+	}
+
+	CMemoryStateFile::MemoryAreaList GetMemoryAreas()
+	{
+		CMemoryStateFile::MemoryAreaList memoryAreas;
+		memoryAreas.push_back({ "large", large.data(), large.size() });
+		memoryAreas.push_back({ "odd", odd.data(), odd.size() });
+		return memoryAreas;
+	}
+
+	bool operator ==(const AREAS& rhs) const
+	{
+		return (large == rhs.large) && (odd == rhs.odd);
+	}
+
+	std::vector<uint8>	large;
+	std::vector<uint8>	odd;
+};
+
+static std::vector<uint8> CreateArchiveData(uint32 value)
+{
+	Framework::CMemStream archiveStream;
+	{
+		Framework::CZipArchiveWriter archive;
+		auto registerFile = new CRegisterStateFile(STATE_REGS);
+		registerFile->SetRegister32(STATE_REGS_VALUE, value);
+		archive.InsertFile(registerFile);
+		archive.Write(archiveStream);
+	}
+	return std::vector<uint8>(archiveStream.GetBuffer(), archiveStream.GetBuffer() + archiveStream.GetSize());
+}
+
+static void FillRandom(std::vector<uint8>& memory, size_t offset, size_t size)
+{
+	for(size_t i = 0; i < size; i++)
+	{
+		memory[offset + i] = static_cast<uint8>(rand());
+	}
+}
+
+static bool Check(bool condition, const char* description)
+{
+	printf("%s: %s\r\n", description, condition ? "passed" : "FAILED");
+	return condition;
+}
+
+int main(int argc, const char** argv)
+{
+	bool passed = true;
+
+	AREAS areas;
+	auto memoryAreas = areas.GetMemoryAreas();
+
+	//Leave most of the large area empty, it should compress well
+	FillRandom(areas.large, 0, CStateSnapshot::CHUNK_SIZE);
+	FillRandom(areas.odd, 0, areas.odd.size());
+
+	CStateSnapshotBuilder builder;
+	auto firstSnapshot = builder.Capture(CreateArchiveData(1), memoryAreas);
+	auto firstAreas = areas;
+
+	//Only touch a few chunks, the others should be shared with the first snapshot
+	areas.large[AREA_LARGE_SIZE / 2] ^= 0xFF;
+	areas.odd[AREA_ODD_SIZE - 1] ^= 0xFF;
+	auto secondSnapshot = builder.Capture(CreateArchiveData(2), memoryAreas);
+	auto secondAreas = areas;
+
+	{
+		const auto& stats = secondSnapshot->GetStats();
+		passed &= Check(stats.compressedChunkCount == 2, "Unchanged chunks are shared");
+		passed &= Check(stats.totalSize == (AREA_LARGE_SIZE + AREA_ODD_SIZE), "Snapshot size");
+	}
+
+	memset(areas.large.data(), 0, areas.large.size());
+	memset(areas.odd.data(), 0, areas.odd.size());
+	firstSnapshot->RestoreMemoryAreas(memoryAreas);
+	passed &= Check(areas == firstAreas, "First snapshot restored");
+
+	secondSnapshot->RestoreMemoryAreas(memoryAreas);
+	passed &= Check(areas == secondAreas, "Second snapshot restored");
+
+	//Written snapshot must be a state archive like the ones saved by the VM
+	{
+		Framework::CMemStream stateStream;
+		secondSnapshot->Write(stateStream);
+
+		memset(areas.large.data(), 0, areas.large.size());
+		memset(areas.odd.data(), 0, areas.odd.size());
+
+		Framework::CPtrStream archiveStream(stateStream.GetBuffer(), stateStream.GetSize());
+		Framework::CZipArchiveReader archive(archiveStream);
+		CMemoryStateFile::ReadMemoryAreas(archive, memoryAreas);
+		passed &= Check(areas == secondAreas, "Written snapshot memory areas");
+
+		CRegisterStateFile registerFile(*archive.BeginReadFile(STATE_REGS));
+		passed &= Check(registerFile.GetRegister32(STATE_REGS_VALUE) == 2, "Written snapshot archive files");
+	}
+
+	//Capturing an incompatible set of areas must not share anything
+	{
+		CMemoryStateFile::MemoryAreaList otherAreas;
+		otherAreas.push_back(memoryAreas[0]);
+		auto otherSnapshot = builder.Capture(CreateArchiveData(3), otherAreas);
+		const auto& stats = otherSnapshot->GetStats();
+		passed &= Check(stats.compressedChunkCount == stats.chunkCount, "Incompatible areas aren't shared");
+	}
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include "Types.h"
+#include "MIPS.h"
+#include "MA_MIPSIV.h"
+#include "MIPSAssembler.h"
+#include "MipsExecutor.h"
+
+//Runs a loop until a trace gets compiled for it, then has the loop write into a block of the trace
+//while the trace is running. Execution must leave the trace and run the new code right away.
+
+#define RAM_SIZE			(0x10000)
+#define IO_ADDRESS			(0x10000)
+
+//Block that comes after the writing one in the trace
+#define PATCH_ADDRESS		(0x14)
+
+#define ITERATION_COUNT		(0x1000)
+#define PATCH_ITERATION		(0x600)
+#define PATCH_INCREMENT		(0x100)
+
+class CTestExecutor : public CMipsExecutor
+{
+public:
+	CTestExecutor(CMIPS& context)
+	: CMipsExecutor(context, RAM_SIZE)
+	{
+
+	}
+
+	void NotifyCodeWrite(uint32 address)
+	{
+		//Same thing the EE executor's access fault handler does
+		m_writtenAddress = address;
+		m_context.m_codeWritten.store(1);
+	}
+
+	bool HasTraceAt(uint32 address) const
+	{
+		auto block = FindBlockStartingAt(address);
+		return (block != nullptr) && block->HasTrace();
+	}
+
+protected:
+	void ProcessCodeWrites() override
+	{
+		if(m_writtenAddress == MIPS_INVALID_PC) return;
+		auto block = FindBlockAt(m_writtenAddress);
+		m_writtenAddress = MIPS_INVALID_PC;
+		if((block == nullptr) || block->IsValidationPending()) return;
+		block->UnlinkAllBlocks();
+		block->SetValidationPending(true);
+	}
+
+private:
+	uint32 m_writtenAddress = MIPS_INVALID_PC;
+};
+
+class CTestVm
+{
+public:
+	CTestVm()
+	: m_cpu(MEMORYMAP_ENDIAN_LSBF)
+	, m_cpuArch(MIPS_REGSIZE_32)
+	, m_executor(m_cpu)
+	, m_ram(new uint8[RAM_SIZE])
+	{
+		memset(m_ram, 0, RAM_SIZE);
+
+		m_cpu.m_pMemoryMap->InsertReadMap(0x00000000, RAM_SIZE - 1, m_ram, 0x00);
+		m_cpu.m_pMemoryMap->InsertWriteMap(0x00000000, RAM_SIZE - 1, m_ram, 0x00);
+		m_cpu.m_pMemoryMap->InsertWriteMap(IO_ADDRESS, IO_ADDRESS + 3, std::bind(&CTestVm::WriteIo, this, std::placeholders::_1, std::placeholders::_2), 0x01);
+
+		m_cpu.m_pMemoryMap->InsertInstructionMap(0x00000000, RAM_SIZE - 1, m_ram, 0x00);
+
+		m_cpu.m_pArch			= &m_cpuArch;
+		m_cpu.m_pAddrTranslator	= CMIPS::TranslateAddress64;
+
+		m_executor.SetTraceCompilationEnabled(true);
+	}
+
+	~CTestVm()
+	{
+		delete [] m_ram;
+	}
+
+	void AssembleProgram()
+	{
+		CMIPSAssembler assembler(reinterpret_cast<uint32*>(m_ram));
+		auto loopLabel = assembler.CreateLabel();
+		auto secondLabel = assembler.CreateLabel();
+
+		//First block, writes to the second one at some point
+		assembler.MarkLabel(loopLabel);
+		assembler.ADDIU(CMIPS::T0, CMIPS::T0, 1);
+		assembler.SW(CMIPS::T0, 0, CMIPS::S0);
+		assembler.BEQ(CMIPS::R0, CMIPS::R0, secondLabel);
+		assembler.NOP();
+		assembler.NOP();
+
+		//Second block
+		assembler.MarkLabel(secondLabel);
+		assert(assembler.GetProgramSize() * 4 == PATCH_ADDRESS);
+		assembler.ADDIU(CMIPS::T1, CMIPS::T1, 1);
+		assembler.BNE(CMIPS::T0, CMIPS::T2, loopLabel);
+		assembler.NOP();
+
+		assembler.SYSCALL();
+		assembler.JR(CMIPS::RA);
+		assembler.NOP();
+	}
+
+	void Execute()
+	{
+		m_cpu.m_State.nGPR[CMIPS::S0].nV0 = IO_ADDRESS;
+		m_cpu.m_State.nGPR[CMIPS::T2].nV0 = ITERATION_COUNT;
+		m_cpu.m_State.nPC = 0;
+		while(!m_cpu.m_State.nHasException)
+		{
+			m_executor.Execute(100);
+		}
+	}
+
+	uint32 GetRegister(unsigned int reg) const
+	{
+		return m_cpu.m_State.nGPR[reg].nV0;
+	}
+
+	uint32 GetTraceCount() const
+	{
+		return m_executor.GetTraceCount();
+	}
+
+	bool WasTracedWhenPatched() const
+	{
+		return m_tracedWhenPatched;
+	}
+
+	uint32 GetTraceCountWhenPatched() const
+	{
+		return m_traceCountWhenPatched;
+	}
+
+private:
+	uint32 WriteIo(uint32 address, uint32 value)
+	{
+		if(value == PATCH_ITERATION)
+		{
+			m_tracedWhenPatched = m_executor.HasTraceAt(0);
+			m_traceCountWhenPatched = m_executor.GetTraceCount();
+
+			CMIPSAssembler assembler(reinterpret_cast<uint32*>(m_ram + PATCH_ADDRESS));
+			assembler.ADDIU(CMIPS::T1, CMIPS::T1, PATCH_INCREMENT);
+			m_executor.NotifyCodeWrite(PATCH_ADDRESS);
+		}
+		return 0;
+	}
+
+	CMIPS				m_cpu;
+	CMA_MIPSIV			m_cpuArch;
+	CTestExecutor		m_executor;
+	uint8*				m_ram = nullptr;
+
+	bool				m_tracedWhenPatched = false;
+	uint32				m_traceCountWhenPatched = 0;
+};
+
+static bool Check(bool condition, const char* description)
+{
+	printf("%s: %s\r\n", description, condition ? "passed" : "FAILED");
+	return condition;
+}
+
+int main(int argc, const char** argv)
+{
+	bool passed = true;
+
+	CTestVm virtualMachine;
+	virtualMachine.AssembleProgram();
+	virtualMachine.Execute();
+
+	passed &= Check(virtualMachine.WasTracedWhenPatched(), "Loop was running as a trace when patched");
+	passed &= Check(virtualMachine.GetRegister(CMIPS::T0) == ITERATION_COUNT, "Iteration count");
+
+	//The second block must run its new code in the same iteration the write happened
+	uint32 expectedValue = (PATCH_ITERATION - 1) + ((ITERATION_COUNT - PATCH_ITERATION + 1) * PATCH_INCREMENT);
+	passed &= Check(virtualMachine.GetRegister(CMIPS::T1) == expectedValue, "Execution left the trace after the write");
+
+	//There's enough iterations left for the loop to get hot again
+	passed &= Check(virtualMachine.GetTraceCount() > virtualMachine.GetTraceCountWhenPatched(), "Trace compiled again with the new code");
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,541 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "Types.h"
+#include "Ps2Const.h"
+#include "MIPS.h"
+#include "ee/GIF.h"
+#include "ee/Vif.h"
+#include "ee/Vpu.h"
+
+//Sends packets made of UNPACK commands to VIF0 and reports how fast every
+//format gets unpacked to VU memory. In verification mode, random command streams
+//are sent instead and the results are compared against a scalar implementation.
+
+#define DEFAULT_ITERATION_COUNT		(200)
+#define DEFAULT_VERIFY_STREAM_COUNT	(5000)
+#define UNPACK_COMMAND_COUNT		(64)
+#define UNPACK_VECTOR_COUNT			(256)
+#define PACKET_ADDRESS				(0x100000)
+#define VERIFY_COMMAND_COUNT_MAX	(40)
+#define VERIFY_PACKET_QWC_MAX		(20)
+
+typedef std::chrono::high_resolution_clock Clock;
+
+struct FORMAT_INFO
+{
+	const char*		name;
+	uint32			format;
+	uint32			elementSize;
+};
+
+static const FORMAT_INFO g_formats[] =
+{
+	{ "S-32",	0x00,	4 },
+	{ "S-16",	0x01,	2 },
+	{ "S-8",	0x02,	1 },
+	{ "V2-32",	0x04,	8 },
+	{ "V2-16",	0x05,	4 },
+	{ "V2-8",	0x06,	2 },
+	{ "V3-32",	0x08,	12 },
+	{ "V3-16",	0x09,	6 },
+	{ "V3-8",	0x0A,	3 },
+	{ "V4-32",	0x0C,	16 },
+	{ "V4-16",	0x0D,	8 },
+	{ "V4-8",	0x0E,	4 },
+	{ "V4-5",	0x0F,	2 },
+};
+
+struct SETTINGS
+{
+	uint32			cycleCl = 4;
+	uint32			cycleWl = 4;
+	uint32			mode = 0;
+	bool			useMask = false;
+	bool			unsignedData = false;
+};
+
+static void WriteWord(std::vector<uint8>& packet, uint32 value)
+{
+	packet.insert(packet.end(), reinterpret_cast<uint8*>(&value), reinterpret_cast<uint8*>(&value) + 4);
+}
+
+//Returns the amount of elements read from the stream for a given number of written vectors
+static uint32 GetReadCount(const SETTINGS& settings, uint32 writeCount)
+{
+	uint32 cl = settings.cycleCl;
+	uint32 wl = settings.cycleWl;
+	if((wl == 0) || (cl >= wl)) return writeCount;
+	return ((writeCount / wl) * cl) + std::min(writeCount % wl, cl);
+}
+
+static std::vector<uint8> MakePacket(const FORMAT_INFO& formatInfo, const SETTINGS& settings)
+{
+	std::vector<uint8> packet;
+
+	//STCYCL, STMOD, STMASK
+	WriteWord(packet, 0x01000000 | settings.cycleCl | (settings.cycleWl << 8));
+	WriteWord(packet, 0x05000000 | settings.mode);
+	WriteWord(packet, 0x20000000);
+	WriteWord(packet, 0xE4E4E4E4);
+
+	uint32 readSize = GetReadCount(settings, UNPACK_VECTOR_COUNT) * formatInfo.elementSize;
+	uint32 command = 0x60 | formatInfo.format | (settings.useMask ? 0x10 : 0);
+	uint32 immediate = settings.unsignedData ? 0x4000 : 0;
+	for(unsigned int i = 0; i < UNPACK_COMMAND_COUNT; i++)
+	{
+		//NUM = 0 unpacks 256 vectors, filling the whole VU0 memory
+		WriteWord(packet, (command << 24) | immediate);
+		for(uint32 j = 0; j < readSize; j++)
+		{
+			packet.push_back(static_cast<uint8>(rand()));
+		}
+		while(packet.size() & 0x03)
+		{
+			packet.push_back(0);
+		}
+	}
+
+	//Pad with NOPs to end on a quadword boundary
+	while(packet.size() & 0x0F)
+	{
+		WriteWord(packet, 0);
+	}
+
+	return packet;
+}
+
+//Scalar UNPACK, one element at a time, like VIF did before the specialized kernels
+struct REFERENCE_VIF
+{
+	uint32			cycleCl = 0;
+	uint32			cycleWl = 0;
+	uint32			mode = 0;
+	uint32			mask = 0;
+	uint32			row[4] = {};
+	uint32			col[4] = {};
+};
+
+static uint32 ReadWord(const std::vector<uint8>& stream, size_t& position)
+{
+	uint32 value = 0;
+	memcpy(&value, stream.data() + position, 4);
+	position += 4;
+	return value;
+}
+
+static void ReferenceReadElement(uint32 format, bool usn, const std::vector<uint8>& stream, size_t& position, uint32* value)
+{
+	memset(value, 0, sizeof(uint32) * 4);
+	if(format == 0x0F)
+	{
+		//V4-5
+		uint32 color = stream[position] | (stream[position + 1] << 8);
+		value[0] = ((color >>  0) & 0x1F) << 3;
+		value[1] = ((color >>  5) & 0x1F) << 3;
+		value[2] = ((color >> 10) & 0x1F) << 3;
+		value[3] = ((color >> 15) & 0x01) << 7;
+		position += 2;
+		return;
+	}
+	uint32 componentSize = 4 >> (format & 0x03);
+	uint32 componentCount = (format >> 2) + 1;
+	for(unsigned int i = 0; i < componentCount; i++)
+	{
+		uint32 component = 0;
+		memcpy(&component, stream.data() + position, componentSize);
+		if(!usn && (componentSize == 2)) component = static_cast<int16>(component);
+		if(!usn && (componentSize == 1)) component = static_cast<int8>(component);
+		value[i] = component;
+		position += componentSize;
+	}
+	if(componentCount == 1)
+	{
+		value[1] = value[2] = value[3] = value[0];
+	}
+}
+
+static void ReferenceUnpack(REFERENCE_VIF& vif, uint32 code, const std::vector<uint8>& stream, size_t& position, uint8* vuMem, uint32 vuMemSize)
+{
+	uint32 format = (code >> 24) & 0x0F;
+	bool useMask = (code & 0x10000000) != 0;
+	bool usn = (code & 0x4000) != 0;
+	uint32 num = (code >> 16) & 0xFF;
+	if(num == 0) num = 256;
+	uint32 address = ((code & 0x3FF) * 0x10) & (vuMemSize - 1);
+
+	uint32 cl = vif.cycleCl;
+	uint32 wl = vif.cycleWl;
+	if(wl == 0)
+	{
+		wl = UINT_MAX;
+		cl = UINT_MAX;
+	}
+
+	uint32 readTick = 0;
+	uint32 writeTick = 0;
+	while(num != 0)
+	{
+		uint32 value[4] = {};
+		bool mustWrite = true;
+		if(cl >= wl)
+		{
+			mustWrite = (readTick < wl);
+			if(mustWrite) ReferenceReadElement(format, usn, stream, position, value);
+		}
+		else if(writeTick < cl)
+		{
+			ReferenceReadElement(format, usn, stream, position, value);
+		}
+
+		if(mustWrite)
+		{
+			auto dst = reinterpret_cast<uint32*>(vuMem + address);
+			uint32 maskColumn = std::min<uint32>(writeTick, 3);
+			for(unsigned int i = 0; i < 4; i++)
+			{
+				uint32 maskOp = useMask ? ((vif.mask >> (((maskColumn * 4) + i) * 2)) & 0x03) : 0;
+				switch(maskOp)
+				{
+				case 0:
+					if(vif.mode == 1)
+					{
+						value[i] += vif.row[i];
+					}
+					else if(vif.mode == 2)
+					{
+						value[i] += vif.row[i];
+						vif.row[i] = value[i];
+					}
+					dst[i] = value[i];
+					break;
+				case 1:
+					dst[i] = vif.row[i];
+					break;
+				case 2:
+					dst[i] = vif.col[maskColumn];
+					break;
+				}
+			}
+			num--;
+		}
+
+		writeTick = std::min<uint32>(writeTick + 1, wl);
+		readTick = std::min<uint32>(readTick + 1, cl);
+		if(((cl >= wl) && (readTick == cl)) || ((cl < wl) && (writeTick == wl)))
+		{
+			writeTick = 0;
+			readTick = 0;
+		}
+
+		address = (address + 0x10) & (vuMemSize - 1);
+	}
+
+	position = (position + 3) & ~3;
+}
+
+static void ReferenceProcessStream(REFERENCE_VIF& vif, const std::vector<uint8>& stream, uint8* vuMem, uint32 vuMemSize)
+{
+	size_t position = 0;
+	while(position < stream.size())
+	{
+		uint32 code = ReadWord(stream, position);
+		uint32 command = code >> 24;
+		if(command >= 0x60)
+		{
+			ReferenceUnpack(vif, code, stream, position, vuMem, vuMemSize);
+			continue;
+		}
+		switch(command)
+		{
+		case 0x01:
+			vif.cycleCl = code & 0xFF;
+			vif.cycleWl = (code >> 8) & 0xFF;
+			break;
+		case 0x05:
+			vif.mode = code & 0x03;
+			break;
+		case 0x20:
+			vif.mask = ReadWord(stream, position);
+			break;
+		case 0x30:
+			for(unsigned int i = 0; i < 4; i++) vif.row[i] = ReadWord(stream, position);
+			break;
+		case 0x31:
+			for(unsigned int i = 0; i < 4; i++) vif.col[i] = ReadWord(stream, position);
+			break;
+		}
+	}
+}
+
+static uint32 RandomWord()
+{
+	return (static_cast<uint32>(rand()) << 16) ^ static_cast<uint32>(rand());
+}
+
+//Random mix of UNPACK and the commands that change how it writes
+static std::vector<uint8> MakeRandomStream()
+{
+	std::vector<uint8> stream;
+	SETTINGS settings;
+	settings.cycleCl = 0;
+	settings.cycleWl = 0;
+
+	unsigned int commandCount = 1 + (rand() % VERIFY_COMMAND_COUNT_MAX);
+	for(unsigned int i = 0; i < commandCount; i++)
+	{
+		switch(rand() % 8)
+		{
+		case 0:
+			settings.cycleCl = (rand() % 3) ? (rand() % 6) : 4;
+			settings.cycleWl = (rand() % 3) ? (rand() % 6) : 4;
+			WriteWord(stream, 0x01000000 | settings.cycleCl | (settings.cycleWl << 8));
+			break;
+		case 1:
+			WriteWord(stream, 0x05000000 | (rand() % 4));
+			break;
+		case 2:
+			WriteWord(stream, 0x20000000);
+			WriteWord(stream, RandomWord());
+			break;
+		case 3:
+		case 4:
+			WriteWord(stream, (i & 1) ? 0x30000000 : 0x31000000);
+			for(unsigned int j = 0; j < 4; j++) WriteWord(stream, RandomWord());
+			break;
+		default:
+			{
+				const auto& formatInfo = g_formats[rand() % (sizeof(g_formats) / sizeof(g_formats[0]))];
+				uint32 num = (rand() % 2) ? (rand() % 8) : (rand() % 256);
+				uint32 command = 0x60 | formatInfo.format | ((rand() % 2) ? 0x10 : 0);
+				uint32 immediate = (rand() % 0x400) | ((rand() % 2) ? 0x4000 : 0);
+				WriteWord(stream, (command << 24) | (num << 16) | immediate);
+				uint32 readSize = GetReadCount(settings, (num == 0) ? 256 : num) * formatInfo.elementSize;
+				for(uint32 j = 0; j < readSize; j++)
+				{
+					stream.push_back(static_cast<uint8>(rand()));
+				}
+				while(stream.size() & 0x03)
+				{
+					stream.push_back(0);
+				}
+			}
+			break;
+		}
+	}
+
+	return stream;
+}
+
+//Sends the stream in packets of random sizes, some of them with a DMA tag, so that elements get split across packets.
+//Packets with a tag are at least 2 quadwords long, VIF doesn't handle elements spanning more than two packets.
+static bool SendRandomPackets(CVif& vif, uint8* ram, const std::vector<uint8>& stream)
+{
+	uint32 address = PACKET_ADDRESS;
+	size_t position = 0;
+	while(position < stream.size())
+	{
+		bool tagIncluded = (rand() % 4) == 0;
+		uint32 tagSize = tagIncluded ? 8 : 0;
+		uint32 qwc = (tagIncluded ? 2 : 1) + (rand() % VERIFY_PACKET_QWC_MAX);
+		uint32 size = std::min<uint32>((qwc * 0x10) - tagSize, static_cast<uint32>(stream.size() - position));
+		qwc = (size + tagSize + 0x0F) / 0x10;
+
+		//Leftover space is filled with NOPs
+		memset(ram + address, 0, qwc * 0x10);
+		memcpy(ram + address + tagSize, stream.data() + position, size);
+		position += size;
+
+		if(vif.ReceiveDMA(address, qwc, 0, tagIncluded) != qwc) return false;
+		address += qwc * 0x10;
+	}
+	return true;
+}
+
+static unsigned int RunVerify(CVpu& vpu, uint8* ram, unsigned int streamCount)
+{
+	auto& vif = vpu.GetVif();
+	auto vuMem = vpu.GetVuMemory();
+	uint32 vuMemSize = vpu.GetVuMemorySize();
+	std::vector<uint8> referenceVuMem(vuMemSize);
+	unsigned int failureCount = 0;
+
+	for(unsigned int i = 0; i < streamCount; i++)
+	{
+		auto stream = MakeRandomStream();
+
+		vpu.Reset();
+		memset(vuMem, 0, vuMemSize);
+		bool processed = false;
+		try
+		{
+			processed = SendRandomPackets(vif, ram, stream);
+		}
+		catch(...)
+		{
+		}
+
+		REFERENCE_VIF reference;
+		std::fill(referenceVuMem.begin(), referenceVuMem.end(), 0);
+		ReferenceProcessStream(reference, stream, referenceVuMem.data(), vuMemSize);
+
+		bool rowMatches = true;
+		for(unsigned int j = 0; j < 4; j++)
+		{
+			rowMatches &= (vif.GetRegister(CVif::VIF0_R0 + (j * 0x10)) == reference.row[j]);
+		}
+
+		if(!processed || !rowMatches || memcmp(vuMem, referenceVuMem.data(), vuMemSize))
+		{
+			printf("Stream %d: %s.\r\n", i,
+				!processed ? "VIF stopped processing the packets" : (rowMatches ? "VU memory differs" : "row registers differ"));
+			failureCount++;
+		}
+	}
+
+	return failureCount;
+}
+
+static double RunFormat(CVpu& vpu, uint8* ram, const FORMAT_INFO& formatInfo, const SETTINGS& settings, unsigned int iterationCount)
+{
+	auto packet = MakePacket(formatInfo, settings);
+	memcpy(ram + PACKET_ADDRESS, packet.data(), packet.size());
+	uint32 qwc = static_cast<uint32>(packet.size() / 0x10);
+
+	vpu.Reset();
+	auto& vif = vpu.GetVif();
+
+	//Warm up once
+	vif.ReceiveDMA(PACKET_ADDRESS, qwc, 0, false);
+
+	auto startTime = Clock::now();
+	for(unsigned int i = 0; i < iterationCount; i++)
+	{
+		uint32 processed = vif.ReceiveDMA(PACKET_ADDRESS, qwc, 0, false);
+		if(processed != qwc)
+		{
+			printf("Error: VIF stopped processing the packet.\r\n");
+			return 0;
+		}
+	}
+	auto endTime = Clock::now();
+
+	return std::chrono::duration<double>(endTime - startTime).count();
+}
+
+int main(int argc, const char** argv)
+{
+	SETTINGS settings;
+	unsigned int iterationCount = DEFAULT_ITERATION_COUNT;
+	unsigned int verifyStreamCount = 0;
+	unsigned int seed = 0;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "--iterations") && ((i + 1) < argc))
+		{
+			iterationCount = std::max(atoi(argv[i + 1]), 1);
+			i++;
+		}
+		else if(!strcmp(argv[i], "--cycle") && ((i + 2) < argc))
+		{
+			settings.cycleCl = atoi(argv[i + 1]) & 0xFF;
+			settings.cycleWl = atoi(argv[i + 2]) & 0xFF;
+			i += 2;
+		}
+		else if(!strcmp(argv[i], "--mode") && ((i + 1) < argc))
+		{
+			settings.mode = atoi(argv[i + 1]) & 0x03;
+			i++;
+		}
+		else if(!strcmp(argv[i], "--mask"))
+		{
+			settings.useMask = true;
+		}
+		else if(!strcmp(argv[i], "--usn"))
+		{
+			settings.unsignedData = true;
+		}
+		else if(!strcmp(argv[i], "--verify"))
+		{
+			verifyStreamCount = DEFAULT_VERIFY_STREAM_COUNT;
+			if(((i + 1) < argc) && (atoi(argv[i + 1]) > 0))
+			{
+				verifyStreamCount = atoi(argv[i + 1]);
+				i++;
+			}
+		}
+		else if(!strcmp(argv[i], "--seed") && ((i + 1) < argc))
+		{
+			seed = atoi(argv[i + 1]);
+			i++;
+		}
+		else
+		{
+			printf("Usage: VifUnpackBenchmark [options]\r\n");
+			printf("Options: \r\n");
+			printf("\t --iterations <count>\t Number of times each packet is sent (default is %d).\r\n", DEFAULT_ITERATION_COUNT);
+			printf("\t --cycle <cl> <wl>\t CYCLE register values (default is 4 4).\r\n");
+			printf("\t --mode <mode>\t\t MODE register value (0: normal, 1: offset, 2: difference).\r\n");
+			printf("\t --mask\t\t\t Uses masked UNPACK commands.\r\n");
+			printf("\t --usn\t\t\t Zero extends 8-bit and 16-bit data.\r\n");
+			printf("\t --verify [count]\t Compares unpacked data from random command streams with a scalar implementation (default is %d streams).\r\n", DEFAULT_VERIFY_STREAM_COUNT);
+			printf("\t --seed <seed>\t\t Seed used to generate packet data.\r\n");
+			return -1;
+		}
+	}
+
+	auto ram = new uint8[PS2::EE_RAM_SIZE];
+	auto spr = new uint8[PS2::EE_SPR_SIZE];
+	auto microMem = new uint8[PS2::MICROMEM0SIZE];
+	auto vuMem = new uint8[PS2::VUMEM0SIZE];
+	memset(ram, 0, PS2::EE_RAM_SIZE);
+	memset(spr, 0, PS2::EE_SPR_SIZE);
+	memset(microMem, 0, PS2::MICROMEM0SIZE);
+	memset(vuMem, 0, PS2::VUMEM0SIZE);
+
+	CGSHandler* gs = nullptr;
+	CMIPS context(MEMORYMAP_ENDIAN_LSBF);
+	CGIF gif(gs, ram, spr);
+
+	srand(seed);
+
+	int result = 0;
+	{
+		CVpu vpu(0, CVpu::VPUINIT(microMem, vuMem, &context), gif, ram, spr);
+
+		if(verifyStreamCount != 0)
+		{
+			unsigned int failureCount = RunVerify(vpu, ram, verifyStreamCount);
+			printf("%d of %d stream(s) matched.\r\n", verifyStreamCount - failureCount, verifyStreamCount);
+			result = (failureCount == 0) ? 0 : 1;
+		}
+		else
+		{
+			printf("CYCLE: CL = %d, WL = %d, MODE: %d, mask: %s, %d iteration(s).\r\n",
+				settings.cycleCl, settings.cycleWl, settings.mode, settings.useMask ? "yes" : "no", iterationCount);
+			printf("\r\n%-8s %12s %16s %12s\r\n", "Format", "Time (ms)", "Mvectors/s", "MB/s read");
+
+			for(const auto& formatInfo : g_formats)
+			{
+				double seconds = RunFormat(vpu, ram, formatInfo, settings, iterationCount);
+				double vectorCount = static_cast<double>(UNPACK_COMMAND_COUNT) * UNPACK_VECTOR_COUNT * iterationCount;
+				double readSize = static_cast<double>(UNPACK_COMMAND_COUNT) * GetReadCount(settings, UNPACK_VECTOR_COUNT) * formatInfo.elementSize * iterationCount;
+				printf("%-8s %12.3f %16.3f %12.3f\r\n", formatInfo.name, seconds * 1000.0,
+					(seconds != 0) ? (vectorCount / (seconds * 1e6)) : 0.0,
+					(seconds != 0) ? (readSize / (seconds * 1024.0 * 1024.0)) : 0.0);
+			}
+		}
+	}
+
+	delete [] vuMem;
+	delete [] microMem;
+	delete [] spr;
+	delete [] ram;
+
+	return result;
+}